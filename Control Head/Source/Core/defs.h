@@ -122,7 +122,18 @@
 
 /******************************************************
  * General definitions for making the code easier to understand */
-#define ROTARY_SYNC_DELAY 100
+#define ROTARY_REST_STATE 0x03         /* A and B both high (pulled up) while the knob sits in a detent */
+#define ROTARY_MEDIUM_TICKS 40          /* detents arriving within this many ticks of each other are a medium-speed spin */
+#define ROTARY_FAST_TICKS 15            /* ... and within this many, a fast spin */
+#define ROTARY_STEP_MEDIUM_HZ 1000L     /* minimum tuning step per detent during a medium-speed spin */
+#define ROTARY_STEP_FAST_HZ 100000L     /* minimum tuning step per detent during a fast spin */
+
+typedef enum
+{
+	ROTARY_SLOW,
+	ROTARY_MEDIUM,
+	ROTARY_FAST
+} RotarySpeed;
 
 #define         SDA_PIN (1 << PINC4)
 #define         SCL_PIN (1 << PINC5)
@@ -188,6 +199,15 @@ typedef enum
 
 #define BEEP_SHORT 100
 
+/******************************************************
+ * Signal strength meter */
+#define RSSI_FULL_SCALE_MV 3300
+#define RSSI_CONVERSION_TICKS 25        /* receiver RSSI sampling period; also the minimum interval between RSSI broadcasts */
+#define RSSI_METER_CELLS 16             /* bar graph width in characters; the reading is shown in the remaining columns */
+#define RSSI_METER_STEPS (RSSI_METER_CELLS * LCD_GLYPH_COLUMNS)
+#define RSSI_PEAK_HOLD_TICKS 600        /* peak marker stays put this long after the last new peak */
+#define RSSI_PEAK_DECAY_TICKS 20        /* then falls one step per this many ticks */
+
 /******************************************************
  * UI Hardware-related definitions */
 
@@ -54,6 +54,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 #include <avr/wdt.h>
 
 /***********************************************************************
@@ -106,7 +107,8 @@ typedef enum
 #endif  /* PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD */
 
 static volatile MenuType g_menu_state = MENU_MAIN;
-static volatile int16_t g_rotary_count = 0;
+static volatile int16_t g_rotary_count = 0;  /* detents */
+static volatile RotarySpeed g_rotary_speed = ROTARY_SLOW;
 
 /* Pushbutton Defines */
 static volatile uint16_t g_button0_press_ticks = FALSE;
@@ -271,8 +273,8 @@ static volatile uint8_t g_receiver_port_shadow = 0xff; // keep track of port val
    #define NUMBER_OF_POLLED_ADC_CHANNELS 3
 	static const uint8_t activeADC[NUMBER_OF_POLLED_ADC_CHANNELS] = { RF_LEVEL, BAT_VOLTAGE, RSSI_LEVEL };
 
-	static const uint16_t g_adcChannelConversionPeriod_ticks[NUMBER_OF_POLLED_ADC_CHANNELS] = { 1000, 1000, 100 };
-	static volatile uint16_t g_tickCountdownADCFlag[NUMBER_OF_POLLED_ADC_CHANNELS] = { 1000, 1000, 100 };
+	static const uint16_t g_adcChannelConversionPeriod_ticks[NUMBER_OF_POLLED_ADC_CHANNELS] = { 1000, 1000, RSSI_CONVERSION_TICKS };
+	static volatile uint16_t g_tickCountdownADCFlag[NUMBER_OF_POLLED_ADC_CHANNELS] = { 1000, 1000, RSSI_CONVERSION_TICKS };
 	static uint16_t g_filterADCValue[NUMBER_OF_POLLED_ADC_CHANNELS] = { 500, 500, 3 };
 	static volatile BOOL g_adcUpdated[NUMBER_OF_POLLED_ADC_CHANNELS] = { FALSE, FALSE, FALSE };
 	static volatile uint16_t g_lastConversionResult[NUMBER_OF_POLLED_ADC_CHANNELS];
@@ -289,7 +291,6 @@ static volatile uint16_t g_headphone_removed_delay = HEADPHONE_REMOVED_DELAY;
 static volatile uint16_t g_low_voltage_shutdown_delay = LOW_VOLTAGE_DELAY;
 static volatile uint16_t g_backlight_off_countdown = BACKLIGHT_ALWAYS_ON;
 static uint16_t g_backlight_delay_value = BACKLIGHT_ALWAYS_ON;
-extern volatile BOOL g_i2c_not_timed_out;
 static volatile BOOL g_sufficient_power_detected = FALSE;
 static volatile BOOL g_enableHardwareWDResets = FALSE;
 
@@ -320,6 +321,85 @@ LcdColType columnForDigit(int8_t digit, TextFormat format);
 
 #endif  /* PRODUCT_TEST_INSTRUMENT_HEAD */
 
+#if PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD
+
+	BOOL menuCurrentPage(MenuType menu, uint8_t displayedSubMenu[], MenuPage* page);
+	uint8_t menuPageCount(MenuType menu);
+	void menuShowPage(MenuType menu, uint8_t displayedSubMenu[]);
+	void menuNextPage(MenuType menu, uint8_t displayedSubMenu[]);
+	void menuKnob(MenuType menu, uint8_t displayedSubMenu[], BOOL up);
+	void menuUpdateValue(MenuType menu, uint8_t displayedSubMenu[]);
+
+	void knobToneVolume(BOOL up);
+	void knobMainVolume(BOOL up);
+	void knobBacklight(BOOL up);
+	void knobContrast(BOOL up);
+	void showBattery(BOOL show);
+	void showRSSI(BOOL show);
+	BOOL valueTemperature(char* buf);
+	BOOL valueBattery(char* buf);
+	BOOL valueRSSI(char* buf);
+
+   #if PRODUCT_CONTROL_HEAD
+
+		void printMeter(char* buf, uint8_t level, uint8_t peak);
+
+   #else
+
+		void knobBand(BOOL up);
+		void showBand(BOOL show);
+
+   #endif   /* PRODUCT_CONTROL_HEAD */
+
+/***********************************************************************
+ * Menu Page Table
+ *
+ * Interpreted by the menuXxx() functions below
+ ************************************************************************/
+
+	static const MenuPage g_menu_pages[] PROGMEM =
+	{
+   #if PRODUCT_TEST_INSTRUMENT_HEAD
+		{ MENU_BAND, BUTTON1, textBandSelect, knobBand, 100, showBand, NULL },
+   #endif
+		{ MENU_VOLUME, BUTTON4, textToneVolume, knobToneVolume, 50, NULL, NULL },
+		{ MENU_VOLUME, BUTTON4, textMainVolume, knobMainVolume, 50, NULL, NULL },
+		{ MENU_LCD, BUTTON4, textBacklight, knobBacklight, 0, NULL, NULL },
+		{ MENU_LCD, BUTTON4, textContrast, knobContrast, 0, NULL, NULL },
+		{ MENU_STATUS, BUTTON1, textTemperature, NULL, 0, NULL, valueTemperature },
+		{ MENU_STATUS, BUTTON1, textBattery, NULL, 0, showBattery, valueBattery },
+		{ MENU_STATUS, BUTTON1, textRSSI, NULL, 0, showRSSI, valueRSSI }
+	};
+
+   #define NUMBER_OF_MENU_PAGES (sizeof(g_menu_pages) / sizeof(MenuPage))
+
+   #if PRODUCT_CONTROL_HEAD
+
+/***********************************************************************
+ * Signal Meter Glyphs
+ *
+ * Loaded into CGRAM at start up. A bar cell holds 1 to 5 lit columns;
+ * the peak marker is a thin line in the middle of an otherwise empty cell.
+ ************************************************************************/
+
+		#define METER_GLYPH_FULL (LCD_GLYPH_COLUMNS - 1)
+		#define METER_GLYPH_PEAK LCD_GLYPH_COLUMNS
+		#define NUMBER_OF_METER_GLYPHS (LCD_GLYPH_COLUMNS + 1)
+
+		static const uint8_t g_meter_glyphs[NUMBER_OF_METER_GLYPHS][LCD_GLYPH_ROWS] PROGMEM =
+		{
+			{ 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 },
+			{ 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00 },
+			{ 0x00, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x00 },
+			{ 0x00, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x00 },
+			{ 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x00 },
+			{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }
+		};
+
+   #endif   /* PRODUCT_CONTROL_HEAD */
+
+#endif  /* PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD */
+
 /***********************************************************************
  * Watchdog Timer ISR
  *
@@ -369,6 +449,7 @@ ISR( TIMER2_COMPB_vect )
 	static int8_t indexConversionInProcess;
 
 	g_tick_count++;
+	i2c_tick();
 	g_pressed_button_ticks++;
 
 	if(g_power_off_countdown)
@@ -401,9 +482,6 @@ ISR( TIMER2_COMPB_vect )
 
 #if PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD
 
-		static uint16_t holdRotaryCount = 0;
-		static uint8_t rotaryNoMotionCountdown = ROTARY_SYNC_DELAY;
-
 		if(g_backlight_off_countdown && (g_backlight_off_countdown != BACKLIGHT_ALWAYS_ON))
 		{
 			g_backlight_off_countdown--;
@@ -421,30 +499,7 @@ ISR( TIMER2_COMPB_vect )
 			g_time_update_countdown--;
 		}
 
-		/**********************
-		 * This is a kluge that helps ensure that the rotary encoder count remains in sync with the
-		 * encoder's indents. This kluge seems to be necessary because when the encoder is turned
-		 * rapidly (and especially if the direction of turn reverses) a transition can be missed,
-		 * causing indents to no longer align. Testing indicates that this re-alignment is rarely needed,
-		 * but when it is provided it improves user experience. */
-		if(holdRotaryCount == g_rotary_count)
-		{
-			rotaryNoMotionCountdown--;  /* underflow of the countdown is harmless */
-
-			if(!rotaryNoMotionCountdown)
-			{
-				if(g_rotary_count % 4)  /* need to make the count be a multiple of 4 edges */
-				{
-					g_rotary_count += 2;
-					g_rotary_count = ((g_rotary_count >> 2) << 2);
-				}
-			}
-		}
-		else
-		{
-			rotaryNoMotionCountdown = ROTARY_SYNC_DELAY;
-			holdRotaryCount = g_rotary_count;
-		}
+		LCD_tick();
 
 #elif PRODUCT_DUAL_BAND_RECEIVER || PRODUCT_TEST_DIGITAL_INTERFACE
 
@@ -632,6 +687,70 @@ ISR( TIMER2_COMPB_vect )
 }/* ISR */
 
 
+/***********************************************************************
+ * Rotary Encoder Decoding
+ *
+ * Each change of the A/B signals is looked up in a table indexed by the
+ * previous and current states. Transitions in which both signals changed
+ * are invalid and contribute nothing. A detent is counted only when the
+ * encoder arrives at its rest state having traversed more than half of a
+ * quadrature cycle, so a missed or rejected edge cannot leave the count
+ * out of step with the detents. The interval between detents sets
+ * g_rotary_speed, which ramps up one level per detent and drops back at
+ * once when turning slows or reverses.
+ ************************************************************************/
+	static const int8_t g_quad_transitions[16] = { 0, 1, -1, 0, -1, 0, 0, 1, 1, 0, 0, -1, 0, -1, 1, 0 };
+
+	static inline void rotaryDecode(uint8_t pins)
+	{
+		static uint8_t lastState = ROTARY_REST_STATE;
+		static int8_t edges = 0;
+		static int8_t lastDirection = 0;
+		static uint16_t lastDetentTick = 0;
+		uint8_t state = (pins & QUAD_MASK) >> QUAD_B;
+		uint16_t interval;
+		int8_t direction;
+		RotarySpeed speed;
+
+		edges += g_quad_transitions[(lastState << 2) | state];
+		lastState = state;
+
+		if(state != ROTARY_REST_STATE)
+		{
+			return;
+		}
+
+		if((edges < 2) && (edges > -2))  /* returned to the same detent */
+		{
+			edges = 0;
+			return;
+		}
+
+		direction = (edges > 0) ? 1 : -1;
+		edges = 0;
+		g_rotary_count += direction;
+
+		interval = g_tick_count - lastDetentTick;
+		lastDetentTick = g_tick_count;
+
+		if((direction != lastDirection) || (interval > ROTARY_MEDIUM_TICKS))
+		{
+			speed = ROTARY_SLOW;
+		}
+		else if(interval > ROTARY_FAST_TICKS)
+		{
+			speed = ROTARY_MEDIUM;
+		}
+		else
+		{
+			speed = ROTARY_FAST;
+		}
+
+		g_rotary_speed = (speed > g_rotary_speed) ? g_rotary_speed + 1 : speed;
+		lastDirection = direction;
+	}
+
+
 #if PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD
 
 /***********************************************************************
@@ -692,39 +811,13 @@ ISR( TIMER2_COMPB_vect )
 
 		quad = changedbits & QUAD_MASK; /* A and B for quadrature rotary encoder */
 
-		/* Note: the following logic results in the count incrementing by 4 for each full
-		 * quadrature cycle. The click count can be derived by shifting right twice (dividing
-		 * by four). */
+		/* Note: g_rotary_count changes by one for each detent (full quadrature cycle) */
 		if(quad)
 		{
 			g_backlight_off_countdown = g_backlight_delay_value;    /* keep backlight illuminated */
 			g_power_off_countdown = POWER_OFF_DELAY;                /* restart countdown */
 
-			BOOL _asignal = (PINB & (1 << QUAD_A)) >> QUAD_A;
-			BOOL _bsignal = (PINB & (1 << QUAD_B)) >> QUAD_B;
-
-			if(quad == (1 << QUAD_A))   /* "A" changed */
-			{
-				if(_asignal == _bsignal)
-				{
-					g_rotary_count++;
-				}
-				else
-				{
-					g_rotary_count--;
-				}
-			}
-			else if(quad == (1 << QUAD_B))  /* "B" changed */
-			{
-				if(_asignal == _bsignal)
-				{
-					g_rotary_count--;
-				}
-				else
-				{
-					g_rotary_count++;
-				}
-			}
+			rotaryDecode(portBhistory);
 		}
 	}
 
@@ -774,39 +867,13 @@ ISR( TIMER2_COMPB_vect )
 
 		quad = changedbits & QUAD_MASK; /* A and B for quadrature rotary encoder */
 
-		/* Note: the following logic results in the count incrementing by 4 for each full
-		 * quadrature cycle. The click count can be derived by shifting right twice (dividing
-		 * by four). */
+		/* Note: g_rotary_count changes by one for each detent (full quadrature cycle) */
 		if(quad)
 		{
 			g_backlight_off_countdown = g_backlight_delay_value;    /* keep backlight illuminated */
 			g_power_off_countdown = POWER_OFF_DELAY;                /* restart countdown */
 
-			BOOL _asignal = (PINB & (1 << QUAD_A)) >> QUAD_A;
-			BOOL _bsignal = (PINB & (1 << QUAD_B)) >> QUAD_B;
-
-			if(quad == (1 << QUAD_A))   /* "A" changed */
-			{
-				if(_asignal == _bsignal)
-				{
-					g_rotary_count++;
-				}
-				else
-				{
-					g_rotary_count--;
-				}
-			}
-			else if(quad == (1 << QUAD_B))  /* "B" changed */
-			{
-				if(_asignal == _bsignal)
-				{
-					g_rotary_count--;
-				}
-				else
-				{
-					g_rotary_count++;
-				}
-			}
+			rotaryDecode(portBhistory);
 		}
 	}
 
@@ -1020,6 +1087,17 @@ ISR( TIMER2_COMPB_vect )
 #endif  /* PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD */
 
 
+/***********************************************************************
+ * TWI ISR
+ *
+ * Advances the I2C transaction in progress by one bus event.
+ ************************************************************************/
+ISR( TWI_vect )
+{
+	i2c_twi_interrupt();
+}
+
+
 /***********************************************************************
  * Watchdog Timeout ISR
  *
@@ -1031,7 +1109,7 @@ ISR(WDT_vect)
 {
 	static uint8_t limit = 10;
 
-	g_i2c_not_timed_out = FALSE;    /* unstick I2C */
+	i2c_reset();                    /* unstick I2C */
 	saveAllEEPROM();                /* Make sure changed values get saved */
 
 	/* Don't allow an unlimited number of WD interrupts to occur without enabling
@@ -1603,6 +1681,11 @@ int main( void )
 	 * Enable watchdog interrupts before performing I2C calls that might cause a lockup */
 	wdt_init(WD_SW_RESETS);
 
+	/**
+	 * Select the fastest bus speed each I2C device supports */
+	i2c_init();
+	i2c_probe();
+
 	/**
 	 * Initialize the receiver */
 
@@ -1627,6 +1710,15 @@ int main( void )
 
 #if PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD
 		LCD_init(NUMBER_OF_LCD_ROWS, NUMBER_OF_LCD_COLS, LCD_I2C_SLAVE_ADDRESS, g_contrast_setting);
+
+   #if PRODUCT_CONTROL_HEAD
+
+			for(uint8_t i = 0; i < NUMBER_OF_METER_GLYPHS; i++)
+			{
+				LCD_load_glyph_P(i, g_meter_glyphs[i]);
+			}
+
+   #endif   /* PRODUCT_CONTROL_HEAD */
 #else
 		ad5245_set_potentiometer(g_tone_volume);    /* move to receiver initialization */
 //		pcf8574_writePort(0b00000000); /* initialize receiver port expander */
@@ -1676,6 +1768,15 @@ int main( void )
 		**************************************/
 		cli(); wdt_reset(); /* HW watchdog */ sei();
 
+#if PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD
+
+			/**************************************
+			 * Send any changed display cells
+			 ***************************************/
+			LCD_flush();
+
+#endif  /* PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD */
+
 #if PRODUCT_DUAL_BAND_RECEIVER || PRODUCT_TEST_DIGITAL_INTERFACE
 
 			/**************************************
@@ -2757,156 +2858,14 @@ int main( void )
 						}
 						break;
 
-						case MENU_STATUS:
-						{
-							if(g_adcUpdated[displayedSubMenu])
-							{
-								BOOL printADCResult = FALSE;
-								g_adcUpdated[displayedSubMenu] = FALSE;
-
-								switch(displayedSubMenu[BUTTON1])
-								{
-									case 0:                                                                                     /* Temperature */
-									{
-										int32_t t = 100 * (1866 - g_lastConversionResult[displayedSubMenu[BUTTON4]]) / 1169;    /* degrees C for LM20 */
-										BOOL neg = FALSE;
-										if(t < 0)
-										{
-											neg = TRUE;
-											t = -t;
-										}
-
-										sprintf(g_tempBuffer, "%s%2ldC  ", neg ? "-" : "+", t);
-										updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
-										printADCResult = TRUE;
-									}
-
-									/* intentional fall-through */
-									case 1:                                                                                                                                                                         /* Battery Voltage */
-									{
-										if(!printADCResult)
-										{
-											uint16_t v = (uint16_t)( ( 1000 * ( (uint32_t)(g_lastConversionResult[displayedSubMenu[BUTTON4]] + POWER_SUPPLY_VOLTAGE_DROP_MV) ) ) / BATTERY_VOLTAGE_COEFFICIENT );   /* round up and adjust for voltage divider and drops */
-											int16_t pc = -1;
-
-											if(g_battery_type == BATTERY_4r2V)
-											{
-												pc = (v < 3200) ? 0 : MIN(5 * ((v - 3150) / 50), 100);
-											}
-											else if(g_battery_type == BATTERY_9V)
-											{
-												pc = (v < 7000) ? 0 : MIN(5 * ((v - 6950) / 100), 100);
-											}
-
-											sprintf(g_tempBuffer, "%1u.%02uV",  v / 1000, (v / 10) % 100);
-											updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
-
-											if(pc >= 0)
-											{
-												sprintf(g_tempBuffer, "%s (%d%%) ",  g_tempBuffer, pc);
-												updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
-											}
-
-											printADCResult = TRUE;
-										}
-									}
-
-									/* intentional fall-through */
-									case 2: /* RSSI */
-									{
-										if(!printADCResult)
-										{
-											if(g_RSSI_data != WAITING_FOR_UPDATE)
-											{
-												sprintf(g_tempBuffer, "S: %d/3300mV    ",  g_RSSI_data);
-												updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
-												printADCResult = TRUE;
-												g_RSSI_data = WAITING_FOR_UPDATE;
-											}
-										}
-									}
-									break;
-
-									default:
-									{
-									}
-									break;
-								}
-
-								if(printADCResult)
-								{
-									LCD_print_row(g_textBuffer[ROW1], ROW1);
-								}
-							}
-						}
-						break;
-
-   #elif PRODUCT_CONTROL_HEAD
-
-						case MENU_STATUS:
-						{
-							BOOL caseHandled = FALSE;
-							BOOL printResult = FALSE;
-							clearTextBuffer(ROW1);
-
-							switch(displayedSubMenu[BUTTON1])
-							{
-								case 0: /* Temperature */
-								{
-									updateLCDTextBuffer(g_textBuffer[ROW1], "N/A", FALSE);
-									printResult = TRUE;
-									caseHandled = TRUE;
-								}
-
-								/* intentional fall-through */
-								case 1: /* Battery Voltage */
-								{
-									if(!caseHandled)
-									{
-										if(g_Battery_data != WAITING_FOR_UPDATE)
-										{
-											sprintf(g_tempBuffer, " %dmV    ",  g_Battery_data);
-											updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
-											g_Battery_data = WAITING_FOR_UPDATE;
-											printResult = TRUE;
-										}
-
-										caseHandled = TRUE;
-									}
-								}
-
-								/* intentional fall-through */
-								case 2: /* RSSI */
-								{
-									if(!caseHandled)
-									{
-										if(g_RSSI_data != WAITING_FOR_UPDATE)
-										{
-											sprintf(g_tempBuffer, " %d/3300mV    ",  g_RSSI_data);
-											updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
-											g_RSSI_data = WAITING_FOR_UPDATE;
-											printResult = TRUE;
-										}
-									}
-								}
-								break;
-
-								default:
-								{
-								}
-								break;
-							}
-
-							if(printResult)
-							{
-								LCD_print_row(g_textBuffer[ROW1], ROW1);
-							}
-						}
-						break;
-
-
    #endif   /* PRODUCT_TEST_INSTRUMENT_HEAD */
 
+					case MENU_STATUS:
+					{
+						menuUpdateValue(holdMenuState, displayedSubMenu);
+					}
+					break;
+
 						case MENU_POWER_OFF:
 						{
 							static uint8_t lastCountdown = 0;
@@ -3162,7 +3121,7 @@ int main( void )
 							uint16_t v = g_lastConversionResult[RSSI_READING];  /* round up and adjust for voltage divider */
 							lb_broadcast_rssi(v);
 							g_adcUpdated[RSSI_READING] = FALSE;
-							g_LB_broadcast_interval = 100;                      /* minimum delay before next broadcast */
+							g_LB_broadcast_interval = RSSI_CONVERSION_TICKS;    /* minimum delay before next broadcast */
 						}
 					}
 
@@ -3198,36 +3157,13 @@ int main( void )
 			/*********************************
 			* Handle Rotary Encoder Turns
 			*********************************/
-			newCount = g_rotary_count / 4;
+			newCount = g_rotary_count;
 			if(newCount != holdCount)
 			{
 				switch(holdMenuState)
 				{
    #if PRODUCT_TEST_INSTRUMENT_HEAD
 
-						case MENU_BAND:
-						{
-							if(!g_menu_delay_countdown) /* slow things down to prevent double increments if dial clicks more than once */
-							{
-								RadioBand band = dual_band_receiver.bandSetting;
-
-								if(band == BAND_80M)
-								{
-									band = BAND_2M;
-								}
-								else
-								{
-									band = BAND_80M;
-								}
-
-								lb_send_BND(LINKBUS_MSG_QUERY, band);
-
-								holdMenuState = NUMBER_OF_MENUS;
-								g_menu_delay_countdown = 100;
-							}
-						}
-						break;
-
 						case MENU_SI5351:
 						{
 							int8_t hold = selectedField;
@@ -3243,100 +3179,37 @@ int main( void )
 
    #endif   /* PRODUCT_TEST_INSTRUMENT_HEAD */
 
+   #if PRODUCT_TEST_INSTRUMENT_HEAD
+						case MENU_BAND:
+   #endif
 					case MENU_LCD:
+					case MENU_VOLUME:
 					{
-						if(displayedSubMenu[BUTTON4] == 0)
-						{
-							uint8_t up = newCount > holdCount;
+						menuKnob(holdMenuState, displayedSubMenu, newCount > holdCount);
+					}
+					break;
 
-							switch(g_backlight_setting)
+					case MENU_REMOTE_DEVICE:
+					{
+						if(!cursorOFF)
+						{
+							int32_t inc = 1;
+							for(uint8_t i = 0; i < selectedField; inc *= 10, i++)
 							{
-								case BL_OFF:
-								{
-									g_backlight_setting = up ? BL_LOW : BL_OFF;
-								}
-								break;
-
-								case BL_LOW:
-								{
-									g_backlight_setting = up ? BL_MED : BL_OFF;
-								}
-								break;
-
-								case BL_MED:
-								{
-									g_backlight_setting = up ? BL_HIGH : BL_LOW;
-								}
-								break;
-
-								default:
-								{
-									g_backlight_setting = up ? BL_HIGH : BL_MED;
-								}
-								break;
+								;
 							}
 
-							OCR1BH = g_backlight_setting;   /* set PWM duty cycle @ 16bit */
-							OCR1BL = 0xFF;
-						}
-						else
-						{
-							if(newCount > holdCount)
+							/* Spinning the knob quickly overrides small steps */
+							if(g_rotary_speed == ROTARY_FAST)
 							{
-								if(g_contrast_setting < 0x0F)
-								{
-									g_contrast_setting++;
-								}
+								inc = MAX(inc, ROTARY_STEP_FAST_HZ);
 							}
-							else
+							else if(g_rotary_speed == ROTARY_MEDIUM)
 							{
-								if(g_contrast_setting)
-								{
-									g_contrast_setting--;
-								}
+								inc = MAX(inc, ROTARY_STEP_MEDIUM_HZ);
 							}
 
-							LCD_set_contrast(g_contrast_setting);
-						}
-					}
-					break;
-
-					case MENU_VOLUME:
-					{
-						if(!g_menu_delay_countdown) /* slow things down to prevent double increments if dial clicks more than once */
-						{
-							uint8_t up = newCount > holdCount;
-
-							if(displayedSubMenu[BUTTON4] == 0)
-							{
-								lb_send_VOL(LINKBUS_MSG_QUERY, TONE_VOLUME, up ? INCREMENT_VOL : DECREMENT_VOL);
-							}
-							else
-							{
-								lb_send_VOL(LINKBUS_MSG_QUERY, MAIN_VOLUME, up ? INCREMENT_VOL : DECREMENT_VOL);
-							}
-
-							g_menu_delay_countdown = 50;
-						}
-					}
-					break;
-
-					case MENU_REMOTE_DEVICE:
-					{
-						if(!cursorOFF)
-						{
-							int32_t inc = 1;
-							for(uint8_t i = 0; i < selectedField; inc *= 10, i++)
-							{
-								;
-							}
-
-							if(newCount < holdCount)
-							{
-								inc = -inc;
-							}
-
-							g_receiver_freq += inc;
+							g_receiver_freq += inc * (newCount - holdCount);    /* every detent counts, however many arrived since the last pass */
 							lb_send_FRE(LINKBUS_MSG_QUERY, g_receiver_freq, FALSE);
 							g_cursor_active_countdown = CURSOR_EXPIRATION_DELAY;
 						}
@@ -3401,17 +3274,6 @@ int main( void )
 				{
    #if PRODUCT_TEST_INSTRUMENT_HEAD
 
-						case MENU_BAND:
-						{
-							g_labels[BUTTON1] = textBandSelect;
-							g_labels[BUTTON3] = (dual_band_receiver.bandSetting == BAND_80M) ? " 80m" : "  2m";
-							g_labels[BUTTON2] = g_labels[BUTTON4] = NULL_CHAR;
-							printButtons(g_textBuffer[ROW0], (char**)g_labels);
-							updateLCDTextBuffer(g_textBuffer[ROW1], (char*)textTurnKnob, FALSE);
-							LCD_print_screen(g_textBuffer);
-						}
-						break;
-
 						case MENU_SI5351:
 						{
 							Frequency_Hz f;
@@ -3449,70 +3311,14 @@ int main( void )
 
    #endif   /* PRODUCT_TEST_INSTRUMENT_HEAD */
 
+   #if PRODUCT_TEST_INSTRUMENT_HEAD
+						case MENU_BAND:
+   #endif
 					case MENU_LCD:
-					{
-						if(displayedSubMenu[BUTTON4] == 0)
-						{
-							g_labels[BUTTON1] = textBacklight;
-							g_labels[BUTTON2] = g_labels[BUTTON3] = NULL_CHAR;
-							g_labels[BUTTON4] = textMore;
-						}
-						else
-						{
-							g_labels[BUTTON1] = textContrast;
-							g_labels[BUTTON2] = g_labels[BUTTON3] = NULL_CHAR;
-							g_labels[BUTTON4] = textMore;
-						}
-
-						printButtons(g_textBuffer[ROW0], (char**)g_labels);
-						updateLCDTextBuffer(g_textBuffer[ROW1], (char*)textTurnKnob, FALSE);
-						LCD_print_screen(g_textBuffer);
-					}
-					break;
-
 					case MENU_VOLUME:
-					{
-						if(displayedSubMenu[BUTTON4] == 0)
-						{
-							g_labels[BUTTON1] = textToneVolume;
-						}
-						else    /* if(displayedSubMenu[BUTTON4] == 1) */
-						{
-							g_labels[BUTTON1] = textMainVolume;
-						}
-
-						g_labels[BUTTON2] = g_labels[BUTTON3] = NULL_CHAR;
-						g_labels[BUTTON4] = textMore;
-
-						printButtons(g_textBuffer[ROW0], (char**)g_labels);
-						updateLCDTextBuffer(g_textBuffer[ROW1], (char*)textTurnKnob, FALSE);
-						LCD_print_screen(g_textBuffer);
-					}
-					break;
-
 					case MENU_STATUS:
 					{
-						/*LCD_TEMP, BAT_VOLTAGE, RSSI_LEVEL (remote) */
-						if(displayedSubMenu[BUTTON1] == 0)
-						{
-							g_labels[BUTTON1] = textTemperature;
-						}
-						else if(displayedSubMenu[BUTTON1] == 1)
-						{
-							g_labels[BUTTON1] = textBattery;
-							lb_send_BCR(BATTERY_BROADCAST, ON);
-						}
-						else
-						{
-							g_labels[BUTTON1] = textRSSI;
-							lb_send_BCR(RSSI_BROADCAST, ON);
-						}
-
-						g_labels[BUTTON2] = g_labels[BUTTON3] = g_labels[BUTTON4] = NULL_CHAR;
-
-						printButtons(g_textBuffer[ROW0], (char**)g_labels);
-						clearTextBuffer(ROW1);
-						LCD_print_screen(g_textBuffer);
+						menuShowPage(tempMenuState, displayedSubMenu);
 					}
 					break;
 
@@ -3655,21 +3461,7 @@ int main( void )
 
 						case MENU_STATUS:
 						{
-							if(displayedSubMenu[BUTTON1] == 0)      /* Temperature */
-							{
-								lb_send_BCR(RSSI_BROADCAST, OFF);
-							}
-							else if(displayedSubMenu[BUTTON1] == 1) /* Battery */
-							{
-								lb_send_BCR(UPC_TEMP_BROADCAST, OFF);
-							}
-							else                                    /* RSSI */
-							{
-								lb_send_BCR(BATTERY_BROADCAST, OFF);
-							}
-
-							displayedSubMenu[BUTTON1]++;
-							displayedSubMenu[BUTTON1] %= 3;
+							menuNextPage(holdMenuState, displayedSubMenu);
 							holdMenuState = LEAVE_MENU_UNCHANGED;   /* Ensure the screen is updated */
 						}
 						break;
@@ -3820,14 +3612,10 @@ int main( void )
 					break;
 
 					case MENU_VOLUME:
-					{
-						maxVal = NUMBER_OF_VOLUME_SUBMENUS;
-					}
-					break;
-
 					case MENU_LCD:
 					{
-						maxVal = NUMBER_OF_LCD_SUBMENUS;
+						menuNextPage(holdMenuState, displayedSubMenu);
+						holdMenuState = LEAVE_MENU_UNCHANGED;   /* Ensure the screen is updated */
 					}
 					break;
 
@@ -3854,17 +3642,6 @@ int main( void )
 
    #endif   /* PRODUCT_TEST_INSTRUMENT_HEAD */
 
-						case MENU_VOLUME:
-						{
-
-						}
-						break;
-
-						case MENU_LCD:
-						{
-						}
-						break;
-
 						default:
 						{
 						}
@@ -3884,7 +3661,7 @@ int main( void )
 
 			/* ////////////////////////////////////
 			 * Handle Rotary Encoder Turns */
-			newCount = g_rotary_count / 4;
+			newCount = g_rotary_count;
 			if(newCount != holdCount)
 			{
 				holdCount = newCount;
@@ -4208,4 +3985,374 @@ int main( void )
 		}
 	}
 
+/**
+ *       Copies the page of menu currently selected by displayedSubMenu[] into page. Returns TRUE if none.
+ */
+	BOOL menuCurrentPage(MenuType menu, uint8_t displayedSubMenu[], MenuPage* page)
+	{
+		uint8_t index = 0;
+
+		for(uint8_t i = 0; i < NUMBER_OF_MENU_PAGES; i++)
+		{
+			memcpy_P(page, &g_menu_pages[i], sizeof(MenuPage));
+
+			if(page->menu == menu)
+			{
+				if(index == displayedSubMenu[page->pageButton])
+				{
+					return( FALSE);
+				}
+
+				index++;
+			}
+		}
+
+		return( TRUE);
+	}
+
+	uint8_t menuPageCount(MenuType menu)
+	{
+		uint8_t count = 0;
+
+		for(uint8_t i = 0; i < NUMBER_OF_MENU_PAGES; i++)
+		{
+			if((MenuType)pgm_read_byte(&g_menu_pages[i].menu) == menu)
+			{
+				count++;
+			}
+		}
+
+		return( count);
+	}
+
+	void menuShowPage(MenuType menu, uint8_t displayedSubMenu[])
+	{
+		MenuPage page;
+
+		if(menuCurrentPage(menu, displayedSubMenu, &page))
+		{
+			return;
+		}
+
+		g_labels[BUTTON1] = page.label;
+		g_labels[BUTTON2] = g_labels[BUTTON3] = NULL_CHAR;
+		g_labels[BUTTON4] = (page.pageButton == BUTTON4) ? textMore : NULL_CHAR;
+
+		if(page.show)
+		{
+			page.show(TRUE);
+		}
+
+		printButtons(g_textBuffer[ROW0], (char**)g_labels);
+
+		if(page.knob)
+		{
+			updateLCDTextBuffer(g_textBuffer[ROW1], (char*)textTurnKnob, FALSE);
+		}
+		else
+		{
+			clearTextBuffer(ROW1);
+		}
+
+		LCD_print_screen(g_textBuffer);
+	}
+
+	void menuNextPage(MenuType menu, uint8_t displayedSubMenu[])
+	{
+		MenuPage page;
+		uint8_t count = menuPageCount(menu);
+
+		if(menuCurrentPage(menu, displayedSubMenu, &page))
+		{
+			return;
+		}
+
+		if(page.show)
+		{
+			page.show(FALSE);
+		}
+
+		displayedSubMenu[page.pageButton]++;
+		displayedSubMenu[page.pageButton] %= count;
+	}
+
+	void menuKnob(MenuType menu, uint8_t displayedSubMenu[], BOOL up)
+	{
+		MenuPage page;
+
+		if(g_menu_delay_countdown)  /* slow things down to prevent double increments if dial clicks more than once */
+		{
+			return;
+		}
+
+		if(menuCurrentPage(menu, displayedSubMenu, &page) || !page.knob)
+		{
+			return;
+		}
+
+		page.knob(up);
+		g_menu_delay_countdown = page.knobHoldoffTicks;
+	}
+
+/**
+ *       Redraws the value row only when the page's formatter reports something new
+ */
+	void menuUpdateValue(MenuType menu, uint8_t displayedSubMenu[])
+	{
+		MenuPage page;
+
+		if(menuCurrentPage(menu, displayedSubMenu, &page) || !page.value)
+		{
+			return;
+		}
+
+		if(page.value(g_tempBuffer))
+		{
+			updateLCDTextBuffer(g_textBuffer[ROW1], g_tempBuffer, FALSE);
+			LCD_print_row(g_textBuffer[ROW1], ROW1);
+		}
+	}
+
+	void knobToneVolume(BOOL up)
+	{
+		lb_send_VOL(LINKBUS_MSG_QUERY, TONE_VOLUME, up ? INCREMENT_VOL : DECREMENT_VOL);
+	}
+
+	void knobMainVolume(BOOL up)
+	{
+		lb_send_VOL(LINKBUS_MSG_QUERY, MAIN_VOLUME, up ? INCREMENT_VOL : DECREMENT_VOL);
+	}
+
+	void knobBacklight(BOOL up)
+	{
+		switch(g_backlight_setting)
+		{
+			case BL_OFF:
+			{
+				g_backlight_setting = up ? BL_LOW : BL_OFF;
+			}
+			break;
+
+			case BL_LOW:
+			{
+				g_backlight_setting = up ? BL_MED : BL_OFF;
+			}
+			break;
+
+			case BL_MED:
+			{
+				g_backlight_setting = up ? BL_HIGH : BL_LOW;
+			}
+			break;
+
+			default:
+			{
+				g_backlight_setting = up ? BL_HIGH : BL_MED;
+			}
+			break;
+		}
+
+		OCR1BH = g_backlight_setting;   /* set PWM duty cycle @ 16bit */
+		OCR1BL = 0xFF;
+	}
+
+	void knobContrast(BOOL up)
+	{
+		if(up)
+		{
+			if(g_contrast_setting < 0x0F)
+			{
+				g_contrast_setting++;
+			}
+		}
+		else
+		{
+			if(g_contrast_setting)
+			{
+				g_contrast_setting--;
+			}
+		}
+
+		LCD_set_contrast(g_contrast_setting);
+	}
+
+	void showBattery(BOOL show)
+	{
+		lb_send_BCR(BATTERY_BROADCAST, show);
+	}
+
+	void showRSSI(BOOL show)
+	{
+		lb_send_BCR(RSSI_BROADCAST, show);
+	}
+
+   #if PRODUCT_CONTROL_HEAD
+
+		BOOL valueTemperature(char* buf)
+		{
+			strcpy(buf, "N/A");
+			return( TRUE);
+		}
+
+		BOOL valueBattery(char* buf)
+		{
+			if(g_Battery_data == WAITING_FOR_UPDATE)
+			{
+				return( FALSE);
+			}
+
+			sprintf(buf, " %dmV    ",  g_Battery_data);
+			g_Battery_data = WAITING_FOR_UPDATE;
+			return( TRUE);
+		}
+
+/**
+ *       Shows the latest RSSI broadcast as a bar graph with a peak-hold marker, followed by
+ *       the reading. Also redraws as the held peak decays.
+ */
+		BOOL valueRSSI(char* buf)
+		{
+			static int16_t rssi = 0;
+			static uint8_t level = 0;
+			static uint8_t peak = 0;
+			static uint16_t peakTick = 0;
+
+			if(g_RSSI_data != WAITING_FOR_UPDATE)
+			{
+				rssi = MAX(0, MIN(g_RSSI_data, RSSI_FULL_SCALE_MV));
+				g_RSSI_data = WAITING_FOR_UPDATE;
+				level = (uint8_t)(((uint32_t)rssi * RSSI_METER_STEPS) / RSSI_FULL_SCALE_MV);
+
+				if(level >= peak)
+				{
+					peak = level;
+					peakTick = g_tick_count;
+				}
+			}
+			else if((peak > level) && ((uint16_t)(g_tick_count - peakTick) > RSSI_PEAK_HOLD_TICKS))
+			{
+				peak--;
+				peakTick = g_tick_count - RSSI_PEAK_HOLD_TICKS + RSSI_PEAK_DECAY_TICKS;
+			}
+			else
+			{
+				return( FALSE);
+			}
+
+			printMeter(buf, level, peak);
+			sprintf(&buf[RSSI_METER_CELLS], "%4d", rssi / 33);
+			return( TRUE);
+		}
+
+/**
+ *       Writes a RSSI_METER_CELLS-character bar graph of level, with a marker at peak
+ */
+		void printMeter(char* buf, uint8_t level, uint8_t peak)
+		{
+			uint8_t cellStart = 0;
+
+			for(uint8_t i = 0; i < RSSI_METER_CELLS; i++, cellStart += LCD_GLYPH_COLUMNS)
+			{
+				if(level >= cellStart + LCD_GLYPH_COLUMNS)
+				{
+					buf[i] = LCD_GLYPH_CODE(METER_GLYPH_FULL);
+				}
+				else if(level > cellStart)
+				{
+					buf[i] = LCD_GLYPH_CODE(level - cellStart - 1);
+				}
+				else if(peak && (peak > cellStart) && (peak <= cellStart + LCD_GLYPH_COLUMNS))
+				{
+					buf[i] = LCD_GLYPH_CODE(METER_GLYPH_PEAK);
+				}
+				else
+				{
+					buf[i] = ' ';
+				}
+			}
+
+			buf[RSSI_METER_CELLS] = '\0';
+		}
+
+   #else
+
+		void knobBand(BOOL up)
+		{
+			lb_send_BND(LINKBUS_MSG_QUERY, (dual_band_receiver.bandSetting == BAND_80M) ? BAND_2M : BAND_80M);
+		}
+
+/**
+ *       Shows the band on BUTTON3's label. The page is redrawn when the receiver confirms a change.
+ */
+		void showBand(BOOL show)
+		{
+			if(show)
+			{
+				g_labels[BUTTON3] = (dual_band_receiver.bandSetting == BAND_80M) ? " 80m" : "  2m";
+			}
+		}
+
+		BOOL valueTemperature(char* buf)
+		{
+			int32_t t;
+
+			if(!g_adcUpdated[LCD_TEMP_READING])
+			{
+				return( FALSE);
+			}
+
+			g_adcUpdated[LCD_TEMP_READING] = FALSE;
+			t = 100 * (1866 - (int32_t)g_lastConversionResult[LCD_TEMP_READING]) / 1169;    /* degrees C for LM20 */
+			sprintf(buf, "%s%2ldC  ", (t < 0) ? "-" : "+", (t < 0) ? -t : t);
+			return( TRUE);
+		}
+
+		BOOL valueBattery(char* buf)
+		{
+			uint16_t v;
+			int16_t pc = -1;
+
+			if(!g_adcUpdated[BATTERY_READING])
+			{
+				return( FALSE);
+			}
+
+			g_adcUpdated[BATTERY_READING] = FALSE;
+			v = (uint16_t)( ( 1000 * ( (uint32_t)(g_lastConversionResult[BATTERY_READING] + POWER_SUPPLY_VOLTAGE_DROP_MV) ) ) / BATTERY_VOLTAGE_COEFFICIENT );    /* round up and adjust for voltage divider and drops */
+
+			if(g_battery_type == BATTERY_4r2V)
+			{
+				pc = (v < 3200) ? 0 : MIN(5 * ((v - 3150) / 50), 100);
+			}
+			else if(g_battery_type == BATTERY_9V)
+			{
+				pc = (v < 7000) ? 0 : MIN(5 * ((v - 6950) / 100), 100);
+			}
+
+			if(pc >= 0)
+			{
+				sprintf(buf, "%1u.%02uV (%d%%) ", v / 1000, (v / 10) % 100, pc);
+			}
+			else
+			{
+				sprintf(buf, "%1u.%02uV", v / 1000, (v / 10) % 100);
+			}
+
+			return( TRUE);
+		}
+
+		BOOL valueRSSI(char* buf)
+		{
+			if(g_RSSI_data == WAITING_FOR_UPDATE)
+			{
+				return( FALSE);
+			}
+
+			sprintf(buf, "S: %d/3300mV    ", g_RSSI_data);
+			g_RSSI_data = WAITING_FOR_UPDATE;
+			return( TRUE);
+		}
+
+   #endif   /* PRODUCT_CONTROL_HEAD */
+
 #endif  /* PRODUCT_CONTROL_HEAD || PRODUCT_TEST_INSTRUMENT_HEAD */
\ No newline at end of file
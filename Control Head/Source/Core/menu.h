@@ -28,6 +28,8 @@
 #ifndef MENU_H_
 #define MENU_H_
 
+#include "defs.h"
+
 typedef enum menu_type
 {
 	MENU_MAIN,
@@ -55,9 +57,26 @@ typedef enum menu_type
 } MenuType;
 
 #define NUMBER_OF_SI5351_SUBMENUS 3
-#define NUMBER_OF_VOLUME_SUBMENUS 2
-#define NUMBER_OF_LCD_SUBMENUS 2
-#define NUMBER_OF_STATUS_SUBMENUS 3
+
+/**
+ * Menus whose pages differ only in label, knob action and displayed value are described by a
+ * table of MenuPage entries held in program memory. A menu's pages are listed consecutively, in
+ * the order they are shown.
+ */
+typedef void (*MenuKnobHandler)(BOOL up);       /* called once per knob detent */
+typedef void (*MenuShowHandler)(BOOL show);     /* called before the page is drawn (TRUE), so it may set button labels, and when it is left (FALSE) */
+typedef BOOL (*MenuValueFormatter)(char* buf);  /* writes the value row text; returns FALSE if there is nothing new to show */
+
+typedef struct
+{
+	MenuType menu;
+	ButtonType pageButton;      /* button that steps through the menu's pages */
+	const char* label;          /* label shown for BUTTON1 */
+	MenuKnobHandler knob;       /* NULL if the knob has no effect */
+	uint8_t knobHoldoffTicks;   /* minimum ticks between knob steps */
+	MenuShowHandler show;       /* may be NULL */
+	MenuValueFormatter value;   /* may be NULL */
+} MenuPage;
 
 
 #endif  /* MENU_H_ */
\ No newline at end of file
@@ -27,9 +27,6 @@
 #include "i2c.h"
 #include <util/twi.h>
 
-#define AD5245_SLAVE_ADDR_A0_0 0x58
-#define AD5245_SLAVE_ADDR_A0_1 0x59
-
 void ad5245_set_potentiometer(uint8_t setting)
 {
 	i2c_device_write(AD5245_SLAVE_ADDR_A0_0, 0x00, &setting, 1);
@@ -37,6 +37,9 @@
 
 #include "defs.h"
 
+#define AD5245_SLAVE_ADDR_A0_0 0x58
+#define AD5245_SLAVE_ADDR_A0_1 0x59
+
 /**
    Set the AD5345 potentiometer to the value passed in setting.
 */
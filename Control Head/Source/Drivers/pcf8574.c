@@ -30,11 +30,9 @@
 
 #include "pcf8574.h"
 #include <util/twi.h>
+#include <stddef.h>
 #include "i2c.h"
 
-#define PCF8574_SLAVE_ADDR_A000_0 0x70
-#define PCF8574_SLAVE_ADDR_A000_1 0x71
-
 BOOL pcf8574_write(uint8_t addr, uint8_t data);
 BOOL pcf8574_read(uint8_t addr, uint8_t *data);
 
@@ -59,27 +57,9 @@ BOOL pcf8574_readPort(uint8_t *portData)
 		BOOL pcf8574_write(uint8_t slaveAddr, uint8_t data)
 #endif
 	{
-		#ifndef DEBUG_WITHOUT_I2C
-			i2c_start();
-			if(i2c_status(TW_START))
-			{
-				return(TRUE);
-			}
-			
-			if(i2c_write_success(slaveAddr, TW_MT_SLA_ACK))
-			{
-				return(TRUE);
-			}
-			
-			if(i2c_write_success(data, TW_MT_DATA_ACK))
-			{
-				return(TRUE);
-			}
-			
-			i2c_stop();
-		#endif  /* #ifndef DEBUG_WITHOUT_I2C */
+		I2CTransaction t = { slaveAddr, 0, TRUE, &data, 1, NULL, 0, NULL, I2C_STATUS_OK };   /* the port has no register address */
 
-		return(FALSE);
+		return(i2c_transact(&t));
 	}
 
 #ifdef SELECTIVELY_DISABLE_OPTIMIZATION
@@ -88,36 +68,9 @@ BOOL pcf8574_readPort(uint8_t *portData)
 		BOOL pcf8574_read(uint8_t slaveAddr, uint8_t *data)
 #endif
 	{
-		#ifndef DEBUG_WITHOUT_I2C
-
-			i2c_start();
-			if(i2c_status(TW_START))
-			{
-				return(TRUE);
-			}
-
-			if(i2c_write_success(slaveAddr, TW_MT_SLA_ACK))
-			{
-				return(TRUE);
-			}
-
-			i2c_start();
-			if(i2c_status(TW_START))
-			{
-				return(TRUE);
-			}
-
-			*data = i2c_read_nack();
-			if(i2c_status(TW_MR_DATA_NACK))
-			{
-				return(TRUE);
-			}
-
-			i2c_stop();
-
-		#endif  /* #ifndef DEBUG_WITHOUT_I2C */
+		I2CTransaction t = { slaveAddr & ~TW_READ, 0, TRUE, NULL, 0, data, 1, NULL, I2C_STATUS_OK };
 
-		return(FALSE);
+		return(i2c_transact(&t));
 	}
 
 #endif  /* #ifdef INCLUDE_PCF8574_SUPPORT */
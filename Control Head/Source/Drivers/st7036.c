@@ -30,8 +30,8 @@
 
 #include <string.h> /*needed for strlen() */
 #include <inttypes.h>
-#include <util/twi.h>
 #include <avr/wdt.h>
+#include <avr/pgmspace.h>
 
 #include "st7036.h"
 #include "i2c.h"
@@ -40,6 +40,7 @@
  * private constants and definitions
  *********************************************************************************************************************/
 	const int CMD_DELAY           = 1;      /* Command delay in miliseconds */
+	const uint8_t RUN_MERGE_GAP   = 3;      /* Unchanged cells this close together are re-sent rather than starting a new run */
 	const int PIXEL_ROWS_PER_CHAR = 8;      /* Number of pixel rows in the LCD character */
 	const int MAX_USER_CHARS      = 16;     /* Maximun number of user defined characters */
 
@@ -55,6 +56,8 @@
 	const uint8_t FOLLOWER_CMD   = 0x60;    /* Set follower circuit */
 	const uint8_t FUNC_SET_TBL0  = 0x38;    /* Function set - 8 bit, 2 line display 5x8, inst table 0 */
 	const uint8_t FUNC_SET_TBL1  = 0x39;    /* Function set - 8 bit, 2 line display 5x8, inst table 1 */
+	const uint8_t CMD_CONTINUE   = 0x80;    /* Control byte: one command byte follows, then another control byte */
+	const uint8_t SET_CGRAM_CMD  = 0x40;    /* Set CGRAM address command (instruction table 0 only) */
 
 /* LCD bitmap definition */
 	const uint8_t CURSOR_ON_BIT  = ( 1 << 1 );    /* Cursor selection bit in Display on cmd. */
@@ -68,6 +71,17 @@
 	static BOOL g_initialized = FALSE;
 	static uint8_t g_display_status;
 
+/* The shadow holds what callers have asked to be displayed; the onscreen copy holds what has
+ * actually been written to the display. Cells that differ are dirty, and are sent by LCD_flush(). */
+	static char g_lcd_shadow[NUMBER_OF_LCD_ROWS][NUMBER_OF_LCD_COLS];
+	static char g_lcd_onscreen[NUMBER_OF_LCD_ROWS][NUMBER_OF_LCD_COLS];
+	static BOOL g_lcd_dirty = FALSE;
+	static BOOL g_lcd_cursor_pending = FALSE;
+	static BOOL g_lcd_blink = FALSE;
+	static LcdRowType g_lcd_cursor_row = ROW0;
+	static LcdColType g_lcd_cursor_col = COL0;
+	static volatile uint8_t g_lcd_holdoff = 0;
+
 	const uint8_t dispAddr[][3] =
 	{
 		{ 0x00, 0x00, 0x00 },   /* One line display address */
@@ -148,6 +162,16 @@
  */
 	void st7036_setCursor(LcdRowType row, LcdColType col);
 
+/**
+ * Writes a run of characters starting at (row, col) in a single I2C transaction that
+ * sets the DDRAM address and then bursts the character data.
+ *
+ * @return TRUE on failure
+ *
+ * BOOL st7036_write_run(LcdRowType row, LcdColType col, char *data, uint8_t size);
+ */
+	BOOL st7036_write_run(LcdRowType row, LcdColType col, char *data, uint8_t size);
+
 /**
  * Simple (and probably unnecessary) wrapper for _delay_ms()
  */
@@ -165,6 +189,13 @@ void LCD_init(uint8_t num_lines, uint8_t num_cols, uint8_t i2cAddr, ContrastType
 	g_write_delay_ms = 1;
 	g_initialized = FALSE;
 
+	memset(g_lcd_shadow, ' ', sizeof(g_lcd_shadow));
+	memset(g_lcd_onscreen, ' ', sizeof(g_lcd_onscreen));   /* initialize() clears the display */
+	g_lcd_dirty = FALSE;
+	g_lcd_cursor_pending = FALSE;
+	g_lcd_blink = FALSE;
+	g_lcd_holdoff = 0;
+
 	initialize(contrast);
 }
 
@@ -182,46 +213,34 @@ void LCD_init(uint8_t num_lines, uint8_t num_cols, uint8_t i2cAddr, ContrastType
  *	_delay_ms(30);
  *	PORTD |= 0b10000000; */
 
+	uint8_t bias[3] = { 0x14, CONTRAST_CMD | contrast, 0x5E }; /* Set BIAS - 1/5; Set contrast; ICON disp on, Booster on, Contrast high byte */
+	uint8_t entry[2] = { CLEAR_DISP_CMD, 0x06 };                /* Clear display; Entry mode set - increment */
+
 	i2c_init();
 	g_initialized = TRUE;
 
-#ifdef I2C_TIMEOUT_SUPPORT
-	while(i2c_start())
-	{
-		;
-	}
-#else
-	i2c_start();
-#endif
-
-	i2c_write_success(g_i2c_slave_addr, TW_MT_SLA_ACK);
-	i2c_write_success(0x00, TW_MT_DATA_ACK);                    /* Comsend = 0x00 */
-	i2c_write_success(0x38, TW_MT_DATA_ACK);                    /* I2C_out(0x38); */
+	/* Each command is sent in its own transaction (Comsend = 0x00), so the bus is free during the delays */
+	command(FUNC_SET_TBL0);                                     /* I2C_out(0x38); */
 	delay(10);                                                  /* delay(10); */
-	i2c_write_success(0x39, TW_MT_DATA_ACK);                    /* I2C_out(0x39); */
+	command(FUNC_SET_TBL1);                                     /* I2C_out(0x39); */
 	delay(10);                                                  /* delay(10); */
-	i2c_write_success(0x14, TW_MT_DATA_ACK);                    /* Set BIAS - 1/5 */
-	i2c_write_success(CONTRAST_CMD | contrast, TW_MT_DATA_ACK); /* Set contrast */
-	i2c_write_success(0x5E, TW_MT_DATA_ACK);                    /* ICON disp on, Booster on, Contrast high byte */
+	i2c_device_write(g_i2c_slave_addr, DISP_CMD, bias, 3);
 
 	wdt_reset();
 	delay(200);
 	wdt_reset();
 
-	i2c_write_success(0x6D, TW_MT_DATA_ACK);    /* Follower circuit (internal), amp ratio (6) */
+	command(0x6D);          /* Follower circuit (internal), amp ratio (6) */
 	wdt_reset();
 	delay(200);
 	wdt_reset();
 
-	i2c_write_success(DISP_ON_CMD, TW_MT_DATA_ACK);     /* Display on */
+	command(DISP_ON_CMD);   /* Display on */
 	delay(200);
 	wdt_reset();
 
-	i2c_write_success(CLEAR_DISP_CMD, TW_MT_DATA_ACK);  /* Clear display */
-	i2c_write_success(0x06, TW_MT_DATA_ACK);            /* Entry mode set - increment */
-	delay(100);                                         /* delay(10); */
-	i2c_stop();                                         /* I2C_Stop(); */
-	delay(100);
+	i2c_device_write(g_i2c_slave_addr, DISP_CMD, entry, 2);
+	delay(200);
 }
 
 
@@ -249,14 +268,115 @@ size_t LCD_print_row(char *buffer, LcdRowType row)
 
 size_t LCD_print_row_col(char *buffer, LcdRowType row, LcdColType col)
 {
-	delay(10);
-	st7036_setCursor(row, col);
-	delay(10);
-	int len = strlen(buffer);
-	st7036_write_str(buffer, len);
+	size_t len = strlen(buffer);
+
+	if((row >= NUMBER_OF_LCD_ROWS) || (col >= NUMBER_OF_LCD_COLS))
+	{
+		return(len);
+	}
+
+	char *cell = &g_lcd_shadow[row][col];
+	uint8_t n = MIN(len, (size_t)(NUMBER_OF_LCD_COLS - col));
+
+	while(n--)
+	{
+		if(*cell != *buffer)
+		{
+			*cell = *buffer;
+			g_lcd_dirty = TRUE;
+		}
+
+		cell++;
+		buffer++;
+	}
+
 	return(len);
 }
 
+BOOL LCD_flush(void)
+{
+	if(!g_initialized || g_lcd_holdoff)
+	{
+		return( g_lcd_dirty || g_lcd_cursor_pending);
+	}
+
+	if(g_lcd_dirty)
+	{
+		for(LcdRowType row = ROW0; row < NUMBER_OF_LCD_ROWS; row++)
+		{
+			uint8_t first, last, col;
+
+			for(first = 0; first < NUMBER_OF_LCD_COLS; first++)
+			{
+				if(g_lcd_shadow[row][first] != g_lcd_onscreen[row][first])
+				{
+					break;
+				}
+			}
+
+			if(first == NUMBER_OF_LCD_COLS)
+			{
+				continue;
+			}
+
+			/* Extend the run over any dirty cells that lie within RUN_MERGE_GAP of its end */
+			last = first;
+
+			for(col = first + 1; (col < NUMBER_OF_LCD_COLS) && ((col - last) <= RUN_MERGE_GAP + 1); col++)
+			{
+				if(g_lcd_shadow[row][col] != g_lcd_onscreen[row][col])
+				{
+					last = col;
+				}
+			}
+
+			g_lcd_holdoff = LCD_FLUSH_HOLDOFF_TICKS;
+
+			if(!st7036_write_run(row, (LcdColType)first, &g_lcd_shadow[row][first], last - first + 1))
+			{
+				memcpy(&g_lcd_onscreen[row][first], &g_lcd_shadow[row][first], last - first + 1);
+
+				if(g_lcd_blink)
+				{
+					g_lcd_cursor_pending = TRUE;    /* the write moved the cursor */
+				}
+			}
+
+			return( TRUE);
+		}
+
+		g_lcd_dirty = FALSE;
+	}
+
+	if(g_lcd_cursor_pending)
+	{
+		g_lcd_cursor_pending = FALSE;
+		g_lcd_holdoff = LCD_FLUSH_HOLDOFF_TICKS;
+
+		if(g_lcd_blink)
+		{
+			st7036_blink_on();
+			st7036_setCursor(g_lcd_cursor_row, g_lcd_cursor_col);
+		}
+		else
+		{
+			st7036_cursor_off();
+			st7036_setCursor(ROW1, COL0);
+			st7036_blink_off();
+		}
+	}
+
+	return( FALSE);
+}
+
+void LCD_tick(void)
+{
+	if(g_lcd_holdoff)
+	{
+		g_lcd_holdoff--;
+	}
+}
+
 void LCD_print_screen(char buffer[NUMBER_OF_LCD_ROWS][DISPLAY_WIDTH_STRING_SIZE])
 {
 	for(LcdRowType i = ROW0; i < NUMBER_OF_LCD_ROWS; i++)
@@ -272,22 +392,48 @@ void LCD_blink_cursor_row_col(BOOL on, LcdRowType row, LcdColType col)
 		return;
 	}
 
-	if(!on)
+	g_lcd_blink = on;
+
+	if(on)
 	{
-		st7036_cursor_off();
-		st7036_setCursor(1, 0);
-		st7036_blink_off();
+		g_lcd_cursor_row = row;
+		g_lcd_cursor_col = col;
 	}
-	else
+
+	g_lcd_cursor_pending = TRUE;
+}
+
+void LCD_set_cursor_row_col(LcdRowType row, LcdColType col)
+{
+	if(col >= NUMBER_OF_LCD_COLS)
 	{
-		st7036_blink_on();
-		st7036_setCursor(row, col);
+		return;
 	}
+
+	g_lcd_cursor_row = row;
+	g_lcd_cursor_col = col;
+	g_lcd_cursor_pending = TRUE;
 }
 
-void LCD_set_cursor_row_col(LcdRowType row, LcdColType col)
+void LCD_load_glyph_P(uint8_t index, const uint8_t* pattern)
 {
-	st7036_setCursor(row, col);
+	uint8_t rows[LCD_GLYPH_ROWS];
+	uint8_t cmd[2];
+
+	if(!g_initialized || (index >= LCD_NUMBER_OF_GLYPHS))
+	{
+		return;
+	}
+
+	memcpy_P(rows, pattern, LCD_GLYPH_ROWS);
+
+	cmd[0] = FUNC_SET_TBL0;                     /* the CGRAM address command is not available in table 1 */
+	cmd[1] = SET_CGRAM_CMD | (index << 3);
+	i2c_device_write(g_i2c_slave_addr, DISP_CMD, cmd, 2);
+	i2c_device_write(g_i2c_slave_addr, RAM_WRITE_CMD, rows, LCD_GLYPH_ROWS);
+	command(FUNC_SET_TBL1);                     /* table 1 holds the contrast command */
+
+	g_lcd_cursor_pending = g_lcd_blink;         /* the cursor now points into CGRAM */
 }
 
 void LCD_set_contrast(ContrastType contrast)
@@ -331,10 +477,34 @@ void st7036_setCursor(LcdRowType row, LcdColType col)
 		/* set the baseline address with respect to the number of lines of the display */
 		base = dispAddr[g_display_number_of_rows - 1][row] + SET_DDRAM_CMD + col;
 		command(base);
-		delay(1);
 	}
 }
 
+BOOL st7036_write_run(LcdRowType row, LcdColType col, char *data, uint8_t size)
+{
+	uint8_t bytes[NUMBER_OF_LCD_COLS + 2];
+
+	if(size > NUMBER_OF_LCD_COLS)
+	{
+		return( TRUE);
+	}
+
+	/* CMD_CONTINUE is the control byte for the address command; RAM_WRITE_CMD is the control byte for the data that follows.
+	 * The bus takes longer to deliver each byte than the controller takes to write it, so no pacing is needed */
+	bytes[0] = dispAddr[g_display_number_of_rows - 1][row] + SET_DDRAM_CMD + col;
+	bytes[1] = RAM_WRITE_CMD;
+	memcpy(&bytes[2], data, size);
+
+	if(i2c_device_write(g_i2c_slave_addr, CMD_CONTINUE, bytes, size + 2))
+	{
+		return( TRUE);
+	}
+
+	g_display_status = 0;
+
+	return( FALSE);
+}
+
 void __attribute__((optimize("O1"))) delay(int millisecs)
 {
 	_delay_ms(millisecs);
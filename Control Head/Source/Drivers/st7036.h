@@ -34,6 +34,14 @@
 #include <inttypes.h>
 
 #define LCD_I2C_SLAVE_ADDRESS   0x78
+#define LCD_FLUSH_HOLDOFF_TICKS 1   /* minimum TIMER2 ticks between display transactions sent by LCD_flush() */
+
+#define LCD_NUMBER_OF_GLYPHS 8      /* user-defined characters held in CGRAM */
+#define LCD_GLYPH_ROWS 8            /* pixel rows per character; each row uses the low 5 bits */
+#define LCD_GLYPH_COLUMNS 5
+
+/* CGRAM characters also appear at codes 0x08-0x0F, which lets them be used in NUL-terminated strings */
+#define LCD_GLYPH_CODE(index) ((char)(0x08 + (index)))
 
 /**
  */
@@ -48,10 +56,24 @@ void LCD_print_screen(char buffer[NUMBER_OF_LCD_ROWS][DISPLAY_WIDTH_STRING_SIZE]
 size_t LCD_print_row(char *buffer, LcdRowType row);                     /* Print buffer at row, col=0 */
 
 /**
+ * Text is written to a RAM shadow of the display; only cells whose contents change are marked
+ * for sending. Nothing is sent to the display until LCD_flush() is called.
  */
 size_t LCD_print_row_col(char *buffer, LcdRowType row, LcdColType col); /* Print buffer at row, col */
 
 /**
+ * Sends at most one run of changed cells, or a pending cursor change, to the display. Call from
+ * the foreground loop. Returns TRUE if changes remain to be sent.
+ */
+BOOL LCD_flush(void);
+
+/**
+ * Paces LCD_flush(). Call once per TIMER2 interrupt.
+ */
+void LCD_tick(void);
+
+/**
+ * Cursor changes take effect on the display after any pending text has been flushed.
  */
 void LCD_set_cursor_row_col(LcdRowType row, LcdColType col);
 
@@ -59,6 +81,12 @@ void LCD_set_cursor_row_col(LcdRowType row, LcdColType col);
  */
 void LCD_blink_cursor_row_col(BOOL on, LcdRowType row, LcdColType col); /* Move cursor to row,col and turn blinking on/off */
 
+/**
+ * Writes a user-defined character into CGRAM, from a pattern held in program memory. Displayed
+ * using LCD_GLYPH_CODE(index). Sent immediately rather than by LCD_flush(); intended for use at start up.
+ */
+void LCD_load_glyph_P(uint8_t index, const uint8_t* pattern);
+
 /**
  */
 void LCD_set_contrast(ContrastType contrast);
@@ -155,6 +155,8 @@ bool g_onlyUpdateEvent = false;
 int g_noActivityTimeoutSeconds = NO_ACTIVITY_TIMEOUT;
 
 unsigned long g_timeOfDayFromTx = 0;
+unsigned long g_timeOfDayFromTxMillis = 0; /* millis() when the second reported in g_timeOfDayFromTx began */
+int g_syncRequestsLeft = 0;
 
 static WiFiEventHandler e1, e2;
 
@@ -190,6 +192,8 @@ void fileDelete(void);
 void fileDeleteWithMessage(String msg);
 void handleFileDelete(void);
 void handleLBMessage(String message);
+unsigned long linkbusTransmitMillis(unsigned int length);
+void sendTimeToAtmega(unsigned long epoch, unsigned long ms);
 void handleFS(void);
 bool linkbusLoop(void);
 bool clientConnectLoop();
@@ -1222,6 +1226,8 @@ bool clientConnectLoop()
             if (!g_slave_released) /* Success */
             {
               times2try = 5;
+              g_syncRequestsLeft = SYNC_TIME_REQUEST_TRIES;
+              last = 0;
               g_webSocketSlaveState = WSClientSyncClock;
 
 #if TRANSMITTER_COMPILE_DEBUG_PRINTS
@@ -1263,6 +1269,16 @@ bool clientConnectLoop()
           {
             g_linkBusAckTimoutOccurred = false;
             times2try = 5;
+
+            /* Ask the Master for its time; the reply's round trip is used to compensate for network delay */
+            if (g_syncRequestsLeft && (abs(millis() - last) > 1000))
+            {
+              last = millis();
+              msg = String(SOCK_COMMAND_SYNC_TIME) + "," + SYNC_TIME_REQUEST + "," + String(last);
+              g_webSocketLocalClient.sendTXT(stringObjToConstCharString(&msg)); /* Send to Master */
+              g_syncRequestsLeft--;
+            }
+
             /* Wait in this state until an incoming sync message changes the state */
           }
         }
@@ -2136,6 +2152,10 @@ void httpWebServerLoop(int blinkRate)
           {
             g_LBOutputBuff->put(LB_MESSAGE_BATTERY_REQUEST);
           }
+          else if (!(holdSeconds % 29))
+          {
+            g_LBOutputBuff->put(LB_MESSAGE_ENERGY_REQUEST);
+          }
         }
       }
 
@@ -3267,9 +3287,32 @@ void webSocketClientEvent(WStype_t type, uint8_t * payload, size_t length)
           }
           else if (msgHeader.equalsIgnoreCase(SOCK_COMMAND_SYNC_TIME)) /* From connected Master */
           {
-            if (g_webSocketSlaveState == WSClientSyncClock)
+            p = p.substring(p.indexOf(',') + 1);
+            int msIndex = p.indexOf(',');
+            bool isReply = (msIndex > 0); /* Reply to a sync request, rather than a time broadcast */
+
+            /* Prefer a reply to our request; accept the Master's once-per-second broadcast only if it does not reply */
+            if ((g_webSocketSlaveState == WSClientSyncClock) && (isReply || !g_syncRequestsLeft))
             {
-              p = p.substring(p.indexOf(',') + 1);
+              unsigned long ms = 0;
+
+              if (isReply)
+              {
+                String s = p.substring(msIndex + 1);
+                String sentStr = s.substring(s.indexOf(',') + 1);
+                unsigned long sent = strtoul(stringObjToConstCharString(&sentStr), NULL, 10);
+                unsigned long roundTrip = millis() - sent;
+
+                ms = s.toInt() + roundTrip / 2; /* Master's time was read halfway through the round trip */
+                p = p.substring(0, msIndex);
+
+#if TRANSMITTER_COMPILE_DEBUG_PRINTS
+                if (g_debug_prints_enabled)
+                {
+                  Serial.println(String("WSc: Sync round trip ") + String(roundTrip) + " ms");
+                }
+#endif // TRANSMITTER_COMPILE_DEBUG_PRINTS
+              }
 
               if ((p.length() > 9) && (p.length() < 12))
               {
@@ -3277,18 +3320,16 @@ void webSocketClientEvent(WStype_t type, uint8_t * payload, size_t length)
 
                 if (t > 962452800) /* Avoid obviously wrong dates */
                 {
-                  g_timeOfDayFromTx = t;
-                  p = convertEpochToTimeString(g_timeOfDayFromTx);
+                  g_timeOfDayFromTx = t + ms / 1000;
 
 #if TRANSMITTER_COMPILE_DEBUG_PRINTS
                   if (g_debug_prints_enabled)
                   {
-                    Serial.println(String("WSc: Calcd time string: \"" + p + "\" from ") + String((unsigned)g_timeOfDayFromTx));
+                    Serial.println(String("WSc: Calcd time: ") + String((unsigned)t) + "." + String(ms));
                   }
 #endif // TRANSMITTER_COMPILE_DEBUG_PRINTS
 
-                  String msgOut = String(String(LB_MESSAGE_TIME_SET) + p + ";");
-                  Serial.printf(stringObjToConstCharString(&msgOut));
+                  sendTimeToAtmega(t, ms);
                   g_webSocketSlaveState = WSClientWaitForSyncAck;
                 }
                 else
@@ -3449,6 +3490,7 @@ void webSocketServerEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t
         g_numberOfSocketClients = g_webSocketServer.connectedClients(false);
         g_LBOutputBuff->put(LB_MESSAGE_TEMP_REQUEST);
         g_LBOutputBuff->put(LB_MESSAGE_BATTERY_REQUEST);
+        g_LBOutputBuff->put(LB_MESSAGE_ENERGY_REQUEST);
         g_noActivityTimeoutSeconds = NO_ACTIVITY_TIMEOUT;
       }
       break;
@@ -3617,27 +3659,55 @@ void webSocketServerEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t
               
              g_webSocketServer.broadcastTXT(stringObjToConstCharString(&p), p.length());
           }
-          else if (msgHeader.equalsIgnoreCase(SOCK_COMMAND_SYNC_TIME)) /* From connected browser */
+          else if (msgHeader.equalsIgnoreCase(SOCK_COMMAND_SYNC_TIME)) /* From connected browser or Slave */
           {
             p = p.substring(p.indexOf(',') + 1);
 
-            /* Lop off milliseconds */
-            if ((p.length() > 20) && (p.lastIndexOf('.') > 0))
+            if (p.startsWith(SYNC_TIME_REQUEST)) /* Slave requests the time: reply with the current second, milliseconds into it, and the Slave's timestamp */
             {
-              int index = p.lastIndexOf('.');
-              p = p.substring(0, index);
-              p = p + "Z";
+              if (g_timeOfDayFromTx)
+              {
+                unsigned long elapsed = millis() - g_timeOfDayFromTxMillis;
+                String msgOut = String(SOCK_COMMAND_SYNC_TIME) + "," + String(g_timeOfDayFromTx + elapsed / 1000) + "," + String(elapsed % 1000) + "," + p.substring(p.indexOf(',') + 1);
+                g_webSocketServer.sendTXT(num, stringObjToConstCharString(&msgOut), msgOut.length());
+              }
             }
+            else
+            {
+              unsigned long ms = 0;
+
+              /* Separate milliseconds */
+              if ((p.length() > 20) && (p.lastIndexOf('.') > 0))
+              {
+                int index = p.lastIndexOf('.');
+                ms = p.substring(index + 1, index + 4).toInt();
+                p = p.substring(0, index);
+                p = p + "Z";
+              }
 
 #if TRANSMITTER_COMPILE_DEBUG_PRINTS
-            if (g_debug_prints_enabled)
-            {
-              Serial.println(String("Time string: \"" + p + "\""));
-            }
+              if (g_debug_prints_enabled)
+              {
+                Serial.println(String("Time string: \"" + p + "\" + ") + String(ms) + " ms");
+              }
 #endif // TRANSMITTER_COMPILE_DEBUG_PRINTS
 
-            String msgOut = String(String(LB_MESSAGE_TIME_SET) + p + ";");
-            Serial.printf(stringObjToConstCharString(&msgOut));  /* Send time to Transmitter for synchronization */
+              unsigned long epoch = convertTimeStringToEpoch(p);
+
+              if (epoch)
+              {
+                sendTimeToAtmega(epoch, ms); /* Send time to Transmitter for synchronization */
+              }
+              else
+              {
+                String msgOut = String(String(LB_MESSAGE_TIME_SET) + p + ";");
+                Serial.printf(stringObjToConstCharString(&msgOut));
+              }
+            }
+          }
+          else if (msgHeader.equalsIgnoreCase(SOCK_COMMAND_SYNC_OFFSET)) /* From connected Slave */
+          {
+            g_webSocketServer.broadcastTXT(stringObjToConstCharString(&p), p.length());
           }
           else if (msgHeader.equalsIgnoreCase(SOCK_COMMAND_TX_ROLE))
           {
@@ -4891,6 +4961,30 @@ void showSettings()
 }
 #endif // TRANSMITTER_COMPILE_DEBUG_PRINTS
 
+/**
+   Returns the time taken to send length characters over the linkbus
+*/
+unsigned long linkbusTransmitMillis(unsigned int length)
+{
+  return ( ((unsigned long)length * 10000UL) / SERIAL_BAUD_RATE); /* 10 bits per character */
+}
+
+/**
+   Sends the time to the ATMEGA, including milliseconds into the second. The time is advanced by
+   the time taken to send the message, so that it is correct when the ATMEGA receives it.
+*/
+void sendTimeToAtmega(unsigned long epoch, unsigned long ms)
+{
+  String msgOut = String(LB_MESSAGE_TIME_SET) + convertEpochToTimeString(epoch) + ",000;";
+
+  ms += linkbusTransmitMillis(msgOut.length());
+  epoch += ms / 1000;
+  ms %= 1000;
+
+  msgOut = String(LB_MESSAGE_TIME_SET) + convertEpochToTimeString(epoch) + "," + String(ms) + ";";
+  Serial.printf(stringObjToConstCharString(&msgOut));
+}
+
 void handleLBMessage(String message)
 {
   if (message == NULL) return;
@@ -4931,6 +5025,12 @@ void handleLBMessage(String message)
 
   if (!g_slave_released) /* If connected to Master ignore most messages */
   {
+    if (type.equals(LB_MESSAGE_TIME) && payload.startsWith(LB_MESSAGE_TIME_OFFSET)) /* Let the Master know how far off this transmitter was */
+    {
+      String msg = String(SOCK_COMMAND_SYNC_OFFSET) + "," + payload.substring(payload.indexOf(',') + 1);
+      g_webSocketLocalClient.sendTXT(stringObjToConstCharString(&msg)); /* Send to Master */
+    }
+
     if (!type.equals(LB_MESSAGE_ACK))
     {
       return;
@@ -4972,9 +5072,27 @@ void handleLBMessage(String message)
       }
     }
   }
+  else if (type.equals(LB_MESSAGE_TIME) && payload.startsWith(LB_MESSAGE_TIME_OFFSET))
+  {
+    String offset = payload.substring(payload.indexOf(',') + 1);
+
+#if TRANSMITTER_COMPILE_DEBUG_PRINTS
+    if (g_debug_prints_enabled)
+    {
+      Serial.println(String("Clock offset before sync: ") + offset + " ms");
+    }
+#endif // TRANSMITTER_COMPILE_DEBUG_PRINTS
+
+    if (g_numberOfSocketClients)
+    {
+      String msg = String(String(SOCK_COMMAND_SYNC_OFFSET) + "," + offset);
+      g_webSocketServer.broadcastTXT(stringObjToConstCharString(&msg), msg.length());
+    }
+  }
   else if (type.equals(LB_MESSAGE_TIME))
   {
     String timeinfo = payload;
+    g_timeOfDayFromTxMillis = millis() - linkbusTransmitMillis(message.length()); /* Sent as the ATMEGA's second began */
     g_timeOfDayFromTx = (unsigned long)payload.toInt();
     unsigned long epoch = g_timeOfDayFromTx;
 
@@ -5091,6 +5209,28 @@ void handleLBMessage(String message)
       g_webSocketServer.broadcastTXT(stringObjToConstCharString(&msg), msg.length());
     }
   }
+  else if (type.equals(LB_MESSAGE_ENERGY))
+  {
+    /* Payload is either "T,sleep,awake,wifi,onair,keyed" (minutes) or "B,mV,mV/hr,runtime minutes" */
+    if (g_numberOfSocketClients && (payload.length() > 2))
+    {
+      String msg;
+
+      if (payload.startsWith("T"))
+      {
+        msg = String(String(SOCK_COMMAND_ENERGY_TIME) + "," + payload.substring(2));
+      }
+      else if (payload.startsWith("B"))
+      {
+        msg = String(String(SOCK_COMMAND_ENERGY_BAT) + "," + payload.substring(2));
+      }
+
+      if (msg.length())
+      {
+        g_webSocketServer.broadcastTXT(stringObjToConstCharString(&msg), msg.length());
+      }
+    }
+  }
   else if (type.equals(LB_MESSAGE_VER))
   {
     if (payload.length() > 1)
@@ -158,10 +158,15 @@ typedef enum
 #define SOCK_COMMAND_CLEAR_ACTIVE_EVENT "CLEAR"
 #define SOCK_COMMAND_EVENT_NAME "EVENT_NAME"            /* read only */
 #define SOCK_COMMAND_EVENT_DATA "EVENT_DATA"            /* read only */
-#define SOCK_COMMAND_SYNC_TIME "SYNC"
+#define SOCK_COMMAND_SYNC_TIME "SYNC"                   /* Browser: SYNC,<ISO time>; Slave: SYNC,?,<millis>; Master reply: SYNC,<epoch>,<ms>,<echoed millis> */
+#define SOCK_COMMAND_SYNC_OFFSET "SYNC_OFS"             /* read only: transmitter clock offset (ms) before it was last set */
+#define SYNC_TIME_REQUEST "?"
+#define SYNC_TIME_REQUEST_TRIES 3
 #define SOCK_COMMAND_TEMPERATURE "TEMP"                 /* read only */
 #define SOCK_COMMAND_SSID "SSID"                        /* read only */
 #define SOCK_COMMAND_BATTERY "BAT"                      /* read only */
+#define SOCK_COMMAND_ENERGY_TIME "NRG_TIME"             /* read only: minutes asleep, awake, WiFi on, on the air, keyed */
+#define SOCK_COMMAND_ENERGY_BAT "NRG_BAT"               /* read only: battery mV, drain mV/hr, minutes remaining (65535 = unknown) */
 //#define SOCK_COMMAND_CLONE "CLONE"
 #define SOCK_COMMAND_SW_VERSIONS "SW_VERSIONS"          /* read only */
 #define SOCK_COMMAND_MAC "MAC"                          /* read only */
@@ -212,11 +217,14 @@ typedef enum
 #define LB_MESSAGE_ESP_KEEPALIVE "$ESP,Z;"          /* Keep alive for 2 minutes */
 #define LB_MESSAGE_TIME "TIM"
 #define LB_MESSAGE_TIME_SET "$TIM,"                 /* Prefix for sending RTC time setting to ATMEGA */
+#define LB_MESSAGE_TIME_OFFSET "O,"                 /* Prefix of ATMEGA report of clock offset (ms) before it was set */
 #define LB_MESSAGE_TIME_REQUEST "$TIM?"             /* Request the current time */
 #define LB_MESSAGE_TEMP "TEM"
 #define LB_MESSAGE_TEMP_REQUEST "$TEM?"             /* Request the current temperature */
 #define LB_MESSAGE_BATTERY "BAT"
 #define LB_MESSAGE_BATTERY_REQUEST "$BAT?"          /* Request the current battery level */
+#define LB_MESSAGE_ENERGY "NRG"
+#define LB_MESSAGE_ENERGY_REQUEST "$NRG?"           /* Request power-state times and battery discharge rate */
 #define LB_MESSAGE_CALLSIGN "ID"
 #define LB_MESSAGE_CALLSIGN_SET "$ID,"              /* Prefix for sending the callsign/ID to ATMEGA */
 #define LB_MESSAGE_STARTFINISH_TIME "SF"
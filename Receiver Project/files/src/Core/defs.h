@@ -67,6 +67,7 @@
 /******************************************************
  * EEPROM definitions */
 #define EEPROM_INITIALIZED_FLAG 0xA8
+#define EEPROM_UNINITIALIZED 0x00
 #define EEPROM_TONE_VOLUME_DEFAULT 5
 #define EEPROM_MAIN_VOLUME_DEFAULT 11
 #define EEPROM_AUDIO_RSSI_DEFAULT 0
@@ -156,6 +157,8 @@ typedef enum
 #define TIMER2_20HZ 49
 #define TIMER2_5_8HZ 100
 #define TIMER2_0_5HZ 1000
+#define TIMER2_TICKS_PER_SECOND 601     /* F_CPU / 1024 / (OCR2A + 1) with OCR2A = 0x0C */
+#define RSSI_CONVERSION_TICKS 25        /* minimum interval between RSSI broadcasts, ~24 Hz; RSSI itself is read on every ADC sequence pass */
 
 /*#define BATTERY_VOLTAGE_COEFFICIENT 332 */
 #define BATTERY_VOLTAGE_COEFFICIENT 223                                                                     /* R1 = 69.8k; R2 = 20k; volts x this = mV measured at ADC pin (minus losses) */
@@ -167,6 +170,8 @@ typedef enum
 #define BEEP_SHORT 100
 #define BEEP_LONG 65535
 
+#define MAX_UINT16 65535
+
 /******************************************************
  * UI Hardware-related definitions */
 
@@ -0,0 +1,143 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * journal.h
+ *
+ * Settings are kept in EEPROM as an append-only journal of tagged records. Each record
+ * carries a sequence number and a CRC, and is only appended when its value has changed.
+ * When the active sector fills, the latest record for each tag is copied to the other
+ * sector, which then becomes active.
+ *
+ * Sector layout:  header | record | record | ... | 0xFF
+ * Record layout:  tag | sequence | length | data[length] | CRC-8 of all preceding bytes
+ *
+ * The tag byte is written last, so a record interrupted by reset or power loss is never
+ * seen. A sector header is likewise written only after the sector's records are in place.
+ *
+ * Each sector header records the schema version and a hash of the record lengths it was
+ * written with. To change the format of a setting, give it a new tag, add the new length to
+ * JOURNAL_RECORD_LENGTHS and increment JOURNAL_SCHEMA_VERSION; the module that owns the
+ * setting converts the old tag's record when the new one is absent, so the value moves
+ * rather than reverting to its default. A record whose length exceeds its tag's entry in
+ * JOURNAL_RECORD_LENGTHS is never read.
+ *
+ */
+
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include "defs.h"
+
+#define JOURNAL_SECTOR_SIZE 192         /* two sectors are reserved at the top of EEPROM */
+#define JOURNAL_MAX_DATA_LENGTH 8
+#define JOURNAL_RECORD_OVERHEAD 4       /* tag, sequence, length and CRC */
+
+#define JOURNAL_SCHEMA_LEGACY 0         /* settings predate the journal: flag-guarded EEMEM variables */
+#define JOURNAL_SCHEMA_VERSION 1
+
+/* Tag values are stored in EEPROM: never renumber them, only add new ones */
+typedef enum
+{
+	JOURNAL_TAG_TONE_VOLUME = 0,
+	JOURNAL_TAG_MAIN_VOLUME = 1,
+	JOURNAL_TAG_AUDIO_RSSI = 2,
+	JOURNAL_TAG_TONE_RSSI_DIRECTION = 3,
+	JOURNAL_TAG_RSSI_FILTER = 4,
+	JOURNAL_TAG_SI5351_REF_CORRECTION = 5,
+	JOURNAL_TAG_ACTIVE_BAND = 6,
+	JOURNAL_TAG_2M_FREQUENCY = 7,
+	JOURNAL_TAG_80M_FREQUENCY = 8,
+	JOURNAL_TAG_CW_OFFSET_FREQUENCY = 9,
+	JOURNAL_TAG_PREAMP_80M = 10,
+	JOURNAL_TAG_PREAMP_2M = 11,
+	JOURNAL_TAG_ATTENUATION = 12,
+	JOURNAL_NUMBER_OF_TAGS
+} JournalTag;
+
+/* Maximum record length for each tag, in tag order */
+#define JOURNAL_RECORD_LENGTHS { 1, 1, 1, 1, 1, 4, 1, 4, 4, 4, 1, 1, 1 }
+
+/**
+ * Selects the newest valid sector and replays its records to locate the latest value of
+ * each tag. Records following a damaged record are ignored. A sector written under another
+ * schema version or layout is rewritten in the current one. Call once at startup, before
+ * any other journal function.
+ * Returns the schema version found, or JOURNAL_SCHEMA_LEGACY if there was no journal, in
+ * which case the caller should move any legacy settings into the journal.
+ */
+uint8_t journal_init(void);
+
+/**
+ * Returns the length of the latest record for tag, or zero if there is none.
+ */
+uint8_t journal_length(JournalTag tag);
+
+/**
+ * Copies the latest value of tag into data. Returns TRUE, leaving data unchanged,
+ * if there is no record for tag or its length differs from size.
+ */
+BOOL journal_read(JournalTag tag, void* data, uint8_t size);
+
+/**
+ * Appends a record for tag unless its latest value already equals data. Compacts the
+ * journal first if the active sector is full. Returns TRUE if the record could not be written,
+ * including when called from an ISR that interrupted another write.
+ */
+BOOL journal_write(JournalTag tag, const void* data, uint8_t size);
+
+/**
+ * Scalar accessors. The read functions return fallback if tag has no record of the right length.
+ */
+static inline uint8_t journal_read_byte(JournalTag tag, uint8_t fallback)
+{
+	journal_read(tag, &fallback, sizeof(fallback));
+	return( fallback);
+}
+
+static inline uint16_t journal_read_word(JournalTag tag, uint16_t fallback)
+{
+	journal_read(tag, &fallback, sizeof(fallback));
+	return( fallback);
+}
+
+static inline uint32_t journal_read_dword(JournalTag tag, uint32_t fallback)
+{
+	journal_read(tag, &fallback, sizeof(fallback));
+	return( fallback);
+}
+
+static inline BOOL journal_write_byte(JournalTag tag, uint8_t value)
+{
+	return( journal_write(tag, &value, sizeof(value)));
+}
+
+static inline BOOL journal_write_word(JournalTag tag, uint16_t value)
+{
+	return( journal_write(tag, &value, sizeof(value)));
+}
+
+static inline BOOL journal_write_dword(JournalTag tag, uint32_t value)
+{
+	return( journal_write(tag, &value, sizeof(value)));
+}
+
+#endif  /* JOURNAL_H_ */
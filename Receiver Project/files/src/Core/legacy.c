@@ -0,0 +1,54 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * legacy.c
+ *
+ */
+
+#include "legacy.h"
+#include "journal.h"
+#include <avr/eeprom.h>
+
+void legacy_migrate(void)
+{
+	if(eeprom_read_byte(LEGACY_RECEIVER_FLAG) == EEPROM_INITIALIZED_FLAG)
+	{
+		journal_write_dword(JOURNAL_TAG_SI5351_REF_CORRECTION, eeprom_read_dword(LEGACY_SI5351_REF_CORRECTION));
+		journal_write_byte(JOURNAL_TAG_ACTIVE_BAND, eeprom_read_byte(LEGACY_ACTIVE_BAND));
+		journal_write_dword(JOURNAL_TAG_2M_FREQUENCY, eeprom_read_dword(LEGACY_2M_FREQUENCY));
+		journal_write_dword(JOURNAL_TAG_80M_FREQUENCY, eeprom_read_dword(LEGACY_80M_FREQUENCY));
+		journal_write_dword(JOURNAL_TAG_CW_OFFSET_FREQUENCY, eeprom_read_dword(LEGACY_CW_OFFSET_FREQUENCY));
+		journal_write_byte(JOURNAL_TAG_PREAMP_80M, eeprom_read_byte(LEGACY_PREAMP_80M));
+		journal_write_byte(JOURNAL_TAG_PREAMP_2M, eeprom_read_byte(LEGACY_PREAMP_2M));
+		journal_write_byte(JOURNAL_TAG_ATTENUATION, eeprom_read_byte(LEGACY_ATTENUATION));
+	}
+
+	if(eeprom_read_byte(LEGACY_INTERFACE_FLAG) == EEPROM_INITIALIZED_FLAG)
+	{
+		journal_write_byte(JOURNAL_TAG_TONE_VOLUME, eeprom_read_byte(LEGACY_TONE_VOLUME));
+		journal_write_byte(JOURNAL_TAG_MAIN_VOLUME, eeprom_read_byte(LEGACY_MAIN_VOLUME));
+		journal_write_byte(JOURNAL_TAG_AUDIO_RSSI, eeprom_read_byte(LEGACY_AUDIO_RSSI));
+		journal_write_byte(JOURNAL_TAG_TONE_RSSI_DIRECTION, eeprom_read_byte(LEGACY_TONE_RSSI_DIRECTION));
+		journal_write_byte(JOURNAL_TAG_RSSI_FILTER, eeprom_read_byte(LEGACY_RSSI_FILTER));
+		eeprom_update_byte(LEGACY_INTERFACE_FLAG, EEPROM_UNINITIALIZED);
+	}
+}
@@ -0,0 +1,72 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * legacy.h
+ *
+ * Settings saved by firmware that predates the journal. That firmware kept them in EEMEM
+ * variables, which the linker places in link order, so the addresses below are pinned to
+ * those the linker gave them rather than declared again as EEMEM. No build of that firmware
+ * survives, so the addresses follow the declaration order of its two modules, main.o then
+ * receiver.o, as they are in the transmitter's Debug/RDP.elf.
+ *
+ * EEPROM map:
+ *
+ *   0x000 - 0x005   interface settings
+ *   0x006 - 0x01A   receiver settings
+ *   0x01B - 0x042   frequency memories (still in use)
+ *   0x0C0 - 0x18D   Si5351 frequency plans (SI5351_PLANS_EEPROM_ADDRESS)
+ *   0x280 - 0x3FF   journal
+ */
+
+#ifndef LEGACY_H_
+#define LEGACY_H_
+
+#include "defs.h"
+
+#define LEGACY_INTERFACE_FLAG ((uint8_t*)0x000)
+#define LEGACY_TONE_VOLUME ((uint8_t*)0x001)
+#define LEGACY_MAIN_VOLUME ((uint8_t*)0x002)
+#define LEGACY_AUDIO_RSSI ((uint8_t*)0x003)
+#define LEGACY_TONE_RSSI_DIRECTION ((uint8_t*)0x004)
+#define LEGACY_RSSI_FILTER ((uint8_t*)0x005)
+
+#define LEGACY_RECEIVER_FLAG ((uint8_t*)0x006)      /* also marks the frequency memories as written */
+#define LEGACY_SI5351_REF_CORRECTION ((uint32_t*)0x007)
+#define LEGACY_ACTIVE_BAND ((uint8_t*)0x00B)
+#define LEGACY_2M_FREQUENCY ((uint32_t*)0x00C)
+#define LEGACY_80M_FREQUENCY ((uint32_t*)0x010)
+#define LEGACY_CW_OFFSET_FREQUENCY ((uint32_t*)0x014)
+#define LEGACY_PREAMP_80M ((uint8_t*)0x018)
+#define LEGACY_PREAMP_2M ((uint8_t*)0x019)
+#define LEGACY_ATTENUATION ((uint8_t*)0x01A)
+
+#define LEGACY_2M_MEMORIES ((uint32_t*)0x01B)       /* MEMORY_1 to MEMORY_5 */
+#define LEGACY_80M_MEMORIES ((uint32_t*)0x02F)
+
+/**
+ * Moves legacy settings into the journal, so that an upgrade keeps them. Call only when
+ * journal_init() returns JOURNAL_SCHEMA_LEGACY. The interface flag is cleared so that its
+ * settings move only once; the receiver flag is left alone, since it guards the memories.
+ */
+void legacy_migrate(void);
+
+#endif  /* LEGACY_H_ */
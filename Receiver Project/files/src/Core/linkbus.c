@@ -45,7 +45,11 @@ static const char textHelp[][40] = { "\nCommands:\n",
 "  PRE [0-255]       - Preamp\n",
 "  O [Hz]            - CW Offset\n",
 "  A [0-100]         - Attenuation\n",
+"  AGC [0|1]         - Auto Gain\n",
 "  S[S]              - RSSI\n",
+"  SCN [0|1|M|C|A Hz]- Band Scan\n",
+"  SWP [0|1]         - Sweep Capture\n",
+"  I2C [0]           - I2C Devices\n",
 //"  TIM [hh:mm:ss]    - RTC Time\n",
 "  TON [-1|0|1]      - Tone RSSI\n",
 "  VOL <M:T> [0-15]  - Main/Tone Vol\n",
@@ -704,6 +708,115 @@ void lb_broadcast_rf(uint16_t data)
 	linkbus_send_text(g_tempMsgBuff);
 }
 
+void lb_send_sweep(SweepResult* result)
+{
+	char t[(2 * SWEEP_TRACE_POINTS) + 1];
+	uint8_t i;
+
+	if(!result)
+	{
+		return;
+	}
+
+	for(i = 0; i < result->traceLength; i++)
+	{
+		sprintf(&t[2 * i], "%02X", result->trace[i]);
+	}
+
+	t[2 * result->traceLength] = '\0';
+
+	if(g_lb_terminal_mode)
+	{
+		sprintf(g_tempMsgBuff, "> PK=%u@%u NUL=%u@%u W=%u%s", result->peak_mV, result->peak_ms, result->null_mV, result->null_ms, result->halfPowerWidth_ms, lineTerm);
+	}
+	else
+	{
+		sprintf(g_tempMsgBuff, "!SWP,%u,%u,%u,%u,%u,%s;", result->peak_mV, result->peak_ms, result->null_mV, result->null_ms, result->halfPowerWidth_ms, t);
+	}
+
+	linkbus_send_text(g_tempMsgBuff);
+}
+
+void lb_send_scan_peaks(ScanChannel* channels, uint8_t count)
+{
+	char t[(2 * SCAN_MAX_CHANNELS) + 1];
+	uint8_t i;
+
+	if(!channels)
+	{
+		return;
+	}
+
+	count = MIN(count, SCAN_MAX_CHANNELS);
+
+	for(i = 0; i < count; i++)
+	{
+		sprintf(&t[2 * i], "%02X", (uint8_t)MIN(channels[i].peak_mV / SCAN_MV_PER_COUNT, 0xFF));
+	}
+
+	t[2 * count] = '\0';
+
+	if(g_lb_terminal_mode)
+	{
+		sprintf(g_tempMsgBuff, "> SCN=%s%s", t, lineTerm);
+	}
+	else
+	{
+		sprintf(g_tempMsgBuff, "!SCN,%s;", t);
+	}
+
+	linkbus_send_text(g_tempMsgBuff);
+}
+
+void lb_send_scan_channel(ScanChannel* channel)
+{
+	if(!channel)
+	{
+		return;
+	}
+
+	if(g_lb_terminal_mode)
+	{
+		sprintf(g_tempMsgBuff, "> %lu Hz PK=%u%s", channel->freq, channel->peak_mV, lineTerm);
+	}
+	else
+	{
+		sprintf(g_tempMsgBuff, "!SCN,%lu,%u;", channel->freq, channel->peak_mV);
+	}
+
+	linkbus_send_text(g_tempMsgBuff);
+}
+
+void lb_send_agc(BOOL on, uint8_t stage, uint16_t level)
+{
+	if(g_lb_terminal_mode)
+	{
+		sprintf(g_tempMsgBuff, "> AGC=%u STG=%u LVL=%u%s", on ? 1 : 0, stage, level, lineTerm);
+	}
+	else
+	{
+		sprintf(g_tempMsgBuff, "!AGC,%u,%u,%u;", on ? 1 : 0, stage, level);
+	}
+
+	linkbus_send_text(g_tempMsgBuff);
+}
+
+void lb_send_i2c(I2CDevice* device)
+{
+	uint16_t kHz = (device->speed == I2C_SPEED_FAST) ? 400 : (device->speed == I2C_SPEED_STANDARD) ? 100 : 0;
+
+	if(g_lb_terminal_mode)
+	{
+		sprintf(g_tempMsgBuff, "> I2C %02X: %ukHz NACK=%u TMO=%u RCV=%u%s", device->slaveAddr, kHz, device->nacks, device->timeouts, device->recoveries, lineTerm);
+	}
+	else
+	{
+		sprintf(g_tempMsgBuff, "!I2C,%02X,%u,%u,%u,%u;", device->slaveAddr, kHz, device->nacks, device->timeouts, device->recoveries);
+	}
+
+	while(linkbus_send_text(g_tempMsgBuff));
+}
+
 void lb_broadcast_num(uint16_t data, char* str)
 {
 	char t[6] = "\0";
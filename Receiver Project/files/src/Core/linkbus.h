@@ -29,6 +29,9 @@
 #include "defs.h"
 #include "receiver.h"
 #include "si5351.h"
+#include "sweep.h"
+#include "scan.h"
+#include "i2c.h"
 
 #define INKBUS_TERMINAL_MODE_DEFAULT TRUE
 #define LINKBUS_MAX_MSG_LENGTH 75
@@ -114,7 +117,11 @@ typedef enum
 	MESSAGE_CW_OFFSET = 'O',						/* Sets or returns the CW offset in Hz */
 	MESSAGE_ATTENUATION = 'A',                      /* Sets receiver attenuation (0-255) */
 	MESSAGE_PREAMP = 'P' * 100 + 'R' * 10 + 'E',    /* Turn on preamp (1|0) */
+	MESSAGE_AGC = 'A' * 100 + 'G' * 10 + 'C',       /* $AGC,1; on / $AGC,0; off / $AGC; // Automatic gain control; reply !AGC,on,stage,level_mV; */
 	MESSAGE_TONE_RSSI = 'T' * 100 + 'O' * 10 + 'N', /* Turn on tone RSSI output */
+	MESSAGE_SWEEP = 'S' * 100 + 'W' * 10 + 'P',     /* $SWP,1; start / $SWP,0; stop / $SWP; // Capture an antenna sweep; reply !SWP,pk_mV,pk_ms,nul_mV,nul_ms,width_ms,trace; */
+	MESSAGE_I2C = 'I' * 100 + '2' * 10 + 'C',       /* $I2C; / $I2C,0; // Read (and optionally clear) each I2C device's address, probed speed (kHz; 0 = did not respond), NACKs, timeouts and bus recoveries */
+	MESSAGE_SCAN = 'S' * 100 + 'C' * 10 + 'N',      /* $SCN,C; clear / $SCN,A,Hz; add / $SCN,1[,ms]; scan list / $SCN,M[,ms]; scan memories / $SCN,0; stop / $SCN; // Band scan; each pass replies !SCN,peaks; $SCN; replies !SCN,Hz,pk_mV; per channel */
 
 	/* TTY USER MESSAGES */
 	MESSAGE_ALL_INFO = '?',                         /* Prints all receiver info */
@@ -286,6 +293,32 @@ void lb_poweroff_msg(uint8_t sec);
  */
 void lb_send_value(uint16_t value, char* label);
 
+/**
+ * Sends the results of an antenna sweep. The trace is sent as two hex digits per point.
+ */
+void lb_send_sweep(SweepResult* result);
+
+/**
+ * Sends the peak RSSI of each channel in one message, as two hex digits per channel in
+ * units of SCAN_MV_PER_COUNT.
+ */
+void lb_send_scan_peaks(ScanChannel* channels, uint8_t count);
+
+/**
+ * Sends the frequency and peak RSSI of one channel.
+ */
+void lb_send_scan_channel(ScanChannel* channel);
+
+/**
+ * Sends the AGC state, stage, and composite signal level.
+ */
+void lb_send_agc(BOOL on, uint8_t stage, uint16_t level);
+
+/**
+ * Sends one I2C device table entry: address, probed speed, and error counts.
+ */
+void lb_send_i2c(I2CDevice* device);
+
 /**
  */
 void lb_echo_char(uint8_t c);
@@ -32,6 +32,11 @@
 #include "i2c.h"
 #include "linkbus.h"
 #include "receiver.h"
+#include "sweep.h"
+#include "scan.h"
+#include "rssi.h"
+#include "journal.h"
+#include "legacy.h"
 #include "util.h"
 
 #include <avr/io.h>
@@ -90,29 +95,10 @@ static volatile uint16_t g_debug_atten_step = 0;
 #endif
 
 static uint8_t g_LB_broadcast_interval = 100;
-static BOOL EEMEM ee_interface_eeprom_initialization_flag = EEPROM_INITIALIZED_FLAG;
-
-extern uint32_t EEMEM ee_receiver_2m_mem1_freq;
-extern uint32_t EEMEM ee_receiver_2m_mem2_freq;
-extern uint32_t EEMEM ee_receiver_2m_mem3_freq;
-extern uint32_t EEMEM ee_receiver_2m_mem4_freq;
-extern uint32_t EEMEM ee_receiver_2m_mem5_freq;
-extern uint32_t EEMEM ee_receiver_80m_mem1_freq;
-extern uint32_t EEMEM ee_receiver_80m_mem2_freq;
-extern uint32_t EEMEM ee_receiver_80m_mem3_freq;
-extern uint32_t EEMEM ee_receiver_80m_mem4_freq;
-extern uint32_t EEMEM ee_receiver_80m_mem5_freq;
+static uint8_t g_LB_RSSI_broadcast_interval = RSSI_CONVERSION_TICKS;   /* RSSI has its own interval so that slower broadcasts do not hold it back */
 
 static volatile Frequency_Hz g_receiver_freq = 0;
 
-/* Digital Potentiometer Defines */
-static uint8_t EEMEM ee_tone_volume_setting = EEPROM_TONE_VOLUME_DEFAULT;
-/* Headphone Driver Defines */
-static uint8_t EEMEM ee_main_volume_setting = EEPROM_MAIN_VOLUME_DEFAULT;
-static uint8_t EEMEM ee_audio_RSSI_setting = EEPROM_AUDIO_RSSI_DEFAULT;
-static uint8_t EEMEM ee_tone_RSSI_direction_setting = EEPROM_TONE_RSSI_DIRECTION_DEFAULT;
-static uint8_t EEMEM ee_rssi_filter_setting = EEPROM_TONE_RSSI_FILTER_DEFAULT;
-
 static volatile uint8_t g_main_volume = 0;
 static volatile uint8_t g_hw_main_volume = EEPROM_MAIN_VOLUME_DEFAULT;
 static volatile uint8_t g_tone_volume;
@@ -137,22 +123,45 @@ static volatile uint8_t g_rssi_filter = 0;
 #define BAT_VOLTAGE 0x06
 #define RSSI_LEVEL 0x07
 #define NUMBER_OF_POLLED_ADC_CHANNELS 3
-static const uint8_t activeADC[NUMBER_OF_POLLED_ADC_CHANNELS] = { RF_LEVEL, BAT_VOLTAGE, RSSI_LEVEL };
 
-static const uint16_t g_adcChannelConversionPeriod_ticks[NUMBER_OF_POLLED_ADC_CHANNELS] = { 1000, 1000, 29 };
-static volatile uint16_t g_tickCountdownADCFlag[NUMBER_OF_POLLED_ADC_CHANNELS] = { 1000, 1000, 29 };
-static uint16_t g_filterADCValue[NUMBER_OF_POLLED_ADC_CHANNELS] = { 500, 500, 3 };
+#define ADC_OVERSAMPLE_NONE 0   /* log4 of the number of conversions summed per reading */
+#define ADC_OVERSAMPLE_4X 1
+#define ADC_OVERSAMPLE_16X 2
+#define ADC_RESULT_BITS 12      /* readings are scaled to 12 bits after decimation */
+#define ADC_FILTER_FRAC_BITS 4  /* fractional bits kept in the IIR filter state */
+#define ADC_SEQUENCE_PERIOD_TICKS 6     /* RSSI is read on every pass, ~100 Hz at 601 ticks per second */
+
+typedef struct
+{
+	uint8_t mux;            /* ADC input channel */
+	uint8_t oversample;     /* ADC_OVERSAMPLE_x */
+	uint8_t filterShift;    /* IIR: y += (x - y) >> filterShift; 0 = unfiltered */
+	uint8_t passDivider;    /* sampled on every passDivider-th pass of the sequence; must be a power of two */
+} ADCSequenceEntry;
+
+/* Entries are in *_READING order. RSSI has its own selectable filter. */
+static const ADCSequenceEntry g_adcSequence[NUMBER_OF_POLLED_ADC_CHANNELS] = {
+	{ RF_LEVEL, ADC_OVERSAMPLE_4X, 3, 128 },
+	{ BAT_VOLTAGE, ADC_OVERSAMPLE_16X, 3, 128 },
+	{ RSSI_LEVEL, ADC_OVERSAMPLE_4X, 0, 1 } };
+
+static volatile BOOL g_adcSequenceInProcess = FALSE;
+static uint8_t g_adcSequenceIndex;                                  /* entry being converted */
+static uint8_t g_adcSequencePass = 0;
+static uint8_t g_adcConversionsLeft;                                /* includes the conversion discarded after a mux change */
+static uint16_t g_adcSampleSum;
+static uint16_t g_adcFilterState[NUMBER_OF_POLLED_ADC_CHANNELS];   /* ADC_RESULT_BITS + ADC_FILTER_FRAC_BITS */
+static uint8_t g_adcFilterPrimed = 0;                               /* one bit per entry */
 static volatile BOOL g_adcUpdated[NUMBER_OF_POLLED_ADC_CHANNELS] = { FALSE, FALSE, FALSE };
 static volatile uint16_t g_lastConversionResult[NUMBER_OF_POLLED_ADC_CHANNELS];
 
-static volatile uint32_t g_filteredRSSI = 0;
+static volatile uint16_t g_filteredRSSI = 0;
 
 static volatile uint16_t g_power_off_countdown = POWER_OFF_DELAY;
 static volatile uint16_t g_headphone_removed_delay = HEADPHONE_REMOVED_DELAY;
 static volatile uint16_t g_low_voltage_shutdown_delay = LOW_VOLTAGE_DELAY;
 static volatile uint16_t g_backlight_off_countdown = BACKLIGHT_ALWAYS_ON;
 static uint16_t g_backlight_delay_value = BACKLIGHT_ALWAYS_ON;
-extern volatile BOOL g_i2c_not_timed_out;
 static volatile BOOL g_sufficient_power_detected = FALSE;
 static volatile BOOL g_enableHardwareWDResets = FALSE;
 
@@ -166,6 +175,7 @@ void initializeEEPROMVars(void);
 void saveAllEEPROM(void);
 void wdt_init(WDReset resetType);
 void tonePitch(uint8_t pitch);
+void adcStartSequenceEntry(uint8_t index);
 
 /***********************************************************************
  * Watchdog Timer ISR
@@ -212,10 +222,10 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
  ************************************************************************/
 ISR( TIMER2_COMPB_vect )
 {
-	static BOOL conversionInProcess = FALSE;
-	static int8_t indexConversionInProcess;
+	static uint16_t adcSequenceCountdown = ADC_SEQUENCE_PERIOD_TICKS;
 
 	g_tick_count++;
+	i2c_tick();
 
 	if(g_power_off_countdown)
 	{
@@ -246,6 +256,11 @@ ISR( TIMER2_COMPB_vect )
 		g_LB_broadcast_interval--;
 	}
 
+	if(g_LB_RSSI_broadcast_interval)
+	{
+		g_LB_RSSI_broadcast_interval--;
+	}
+
 	static BOOL volumeSetInProcess = FALSE;
 	static BOOL beepInProcess = FALSE;
 
@@ -306,131 +321,100 @@ ISR( TIMER2_COMPB_vect )
 	}
 
 	/**
-	 * Handle Periodic ADC Readings
-	 * The following algorithm allows multipe ADC channel readings to be performed at different polling intervals. */
-	if(!conversionInProcess)
+	 * Start a pass through the ADC sequence table. The conversions themselves are chained by ADC_vect. */
+	if(adcSequenceCountdown)
 	{
-		/* Note: countdowns will pause while a conversion is in process. Conversions are so fast that this should not be an issue though. */
+		adcSequenceCountdown--;
+	}
+	else if(!g_adcSequenceInProcess)
+	{
+		adcSequenceCountdown = ADC_SEQUENCE_PERIOD_TICKS - 1;  /* the next pass starts on the tick after this reaches zero */
+		g_adcSequenceInProcess = TRUE;
+		adcStartSequenceEntry(0);
+	}
+}/* ISR */
 
-		volatile uint8_t i; /* volatile to prevent optimization performing undefined behavior */
-		indexConversionInProcess = -1;
 
-		for(i = 0; i < NUMBER_OF_POLLED_ADC_CHANNELS; i++)
-		{
-			if(g_tickCountdownADCFlag[i])
-			{
-				g_tickCountdownADCFlag[i]--;
-			}
+/***********************************************************************
+ * ADC Conversion Complete ISR
+ *
+ * Walks the ADC sequence table one conversion at a time. Each reading
+ * is the sum of 4^n conversions decimated to ADC_RESULT_BITS, passed
+ * through a first-order IIR filter, and stored in millivolts at the pin.
+ ************************************************************************/
+ISR( ADC_vect )
+{
+	uint16_t sample = ADC;
+	uint8_t index = g_adcSequenceIndex;
+	const ADCSequenceEntry* entry = &g_adcSequence[index];
 
-			if(g_tickCountdownADCFlag[i] == 0)
-			{
-				indexConversionInProcess = (int8_t)i;
-			}
-		}
+	if(g_adcConversionsLeft <= (1 << (entry->oversample << 1)))   /* discard the first conversion after a mux change */
+	{
+		g_adcSampleSum += sample;
+	}
 
-		if(indexConversionInProcess >= 0)
-		{
-			g_tickCountdownADCFlag[indexConversionInProcess] = g_adcChannelConversionPeriod_ticks[indexConversionInProcess];    /* reset the tick countdown */
-			ADMUX = (ADMUX & 0xF0) | activeADC[indexConversionInProcess];                                                       /* index through all active channels */
-			ADCSRA |= (1 << ADSC);                                                                                              /*single conversion mode */
-			conversionInProcess = TRUE;
-		}
+	if(--g_adcConversionsLeft)
+	{
+		ADCSRA |= (1 << ADSC);
 	}
-	else if(!( ADCSRA & (1 << ADSC) ))                                                                                          /* wait for conversion to complete */
+	else
 	{
-		uint16_t hold = ADC;
-		uint16_t holdConversionResult = (uint16_t)(((uint32_t)hold * ADC_REF_VOLTAGE_mV) >> 10);                                /* millivolts at ADC pin */
-		uint16_t lastResult = g_lastConversionResult[indexConversionInProcess];
-		BOOL directionUP = holdConversionResult > lastResult;
-		uint16_t delta = directionUP ? holdConversionResult - lastResult : lastResult - holdConversionResult;
+		uint16_t x = g_adcSampleSum << (ADC_RESULT_BITS - 10 + ADC_FILTER_FRAC_BITS - (entry->oversample << 1));   /* decimate */
+		uint16_t y = g_adcFilterState[index];
+		uint16_t holdConversionResult;
+
+		if(!entry->filterShift || !(g_adcFilterPrimed & (1 << index)))
+		{
+			y = x;
+			g_adcFilterPrimed |= (1 << index);
+		}
+		else if(x > y)
+		{
+			y += (x - y) >> entry->filterShift;
+		}
+		else
+		{
+			y -= (y - x) >> entry->filterShift;
+		}
 
-		g_adcUpdated[indexConversionInProcess] = TRUE;
+		g_adcFilterState[index] = y;
+		holdConversionResult = (uint16_t)(((uint32_t)y * ADC_REF_VOLTAGE_mV) >> (ADC_RESULT_BITS + ADC_FILTER_FRAC_BITS));  /* millivolts at ADC pin */
 
-		if(indexConversionInProcess == BATTERY_READING)
+		if(index == BATTERY_READING)
 		{
-			if(delta > g_filterADCValue[indexConversionInProcess])
+			g_battery_measurements_active = TRUE;
+
+			if(holdConversionResult > VOLTS_5)
 			{
-				lastResult = holdConversionResult;
-				g_tickCountdownADCFlag[indexConversionInProcess] = 100; /* speed up next conversion */
+				g_battery_type = BATTERY_9V;
 			}
-			else
+			else if(holdConversionResult > VOLTS_3_0)
 			{
-				if(directionUP)
-				{
-					lastResult++;
-				}
-				else if(delta)
-				{
-					lastResult--;
-				}
-
-				g_battery_measurements_active = TRUE;
-	
-				if(lastResult > VOLTS_5)
-				{
-					g_battery_type = BATTERY_9V;
-				}
-				else if(lastResult > VOLTS_3_0)
-				{
-					g_battery_type = BATTERY_4r2V;
-				}
+				g_battery_type = BATTERY_4r2V;
 			}
 		}
-		else if(indexConversionInProcess == RSSI_READING)
+		else if(index == RSSI_READING)
 		{
-			uint16_t thresh = 0;
-			
-			lastResult = holdConversionResult;
-			
-			switch(g_rssi_filter)
+			if(scan_settling(g_tick_count))
 			{
-				case 1:
-				     thresh = 2500;
-				break;
-				
-				case 2:
-				     thresh = 1000;
-				break;
-				
-				case 3:
-				     thresh = 500;
-				break;
-				
-				case 4:
-				     thresh = 200;
-				break;
-				
-				case 5:
-					thresh = 50;
-				break;
-				
-				default:
-				     thresh = 5;
-				break;
+				rssi_filter_restart();  /* the filter starts afresh on each scanned frequency */
 			}
 
-			if(delta > thresh)
-			{
-				g_filteredRSSI = lastResult;
-			}
-			else
-			{
-				const int n = 3;
-				g_filteredRSSI = g_filteredRSSI << n;
-				g_filteredRSSI += lastResult;
-				g_filteredRSSI /= ((1 << n) + 1);
-			}
-			
+			g_filteredRSSI = rssi_filter(holdConversionResult, g_rssi_filter);
+			sweep_add_sample(g_filteredRSSI, g_tick_count);
+			rxAGCUpdate(holdConversionResult);  /* the AGC has its own attack and release */
+			scan_add_sample(rxSignalLevelOf(g_filteredRSSI), g_tick_count); /* filtered, so impulse noise does not set the channel's peak */
+
 			if(g_audio_RSSI)
 			{
-				g_filteredRSSI = MAX(g_filteredRSSI, 100);
-				tonePitch((g_filteredRSSI - 100) >> 3);
+				tonePitch((MAX(g_filteredRSSI, 100) - 100) >> 3);
 			}
 		}
 
-		g_lastConversionResult[indexConversionInProcess] = lastResult;
+		g_lastConversionResult[index] = holdConversionResult;
+		g_adcUpdated[index] = TRUE;
 
-		conversionInProcess = FALSE;
+		adcStartSequenceEntry(index + 1);
 	}
 }/* ISR */
 
@@ -508,6 +492,17 @@ ISR( PCINT0_vect )
 	}
 
 
+/***********************************************************************
+ * TWI ISR
+ *
+ * Advances the I2C transaction in progress by one bus event.
+ ************************************************************************/
+ISR( TWI_vect )
+{
+	i2c_twi_interrupt();
+}
+
+
 /***********************************************************************
  * Watchdog Timeout ISR
  *
@@ -519,7 +514,7 @@ ISR(WDT_vect)
 {
 	static uint8_t limit = 10;
 
-	g_i2c_not_timed_out = FALSE;    /* unstick I2C */
+	i2c_reset();                    /* unstick I2C */
 	saveAllEEPROM();                /* Make sure changed values get saved */
 
 	/* Don't allow an unlimited number of WD interrupts to occur without enabling
@@ -882,6 +877,11 @@ int main( void )
 
 	/**
 	 * Initialize internal EEPROM if needed */
+	if(journal_init() == JOURNAL_SCHEMA_LEGACY)
+	{
+		legacy_migrate();
+	}
+
 	initializeEEPROMVars();
 
 		DDRB |= (1 << PORTB0);                                                                  /* PB0 is Radio Enable output; */
@@ -917,7 +917,7 @@ int main( void )
 	/**
 	 * Set up ADC */
 	ADMUX |= (1 << REFS0);
-	ADCSRA |= (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0) | (1 << ADEN);
+	ADCSRA |= (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0) | (1 << ADEN) | (1 << ADIE);
 
 	/**
 	 * Set up pin interrupts */
@@ -936,6 +936,11 @@ int main( void )
 	wdt_init(WD_SW_RESETS);
 #endif // TRANQUILIZE_WATCHDOG
 
+	/**
+	 * Select the fastest bus speed each I2C device supports */
+	i2c_init();
+	i2c_probe();
+
 	/**
 	 * Initialize the receiver */
 
@@ -1172,6 +1177,102 @@ int main( void )
 				break;
 #endif //DEBUG_FUNCTIONS_ENABLE		
 
+				case MESSAGE_SWEEP:
+				{
+					SweepResult result;
+
+					if(lb_buff->fields[FIELD1][0] && atoi(lb_buff->fields[FIELD1]))
+					{
+						sweep_start();
+						lb_broadcast_num(1, "!SWP");
+					}
+					else
+					{
+						if(lb_buff->fields[FIELD1][0])
+						{
+							sweep_stop();
+						}
+
+						if(sweep_analyze(&result))  /* nothing captured yet */
+						{
+							lb_broadcast_num(sweep_active(), "!SWP");
+						}
+						else
+						{
+							lb_send_sweep(&result);
+						}
+					}
+				}
+				break;
+
+				case MESSAGE_I2C:
+				{
+					uint8_t index = 0;
+					I2CDevice dev;
+
+					while(!i2c_get_device(index++, &dev))
+					{
+						lb_send_i2c(&dev);
+					}
+
+					if(lb_buff->fields[FIELD1][0] == '0')
+					{
+						i2c_reset_stats();
+					}
+				}
+				break;
+
+				case MESSAGE_SCAN:
+				{
+					char c = lb_buff->fields[FIELD1][0];
+					uint16_t dwell = SCAN_DEFAULT_DWELL_MS;
+
+					if(lb_buff->fields[FIELD2][0])
+					{
+						dwell = (uint16_t)atoi(lb_buff->fields[FIELD2]);
+					}
+
+					if(c == 'C')
+					{
+						scan_clear();
+					}
+					else if(c == 'A')
+					{
+						if(scan_add_frequency(atol(lb_buff->fields[FIELD2])))
+						{
+							lb_broadcast_num(0, "!SCN");
+						}
+					}
+					else if((c == 'M') || (c == '1'))
+					{
+						BOOL err = (c == 'M') ? scan_load_memories() : FALSE;
+
+						if(!err)
+						{
+							err = scan_start(dwell);
+						}
+
+						lb_broadcast_num(!err, "!SCN");
+					}
+					else if(c == '0')
+					{
+						scan_stop();
+						lb_broadcast_num(0, "!SCN");
+					}
+					else
+					{
+						ScanChannel channels[SCAN_MAX_CHANNELS];
+						uint8_t count = scan_get_results(channels);
+						uint8_t i;
+
+						for(i = 0; i < count; i++)
+						{
+							lb_send_scan_channel(&channels[i]);
+						}
+					}
+				}
+				break;
+
 				case MESSAGE_TONE_RSSI:
 				{
 					if(lb_buff->fields[FIELD1][0])
@@ -1221,6 +1322,7 @@ int main( void )
 					{
 						uint8_t setting = atol(lb_buff->fields[FIELD1]);
 						
+						rxAGCEnable(FALSE);
 						result = rxSetPreamp(setting);
 					}
 					
@@ -1229,12 +1331,24 @@ int main( void )
 				}
 				break;
 
+				case MESSAGE_AGC:
+				{
+					if(lb_buff->fields[FIELD1][0])
+					{
+						rxAGCEnable(atoi(lb_buff->fields[FIELD1]) != 0);
+					}
+
+					lb_send_agc(rxAGCEnabled(), rxAGCStage(), rxSignalLevel());
+				}
+				break;
+
 				case MESSAGE_ATTENUATION:
 				{
 					uint16_t attenuation;
 					
 					if(lb_buff->fields[FIELD1][0])
 					{
+						rxAGCEnable(FALSE);
 						attenuation = CLAMP(0, (uint16_t)atoi(lb_buff->fields[FIELD1]), 100); 
 						attenuation = rxSetAttenuation(attenuation);
 					}
@@ -1281,6 +1395,9 @@ int main( void )
 				{
 					store_receiver_values();
 					saveAllEEPROM();
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+						si5351_save_plans();    /* only on request: the cache is too large to rewrite with every save */
+#endif
 				}
 				break;
 				
@@ -1341,11 +1458,11 @@ int main( void )
 									{
 										if(b == BAND_2M)
 										{
-											eemem_location = &ee_receiver_2m_mem1_freq;
+											eemem_location = &LEGACY_2M_MEMORIES[0];
 										}
 										else
 										{
-											eemem_location = &ee_receiver_80m_mem1_freq;
+											eemem_location = &LEGACY_80M_MEMORIES[0];
 										}
 
 									}
@@ -1355,11 +1472,11 @@ int main( void )
 									{
 										if(b == BAND_2M)
 										{
-											eemem_location = &ee_receiver_2m_mem2_freq;
+											eemem_location = &LEGACY_2M_MEMORIES[1];
 										}
 										else
 										{
-											eemem_location = &ee_receiver_80m_mem2_freq;
+											eemem_location = &LEGACY_80M_MEMORIES[1];
 										}
 
 									}
@@ -1369,11 +1486,11 @@ int main( void )
 									{
 										if(b == BAND_2M)
 										{
-											eemem_location = &ee_receiver_2m_mem3_freq;
+											eemem_location = &LEGACY_2M_MEMORIES[2];
 										}
 										else
 										{
-											eemem_location = &ee_receiver_80m_mem3_freq;
+											eemem_location = &LEGACY_80M_MEMORIES[2];
 										}
 
 									}
@@ -1383,11 +1500,11 @@ int main( void )
 									{
 										if(b == BAND_2M)
 										{
-											eemem_location = &ee_receiver_2m_mem4_freq;
+											eemem_location = &LEGACY_2M_MEMORIES[3];
 										}
 										else
 										{
-											eemem_location = &ee_receiver_80m_mem4_freq;
+											eemem_location = &LEGACY_80M_MEMORIES[3];
 										}
 
 									}
@@ -1397,11 +1514,11 @@ int main( void )
 									{
 										if(b == BAND_2M)
 										{
-											eemem_location = &ee_receiver_2m_mem5_freq;
+											eemem_location = &LEGACY_2M_MEMORIES[4];
 										}
 										else
 										{
-											eemem_location = &ee_receiver_80m_mem5_freq;
+											eemem_location = &LEGACY_80M_MEMORIES[4];
 										}
 
 									}
@@ -1811,6 +1928,16 @@ int main( void )
 			{
 				hold_tick_count = g_tick_count;
 
+				rxAGCService();
+
+				if(scan_service())
+				{
+					ScanChannel channels[SCAN_MAX_CHANNELS];
+					uint8_t count = scan_get_results(channels);
+
+					lb_send_scan_peaks(channels, count);
+				}
+
 				if(g_lb_repeat_rssi)
 				{
 					static uint16_t lastRSSI = 0;
@@ -1826,7 +1953,7 @@ int main( void )
 							{
 								lastRoundedRSSI = roundedRSSI;
 #ifndef DEBUG_FUNCTIONS_ENABLE
-								g_rssi_countdown = 100;
+								g_rssi_countdown = RSSI_CONVERSION_TICKS;
 #endif
 								lb_broadcast_rssi(10*roundedRSSI);
 							}
@@ -1859,7 +1986,7 @@ int main( void )
 //
 //						}
 
-						g_rssi_countdown = 100;
+						g_rssi_countdown = RSSI_CONVERSION_TICKS;
 						if(g_debug_atten_step)
 						{
 //							static uint8_t attenuation = 0;
@@ -1923,6 +2050,17 @@ int main( void )
 					}				
 				}
 
+				if(!g_LB_RSSI_broadcast_interval && (g_LB_broadcasts_enabled & RSSI_BROADCAST))
+				{
+					if(g_adcUpdated[RSSI_READING])
+					{
+						uint16_t v = g_lastConversionResult[RSSI_READING];
+						lb_broadcast_rssi(v);
+						g_adcUpdated[RSSI_READING] = FALSE;
+						g_LB_RSSI_broadcast_interval = RSSI_CONVERSION_TICKS;   /* minimum delay before next RSSI broadcast */
+					}
+				}
+
 				if(!g_LB_broadcast_interval && g_LB_broadcasts_enabled)
 				{
 					if(g_LB_broadcasts_enabled & UPC_TEMP_BROADCAST)
@@ -1941,17 +2079,6 @@ int main( void )
 						}
 					}
 
-					if(g_LB_broadcasts_enabled & RSSI_BROADCAST)
-					{
-						if(g_adcUpdated[RSSI_READING])
-						{
-							uint16_t v = g_lastConversionResult[RSSI_READING];  /* round up and adjust for voltage divider */
-							lb_broadcast_rssi(v);
-							g_adcUpdated[RSSI_READING] = FALSE;
-							g_LB_broadcast_interval = 100;                      /* minimum delay before next broadcast */
-						}
-					}
-
 					if(g_LB_broadcasts_enabled & RF_BROADCAST)
 					{
 						if(g_adcUpdated[RF_READING])
@@ -1986,38 +2113,27 @@ int main( void )
 
 void initializeEEPROMVars(void)
 {
-	if(eeprom_read_byte(&ee_interface_eeprom_initialization_flag) == EEPROM_INITIALIZED_FLAG)
-	{
-		g_tone_volume = eeprom_read_byte(&ee_tone_volume_setting);
-		g_main_volume = eeprom_read_byte(&ee_main_volume_setting);
-		g_audio_RSSI = eeprom_read_byte(&ee_audio_RSSI_setting);
-		g_tone_RSSI_direction = eeprom_read_byte(&ee_tone_RSSI_direction_setting);
-		g_rssi_filter = eeprom_read_byte(&ee_rssi_filter_setting);
-	}
-	else
-	{
-		g_tone_volume = EEPROM_TONE_VOLUME_DEFAULT;
-		g_main_volume = EEPROM_MAIN_VOLUME_DEFAULT;
-		g_audio_RSSI = EEPROM_AUDIO_RSSI_DEFAULT;
-		g_tone_RSSI_direction = EEPROM_TONE_RSSI_DIRECTION_DEFAULT;
-		g_rssi_filter = EEPROM_TONE_RSSI_FILTER_DEFAULT;
-
-		saveAllEEPROM();
-		eeprom_write_byte(&ee_interface_eeprom_initialization_flag, EEPROM_INITIALIZED_FLAG);
-		wdt_reset();                                    /* HW watchdog */
-	}
+	g_tone_volume = journal_read_byte(JOURNAL_TAG_TONE_VOLUME, EEPROM_TONE_VOLUME_DEFAULT);
+	g_main_volume = journal_read_byte(JOURNAL_TAG_MAIN_VOLUME, EEPROM_MAIN_VOLUME_DEFAULT);
+	g_audio_RSSI = journal_read_byte(JOURNAL_TAG_AUDIO_RSSI, EEPROM_AUDIO_RSSI_DEFAULT);
+	g_tone_RSSI_direction = journal_read_byte(JOURNAL_TAG_TONE_RSSI_DIRECTION, EEPROM_TONE_RSSI_DIRECTION_DEFAULT);
+	g_rssi_filter = journal_read_byte(JOURNAL_TAG_RSSI_FILTER, EEPROM_TONE_RSSI_FILTER_DEFAULT);
 }
 
+/**
+ * Only settings that have changed since they were last saved are written. Also called
+ * from the WDT ISR; that save is skipped if it interrupted another.
+ */
 void saveAllEEPROM()
 {
 	wdt_reset();                                    /* HW watchdog */
-	storeEEbyteIfChanged(&ee_tone_volume_setting, g_tone_volume);
-	storeEEbyteIfChanged(&ee_main_volume_setting, g_main_volume);
-	storeEEbyteIfChanged(&ee_audio_RSSI_setting, g_audio_RSSI);
-	storeEEbyteIfChanged(&ee_tone_RSSI_direction_setting, g_tone_RSSI_direction);
-	storeEEbyteIfChanged(&ee_rssi_filter_setting, g_rssi_filter);
+	journal_write_byte(JOURNAL_TAG_TONE_VOLUME, g_tone_volume);
+	journal_write_byte(JOURNAL_TAG_MAIN_VOLUME, g_main_volume);
+	journal_write_byte(JOURNAL_TAG_AUDIO_RSSI, g_audio_RSSI);
+	journal_write_byte(JOURNAL_TAG_TONE_RSSI_DIRECTION, g_tone_RSSI_direction);
+	journal_write_byte(JOURNAL_TAG_RSSI_FILTER, g_rssi_filter);
 }
-	
+
 void tonePitch(uint8_t pitch)
 {
 	Frequency_Hz freq;
@@ -2054,3 +2170,30 @@ void tonePitch(uint8_t pitch)
 
 	OCR0A =  MIN(((8000000 / (2 * prescale * freq)) - 1), 255);
 }
+
+/**
+ * Selects the first entry at or after index that is due on this pass of the ADC sequence,
+ * and starts its first conversion. Ends the pass if no entry remains. Called from ISRs only.
+ */
+void adcStartSequenceEntry(uint8_t index)
+{
+	while(index < NUMBER_OF_POLLED_ADC_CHANNELS)
+	{
+		const ADCSequenceEntry* entry = &g_adcSequence[index];
+
+		if(!(g_adcSequencePass & (entry->passDivider - 1)))
+		{
+			g_adcSequenceIndex = index;
+			g_adcConversionsLeft = (1 << (entry->oversample << 1)) + 1;
+			g_adcSampleSum = 0;
+			ADMUX = (ADMUX & 0xF0) | entry->mux;
+			ADCSRA |= (1 << ADSC);
+			return;
+		}
+
+		index++;
+	}
+
+	g_adcSequencePass++;
+	g_adcSequenceInProcess = FALSE;
+}
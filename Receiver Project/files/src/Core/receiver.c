@@ -27,8 +27,12 @@
 #include "util.h"
 
 
+#include <string.h>
 #include <stdlib.h>
+#include <avr/pgmspace.h>
 #include "receiver.h"
+#include "journal.h"
+#include "legacy.h"
 #include "pcf8574.h"	/* Port expander on Rev X1 Receiver board */
 #include "max5478.h"	/* Potentiometer for receiver attenuation on Rev X.1 Receiver board */
 #include "dac081c085.h" /* DAC on 80m VGA of Rev X1 Receiver board */
@@ -47,31 +51,23 @@
 	static volatile RadioBand g_activeBand = DEFAULT_RX_ACTIVE_BAND;
 	
 	static volatile uint8_t g_receiver_port_shadow = 0x00; // keep track of port value to avoid unnecessary reads
+
+	static const AGCStage g_agc_stages[RADIO_NUMBER_OF_BANDS][RX_AGC_STAGES] PROGMEM = { RX_AGC_2M_STAGES, RX_AGC_80M_STAGES };  /* indexed by RadioBand */
+	static volatile BOOL g_agc_enabled = FALSE;
+	static volatile uint8_t g_agc_stage = 0;                   /* requested by rxAGCUpdate() */
+	static volatile uint8_t g_agc_applied_stage = 0;           /* in effect */
+	static volatile RadioBand g_agc_applied_band = BAND_INVALID;
+	static volatile uint8_t g_agc_settle = 0;
+	static volatile uint16_t g_agc_rssi = 0;
+	static uint8_t g_agc_manual_preamp_2m;                     /* settings to restore when the AGC is turned off */
+	static uint8_t g_agc_manual_preamp_80m;
+	static uint8_t g_agc_manual_attenuation;
 	
 /* EEPROM Defines */
    #define EEPROM_BAND_DEFAULT BAND_2M
 
-	static BOOL EEMEM ee_receiver_eeprom_initialization_flag = EEPROM_INITIALIZED_FLAG;
-	static int32_t EEMEM ee_si5351_ref_correction = EEPROM_SI5351_CALIBRATION_DEFAULT;
-
-	static uint8_t EEMEM ee_active_band = EEPROM_BAND_DEFAULT;
-	static uint32_t EEMEM ee_active_2m_frequency = DEFAULT_RX_2M_FREQUENCY;
-	static uint32_t EEMEM ee_active_80m_frequency = DEFAULT_RX_80M_FREQUENCY;
-	static uint32_t EEMEM ee_cw_offset_frequency = DEFAULT_RX_CW_OFFSET_FREQUENCY;
-	static uint8_t EEMEM ee_preamp_80m = DEFAULT_PREAMP_80M;
-	static uint8_t EEMEM ee_preamp_2m = DEFAULT_PREAMP_2M;
-	static uint8_t EEMEM ee_attenuation_setting = DEFAULT_ATTENUATION;
-
-	uint32_t EEMEM ee_receiver_2m_mem1_freq = EEPROM_2M_MEM1_DEFAULT;
-	uint32_t EEMEM ee_receiver_2m_mem2_freq = EEPROM_2M_MEM2_DEFAULT;
-	uint32_t EEMEM ee_receiver_2m_mem3_freq = EEPROM_2M_MEM3_DEFAULT;
-	uint32_t EEMEM ee_receiver_2m_mem4_freq = EEPROM_2M_MEM4_DEFAULT;
-	uint32_t EEMEM ee_receiver_2m_mem5_freq = EEPROM_2M_MEM5_DEFAULT;
-	uint32_t EEMEM ee_receiver_80m_mem1_freq = EEPROM_80M_MEM1_DEFAULT;
-	uint32_t EEMEM ee_receiver_80m_mem2_freq = EEPROM_80M_MEM2_DEFAULT;
-	uint32_t EEMEM ee_receiver_80m_mem3_freq = EEPROM_80M_MEM3_DEFAULT;
-	uint32_t EEMEM ee_receiver_80m_mem4_freq = EEPROM_80M_MEM4_DEFAULT;
-	uint32_t EEMEM ee_receiver_80m_mem5_freq = EEPROM_80M_MEM5_DEFAULT;
+/* Settings are kept in the journal. The frequency memories are still where the firmware
+ * that predates it kept them (see legacy.h). */
 
 /*
  *       Local Function Prototypes
@@ -145,7 +141,14 @@
 		else if(g_activeBand == bandSet)
 		{
 			vfo -= g_cw_offset; // apply CW offset
-			si5351_set_freq(vfo, RX_CLOCK_VFO);
+
+			/* Recently used frequencies (e.g., memories) are set from cached register images; small
+			 * steps need only a PLL numerator update */
+			if(si5351_plan_cached(vfo, RX_CLOCK_VFO) || si5351_fine_tune(vfo, RX_CLOCK_VFO))
+			{
+				si5351_set_freq(vfo, RX_CLOCK_VFO);
+			}
+
 			activeBandSet = TRUE;
 		}
 
@@ -169,6 +172,21 @@
 		return( FREQUENCY_NOT_SPECIFIED);
 	}
 
+	Frequency_Hz rxGetMemoryFrequency(MemoryStore mem)
+	{
+		if((mem < MEMORY_1) || (mem >= ILLEGAL_MEMORY))
+		{
+			return( FREQUENCY_NOT_SPECIFIED);
+		}
+
+		if(g_activeBand == BAND_2M)
+		{
+			return( eeprom_read_dword(&LEGACY_2M_MEMORIES[mem - MEMORY_1]));
+		}
+
+		return( eeprom_read_dword(&LEGACY_80M_MEMORIES[mem - MEMORY_1]));
+	}
+
 	void rxSetVFOConfiguration(RadioVFOConfig config)
 	{
 		g_vfo_configuration = config;
@@ -243,52 +261,43 @@
 
 	void initializeReceiverEEPROMVars(void)
 	{
-		if(eeprom_read_byte(&ee_receiver_eeprom_initialization_flag) == EEPROM_INITIALIZED_FLAG)
-		{
-			g_activeBand = eeprom_read_byte(&ee_active_band);
-			g_freq_2m = eeprom_read_dword(&ee_active_2m_frequency);
-			g_freq_80m = eeprom_read_dword(&ee_active_80m_frequency);
-			g_cw_offset = eeprom_read_dword(&ee_cw_offset_frequency);
-			g_preamp_80m = eeprom_read_byte(&ee_preamp_80m);
-			g_preamp_2m = eeprom_read_byte(&ee_preamp_2m);
-			g_attenuation_setting = eeprom_read_byte(&ee_attenuation_setting);
-		}
-		else
+		g_activeBand = journal_read_byte(JOURNAL_TAG_ACTIVE_BAND, EEPROM_BAND_DEFAULT);
+		g_freq_2m = journal_read_dword(JOURNAL_TAG_2M_FREQUENCY, DEFAULT_RX_2M_FREQUENCY);
+		g_freq_80m = journal_read_dword(JOURNAL_TAG_80M_FREQUENCY, DEFAULT_RX_80M_FREQUENCY);
+		g_cw_offset = journal_read_dword(JOURNAL_TAG_CW_OFFSET_FREQUENCY, DEFAULT_RX_CW_OFFSET_FREQUENCY);
+		g_preamp_80m = journal_read_byte(JOURNAL_TAG_PREAMP_80M, DEFAULT_PREAMP_80M);
+		g_preamp_2m = journal_read_byte(JOURNAL_TAG_PREAMP_2M, DEFAULT_PREAMP_2M);
+		g_attenuation_setting = journal_read_byte(JOURNAL_TAG_ATTENUATION, DEFAULT_ATTENUATION);
+
+		if(eeprom_read_byte(LEGACY_RECEIVER_FLAG) != EEPROM_INITIALIZED_FLAG)
 		{
-			eeprom_write_dword(&ee_receiver_2m_mem1_freq, EEPROM_2M_MEM1_DEFAULT);
-			eeprom_write_dword(&ee_receiver_2m_mem2_freq, EEPROM_2M_MEM2_DEFAULT);
-			eeprom_write_dword(&ee_receiver_2m_mem3_freq, EEPROM_2M_MEM3_DEFAULT);
-			eeprom_write_dword(&ee_receiver_2m_mem4_freq, EEPROM_2M_MEM4_DEFAULT);
-			eeprom_write_dword(&ee_receiver_2m_mem5_freq, EEPROM_2M_MEM5_DEFAULT);
-			eeprom_write_dword(&ee_receiver_80m_mem1_freq, EEPROM_80M_MEM1_DEFAULT);
-			eeprom_write_dword(&ee_receiver_80m_mem2_freq, EEPROM_80M_MEM2_DEFAULT);
-			eeprom_write_dword(&ee_receiver_80m_mem3_freq, EEPROM_80M_MEM3_DEFAULT);
-			eeprom_write_dword(&ee_receiver_80m_mem4_freq, EEPROM_80M_MEM4_DEFAULT);
-			eeprom_write_dword(&ee_receiver_80m_mem5_freq, EEPROM_80M_MEM5_DEFAULT);
-			eeprom_write_byte(&ee_receiver_eeprom_initialization_flag, EEPROM_INITIALIZED_FLAG);
-
-			g_activeBand = EEPROM_BAND_DEFAULT;
-			g_freq_2m = DEFAULT_RX_2M_FREQUENCY;
-			g_freq_80m = DEFAULT_RX_80M_FREQUENCY;
-			g_cw_offset = DEFAULT_RX_CW_OFFSET_FREQUENCY;
-			g_preamp_80m = DEFAULT_PREAMP_80M;
-			g_preamp_2m = DEFAULT_PREAMP_2M;
-			g_attenuation_setting = DEFAULT_ATTENUATION;
-
-			saveAllReceiverEEPROM();
+			eeprom_write_dword(&LEGACY_2M_MEMORIES[0], EEPROM_2M_MEM1_DEFAULT);
+			eeprom_write_dword(&LEGACY_2M_MEMORIES[1], EEPROM_2M_MEM2_DEFAULT);
+			eeprom_write_dword(&LEGACY_2M_MEMORIES[2], EEPROM_2M_MEM3_DEFAULT);
+			eeprom_write_dword(&LEGACY_2M_MEMORIES[3], EEPROM_2M_MEM4_DEFAULT);
+			eeprom_write_dword(&LEGACY_2M_MEMORIES[4], EEPROM_2M_MEM5_DEFAULT);
+			eeprom_write_dword(&LEGACY_80M_MEMORIES[0], EEPROM_80M_MEM1_DEFAULT);
+			eeprom_write_dword(&LEGACY_80M_MEMORIES[1], EEPROM_80M_MEM2_DEFAULT);
+			eeprom_write_dword(&LEGACY_80M_MEMORIES[2], EEPROM_80M_MEM3_DEFAULT);
+			eeprom_write_dword(&LEGACY_80M_MEMORIES[3], EEPROM_80M_MEM4_DEFAULT);
+			eeprom_write_dword(&LEGACY_80M_MEMORIES[4], EEPROM_80M_MEM5_DEFAULT);
+			eeprom_write_byte(LEGACY_RECEIVER_FLAG, EEPROM_INITIALIZED_FLAG);
 		}
 	}
 
+	/**
+	 * Only settings that have changed since they were last saved are written.
+	 */
 	void saveAllReceiverEEPROM(void)
 	{
-		storeEEbyteIfChanged(&ee_active_band, g_activeBand);
-		storeEEdwordIfChanged((uint32_t*)&ee_active_2m_frequency, g_freq_2m);
-		storeEEdwordIfChanged((uint32_t*)&ee_active_80m_frequency, g_freq_80m);
-		storeEEdwordIfChanged((uint32_t*)&ee_cw_offset_frequency, g_cw_offset);
-		storeEEdwordIfChanged((uint32_t*)&ee_si5351_ref_correction, si5351_get_correction());
-		storeEEbyteIfChanged(&ee_preamp_80m, g_preamp_80m);
-		storeEEbyteIfChanged(&ee_preamp_2m, g_preamp_2m);
-		storeEEbyteIfChanged(&ee_attenuation_setting, g_attenuation_setting);
+		journal_write_byte(JOURNAL_TAG_ACTIVE_BAND, g_activeBand);
+		journal_write_dword(JOURNAL_TAG_2M_FREQUENCY, g_freq_2m);
+		journal_write_dword(JOURNAL_TAG_80M_FREQUENCY, g_freq_80m);
+		journal_write_dword(JOURNAL_TAG_CW_OFFSET_FREQUENCY, g_cw_offset);
+		journal_write_dword(JOURNAL_TAG_SI5351_REF_CORRECTION, si5351_get_correction());
+		journal_write_byte(JOURNAL_TAG_PREAMP_80M, g_agc_enabled ? g_agc_manual_preamp_80m : g_preamp_80m);
+		journal_write_byte(JOURNAL_TAG_PREAMP_2M, g_agc_enabled ? g_agc_manual_preamp_2m : g_preamp_2m);
+		journal_write_byte(JOURNAL_TAG_ATTENUATION, g_agc_enabled ? g_agc_manual_attenuation : g_attenuation_setting);
 	}
 
 
@@ -428,4 +437,147 @@ uint8_t rxSetPreamp(uint8_t setting)
 	return(result);
 }
 
+void rxAGCEnable(BOOL on)
+{
+	if(on && !g_agc_enabled)
+	{
+		g_agc_manual_preamp_2m = g_preamp_2m;
+		g_agc_manual_preamp_80m = g_preamp_80m;
+		g_agc_manual_attenuation = g_attenuation_setting;
+		g_agc_stage = 0;
+		g_agc_applied_band = BAND_INVALID;     /* rxAGCService() applies stage 0 */
+		g_agc_enabled = TRUE;
+	}
+	else if(!on && g_agc_enabled)
+	{
+		g_agc_enabled = FALSE;
+
+		if(g_activeBand == BAND_2M)
+		{
+			g_preamp_80m = g_agc_manual_preamp_80m;
+			rxSetPreamp(g_agc_manual_preamp_2m);
+		}
+		else
+		{
+			g_preamp_2m = g_agc_manual_preamp_2m;
+			rxSetPreamp(g_agc_manual_preamp_80m);
+		}
+
+		rxSetAttenuation(g_agc_manual_attenuation);
+	}
+}
+
+BOOL rxAGCEnabled(void)
+{
+	return( g_agc_enabled);
+}
+
+uint8_t rxAGCStage(void)
+{
+	return( g_agc_enabled ? g_agc_applied_stage : 0);
+}
+
+/**
+ * Attack is fast and release slow, so that the gain stays put through the gaps in a keyed
+ * signal. Only one change of stage is outstanding at a time.
+ */
+void rxAGCUpdate(uint16_t rssi_mV)
+{
+	static uint8_t attackCount = 0;
+	static uint8_t releaseCount = 0;
+
+	g_agc_rssi = rssi_mV;
+
+	if(!g_agc_enabled || (g_agc_stage != g_agc_applied_stage) || (g_agc_applied_band != g_activeBand))
+	{
+		attackCount = 0;
+		releaseCount = 0;
+		return;
+	}
+
+	if(g_agc_settle)
+	{
+		g_agc_settle--;
+		return;
+	}
+
+	if(rssi_mV > RX_AGC_ATTACK_MV)
+	{
+		releaseCount = 0;
+
+		if((++attackCount >= RX_AGC_ATTACK_READINGS) && (g_agc_stage < (RX_AGC_STAGES - 1)))
+		{
+			attackCount = 0;
+			g_agc_stage++;
+		}
+	}
+	else if(rssi_mV < RX_AGC_RELEASE_MV)
+	{
+		attackCount = 0;
+
+		if((++releaseCount >= RX_AGC_RELEASE_READINGS) && g_agc_stage)
+		{
+			releaseCount = 0;
+			g_agc_stage--;
+		}
+	}
+	else
+	{
+		attackCount = 0;
+		releaseCount = 0;
+	}
+}
+
+/**
+ * Only the settings that differ from the present stage are written.
+ */
+void rxAGCService(void)
+{
+	AGCStage stage;
+	uint8_t s = g_agc_stage;
+	RadioBand band = g_activeBand;
 
+	if(!g_agc_enabled || (band >= BAND_INVALID))
+	{
+		return;
+	}
+
+	if((s == g_agc_applied_stage) && (band == g_agc_applied_band))
+	{
+		return;
+	}
+
+	memcpy_P(&stage, &g_agc_stages[band][s], sizeof(AGCStage));
+
+	if(stage.preamp != rxGetPreamp())
+	{
+		rxSetPreamp(stage.preamp);
+	}
+
+	if(stage.attenuation != g_attenuation_setting)
+	{
+		rxSetAttenuation(stage.attenuation);
+	}
+
+	g_agc_settle = RX_AGC_SETTLE_READINGS;
+	g_agc_applied_stage = s;
+	g_agc_applied_band = band;
+}
+
+uint16_t rxSignalLevel(void)
+{
+	return( rxSignalLevelOf(g_agc_rssi));
+}
+
+uint16_t rxSignalLevelOf(uint16_t rssi_mV)
+{
+	uint16_t level = rssi_mV;
+	RadioBand band = g_agc_applied_band;
+
+	if(g_agc_enabled && (band < BAND_INVALID))
+	{
+		level += (uint16_t)pgm_read_byte(&g_agc_stages[band][g_agc_applied_stage].reduction_dB) * RX_RSSI_MV_PER_DB;
+	}
+
+	return( level);
+}
@@ -96,9 +96,33 @@ typedef enum
 #define RX_MINIMUM_80M_FREQUENCY 3500000
 #define RX_MAXIMUM_80M_FREQUENCY 4000000
 
-#define DEFAULT_PREAMP_80M 255;
-#define DEFAULT_PREAMP_2M 1;
-#define DEFAULT_ATTENUATION 0;
+#define DEFAULT_PREAMP_80M 255
+#define DEFAULT_PREAMP_2M 1
+#define DEFAULT_ATTENUATION 0
+
+/* Automatic gain control. Gain is reduced one stage at a time while RSSI stays above
+ * RX_AGC_ATTACK_MV, and restored one stage at a time once it has stayed below
+ * RX_AGC_RELEASE_MV for much longer. The gap between the two thresholds exceeds the largest
+ * step between stages, so that a change of stage cannot itself cause the opposite change. */
+#define RX_RSSI_MV_PER_DB 25                /* log detector slope */
+#define RX_AGC_ATTACK_MV 950                /* near the top of the RSSI range */
+#define RX_AGC_RELEASE_MV 600
+#define RX_AGC_ATTACK_READINGS 3            /* ~30 ms at the RSSI reading rate */
+#define RX_AGC_RELEASE_READINGS 200         /* ~2 s */
+#define RX_AGC_SETTLE_READINGS 5            /* readings ignored after a change of stage */
+#define RX_AGC_STAGES 6
+
+typedef struct
+{
+	uint8_t preamp;         /* rxSetPreamp() setting */
+	uint8_t attenuation;    /* rxSetAttenuation() setting */
+	uint8_t reduction_dB;   /* nominal gain reduction relative to the first stage */
+} AGCStage;
+
+/* Stages for each band, in order of decreasing gain. The attenuation settings are the
+ * breakpoints of potValFromAtten(). */
+#define RX_AGC_2M_STAGES { { 1, 0, 0 }, { 0, 0, 10 }, { 0, 23, 20 }, { 0, 41, 30 }, { 0, 70, 40 }, { 0, 100, 50 } }
+#define RX_AGC_80M_STAGES { { 255, 0, 0 }, { 128, 0, 10 }, { 128, 23, 20 }, { 128, 41, 30 }, { 128, 70, 40 }, { 128, 100, 50 } }
 
 
 typedef struct
@@ -139,7 +163,7 @@ typedef enum
 /**
  */
 	void store_receiver_values(void);
-	
+
 /**
  */
 	BOOL rxSetCWOffset(Frequency_Hz offset);
@@ -164,6 +188,12 @@ typedef enum
  */
 	Frequency_Hz rxGetFrequency(void);
 
+/**
+ * Returns the frequency stored in memory mem for the active band, or FREQUENCY_NOT_SPECIFIED
+ * if mem is not a memory.
+ */
+	Frequency_Hz rxGetMemoryFrequency(MemoryStore mem);
+
 /**
  */
 	void rxSetVFOConfiguration(RadioVFOConfig config);
@@ -190,5 +220,43 @@ uint8_t rxSetAttenuation(uint8_t att);
  */
 uint8_t rxGetAttenuation(void);
 
+/**
+ * Turns automatic gain control on or off. The preamp and attenuation settings in effect
+ * when it is turned on are restored when it is turned off, and are the ones saved to EEPROM
+ * meanwhile.
+ */
+void rxAGCEnable(BOOL on);
+
+/**
+ */
+BOOL rxAGCEnabled(void);
+
+/**
+ * Returns the AGC stage in effect; zero is full gain.
+ */
+uint8_t rxAGCStage(void);
+
+/**
+ * Offers an RSSI reading to the AGC, which decides whether to change stage. Call from the ISR
+ * that produces RSSI readings. No I2C traffic results: rxAGCService() applies the change.
+ */
+void rxAGCUpdate(uint16_t rssi_mV);
+
+/**
+ * Applies any change of AGC stage requested by rxAGCUpdate(). Call from the foreground.
+ */
+void rxAGCService(void);
+
+/**
+ * Returns the latest RSSI reading plus the gain reduction in effect, in RSSI millivolts:
+ * the reading the detector would give at full gain if it did not saturate.
+ */
+uint16_t rxSignalLevel(void);
+
+/**
+ * As rxSignalLevel(), for an RSSI reading taken elsewhere, e.g., one that has been filtered.
+ */
+uint16_t rxSignalLevelOf(uint16_t rssi_mV);
+
 
 #endif  /* RECEIVER_H_ */
\ No newline at end of file
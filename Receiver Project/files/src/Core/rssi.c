@@ -0,0 +1,103 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * rssi.c
+ *
+ */
+
+#include "rssi.h"
+
+typedef struct
+{
+	uint8_t averageShift;   /* log2 of moving-average length applied ahead of the IIR; 0 = none */
+	uint8_t attackShift;    /* rising RSSI: y += (x - y) >> attackShift */
+	uint8_t decayShift;     /* falling RSSI: y -= (y - x) >> decayShift */
+} RSSIFilterProfile;
+
+/* 1 is the most heavily smoothed, 0 is unfiltered. Attack is faster than decay so that
+ * peaks are not missed while sweeping for a bearing. */
+static const RSSIFilterProfile g_rssiFilterProfiles[NUMBER_OF_RSSI_FILTERS] = {
+	{ 0, 0, 0 },
+	{ 3, 2, 5 },
+	{ 2, 2, 4 },
+	{ 2, 1, 3 },
+	{ 1, 1, 3 },
+	{ 0, 0, 2 } };
+
+static BOOL g_rssiFilterRestart = FALSE;
+
+uint16_t rssi_filter(uint16_t rssi_mV, uint8_t filter)
+{
+	static uint16_t history[1 << RSSI_AVERAGE_MAX_SHIFT];
+	static uint8_t historyIndex = 0;
+	static uint16_t historySum = 0;
+	static uint16_t y = 0;
+	static uint8_t lastFilter = 0xFF;
+	const RSSIFilterProfile* profile;
+	uint16_t x;
+	uint8_t i;
+
+	profile = &g_rssiFilterProfiles[(filter < NUMBER_OF_RSSI_FILTERS) ? filter : 0];
+
+	if((lastFilter != filter) || g_rssiFilterRestart)  /* restart the filter from the present reading */
+	{
+		lastFilter = filter;
+		g_rssiFilterRestart = FALSE;
+
+		for(i = 0; i < (1 << RSSI_AVERAGE_MAX_SHIFT); i++)
+		{
+			history[i] = rssi_mV;
+		}
+
+		historySum = rssi_mV << profile->averageShift;
+		y = rssi_mV << RSSI_FILTER_FRAC_BITS;
+	}
+
+	if(profile->averageShift)
+	{
+		historyIndex = (historyIndex + 1) & ((1 << profile->averageShift) - 1);
+		historySum -= history[historyIndex];
+		historySum += rssi_mV;
+		history[historyIndex] = rssi_mV;
+		x = historySum << (RSSI_FILTER_FRAC_BITS - profile->averageShift);
+	}
+	else
+	{
+		x = rssi_mV << RSSI_FILTER_FRAC_BITS;
+	}
+
+	if(x > y)
+	{
+		y += (x - y) >> profile->attackShift;
+	}
+	else
+	{
+		y -= (y - x) >> profile->decayShift;
+	}
+
+	return( y >> RSSI_FILTER_FRAC_BITS);
+}
+
+void rssi_filter_restart(void)
+{
+	g_rssiFilterRestart = TRUE;
+}
@@ -0,0 +1,53 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * rssi.h
+ *
+ * Shift-only filters applied to RSSI readings in the ADC interrupt. Each filter is an
+ * optional moving average followed by a first-order IIR with separate attack and decay.
+ *
+ */
+
+#ifndef RSSI_H_
+#define RSSI_H_
+
+#include "defs.h"
+
+#define RSSI_FILTER_FRAC_BITS 4     /* fractional bits kept in the IIR filter state */
+#define RSSI_AVERAGE_MAX_SHIFT 3    /* longest moving average is 8 samples */
+#define RSSI_MAX_INPUT_MV 4095      /* larger readings would overflow the filter state */
+#define NUMBER_OF_RSSI_FILTERS 6
+
+/**
+ * Applies filter (0 = unfiltered ... NUMBER_OF_RSSI_FILTERS - 1) to a new reading, and returns
+ * the filtered result in millivolts. The filter restarts from the present reading whenever the
+ * selection changes. Uses shifts only. Called from ISRs only.
+ */
+uint16_t rssi_filter(uint16_t rssi_mV, uint8_t filter);
+
+/**
+ * Makes the next rssi_filter() call restart the filter from its reading, e.g., after a retune,
+ * so that the previous frequency's signal does not linger. Called from ISRs only.
+ */
+void rssi_filter_restart(void);
+
+#endif  /* RSSI_H_ */
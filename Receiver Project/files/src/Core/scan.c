@@ -0,0 +1,223 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * scan.c
+ *
+ */
+
+#include "scan.h"
+#include "receiver.h"
+#include <util/atomic.h>
+
+static ScanChannel g_scan_channels[SCAN_MAX_CHANNELS];
+static uint8_t g_scan_count = 0;
+static uint8_t g_scan_index = 0;                /* channel being measured */
+static Frequency_Hz g_scan_restore_freq;
+static volatile uint16_t g_scan_dwell_ticks;
+static volatile uint16_t g_scan_step_tick;      /* tick of the first reading after the retune */
+static volatile uint16_t g_scan_peak = 0;
+static volatile BOOL g_scan_step_begun = FALSE;
+static volatile BOOL g_scan_step_done = FALSE;
+static volatile BOOL g_scan_active = FALSE;
+
+/*
+ *       Local Function Prototypes
+ *
+ */
+static void beginStep(void);
+
+
+void scan_clear(void)
+{
+	if(!g_scan_active)
+	{
+		g_scan_count = 0;
+	}
+}
+
+BOOL scan_add_frequency(Frequency_Hz freq)
+{
+	if(g_scan_active || (g_scan_count >= SCAN_MAX_CHANNELS) || (bandForFrequency(freq) != rxGetBand()))
+	{
+		return( TRUE);
+	}
+
+	g_scan_channels[g_scan_count].freq = freq;
+	g_scan_channels[g_scan_count].peak_mV = 0;
+	g_scan_count++;
+
+	return( FALSE);
+}
+
+BOOL scan_load_memories(void)
+{
+	MemoryStore mem;
+
+	if(g_scan_active)
+	{
+		return( TRUE);
+	}
+
+	g_scan_count = 0;
+
+	for(mem = MEMORY_1; mem < ILLEGAL_MEMORY; mem++)
+	{
+		scan_add_frequency(rxGetMemoryFrequency(mem));
+	}
+
+	return( FALSE);
+}
+
+BOOL scan_start(uint16_t dwell_ms)
+{
+	if(!g_scan_count)
+	{
+		return( TRUE);
+	}
+
+	if(!g_scan_active)
+	{
+		g_scan_restore_freq = rxGetFrequency();
+	}
+
+	dwell_ms = CLAMP(SCAN_MIN_DWELL_MS, dwell_ms, SCAN_MAX_DWELL_MS);
+	g_scan_dwell_ticks = (uint16_t)(((uint32_t)dwell_ms * TIMER2_TICKS_PER_SECOND) / 1000UL);
+	g_scan_index = 0;
+	g_scan_active = TRUE;
+	beginStep();
+
+	return( FALSE);
+}
+
+void scan_stop(void)
+{
+	if(g_scan_active)
+	{
+		g_scan_active = FALSE;
+		rxSetFrequency(&g_scan_restore_freq);
+	}
+}
+
+BOOL scan_active(void)
+{
+	return( g_scan_active);
+}
+
+void scan_add_sample(uint16_t rssi_mV, uint16_t tick)
+{
+	uint16_t elapsed;
+
+	if(!g_scan_active || g_scan_step_done)
+	{
+		return;
+	}
+
+	if(!g_scan_step_begun)
+	{
+		g_scan_step_begun = TRUE;
+		g_scan_step_tick = tick;
+	}
+
+	elapsed = tick - g_scan_step_tick;
+
+	if(elapsed < SCAN_SETTLE_TICKS)
+	{
+		return;
+	}
+
+	if(rssi_mV > g_scan_peak)
+	{
+		g_scan_peak = rssi_mV;
+	}
+
+	if(elapsed >= g_scan_dwell_ticks)
+	{
+		g_scan_step_done = TRUE;
+	}
+}
+
+BOOL scan_settling(uint16_t tick)
+{
+	if(!g_scan_active || g_scan_step_done)
+	{
+		return( FALSE);
+	}
+
+	return( !g_scan_step_begun || ((uint16_t)(tick - g_scan_step_tick) < SCAN_SETTLE_TICKS));
+}
+
+BOOL scan_service(void)
+{
+	BOOL passComplete = FALSE;
+
+	if(!g_scan_active || !g_scan_step_done)
+	{
+		return( FALSE);
+	}
+
+	g_scan_channels[g_scan_index].peak_mV = g_scan_peak;
+
+	if(++g_scan_index >= g_scan_count)
+	{
+		g_scan_index = 0;
+		passComplete = TRUE;
+	}
+
+	beginStep();
+
+	return( passComplete);
+}
+
+uint8_t scan_get_results(ScanChannel* results)
+{
+	uint8_t i;
+
+	if(!results)
+	{
+		return( 0);
+	}
+
+	for(i = 0; i < g_scan_count; i++)
+	{
+		results[i] = g_scan_channels[i];
+	}
+
+	return( g_scan_count);
+}
+
+/**
+ * Retunes to the channel at g_scan_index and restarts peak detection. The fast retune paths
+ * in rxSetFrequency() keep the I2C traffic to a few register writes.
+ */
+static void beginStep(void)
+{
+	Frequency_Hz f = g_scan_channels[g_scan_index].freq;
+
+	rxSetFrequency(&f);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		g_scan_peak = 0;
+		g_scan_step_begun = FALSE;
+		g_scan_step_done = FALSE;
+	}
+}
@@ -0,0 +1,105 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * scan.h
+ *
+ * Steps the receiver through a list of frequencies, or the stored memories for the active
+ * band, and records the peak RSSI heard at each. Each step lasts only as long as the
+ * configured dwell time; retuning is done from the foreground as soon as a step ends.
+ *
+ */
+
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include "defs.h"
+
+#define SCAN_MAX_CHANNELS 10
+#define SCAN_SETTLE_TICKS 12            /* ~20 ms after a retune for the IF filter and log detector to settle */
+#define SCAN_DEFAULT_DWELL_MS 60
+#define SCAN_MIN_DWELL_MS 30            /* the settling time plus a few RSSI readings */
+#define SCAN_MAX_DWELL_MS 5000
+#define SCAN_MV_PER_COUNT 16            /* peaks in the compact table are 8 bits */
+
+typedef struct
+{
+	Frequency_Hz freq;
+	uint16_t peak_mV;               /* highest RSSI heard during the most recent dwell */
+} ScanChannel;
+
+/**
+ * Empties the frequency list. Not allowed while scanning.
+ */
+void scan_clear(void);
+
+/**
+ * Appends freq to the frequency list. Returns TRUE if the list is full, freq is not in the
+ * active band, or a scan is in progress.
+ */
+BOOL scan_add_frequency(Frequency_Hz freq);
+
+/**
+ * Replaces the frequency list with the active band's memories. Returns TRUE if a scan is in
+ * progress.
+ */
+BOOL scan_load_memories(void);
+
+/**
+ * Begins scanning the frequency list, with dwell_ms at each frequency. Returns TRUE if the
+ * list is empty.
+ */
+BOOL scan_start(uint16_t dwell_ms);
+
+/**
+ * Stops scanning and retunes the receiver to the frequency it was on before the scan began.
+ */
+void scan_stop(void);
+
+/**
+ */
+BOOL scan_active(void);
+
+/**
+ * Offers an RSSI reading to the step in progress. Call from the ISR that produces RSSI
+ * readings. Readings taken while the receiver settles after a retune are ignored.
+ */
+void scan_add_sample(uint16_t rssi_mV, uint16_t tick);
+
+/**
+ * Returns TRUE while a step's readings are being ignored for the receiver to settle. Call
+ * from the ISR that produces RSSI readings, before scan_add_sample().
+ */
+BOOL scan_settling(uint16_t tick);
+
+/**
+ * Records the peak of a finished step and retunes to the next frequency. Call from the
+ * foreground on every tick. Returns TRUE when this completes a pass through the list.
+ */
+BOOL scan_service(void);
+
+/**
+ * Copies the frequency list with the peak RSSI most recently recorded for each. Returns the
+ * number of channels copied.
+ */
+uint8_t scan_get_results(ScanChannel* results);
+
+#endif  /* SCAN_H_ */
@@ -0,0 +1,178 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * sweep.c
+ *
+ */
+
+#include "sweep.h"
+#include <string.h>
+#include <util/atomic.h>
+
+static uint8_t g_sweep_buffer[SWEEP_BUFFER_SIZE];
+static volatile uint8_t g_sweep_head = 0;       /* next slot to be written */
+static volatile uint8_t g_sweep_count = 0;
+static volatile uint16_t g_sweep_first_tick;    /* tick of the oldest sample in the buffer */
+static volatile uint16_t g_sweep_last_tick;
+static volatile uint16_t g_sweep_period_ticks = 0;
+static volatile BOOL g_sweep_active = FALSE;
+
+void sweep_start(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		g_sweep_head = 0;
+		g_sweep_count = 0;
+		g_sweep_period_ticks = 0;
+		g_sweep_active = TRUE;
+	}
+}
+
+void sweep_stop(void)
+{
+	g_sweep_active = FALSE;
+}
+
+BOOL sweep_active(void)
+{
+	return( g_sweep_active);
+}
+
+void sweep_add_sample(uint16_t rssi_mV, uint16_t tick)
+{
+	static uint8_t decimate = 0;
+
+	if(!g_sweep_active)
+	{
+		return;
+	}
+
+	if(++decimate < SWEEP_DECIMATION)
+	{
+		return;
+	}
+
+	decimate = 0;
+
+	g_sweep_buffer[g_sweep_head] = (uint8_t)MIN(rssi_mV / SWEEP_MV_PER_COUNT, 0xFF);
+	g_sweep_head = (g_sweep_head + 1) & (SWEEP_BUFFER_SIZE - 1);
+
+	if(g_sweep_count < SWEEP_BUFFER_SIZE)
+	{
+		if(!g_sweep_count)
+		{
+			g_sweep_first_tick = tick;
+		}
+		else if(g_sweep_count == 1)
+		{
+			g_sweep_period_ticks = tick - g_sweep_first_tick;
+		}
+
+		g_sweep_count++;
+	}
+	else
+	{
+		g_sweep_first_tick += g_sweep_period_ticks;  /* oldest sample was overwritten */
+	}
+
+	g_sweep_last_tick = tick;
+}
+
+BOOL sweep_analyze(SweepResult* result)
+{
+	uint8_t samples[SWEEP_BUFFER_SIZE];
+	uint8_t count, head, i;
+	uint8_t peak = 0, nul = 0;
+	uint8_t left, right, thresh;
+	uint16_t spanTicks;
+	uint32_t msPerSampleX256;
+
+	if(!result)
+	{
+		return( TRUE);
+	}
+
+	/* Copy the buffer in chronological order so capture can continue */
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = g_sweep_count;
+		head = g_sweep_head;
+		spanTicks = g_sweep_last_tick - g_sweep_first_tick;
+
+		for(i = 0; i < count; i++)
+		{
+			samples[i] = g_sweep_buffer[(uint8_t)(head - count + i) & (SWEEP_BUFFER_SIZE - 1)];
+		}
+	}
+
+	if(count < 2)
+	{
+		return( TRUE);
+	}
+
+	for(i = 1; i < count; i++)
+	{
+		if(samples[i] > samples[peak])
+		{
+			peak = i;
+		}
+
+		if(samples[i] < samples[nul])
+		{
+			nul = i;
+		}
+	}
+
+	thresh = (samples[peak] > (SWEEP_HALF_POWER_DROP_MV / SWEEP_MV_PER_COUNT)) ? samples[peak] - (SWEEP_HALF_POWER_DROP_MV / SWEEP_MV_PER_COUNT) : 0;
+	left = peak;
+	right = peak;
+
+	while((left > 0) && (samples[left - 1] >= thresh))
+	{
+		left--;
+	}
+
+	while((right < count - 1) && (samples[right + 1] >= thresh))
+	{
+		right++;
+	}
+
+	msPerSampleX256 = (((uint32_t)spanTicks * 1000UL) << 8) / ((uint32_t)TIMER2_TICKS_PER_SECOND * (count - 1));
+
+	result->peak_mV = samples[peak] * SWEEP_MV_PER_COUNT;
+	result->peak_ms = (uint16_t)((peak * msPerSampleX256) >> 8);
+	result->null_mV = samples[nul] * SWEEP_MV_PER_COUNT;
+	result->null_ms = (uint16_t)((nul * msPerSampleX256) >> 8);
+	result->halfPowerWidth_ms = (uint16_t)(((right - left + 1) * msPerSampleX256) >> 8);
+
+	/* Peak-hold decimation so that a narrow peak survives in the trace */
+	result->traceLength = MIN(count, SWEEP_TRACE_POINTS);
+	memset(result->trace, 0, SWEEP_TRACE_POINTS);
+
+	for(i = 0; i < count; i++)
+	{
+		uint8_t bin = (uint8_t)(((uint16_t)i * result->traceLength) / count);
+		result->trace[bin] = MAX(result->trace[bin], samples[i]);
+	}
+
+	return( FALSE);
+}
@@ -0,0 +1,77 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * sweep.h
+ *
+ * Captures filtered RSSI while the operator sweeps the antenna, and locates the
+ * peak, the null, and the width of the peak at half power.
+ *
+ */
+
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include "defs.h"
+
+#define SWEEP_BUFFER_SIZE 128           /* must be a power of two */
+#define SWEEP_DECIMATION 4              /* one RSSI reading in this many is captured */
+#define SWEEP_MV_PER_COUNT 16           /* captured samples are 8 bits */
+#define SWEEP_HALF_POWER_DROP_MV 75     /* 3 dB at the log detector's ~25 mV/dB slope */
+#define SWEEP_TRACE_POINTS 16
+
+typedef struct
+{
+	uint16_t peak_mV;
+	uint16_t peak_ms;               /* time from the oldest captured sample */
+	uint16_t null_mV;
+	uint16_t null_ms;
+	uint16_t halfPowerWidth_ms;     /* contiguous time within SWEEP_HALF_POWER_DROP_MV of the peak */
+	uint8_t traceLength;
+	uint8_t trace[SWEEP_TRACE_POINTS];  /* peak-hold decimated samples, SWEEP_MV_PER_COUNT mV each */
+} SweepResult;
+
+/**
+ * Empties the capture buffer and begins capturing.
+ */
+void sweep_start(void);
+
+/**
+ * Stops capturing. The buffer contents remain available to sweep_analyze().
+ */
+void sweep_stop(void);
+
+/**
+ */
+BOOL sweep_active(void);
+
+/**
+ * Offers a filtered RSSI reading to the capture buffer. Call from the ISR that produces
+ * RSSI readings, at a fixed rate. Once the buffer is full the oldest samples are overwritten.
+ */
+void sweep_add_sample(uint16_t rssi_mV, uint16_t tick);
+
+/**
+ * Analyzes the samples captured so far. Returns TRUE if fewer than two samples are available.
+ */
+BOOL sweep_analyze(SweepResult* result);
+
+#endif  /* SWEEP_H_ */
@@ -37,6 +37,8 @@
 
 #include "defs.h"
 
+#define AD5245_I2C_SLAVE_ADDR_A0_0 0x58
+
 /**
    Set the AD5345 potentiometer to the value passed in setting.
 */
@@ -25,9 +25,7 @@
 
 #include "dac081c085.h"
 #include "i2c.h"
-#include <util/twi.h>
-
-#define DAC081C_I2C_SLAVE_ADDR_A0 0x18
+#include <stddef.h>
 
 void dac081c_set_dac(uint8_t setting)
 {
@@ -45,42 +43,13 @@ void dac081c_set_dac(uint8_t setting)
 #endif
 {
 	uint8_t bytes[2];
-	uint8_t bytes2read = 2;
-	uint8_t index = 0;
-	
-	i2c_start();
-	if(i2c_status(TW_START))
-	{
-		return(TRUE);
-	}
+	I2CTransaction t = { DAC081C_I2C_SLAVE_ADDR_A0, 0, TRUE, NULL, 0, bytes, 2, NULL, I2C_STATUS_OK };   /* the DAC has no register address */
 
-	if(i2c_write_success((DAC081C_I2C_SLAVE_ADDR_A0 | TW_READ), TW_MR_SLA_ACK))
+	if(i2c_transact(&t))
 	{
 		return(TRUE);
 	}
 
-	while(bytes2read--)
-	{
-		if(bytes2read)
-		{
-			bytes[index++] = i2c_read_ack();
-			if(i2c_status(TW_MR_DATA_ACK))
-			{
-				return(TRUE);
-			}
-		}
-		else
-		{
-			bytes[index] = i2c_read_nack();
-			if(i2c_status(TW_MR_DATA_NACK))
-			{
-				return(TRUE);
-			}
-		}
-	}
-
-	i2c_stop();
-		
 	bytes[0] = (bytes[0] << 4);
 	bytes[0] |= (bytes[1] >> 4);
 
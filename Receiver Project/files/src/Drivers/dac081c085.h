@@ -36,6 +36,8 @@
 
 #include "defs.h"
 
+#define DAC081C_I2C_SLAVE_ADDR_A0 0x18
+
 /**
    Set the DAC to the value passed in setting.
 */
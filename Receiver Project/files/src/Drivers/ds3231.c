@@ -32,8 +32,6 @@
    #include <stdio.h>
    #include "i2c.h"
 
-   #define DS3231_I2C_SLAVE_ADDR 0xD0   /* corresponds to slave address = 0b1101000x */
-
    #define RTC_SECONDS                     0x00
    #define RTC_MINUTES                     0x01
    #define RTC_HOURS                       0x02
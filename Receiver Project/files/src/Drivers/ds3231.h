@@ -37,6 +37,8 @@
 #ifndef DS3231_H_
 #define DS3231_H_
 
+#define DS3231_I2C_SLAVE_ADDR 0xD0   /* corresponds to slave address = 0b1101000x */
+
 #ifdef INCLUDE_DS3231_SUPPORT
 
 /**
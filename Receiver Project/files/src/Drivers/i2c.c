@@ -28,23 +28,86 @@
 #include <avr/io.h>
 #include <avr/sfr_defs.h>
 #include <util/delay.h>
+#include <util/atomic.h>
+#include <stddef.h>
 
 #include "si5351.h"
+#include "ds3231.h"
+#include "ad5245.h"
+#include "max5478.h"
+#include "dac081c085.h"
+#include "pcf8574.h"
 #include "i2c.h"
 
-volatile BOOL g_i2c_not_timed_out = TRUE;
+/**
+Prototypes for local functions
+*/
+
+/**
+ */
+static void i2c_start_next(void);
+
+/**
+ */
+static void i2c_complete(I2CStatus status);
+
+/**
+ */
+static BOOL i2c_wait(I2CTransaction *t);
+
+/**
+ */
+static uint8_t i2c_bit_rate(uint8_t slaveAddr);
+
+/**
+ */
+static I2CDevice* i2c_find_device(uint8_t slaveAddr);
+
+/**
+ */
+static void i2c_recovery_start(void);
 
 /**
- * This routine turns off the I2C bus and clears it
- * on return SCA and SCL pins are tri-state inputs.
- * You need to call Wire.begin() after this to re-enable I2C
- * This routine does NOT use the Wire library at all.
- *
- * returns 0 if bus cleared
- *         1 if SCL held low.
- *         2 if SDA held low by slave clock stretch for > 2sec
- *         3 if SDA held low after 20 clocks.
  */
+static void i2c_recovery_step(void);
+
+typedef enum
+{
+	I2C_RECOVERY_IDLE = 0,
+	I2C_RECOVERY_WAIT_SCL,      /* SCL released; waiting for a clock-stretching slave to let go */
+	I2C_RECOVERY_CLOCK_LOW,
+	I2C_RECOVERY_CLOCK_HIGH,
+	I2C_RECOVERY_STOP_LOW,      /* SDA driven low while SCL is high (START) */
+	I2C_RECOVERY_STOP_HIGH      /* SDA released while SCL is high (STOP) */
+} I2CRecoveryState;
+
+/* Devices not listed here are always addressed at standard speed */
+static I2CDevice g_i2c_devices[] =
+{
+#ifdef INCLUDE_SI5351_SUPPORT
+	{ SI5351_I2C_SLAVE_ADDR, I2C_SPEED_FAST, I2C_SPEED_STANDARD, 0, 0, 0 },
+#endif
+#ifdef INCLUDE_DS3231_SUPPORT
+	{ DS3231_I2C_SLAVE_ADDR, I2C_SPEED_FAST, I2C_SPEED_STANDARD, 0, 0, 0 },
+#endif
+	{ AD5245_I2C_SLAVE_ADDR_A0_0, I2C_SPEED_FAST, I2C_SPEED_STANDARD, 0, 0, 0 },
+	{ MAX5478_I2C_SLAVE_ADDR_A0_0, I2C_SPEED_FAST, I2C_SPEED_STANDARD, 0, 0, 0 },
+	{ DAC081C_I2C_SLAVE_ADDR_A0, I2C_SPEED_FAST, I2C_SPEED_STANDARD, 0, 0, 0 },
+#ifdef INCLUDE_PCF8574_SUPPORT
+	{ PCF8574_SLAVE_ADDR_A000_0, I2C_SPEED_STANDARD, I2C_SPEED_STANDARD, 0, 0, 0 },   /* 100 kHz part */
+#endif
+};
+
+#define I2C_NUMBER_OF_DEVICES (sizeof(g_i2c_devices) / sizeof(I2CDevice))
+
+static I2CTransaction * volatile g_i2c_queue[I2C_QUEUE_SIZE];
+static volatile uint8_t g_i2c_queue_head = 0;   /* transaction in progress, if any */
+static volatile uint8_t g_i2c_queue_count = 0;
+static volatile uint8_t g_i2c_index = 0;        /* bytes transferred in the present phase */
+static volatile uint8_t g_i2c_ticks_left = 0;   /* timeout for the transaction in progress */
+static volatile I2CRecoveryState g_i2c_recovery_state = I2C_RECOVERY_IDLE;
+static uint8_t g_i2c_recovery_ticks;            /* remaining wait for SCL */
+static uint8_t g_i2c_recovery_clocks;           /* remaining clock pulses */
 
 #ifndef SDA_PIN
 #define         SDA_PIN (1 << PINC4)
@@ -66,318 +129,484 @@ volatile BOOL g_i2c_not_timed_out = TRUE;
 #define         I2C (SCL_PIN | SDA_PIN)
 #endif
 
-#ifdef SUPPORT_I2C_CLEARBUS_FUNCTION
-	BOOL i2c_clearBus(void)
-	{
-#if defined (TWCR) && defined (TWEN)
-			TWCR &= ~(_BV(TWEN));   /*Disable the Atmel 2-Wire interface so we can control the SDA and SCL pins directly */
-#endif
+void i2c_init(void)
+{
+	power_twi_enable();
 
-		/* Make SDA (data) and SCL (clock) pins Inputs with pullup. */
-		uint8_t temp = DDRC;
-		DDRC = temp & ~I2C;
-		temp = PORTC;
-		PORTC = temp | I2C;
-		temp = PORTC;
+	TWSR = 0;   /* Prescale /1 */
+	TWBR = I2C_TWBR_STANDARD;
 
-		_delay_ms(1000);                    /* Wait for power to settle */
-		BOOL scl_low = !(PINC & SCL_PIN);   /* Check if SCL is Low. */
+	/* enable I2C */
+	TWCR = _BV(TWEN);
 
-		if(scl_low)
-		{                                   /*If it is held low processor cannot become the I2C master. */
-			return(1);                     /*I2C bus error. Could not clear SCL clock line held low */
-		}
+	g_i2c_queue_count = 0;
+	g_i2c_queue_head = 0;
+}
 
-		BOOL sda_low = !(PINC & SDA_PIN);   /* vi. Check SDA input. */
-		int clockCount = 20;                /* > 2x9 clock */
+void i2c_reset(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		while(g_i2c_queue_count)
+		{
+			i2c_complete(I2C_STATUS_TIMEOUT);
+		}
 
-		while(sda_low && clockCount--)
+		if(g_i2c_recovery_state == I2C_RECOVERY_IDLE)   /* otherwise recovery completes on its own */
 		{
-			/* Note: I2C bus is open collector so do NOT drive SCL or SDA high. */
-			PORTC &= ~SCL;  /* disable pull-up on SCL */
-			DDRC |= SCL;    /* drive SCL Low by making it an output */
-			_delay_ms(1);
-			DDRC &= ~SCL;   /* release SCL by making it an input */
-			PORTC |= SCL;   /* pull SCL high again */
-			_delay_ms(1);
+			TWCR = 0;   /* release the bus */
+			TWCR = _BV(TWEN);
+		}
+	}
+}
 
-			scl_low = !(PINC & SCL_PIN);
-			int counter = 20;
+BOOL i2c_submit(I2CTransaction *t)
+{
+	BOOL full = FALSE;
 
-			while(scl_low && counter--)
-			{   /*  loop waiting for SCL to become High only wait 2sec. */
-				_delay_ms(100);
-				scl_low = !(PINC & SCL_PIN);
-			}
+	t->status = I2C_STATUS_PENDING;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(g_i2c_queue_count >= I2C_QUEUE_SIZE)
+		{
+			full = TRUE;
+		}
+		else
+		{
+			g_i2c_queue[(g_i2c_queue_head + g_i2c_queue_count) & (I2C_QUEUE_SIZE - 1)] = t;
 
-			if(scl_low)
+			if(!g_i2c_queue_count++ && (g_i2c_recovery_state == I2C_RECOVERY_IDLE))
 			{
-				return(2);
+				i2c_start_next();
 			}
-
-			sda_low = !(PINC & SDA_PIN);    /* Check SDA input. */
 		}
+	}
+
+	return( full);
+}
+
+BOOL i2c_busy(void)
+{
+	return( g_i2c_queue_count != 0);
+}
 
-		if(sda_low)
-		{                                   /* still low */
-			return(3);                     /* I2C bus error. Could not clear. SDA data line held low */
+void i2c_tick(void)
+{
+	if(g_i2c_recovery_state != I2C_RECOVERY_IDLE)
+	{
+		i2c_recovery_step();
+	}
+	else if(g_i2c_queue_count && g_i2c_ticks_left)
+	{
+		if(!--g_i2c_ticks_left)
+		{
+			i2c_recovery_start();   /* abandon the transaction and clear the bus */
+			i2c_complete(I2C_STATUS_TIMEOUT);
 		}
+	}
+}
 
-		/* Pull SDA line low for Start or Repeated Start */
-		PORTC &= ~SDA;                      /* remove SDA pull-up */
-		DDRC |= SDA;                        /* drive SDA low */
-		_delay_ms(1);
-		DDRC &= ~SDA;                       /* make SDA input */
-		PORTC |= SDA;                       /* pull SDA high */
-		_delay_ms(1);
-		DDRC &= ~I2C;                       /* tri-state SCL and SDA with pull-ups enabled */
+void i2c_reset_stats(void)
+{
+	uint8_t i;
 
-		return(0);                          /* all ok */
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(i = 0; i < I2C_NUMBER_OF_DEVICES; i++)
+		{
+			g_i2c_devices[i].nacks = 0;
+			g_i2c_devices[i].timeouts = 0;
+			g_i2c_devices[i].recoveries = 0;
+		}
 	}
-#endif /* SUPPORT_I2C_CLEARBUS_FUNCTION */
+}
 
-void i2c_init(void)
+/**
+ * Takes the pins away from the TWI so that a slave holding SDA low can be clocked free. The
+ * transaction at the head of the queue, if any, is charged with the recovery.
+ */
+static void i2c_recovery_start(void)
 {
-	power_twi_enable();
+	I2CDevice *d;
 
-	/* set SCL to ~100 kHz for 8 MHz CPU clock */
-	TWSR = 0;   /* Prescale /1 */
-	TWBR = 0x25;
+	TWCR = 0;
+	DDRC &= ~I2C;       /* inputs with pull-ups */
+	PORTC |= I2C;
 
-	/* enable I2C */
-	TWCR = _BV(TWEN);
-	g_i2c_not_timed_out = TRUE;
+	g_i2c_recovery_ticks = I2C_RECOVERY_SCL_WAIT_TICKS;
+	g_i2c_recovery_clocks = I2C_RECOVERY_CLOCKS;
+	g_i2c_recovery_state = I2C_RECOVERY_WAIT_SCL;
+
+	if(g_i2c_queue_count && (d = i2c_find_device(g_i2c_queue[g_i2c_queue_head]->slaveAddr)))
+	{
+		d->recoveries++;
+	}
 }
 
-#ifdef I2C_TIMEOUT_SUPPORT
-	BOOL i2c_start(void)
-#else
-	void i2c_start(void)
-#endif
+/**
+ * Advances bus recovery by one TIMER2 tick: clock SCL until the slave releases SDA, then
+ * send START and STOP. Finally the TWI is re-enabled and any queued transactions resume.
+ */
+static void i2c_recovery_step(void)
 {
-#ifdef I2C_TIMEOUT_SUPPORT
-		TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN);
-		while(!(TWCR & _BV(TWINT)) && g_i2c_not_timed_out)
+	switch(g_i2c_recovery_state)
+	{
+		case I2C_RECOVERY_WAIT_SCL:
 		{
-			;
+			if(!(PINC & SCL_PIN))
+			{
+				if(--g_i2c_recovery_ticks)
+				{
+					break;
+				}
+
+				g_i2c_recovery_clocks = 0;  /* SCL held low: give up */
+			}
+
+			if(!(PINC & SDA_PIN) && g_i2c_recovery_clocks)
+			{
+				g_i2c_recovery_clocks--;
+				g_i2c_recovery_state = I2C_RECOVERY_CLOCK_LOW;
+			}
+			else
+			{
+				g_i2c_recovery_state = I2C_RECOVERY_STOP_LOW;
+			}
 		}
+		break;
 
-		if(!g_i2c_not_timed_out)    /* if timed out, reset the bus */
+		case I2C_RECOVERY_CLOCK_LOW:
 		{
-			TWCR = (1 << TWINT) | (1 << TWSTO);
-			g_i2c_not_timed_out = TRUE;
-			return( TRUE);
+			/* Note: I2C bus is open collector so do NOT drive SCL or SDA high. */
+			PORTC &= ~SCL;  /* disable pull-up on SCL */
+			DDRC |= SCL;    /* drive SCL Low by making it an output */
+			g_i2c_recovery_state = I2C_RECOVERY_CLOCK_HIGH;
 		}
+		break;
 
-		return( FALSE);
-#else
-		TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN);
-		while(!(TWCR & _BV(TWINT)))
+		case I2C_RECOVERY_CLOCK_HIGH:
 		{
-			;
+			DDRC &= ~SCL;   /* release SCL by making it an input */
+			PORTC |= SCL;   /* pull SCL high again */
+			g_i2c_recovery_ticks = I2C_RECOVERY_SCL_WAIT_TICKS;
+			g_i2c_recovery_state = I2C_RECOVERY_WAIT_SCL;
 		}
-#endif
-}
+		break;
 
-void i2c_stop(void)
-{
-	TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
+		case I2C_RECOVERY_STOP_LOW:
+		{
+			PORTC &= ~SDA;  /* remove SDA pull-up */
+			DDRC |= SDA;    /* drive SDA low */
+			g_i2c_recovery_state = I2C_RECOVERY_STOP_HIGH;
+		}
+		break;
+
+		default:    /* I2C_RECOVERY_STOP_HIGH */
+		{
+			DDRC &= ~SDA;   /* make SDA input */
+			PORTC |= SDA;   /* pull SDA high */
+			TWCR = _BV(TWEN);
+			g_i2c_recovery_state = I2C_RECOVERY_IDLE;
+
+			if(g_i2c_queue_count)
+			{
+				i2c_start_next();
+			}
+		}
+		break;
+	}
 }
 
-BOOL i2c_write_success(uint8_t data, uint8_t success)
+/**
+ * Advances the transaction at the head of the queue by one bus event.
+ */
+void i2c_twi_interrupt(void)
 {
-#ifdef I2C_TIMEOUT_SUPPORT
-		TWDR = data;
-		TWCR = _BV(TWINT) | _BV(TWEN);
-		while(!(TWCR & _BV(TWINT)) && g_i2c_not_timed_out)
+	I2CTransaction *t = g_i2c_queue[g_i2c_queue_head];
+
+	if(!g_i2c_queue_count)
+	{
+		TWCR = _BV(TWEN);   /* spurious: clear TWIE */
+		return;
+	}
+
+	switch(TW_STATUS)
+	{
+		case TW_START:
 		{
-			;
+			g_i2c_index = 0;
+			TWDR = (t->noRegister && t->readBytes) ? (t->slaveAddr | TW_READ) : t->slaveAddr;
+			TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
 		}
+		break;
 
-		uint8_t stat = TW_STATUS;
+		case TW_REP_START:
+		{
+			g_i2c_index = 0;
+			TWDR = t->slaveAddr | TW_READ;
+			TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+		}
+		break;
 
-		/* ignore timeout condition to ensure i2c_stop() gets sent */
-		if(stat != success)
+		case TW_MT_SLA_ACK:
 		{
-			TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-			g_i2c_not_timed_out = TRUE;
-			return(TRUE);
+			if(!t->noRegister)
+			{
+				TWDR = t->regAddr;
+				TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+				break;
+			}
 		}
+		/* Intentional fall-through: no register address to send */
 
-		return( FALSE);
-#else
-		TWDR = data;
-		TWCR = _BV(TWINT) | _BV(TWEN);
-		while(!(TWCR & _BV(TWINT)))
+		case TW_MT_DATA_ACK:
 		{
-			;
+			if(g_i2c_index < t->writeBytes)
+			{
+				TWDR = t->writeData[g_i2c_index++];
+				TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+			}
+			else if(t->readBytes)
+			{
+				TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);    /* repeated start */
+			}
+			else
+			{
+				i2c_complete(I2C_STATUS_OK);
+			}
 		}
+		break;
 
-		/* ignore timeout condition to ensure i2c_stop() gets sent */
-		if(TW_STATUS != success)
+		case TW_MR_DATA_ACK:
 		{
-			TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-			g_i2c_not_timed_out = TRUE;
-			return(TRUE);
+			t->readData[g_i2c_index++] = TWDR;
 		}
+		/* Intentional fall-through */
 
-		return(FALSE);
-#endif
-}
+		case TW_MR_SLA_ACK:
+		{
+			if(g_i2c_index < (t->readBytes - 1))
+			{
+				TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA) | _BV(TWIE);     /* ACK all but the last byte */
+			}
+			else
+			{
+				TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+			}
+		}
+		break;
 
-uint8_t i2c_read_ack(void)
-{
-#ifdef I2C_TIMEOUT_SUPPORT
-		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
-		while(!(TWCR & _BV(TWINT)) && g_i2c_not_timed_out)
+		case TW_MR_DATA_NACK:
 		{
-			;
+			t->readData[g_i2c_index] = TWDR;
+			i2c_complete(I2C_STATUS_OK);
 		}
-		
-		return(TWDR);
-#else
-		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
-		while(!(TWCR & _BV(TWINT)))
+		break;
+
+		case TW_MT_SLA_NACK:
+		case TW_MT_DATA_NACK:
+		case TW_MR_SLA_NACK:
 		{
-			;
+			i2c_complete(I2C_STATUS_NACK);
 		}
-		
-		return( TWDR);
-#endif
+		break;
+
+		default:    /* bus error or arbitration lost */
+		{
+			i2c_recovery_start();
+			i2c_complete(I2C_STATUS_BUS_ERROR);
+		}
+		break;
+	}
 }
 
-uint8_t i2c_read_nack(void)
+/**
+ * Sends STOP if the bus is held, reports status for the transaction at the head of the queue,
+ * and starts the next one. Call with interrupts disabled.
+ */
+static void i2c_complete(I2CStatus status)
 {
-#ifdef I2C_TIMEOUT_SUPPORT
-		TWCR = _BV(TWINT) | _BV(TWEN);
-		while(!(TWCR & _BV(TWINT)) && g_i2c_not_timed_out)
+	I2CTransaction *t = g_i2c_queue[g_i2c_queue_head];
+	I2CDevice *d = i2c_find_device(t->slaveAddr);
+
+	if(d)
+	{
+		if(status == I2C_STATUS_NACK)
 		{
-			;
+			d->nacks++;
 		}
-		
-		return( TWDR);
-#else
-		TWCR = _BV(TWINT) | _BV(TWEN);
-		while(!(TWCR & _BV(TWINT)))
+		else if(status == I2C_STATUS_TIMEOUT)
 		{
-			;
+			d->timeouts++;
 		}
-		
-		return( TWDR);
-#endif
-}
+	}
 
-BOOL i2c_status(uint8_t status)
-{
-	if(TW_STATUS != status)
+	if((status == I2C_STATUS_OK) || (status == I2C_STATUS_NACK))   /* otherwise the TWI has already been reset */
 	{
 		TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-		return(TRUE);
+
+		while(TWCR & _BV(TWSTO))    /* STOP takes one bit time */
+		{
+			;
+		}
 	}
 
-	return(FALSE);
-}
+	g_i2c_queue_head = (g_i2c_queue_head + 1) & (I2C_QUEUE_SIZE - 1);
+	g_i2c_queue_count--;
 
+	t->status = status;
 
-#ifdef SELECTIVELY_DISABLE_OPTIMIZATION
-	BOOL __attribute__((optimize("O0"))) i2c_device_write(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2write)
-#else
-	BOOL i2c_device_write(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2write)
-#endif
+	if(t->callback)
+	{
+		t->callback(t);
+	}
+
+	if(g_i2c_queue_count && (g_i2c_recovery_state == I2C_RECOVERY_IDLE))
+	{
+		i2c_start_next();
+	}
+}
+
+/**
+ * Issues START for the transaction at the head of the queue. Call with interrupts disabled.
+ */
+static void i2c_start_next(void)
 {
-		#ifndef DEBUG_WITHOUT_I2C
-		uint8_t index = 0;
+	I2CTransaction *t = g_i2c_queue[g_i2c_queue_head];
+
+	t->status = I2C_STATUS_BUSY;
+	TWBR = i2c_bit_rate(t->slaveAddr); /* the bus is idle, so the rate may change */
+	g_i2c_ticks_left = I2C_TIMEOUT_TICKS;
+	TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+}
 
-		i2c_start();
-		if(i2c_status(TW_START))
+/**
+ * Waits for a submitted transaction to finish. With interrupts disabled (e.g., when called
+ * from an ISR) the bus is serviced by polling, and the timeout counts polling passes instead
+ * of timer ticks.
+ */
+static BOOL i2c_wait(I2CTransaction *t)
+{
+	if(SREG & _BV(SREG_I))
+	{
+		while((t->status == I2C_STATUS_PENDING) || (t->status == I2C_STATUS_BUSY))
 		{
-			return(TRUE);
+			;
 		}
+	}
+	else
+	{
+		uint16_t polls = I2C_POLL_LIMIT;
 
-		if(i2c_write_success(slaveAddr, TW_MT_SLA_ACK))
+		while((t->status == I2C_STATUS_PENDING) || (t->status == I2C_STATUS_BUSY))
 		{
-			return(TRUE);
+			if(TWCR & _BV(TWINT))
+			{
+				i2c_twi_interrupt();
+				polls = I2C_POLL_LIMIT;
+			}
+			else if(!--polls)
+			{
+				i2c_reset();
+			}
 		}
+	}
+
+	return( t->status != I2C_STATUS_OK);
+}
+
+BOOL i2c_transact(I2CTransaction *t)
+{
+#ifdef DEBUG_WITHOUT_I2C
+	return( FALSE);
+#else
+	if(!(SREG & _BV(SREG_I)) && (g_i2c_recovery_state != I2C_RECOVERY_IDLE))
+	{
+		return( TRUE);  /* recovery needs TIMER2 ticks, which cannot occur here */
+	}
 
-		if(i2c_write_success(addr, TW_MT_DATA_ACK))
+	while(i2c_submit(t))    /* queue full */
+	{
+		if(!(SREG & _BV(SREG_I)) && (TWCR & _BV(TWINT)))
 		{
-			return(TRUE);
+			i2c_twi_interrupt();
 		}
+	}
+
+	return( i2c_wait(t));
+#endif  /* DEBUG_WITHOUT_I2C */
+}
+
+static I2CDevice* i2c_find_device(uint8_t slaveAddr)
+{
+	uint8_t i;
 
-		while(bytes2write--)
+	for(i = 0; i < I2C_NUMBER_OF_DEVICES; i++)
+	{
+		if(g_i2c_devices[i].slaveAddr == slaveAddr)
 		{
-			if(i2c_write_success(data[index++], TW_MT_DATA_ACK))
-			{
-				return(TRUE);
-			}
+			return( &g_i2c_devices[i]);
 		}
+	}
 
-		i2c_stop();
+	return( NULL);
+}
 
-		#endif  /* #ifndef DEBUG_WITHOUT_I2C */
+static uint8_t i2c_bit_rate(uint8_t slaveAddr)
+{
+	I2CDevice *d = i2c_find_device(slaveAddr);
 
-	return(FALSE);
+	return( (d && (d->speed == I2C_SPEED_FAST)) ? I2C_TWBR_FAST : I2C_TWBR_STANDARD);
 }
 
-#ifdef SELECTIVELY_DISABLE_OPTIMIZATION
-	BOOL __attribute__((optimize("O0"))) i2c_device_read(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2read)
-#else
-	BOOL i2c_device_read(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2read)
-#endif
+void i2c_probe(void)
 {
-		#ifndef DEBUG_WITHOUT_I2C
-		uint8_t index = 0;
+	uint8_t i;
 
-		i2c_start();
-		if(i2c_status(TW_START))
-		{
-			return(TRUE);
-		}
+	for(i = 0; i < I2C_NUMBER_OF_DEVICES; i++)
+	{
+		I2CDevice *d = &g_i2c_devices[i];
+		I2CTransaction t = { d->slaveAddr, 0, TRUE, NULL, 0, NULL, 0, NULL, I2C_STATUS_OK };   /* address only */
 
-		if(i2c_write_success(slaveAddr, TW_MT_SLA_ACK))
+		for(d->speed = d->maxSpeed; d->speed > I2C_SPEED_ABSENT; d->speed--)
 		{
-			return(TRUE);
+			if(!i2c_transact(&t))
+			{
+				break;
+			}
 		}
+	}
+}
 
-		if(i2c_write_success(addr, TW_MT_DATA_ACK))
-		{
-			return(TRUE);
-		}
+BOOL i2c_get_device(uint8_t index, I2CDevice *device)
+{
+	if(index >= I2C_NUMBER_OF_DEVICES)
+	{
+		return( TRUE);
+	}
 
-		i2c_start();
-		if(i2c_status(TW_REP_START))
-		{
-			return(TRUE);
-		}
-		
-		if(i2c_write_success((slaveAddr | TW_READ), TW_MR_SLA_ACK))
+	if(device)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 		{
-			return(TRUE);
+			*device = g_i2c_devices[index];
 		}
+	}
 
-		while(bytes2read--)
-		{
-			if(bytes2read)
-			{
-				data[index++] = i2c_read_ack();
-				if(i2c_status(TW_MR_DATA_ACK))
-				{
-					return(TRUE);
-				}
-			}
-			else
-			{
-				data[index] = i2c_read_nack();
-				if(i2c_status(TW_MR_DATA_NACK))
-				{
-					return(TRUE);
-				}
-			}
-		}
+	return( FALSE);
+}
 
-		i2c_stop();
+BOOL i2c_device_write(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2write)
+{
+	I2CTransaction t = { slaveAddr, addr, FALSE, data, bytes2write, NULL, 0, NULL, I2C_STATUS_OK };
+
+	return( i2c_transact(&t));
+}
 
-		#endif  /* #ifndef DEBUG_WITHOUT_I2C */
+BOOL i2c_device_read(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2read)
+{
+	I2CTransaction t = { slaveAddr, addr, FALSE, NULL, 0, data, bytes2read, NULL, I2C_STATUS_OK };
 
-	return(FALSE);
+	return( i2c_transact(&t));
 }
@@ -27,8 +27,6 @@
 #include "i2c.h"
 #include <util/twi.h>
 
-#define MAX5478_I2C_SLAVE_ADDR_A0_0 0x50
-
 #define MAX_5478_WIPER_A_VREG_COMMAND 0x11
 #define MAX_5478_WIPER_A_NVREG_COMMAND 0x21
 #define MAX_5478_WIPER_A_NVREG_TO_VREG_COMMAND 0x61
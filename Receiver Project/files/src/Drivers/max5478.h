@@ -37,6 +37,8 @@
 
 #include "defs.h"
 
+#define MAX5478_I2C_SLAVE_ADDR_A0_0 0x50
+
 /**
    Set the potentiometer to the value passed in setting.
 */
@@ -38,6 +38,9 @@
 #ifndef PCF8574_H_
 #define PCF8574_H_
 
+#define PCF8574_SLAVE_ADDR_A000_0 0x70
+#define PCF8574_SLAVE_ADDR_A000_1 0x71
+
 /**
  */
 void pcf8574_writePort(uint8_t data);
@@ -136,6 +136,7 @@ typedef enum {
 
 #define PA_VOLTAGE_MAX_MV 14100L
 #define VPA(x)((x * PA_VOLTAGE_MAX_MV) / 1023L)
+#define VPA_FROM_PIN_MV(x)((x * PA_VOLTAGE_MAX_MV) / ADC_REF_VOLTAGE_mV)
 
 #define VEXT(x) (10000L + ((14L * x + 310) / 100))
 
@@ -277,6 +278,7 @@ typedef enum
 #define TIMER2_20HZ (588/OCR2A_OVF_BASE_FREQ)
 #define TIMER2_5_8HZ (1200/OCR2A_OVF_BASE_FREQ)
 #define TIMER2_0_5HZ (12000/OCR2A_OVF_BASE_FREQ)
+#define TIMER2_TICKS_PER_SECOND (F_CPU / 1024UL / (OCR2A_OVF_BASE_FREQ + 1))
 
 #define BEEP_SHORT 100
 #define BEEP_LONG 65535
@@ -0,0 +1,168 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * energy.c
+ *
+ */
+
+#include "energy.h"
+#include "journal.h"
+#include <string.h>
+
+static EnergyStats g_energy_stats;
+static uint32_t g_seconds_since_save = 0;
+static uint16_t g_slope_ref_mV = 0;     /* battery voltage at the start of the slope interval */
+static uint32_t g_slope_ref_seconds = 0;
+
+/*
+ *       Local Function Prototypes
+ *
+ */
+static uint32_t elapsedSeconds(void);
+static void updateBatterySlope(uint16_t battery_mV);
+
+
+void energy_init(void)
+{
+	if(journal_read(JOURNAL_TAG_ENERGY_STATS, &g_energy_stats, sizeof(EnergyStats)))
+	{
+		energy_reset();
+	}
+
+	g_slope_ref_mV = 0;
+	g_seconds_since_save = 0;
+}
+
+void energy_add_awake_second(BOOL wifiOn, BOOL onAir, uint16_t keyedTicks, uint16_t battery_mV)
+{
+	g_energy_stats.awake_seconds++;
+	g_energy_stats.keyed_ticks += keyedTicks;
+
+	if(wifiOn)
+	{
+		g_energy_stats.wifi_seconds++;
+	}
+
+	if(onAir)
+	{
+		g_energy_stats.on_air_seconds++;
+	}
+	else if(battery_mV)     /* battery readings are depressed while the final is powered */
+	{
+		updateBatterySlope(battery_mV);
+	}
+
+	if(++g_seconds_since_save >= ENERGY_SAVE_INTERVAL_SECONDS)
+	{
+		energy_save();
+	}
+}
+
+void energy_add_sleep_seconds(uint32_t seconds)
+{
+	g_energy_stats.sleep_seconds += seconds;
+	g_seconds_since_save += seconds;
+}
+
+void energy_save(void)
+{
+	journal_write(JOURNAL_TAG_ENERGY_STATS, &g_energy_stats, sizeof(EnergyStats));
+	g_seconds_since_save = 0;
+}
+
+void energy_reset(void)
+{
+	memset(&g_energy_stats, 0, sizeof(EnergyStats));
+	g_slope_ref_mV = 0;
+	energy_save();
+}
+
+void energy_get_stats(EnergyStats* stats)
+{
+	if(stats)
+	{
+		*stats = g_energy_stats;
+	}
+}
+
+uint16_t energy_runtime_minutes(uint16_t battery_mV, uint16_t empty_mV)
+{
+	uint32_t minutes;
+
+	if(g_energy_stats.battery_slope <= 0)
+	{
+		return( ENERGY_RUNTIME_UNKNOWN);
+	}
+
+	if(battery_mV <= empty_mV)
+	{
+		return( 0);
+	}
+
+	minutes = ((uint32_t)(battery_mV - empty_mV) * 60UL) / (uint32_t)g_energy_stats.battery_slope;
+
+	return( (uint16_t)MIN(minutes, (uint32_t)(ENERGY_RUNTIME_UNKNOWN - 1)));
+}
+
+/**
+ * Wall-clock seconds accounted for, awake and asleep.
+ */
+static uint32_t elapsedSeconds(void)
+{
+	return( g_energy_stats.awake_seconds + g_energy_stats.sleep_seconds);
+}
+
+/**
+ * The slope is measured between readings taken at least ENERGY_SLOPE_INTERVAL_SECONDS apart,
+ * then smoothed over successive intervals.
+ */
+static void updateBatterySlope(uint16_t battery_mV)
+{
+	uint32_t elapsed;
+	int32_t slope;
+
+	if(!g_slope_ref_mV)
+	{
+		g_slope_ref_mV = battery_mV;
+		g_slope_ref_seconds = elapsedSeconds();
+		return;
+	}
+
+	elapsed = elapsedSeconds() - g_slope_ref_seconds;
+
+	if(elapsed < ENERGY_SLOPE_INTERVAL_SECONDS)
+	{
+		return;
+	}
+
+	slope = (((int32_t)g_slope_ref_mV - (int32_t)battery_mV) * 3600L) / (int32_t)elapsed;
+	slope = CLAMP(-MAX_INT16, slope, MAX_INT16);
+
+	if(g_energy_stats.battery_slope)
+	{
+		slope = (3L * g_energy_stats.battery_slope + slope) / 4L;
+	}
+
+	g_energy_stats.battery_slope = (int16_t)slope;
+	g_slope_ref_mV = battery_mV;
+	g_slope_ref_seconds = elapsedSeconds();
+}
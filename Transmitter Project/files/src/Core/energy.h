@@ -0,0 +1,84 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * energy.h
+ *
+ * Accumulates the time spent in each power state, and the battery discharge rate,
+ * so that remaining runtime can be estimated.
+ *
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include "defs.h"
+
+#define ENERGY_SAVE_INTERVAL_SECONDS 3600   /* journal statistics no more often than this */
+#define ENERGY_SLOPE_INTERVAL_SECONDS 1800  /* battery slope is measured over intervals at least this long */
+#define ENERGY_RUNTIME_UNKNOWN 0xFFFF
+
+typedef struct
+{
+	uint32_t sleep_seconds;     /* power-down sleep */
+	uint32_t awake_seconds;     /* processor running */
+	uint32_t wifi_seconds;      /* WiFi module powered */
+	uint32_t on_air_seconds;    /* within on-the-air intervals (final powered) */
+	uint32_t keyed_ticks;       /* TIMER2 ticks with the carrier keyed */
+	int16_t battery_slope;      /* mV per hour; positive while discharging; 0 = not yet measured */
+} EnergyStats;
+
+/**
+ * Loads accumulated statistics from the journal.
+ */
+void energy_init(void);
+
+/**
+ * Accounts for one second spent awake. battery_mV is ignored while on the air, and if zero.
+ */
+void energy_add_awake_second(BOOL wifiOn, BOOL onAir, uint16_t keyedTicks, uint16_t battery_mV);
+
+/**
+ * Accounts for time spent in power-down sleep.
+ */
+void energy_add_sleep_seconds(uint32_t seconds);
+
+/**
+ * Journals statistics if they have changed since last saved.
+ */
+void energy_save(void);
+
+/**
+ * Clears all statistics, including those saved in the journal.
+ */
+void energy_reset(void);
+
+/**
+ */
+void energy_get_stats(EnergyStats* stats);
+
+/**
+ * Estimates minutes until battery_mV falls to empty_mV at the measured discharge rate.
+ * Returns ENERGY_RUNTIME_UNKNOWN if no discharge rate has been measured.
+ */
+uint16_t energy_runtime_minutes(uint16_t battery_mV, uint16_t empty_mV);
+
+#endif  /* ENERGY_H_ */
@@ -0,0 +1,176 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * fm.c
+ *
+ */
+
+#include "fm.h"
+#include "i2c.h"
+#include <string.h>
+#include <util/atomic.h>
+
+/* sin(2 * pi * i / FM_TABLE_POINTS) scaled to +/-127 */
+static const int8_t g_fm_sine[FM_TABLE_POINTS] = { 0, 90, 127, 90, 0, -90, -127, -90 };
+
+static uint8_t g_fm_table[FM_TABLE_POINTS][SI5351_PARAMETERS_LENGTH];
+static Si5351_clock g_fm_clock = SI5351_CLK0;
+static volatile BOOL g_fm_table_valid = FALSE;
+static volatile BOOL g_fm_running = FALSE;
+static volatile uint16_t g_fm_phase = 0;
+static volatile uint16_t g_fm_phase_step = (uint16_t)(((uint32_t)FM_DEFAULT_TONE_HZ << 16) / FM_SAMPLE_RATE_HZ);
+
+/* Samples are queued from the TIMER0 interrupt without waiting for the bus. Only the parameter
+ * bytes that differ between table entries are sent, and a sample is skipped while the one
+ * before it is still in flight. */
+static I2CTransaction g_fm_write;
+static uint8_t g_fm_write_data[SI5351_PARAMETERS_LENGTH];
+static uint8_t g_fm_first_byte = 0;
+static uint8_t g_fm_bytes = 0;      /* zero if the table entries are all the same */
+
+BOOL fm_prepare(Frequency_Hz carrier, Si5351_clock clk, uint16_t deviation_Hz)
+{
+	uint8_t table[FM_TABLE_POINTS][SI5351_PARAMETERS_LENGTH];
+	BOOL err = FALSE;
+	uint8_t i, j;
+	uint8_t first = SI5351_PARAMETERS_LENGTH, last = 0;
+
+	for(i = 0; i < FM_TABLE_POINTS; i++)
+	{
+		int32_t offset = ((int32_t)deviation_Hz * g_fm_sine[i]) / 127;
+
+		if(si5351_fine_tune_params(carrier + offset, clk, table[i]))
+		{
+			err = TRUE;
+			break;
+		}
+
+		for(j = 0; j < SI5351_PARAMETERS_LENGTH; j++)
+		{
+			if(table[i][j] != table[0][j])
+			{
+				first = MIN(first, j);
+				last = MAX(last, j);
+			}
+		}
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(!err)
+		{
+			memcpy(g_fm_table, table, sizeof(g_fm_table));
+			g_fm_clock = clk;
+			g_fm_first_byte = first;
+			g_fm_bytes = (first < SI5351_PARAMETERS_LENGTH) ? last - first + 1 : 0;
+		}
+
+		g_fm_table_valid = !err;
+	}
+
+	return( err);
+}
+
+void fm_set_tone(uint16_t tone_Hz)
+{
+	uint16_t step = (uint16_t)MIN(((uint32_t)tone_Hz << 16) / FM_SAMPLE_RATE_HZ, 0x8000); /* at least two samples per cycle */
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		g_fm_phase_step = step;
+	}
+}
+
+void fm_start(void)
+{
+	if(!g_fm_table_valid || g_fm_running)
+	{
+		return;
+	}
+
+	/* The samples send only the bytes that vary, so the rest of the table's parameters,
+	 * which differ from those si5351_set_freq() chose for the carrier, must be loaded first. */
+	si5351_forget_pll_params(g_fm_clock);
+	si5351_load_pll_params(g_fm_clock, g_fm_table[0]);
+
+	g_fm_write.slaveAddr = SI5351_I2C_SLAVE_ADDR;
+	g_fm_write.noRegister = FALSE;
+	g_fm_write.writeData = g_fm_write_data;
+	g_fm_write.readBytes = 0;
+	g_fm_write.callback = NULL;
+
+	g_fm_phase = 0;
+	TCNT0 = 0;
+	OCR0A = FM_TIMER0_OCR0A;
+	TCCR0A = (1 << WGM01);          /* CTC with OCR0A */
+	TCCR0B = FM_TIMER0_PRESCALE;
+	TIMSK0 |= (1 << OCIE0A);
+	g_fm_running = TRUE;
+}
+
+void fm_stop(void)
+{
+	if(!g_fm_running)
+	{
+		return;
+	}
+
+	TIMSK0 &= ~(1 << OCIE0A);
+	TCCR0B = 0;                     /* stop the timer */
+	g_fm_running = FALSE;
+
+	/* The samples bypassed the driver's register shadow. The carrier is queued behind any
+	 * sample still in flight, so it is the last write. */
+	si5351_forget_pll_params(g_fm_clock);
+
+	if(g_fm_table_valid)
+	{
+		si5351_load_pll_params(g_fm_clock, g_fm_table[0]);  /* first entry is the carrier */
+	}
+}
+
+void fm_sample(void)
+{
+	uint8_t* entry;
+
+	if(!g_fm_table_valid)
+	{
+		return;
+	}
+
+	g_fm_phase += g_fm_phase_step;  /* advanced even when a sample is skipped, so the tone keeps its pitch */
+
+	if(!g_fm_bytes || (g_fm_write.status == I2C_STATUS_PENDING) || (g_fm_write.status == I2C_STATUS_BUSY))
+	{
+		return;
+	}
+
+	entry = g_fm_table[g_fm_phase >> (16 - FM_TABLE_BITS)];
+	memcpy(g_fm_write_data, &entry[g_fm_first_byte], g_fm_bytes);
+	g_fm_write.regAddr = SI5351_PLLA_PARAMETERS + g_fm_first_byte;
+	g_fm_write.writeBytes = g_fm_bytes;
+
+	if(i2c_submit(&g_fm_write))
+	{
+		g_fm_write.status = I2C_STATUS_TIMEOUT; /* the queue is full: the sample is dropped */
+	}
+}
@@ -0,0 +1,73 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * fm.h
+ *
+ * Frequency modulates the 2m carrier with a tone by stepping the PLLA feedback numerator
+ * through a table of precalculated register images. TIMER0 sets the sample rate; the
+ * tone is synthesized from the table with a phase accumulator.
+ *
+ */
+
+#ifndef FM_H_
+#define FM_H_
+
+#include "defs.h"
+#include "si5351.h"
+
+#define FM_TABLE_BITS 3
+#define FM_TABLE_POINTS (1 << FM_TABLE_BITS)    /* one cycle of the tone */
+#define FM_SAMPLE_RATE_HZ 1200          /* each sample writes the few PLL parameter bytes that vary over the table */
+#define FM_DEFAULT_DEVIATION_HZ 3000
+#define FM_DEFAULT_TONE_HZ 300
+#define FM_TIMER0_PRESCALE ((1 << CS01) | (1 << CS00))  /* F_CPU/64 */
+#define FM_TIMER0_OCR0A ((F_CPU / 64UL / FM_SAMPLE_RATE_HZ) - 1)
+
+/**
+ * Calculates the deviation table for a carrier on clk. Call after the carrier has been set with
+ * si5351_set_freq(). Returns TRUE if the carrier cannot be modulated, in which case fm_start()
+ * will do nothing.
+ */
+BOOL fm_prepare(Frequency_Hz carrier, Si5351_clock clk, uint16_t deviation_Hz);
+
+/**
+ * Sets the modulating tone frequency.
+ */
+void fm_set_tone(uint16_t tone_Hz);
+
+/**
+ * Starts modulating the carrier with the tone.
+ */
+void fm_start(void);
+
+/**
+ * Stops modulation and returns the clock to the unmodulated carrier.
+ */
+void fm_stop(void);
+
+/**
+ * Queues the next sample for the I2C interrupt without waiting for the bus. The sample is skipped
+ * if the previous one is still in flight. Call from the TIMER0 compare ISR.
+ */
+void fm_sample(void);
+
+#endif  /* FM_H_ */
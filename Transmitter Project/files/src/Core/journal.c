@@ -0,0 +1,364 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * journal.c
+ *
+ */
+
+#include "journal.h"
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+#include <stddef.h>
+#include <string.h>
+
+#define JOURNAL_MAGIC 0x4A
+#define JOURNAL_ERASED 0xFF
+#define JOURNAL_FIRST_RECORD sizeof(JournalHeader)
+
+/* The journal occupies the top of EEPROM, at addresses that do not depend on how the
+ * linker places EEMEM variables */
+#define JOURNAL_ADDRESS(sector, offset) ((uint8_t*)(uintptr_t)(E2END + 1 - 2 * JOURNAL_SECTOR_SIZE) + (sector) * JOURNAL_SECTOR_SIZE + (offset))
+
+typedef struct
+{
+	uint16_t generation;    /* incremented by each compaction */
+	uint8_t version;        /* JOURNAL_SCHEMA_VERSION of the firmware that wrote the sector */
+	uint16_t layoutHash;    /* of the record lengths the sector was written with */
+	uint16_t length;        /* JOURNAL_SECTOR_SIZE */
+	uint8_t crc;            /* of the preceding members */
+	uint8_t magic;          /* written last */
+} JournalHeader;
+
+static const uint8_t g_journal_record_lengths[JOURNAL_NUMBER_OF_TAGS] PROGMEM = JOURNAL_RECORD_LENGTHS;
+
+static uint8_t g_journal_sector = 0;
+static uint16_t g_journal_generation = 0;
+static uint16_t g_journal_layout_hash = 0;
+static uint16_t g_journal_head = JOURNAL_FIRST_RECORD;      /* offset at which the next record will be appended */
+static uint8_t g_journal_sequence = 0;                      /* sequence number of the next record */
+static uint16_t g_journal_index[JOURNAL_NUMBER_OF_TAGS];    /* offset of the latest record for each tag; zero if none */
+static volatile BOOL g_journal_busy = FALSE;                /* a write is in progress; an ISR must not start another */
+
+/*
+ *       Local Function Prototypes
+ *
+ */
+static BOOL appendRecord(JournalTag tag, const uint8_t* bytes, uint8_t size);
+static uint8_t crc8(uint8_t crc, const uint8_t* data, uint8_t length);
+static BOOL readHeader(uint8_t sector, JournalHeader* header);
+static BOOL readRecord(uint8_t sector, uint16_t offset, uint8_t* tag, uint8_t* sequence, uint8_t* data, uint8_t* length);
+static void writeRecord(uint8_t sector, uint16_t offset, uint8_t tag, const uint8_t* data, uint8_t length);
+static void compact(BOOL keepRecords);
+
+
+uint8_t journal_init(void)
+{
+	JournalHeader header[2];
+	BOOL invalid[2];
+	uint8_t data[JOURNAL_MAX_DATA_LENGTH];
+	uint8_t tag, sequence, length, version;
+	uint16_t offset = JOURNAL_FIRST_RECORD;
+
+	memset(g_journal_index, 0, sizeof(g_journal_index));
+	g_journal_busy = FALSE;
+	g_journal_sequence = 0;
+
+	g_journal_layout_hash = 0;
+	for(tag = 0; tag < JOURNAL_NUMBER_OF_TAGS; tag++)
+	{
+		g_journal_layout_hash = _crc16_update(g_journal_layout_hash, pgm_read_byte(&g_journal_record_lengths[tag]));
+	}
+
+	invalid[0] = readHeader(0, &header[0]);
+	invalid[1] = readHeader(1, &header[1]);
+
+	if(invalid[0] && invalid[1])
+	{
+		g_journal_sector = 1;
+		g_journal_generation = MAX_UINT16;
+		compact(FALSE); /* start afresh with an empty sector 0 */
+		return( JOURNAL_SCHEMA_LEGACY);
+	}
+
+	if(invalid[0] || (!invalid[1] && ((int16_t)(header[1].generation - header[0].generation) > 0)))
+	{
+		g_journal_sector = 1;
+	}
+	else
+	{
+		g_journal_sector = 0;
+	}
+
+	g_journal_generation = header[g_journal_sector].generation;
+
+	/* Replay the sector. Every record must follow its predecessor's sequence number, so that
+	 * nothing after a damaged record is trusted. */
+	while(!readRecord(g_journal_sector, offset, &tag, &sequence, data, &length))
+	{
+		if((offset > JOURNAL_FIRST_RECORD) && (sequence != g_journal_sequence))
+		{
+			break;
+		}
+
+		/* Tags unknown to this firmware, and records that no longer fit the layout, are ignored */
+		if((tag < JOURNAL_NUMBER_OF_TAGS) && (length <= pgm_read_byte(&g_journal_record_lengths[tag])))
+		{
+			g_journal_index[tag] = offset;
+		}
+
+		g_journal_sequence = sequence + 1;
+		offset += length + JOURNAL_RECORD_OVERHEAD;
+	}
+
+	g_journal_head = offset;
+	version = header[g_journal_sector].version;
+
+	/* Rewrite a sector from other firmware so that records this firmware ignores are discarded,
+	 * and the header describes the layout in use */
+	if((version != JOURNAL_SCHEMA_VERSION) || (header[g_journal_sector].layoutHash != g_journal_layout_hash))
+	{
+		compact(TRUE);
+	}
+
+	return( version);
+}
+
+uint8_t journal_length(JournalTag tag)
+{
+	if((tag >= JOURNAL_NUMBER_OF_TAGS) || !g_journal_index[tag])
+	{
+		return( 0);
+	}
+
+	return( eeprom_read_byte(JOURNAL_ADDRESS(g_journal_sector, g_journal_index[tag] + 2)));
+}
+
+BOOL journal_read(JournalTag tag, void* data, uint8_t size)
+{
+	if(!data || !size || (journal_length(tag) != size))
+	{
+		return( TRUE);
+	}
+
+	eeprom_read_block(data, JOURNAL_ADDRESS(g_journal_sector, g_journal_index[tag] + 3), size);
+
+	return( FALSE);
+}
+
+BOOL journal_write(JournalTag tag, const void* data, uint8_t size)
+{
+	BOOL failure;
+
+	if(!data || (tag >= JOURNAL_NUMBER_OF_TAGS) || (size > pgm_read_byte(&g_journal_record_lengths[tag])) || g_journal_busy)
+	{
+		return( TRUE);
+	}
+
+	g_journal_busy = TRUE;
+	failure = appendRecord(tag, (const uint8_t*)data, size);
+	g_journal_busy = FALSE;
+
+	return( failure);
+}
+
+/**
+ * Appends a record unless the latest record for tag already holds bytes.
+ */
+static BOOL appendRecord(JournalTag tag, const uint8_t* bytes, uint8_t size)
+{
+	uint8_t* stored;
+	uint8_t i;
+
+	if(journal_length(tag) == size)
+	{
+		stored = JOURNAL_ADDRESS(g_journal_sector, g_journal_index[tag] + 3);
+
+		for(i = 0; i < size; i++)
+		{
+			if(eeprom_read_byte(stored + i) != bytes[i])
+			{
+				break;
+			}
+		}
+
+		if(i == size)
+		{
+			return( FALSE); /* unchanged */
+		}
+	}
+
+	if((g_journal_head + size + JOURNAL_RECORD_OVERHEAD) > JOURNAL_SECTOR_SIZE)
+	{
+		compact(TRUE);
+
+		if((g_journal_head + size + JOURNAL_RECORD_OVERHEAD) > JOURNAL_SECTOR_SIZE)
+		{
+			return( TRUE);
+		}
+	}
+
+	writeRecord(g_journal_sector, g_journal_head, tag, bytes, size);
+	g_journal_index[tag] = g_journal_head;
+	g_journal_head += size + JOURNAL_RECORD_OVERHEAD;
+
+	return( FALSE);
+}
+
+/**
+ * CCITT CRC-8 of length bytes, continuing from crc.
+ */
+static uint8_t crc8(uint8_t crc, const uint8_t* data, uint8_t length)
+{
+	while(length--)
+	{
+		crc = _crc8_ccitt_update(crc, *data++);
+	}
+
+	return( crc);
+}
+
+/**
+ * Returns TRUE if the header of sector is missing or damaged, or describes a sector of another size.
+ */
+static BOOL readHeader(uint8_t sector, JournalHeader* header)
+{
+	eeprom_read_block(header, JOURNAL_ADDRESS(sector, 0), sizeof(JournalHeader));
+
+	if(header->magic != JOURNAL_MAGIC)
+	{
+		return( TRUE);
+	}
+
+	if(header->crc != crc8(0, (uint8_t*)header, offsetof(JournalHeader, crc)))
+	{
+		return( TRUE);
+	}
+
+	return( header->length != JOURNAL_SECTOR_SIZE);
+}
+
+/**
+ * Reads the record at offset into data. Returns TRUE at the end of the journal, and if the
+ * record is damaged.
+ */
+static BOOL readRecord(uint8_t sector, uint16_t offset, uint8_t* tag, uint8_t* sequence, uint8_t* data, uint8_t* length)
+{
+	uint8_t prefix[3];  /* tag, sequence, length */
+
+	if((offset + JOURNAL_RECORD_OVERHEAD) > JOURNAL_SECTOR_SIZE)
+	{
+		return( TRUE);
+	}
+
+	eeprom_read_block(prefix, JOURNAL_ADDRESS(sector, offset), sizeof(prefix));
+
+	if((prefix[0] == JOURNAL_ERASED) || (prefix[2] > JOURNAL_MAX_DATA_LENGTH) || ((offset + prefix[2] + JOURNAL_RECORD_OVERHEAD) > JOURNAL_SECTOR_SIZE))
+	{
+		return( TRUE);
+	}
+
+	eeprom_read_block(data, JOURNAL_ADDRESS(sector, offset + 3), prefix[2]);
+
+	if(eeprom_read_byte(JOURNAL_ADDRESS(sector, offset + 3 + prefix[2])) != crc8(crc8(0, prefix, sizeof(prefix)), data, prefix[2]))
+	{
+		return( TRUE);
+	}
+
+	*tag = prefix[0];
+	*sequence = prefix[1];
+	*length = prefix[2];
+
+	return( FALSE);
+}
+
+/**
+ * Writes a record with the next sequence number. The byte following the record is erased
+ * to terminate the journal, and the tag is written last to commit the record.
+ */
+static void writeRecord(uint8_t sector, uint16_t offset, uint8_t tag, const uint8_t* data, uint8_t length)
+{
+	uint8_t* record = JOURNAL_ADDRESS(sector, offset);
+	uint8_t prefix[3] = { tag, g_journal_sequence++, length };
+
+	eeprom_update_block(&prefix[1], record + 1, 2);
+	eeprom_update_block(data, record + 3, length);
+	eeprom_update_byte(record + 3 + length, crc8(crc8(0, prefix, sizeof(prefix)), data, length));
+
+	if((offset + length + JOURNAL_RECORD_OVERHEAD) < JOURNAL_SECTOR_SIZE)
+	{
+		eeprom_update_byte(record + length + JOURNAL_RECORD_OVERHEAD, JOURNAL_ERASED);
+	}
+
+	eeprom_update_byte(record, tag);
+}
+
+/**
+ * Copies the latest record for each tag (or none, if keepRecords is FALSE) into the other
+ * sector, then makes it the active sector. The active sector remains valid until the
+ * other sector's header is written.
+ */
+static void compact(BOOL keepRecords)
+{
+	uint8_t dest = g_journal_sector ^ 1;
+	uint16_t offset = JOURNAL_FIRST_RECORD;
+	uint8_t data[JOURNAL_MAX_DATA_LENGTH];
+	uint8_t tag, sequence, length, record;
+	JournalHeader header;
+
+	wdt_reset();    /* HW watchdog */
+	eeprom_update_byte(JOURNAL_ADDRESS(dest, offsetof(JournalHeader, magic)), JOURNAL_ERASED);
+	eeprom_update_byte(JOURNAL_ADDRESS(dest, JOURNAL_FIRST_RECORD), JOURNAL_ERASED);
+
+	for(tag = 0; tag < JOURNAL_NUMBER_OF_TAGS; tag++)
+	{
+		if(!g_journal_index[tag])
+		{
+			continue;
+		}
+
+		if(!keepRecords || readRecord(g_journal_sector, g_journal_index[tag], &record, &sequence, data, &length) || ((offset + length + JOURNAL_RECORD_OVERHEAD) > JOURNAL_SECTOR_SIZE))
+		{
+			g_journal_index[tag] = 0;
+			continue;
+		}
+
+		writeRecord(dest, offset, tag, data, length);
+		g_journal_index[tag] = offset;
+		offset += length + JOURNAL_RECORD_OVERHEAD;
+		wdt_reset();    /* HW watchdog */
+	}
+
+	header.generation = g_journal_generation + 1;
+	header.version = JOURNAL_SCHEMA_VERSION;
+	header.layoutHash = g_journal_layout_hash;
+	header.length = JOURNAL_SECTOR_SIZE;
+	header.crc = crc8(0, (uint8_t*)&header, offsetof(JournalHeader, crc));
+	header.magic = JOURNAL_MAGIC;
+	eeprom_update_block(&header, JOURNAL_ADDRESS(dest, 0), offsetof(JournalHeader, magic));
+	eeprom_update_byte(JOURNAL_ADDRESS(dest, offsetof(JournalHeader, magic)), header.magic);
+
+	g_journal_sector = dest;
+	g_journal_generation = header.generation;
+	g_journal_head = offset;
+}
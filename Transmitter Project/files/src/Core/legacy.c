@@ -0,0 +1,129 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * legacy.c
+ *
+ */
+
+#include "legacy.h"
+#include "journal.h"
+#include "transmitter.h"
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include <string.h>
+
+static void migrateText(JournalTag tag, const char* eeText, uint8_t length)
+{
+	char text[LEGACY2_TEXT_LENGTH];
+
+	eeprom_read_block(text, eeText, length);
+	text[length - 1] = '\0';
+	journal_write(tag, text, strlen(text) + 1);
+}
+
+static void migrateInterface1(void)
+{
+	journal_write_dword(JOURNAL_TAG_EVENT_START_TIME, eeprom_read_dword(LEGACY1_START_TIME));
+	journal_write_dword(JOURNAL_TAG_EVENT_FINISH_TIME, eeprom_read_dword(LEGACY1_FINISH_TIME));
+	journal_write_byte(JOURNAL_TAG_ID_CODESPEED, eeprom_read_byte(LEGACY1_ID_CODESPEED));
+	journal_write_byte(JOURNAL_TAG_PATTERN_CODESPEED, eeprom_read_byte(LEGACY1_PATTERN_CODESPEED));
+	journal_write_word(JOURNAL_TAG_ON_AIR_TIME, eeprom_read_word(LEGACY1_ON_AIR_TIME));
+	journal_write_word(JOURNAL_TAG_OFF_AIR_TIME, eeprom_read_word(LEGACY1_OFF_AIR_TIME));
+	journal_write_word(JOURNAL_TAG_INTRA_CYCLE_DELAY_TIME, eeprom_read_word(LEGACY1_INTRA_CYCLE_DELAY_TIME));
+	journal_write_word(JOURNAL_TAG_ID_TIME, eeprom_read_word(LEGACY1_ID_TIME));
+	migrateText(JOURNAL_TAG_STATION_ID_TEXT, LEGACY1_STATION_ID_TEXT, LEGACY1_TEXT_LENGTH);
+	migrateText(JOURNAL_TAG_PATTERN_TEXT, LEGACY1_PATTERN_TEXT, LEGACY1_TEXT_LENGTH);
+}
+
+static void migrateInterface2(void)
+{
+	journal_write_dword(JOURNAL_TAG_EVENT_START_TIME, eeprom_read_dword(LEGACY2_START_TIME));
+	journal_write_dword(JOURNAL_TAG_EVENT_FINISH_TIME, eeprom_read_dword(LEGACY2_FINISH_TIME));
+	journal_write_byte(JOURNAL_TAG_ID_CODESPEED, eeprom_read_byte(LEGACY2_ID_CODESPEED));
+	journal_write_byte(JOURNAL_TAG_PATTERN_CODESPEED, eeprom_read_byte(LEGACY2_PATTERN_CODESPEED));
+	journal_write_word(JOURNAL_TAG_ON_AIR_TIME, eeprom_read_word(LEGACY2_ON_AIR_TIME));
+	journal_write_word(JOURNAL_TAG_OFF_AIR_TIME, eeprom_read_word(LEGACY2_OFF_AIR_TIME));
+	journal_write_word(JOURNAL_TAG_INTRA_CYCLE_DELAY_TIME, eeprom_read_word(LEGACY2_INTRA_CYCLE_DELAY_TIME));
+	journal_write_word(JOURNAL_TAG_ID_TIME, eeprom_read_word(LEGACY2_ID_TIME));
+	journal_write_word(JOURNAL_TAG_BATTERY_EMPTY_MV, eeprom_read_word(LEGACY2_BATTERY_EMPTY_MV));
+	journal_write_byte(JOURNAL_TAG_CLOCK_OSCCAL, eeprom_read_byte(LEGACY2_CLOCK_OSCCAL));
+	migrateText(JOURNAL_TAG_STATION_ID_TEXT, LEGACY2_STATION_ID_TEXT, LEGACY2_TEXT_LENGTH);
+	migrateText(JOURNAL_TAG_PATTERN_TEXT, LEGACY2_PATTERN_TEXT, LEGACY2_TEXT_LENGTH);
+}
+
+static void migrateTransmitter1(void)
+{
+	journal_write_dword(JOURNAL_TAG_SI5351_REF_CORRECTION, eeprom_read_dword(LEGACY1_SI5351_REF_CORRECTION));
+	journal_write_byte(JOURNAL_TAG_ACTIVE_BAND, eeprom_read_byte(LEGACY1_ACTIVE_BAND));
+	journal_write_dword(JOURNAL_TAG_2M_FREQUENCY, eeprom_read_dword(LEGACY1_2M_FREQUENCY));
+	journal_write_dword(JOURNAL_TAG_80M_FREQUENCY, eeprom_read_dword(LEGACY1_80M_FREQUENCY));
+	journal_write_dword(JOURNAL_TAG_RTTY_OFFSET_FREQUENCY, eeprom_read_dword(LEGACY1_CW_OFFSET_FREQUENCY));
+	journal_write_byte(JOURNAL_TAG_2M_MODULATION, (eeprom_read_byte(LEGACY1_2M_MODULATION) == LEGACY1_MODE_AM) ? MODE_AM : MODE_CW);
+}
+
+static void migrateTransmitter2(void)
+{
+	journal_write_dword(JOURNAL_TAG_SI5351_REF_CORRECTION, eeprom_read_dword(LEGACY2_SI5351_REF_CORRECTION));
+	journal_write_byte(JOURNAL_TAG_ACTIVE_BAND, eeprom_read_byte(LEGACY2_ACTIVE_BAND));
+	journal_write_dword(JOURNAL_TAG_2M_FREQUENCY, eeprom_read_dword(LEGACY2_2M_FREQUENCY));
+	journal_write_word(JOURNAL_TAG_2M_POWER_LEVEL_MW, eeprom_read_word(LEGACY2_2M_POWER_LEVEL_MW));
+	journal_write_dword(JOURNAL_TAG_80M_FREQUENCY, eeprom_read_dword(LEGACY2_80M_FREQUENCY));
+	journal_write_word(JOURNAL_TAG_80M_POWER_LEVEL_MW, eeprom_read_word(LEGACY2_80M_POWER_LEVEL_MW));
+	journal_write_dword(JOURNAL_TAG_RTTY_OFFSET_FREQUENCY, eeprom_read_dword(LEGACY2_CW_OFFSET_FREQUENCY));
+	journal_write_byte(JOURNAL_TAG_AM_DRIVE_LEVEL_HIGH, eeprom_read_byte(LEGACY2_AM_DRIVE_LEVEL_HIGH));
+	journal_write_byte(JOURNAL_TAG_AM_DRIVE_LEVEL_LOW, eeprom_read_byte(LEGACY2_AM_DRIVE_LEVEL_LOW));
+	journal_write_byte(JOURNAL_TAG_2M_MODULATION, eeprom_read_byte(LEGACY2_2M_MODULATION));
+}
+
+/**
+ * The layouts are told apart by their flag values. A layout 2 transmitter block sits where
+ * layout 1 kept the band, which is never LEGACY2_INITIALIZED_FLAG.
+ */
+void legacy_migrate(void)
+{
+	uint8_t interfaceFlag = eeprom_read_byte(LEGACY2_INTERFACE_FLAG);
+
+	wdt_reset();    /* HW watchdog */
+
+	if(eeprom_read_byte(LEGACY2_TRANSMITTER_FLAG) == LEGACY2_INITIALIZED_FLAG)
+	{
+		migrateTransmitter2();
+	}
+	else if((eeprom_read_byte(LEGACY1_TRANSMITTER_FLAG) == LEGACY1_INITIALIZED_FLAG) && (interfaceFlag != LEGACY2_INITIALIZED_FLAG))
+	{
+		migrateTransmitter1();
+		eeprom_update_byte(LEGACY1_TRANSMITTER_FLAG, EEPROM_UNINITIALIZED);
+	}
+
+	wdt_reset();    /* HW watchdog */
+
+	if(interfaceFlag == LEGACY2_INITIALIZED_FLAG)
+	{
+		migrateInterface2();
+		eeprom_update_byte(LEGACY2_INTERFACE_FLAG, EEPROM_UNINITIALIZED);
+	}
+	else if(interfaceFlag == LEGACY1_INITIALIZED_FLAG)
+	{
+		migrateInterface1();
+		eeprom_update_byte(LEGACY1_INTERFACE_FLAG, EEPROM_UNINITIALIZED);
+	}
+}
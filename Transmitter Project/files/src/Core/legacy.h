@@ -0,0 +1,121 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * legacy.h
+ *
+ * Settings saved by firmware that predates the journal. That firmware kept them in EEMEM
+ * variables, which the linker places in link order, so the addresses below are pinned to
+ * those the linker gave them rather than declared again as EEMEM.
+ *
+ * Layout 1 is that of Debug/RDP.elf (nm -n; the .eeprom section holds main.o, then
+ * transmitter.o). Layout 2 is that of the last firmware before the journal: the same two
+ * modules, in the same link order, with longer text, a battery threshold, an oscillator
+ * calibration and the power tables.
+ *
+ * EEPROM map:
+ *
+ *   0x000 - 0x03A   interface settings, layout 1
+ *   0x03B - 0x051   transmitter settings, layout 1
+ *   0x000 - 0x03F   interface settings, layout 2
+ *   0x040 - 0x058   transmitter settings, layout 2
+ *   0x059 - 0x0B8   power tables, layout 2 (still in use)
+ *   0x0C0 - 0x14B   Si5351 frequency plans (SI5351_PLANS_EEPROM_ADDRESS)
+ *   0x180 - 0x3FF   journal
+ */
+
+#ifndef LEGACY_H_
+#define LEGACY_H_
+
+#include "defs.h"
+
+#define LEGACY1_INITIALIZED_FLAG 0xAA
+#define LEGACY2_INITIALIZED_FLAG EEPROM_INITIALIZED_FLAG
+
+/* Layout 1 */
+#define LEGACY1_TEXT_LENGTH 20
+#define LEGACY1_INTERFACE_FLAG ((uint8_t*)0x000)
+#define LEGACY1_STATION_ID_TEXT ((char*)0x001)
+#define LEGACY1_PATTERN_TEXT ((char*)0x015)
+#define LEGACY1_PATTERN_CODESPEED ((uint8_t*)0x029)
+#define LEGACY1_ID_CODESPEED ((uint8_t*)0x02A)
+#define LEGACY1_ON_AIR_TIME ((uint16_t*)0x02B)
+#define LEGACY1_OFF_AIR_TIME ((uint16_t*)0x02D)
+#define LEGACY1_INTRA_CYCLE_DELAY_TIME ((uint16_t*)0x02F)
+#define LEGACY1_ID_TIME ((uint16_t*)0x031)
+#define LEGACY1_START_TIME ((uint32_t*)0x033)
+#define LEGACY1_FINISH_TIME ((uint32_t*)0x037)
+
+#define LEGACY1_TRANSMITTER_FLAG ((uint8_t*)0x03B)
+#define LEGACY1_SI5351_REF_CORRECTION ((uint32_t*)0x03C)
+#define LEGACY1_ACTIVE_BAND ((uint8_t*)0x040)
+#define LEGACY1_2M_FREQUENCY ((uint32_t*)0x041)
+#define LEGACY1_80M_FREQUENCY ((uint32_t*)0x046)
+#define LEGACY1_CW_OFFSET_FREQUENCY ((uint32_t*)0x04B)
+#define LEGACY1_2M_MODULATION ((uint8_t*)0x051)
+#define LEGACY1_MODE_AM 1                       /* layout 1 numbered the modulation formats CW = 0, AM = 1 */
+
+/* Layout 2 */
+#define LEGACY2_TEXT_LENGTH 21
+#define LEGACY2_INTERFACE_FLAG ((uint8_t*)0x000)
+#define LEGACY2_STATION_ID_TEXT ((char*)0x001)
+#define LEGACY2_PATTERN_TEXT ((char*)0x016)
+#define LEGACY2_PATTERN_CODESPEED ((uint8_t*)0x02B)
+#define LEGACY2_ID_CODESPEED ((uint8_t*)0x02C)
+#define LEGACY2_ON_AIR_TIME ((uint16_t*)0x02D)
+#define LEGACY2_OFF_AIR_TIME ((uint16_t*)0x02F)
+#define LEGACY2_INTRA_CYCLE_DELAY_TIME ((uint16_t*)0x031)
+#define LEGACY2_ID_TIME ((uint16_t*)0x033)
+#define LEGACY2_START_TIME ((uint32_t*)0x035)
+#define LEGACY2_FINISH_TIME ((uint32_t*)0x039)
+#define LEGACY2_BATTERY_EMPTY_MV ((uint16_t*)0x03D)
+#define LEGACY2_CLOCK_OSCCAL ((uint8_t*)0x03F)
+
+#define LEGACY2_TRANSMITTER_FLAG ((uint8_t*)0x040)  /* also marks the power tables as written */
+#define LEGACY2_SI5351_REF_CORRECTION ((uint32_t*)0x041)
+#define LEGACY2_ACTIVE_BAND ((uint8_t*)0x045)
+#define LEGACY2_2M_FREQUENCY ((uint32_t*)0x046)
+#define LEGACY2_2M_POWER_LEVEL_MW ((uint16_t*)0x04A)
+#define LEGACY2_80M_FREQUENCY ((uint32_t*)0x04C)
+#define LEGACY2_80M_POWER_LEVEL_MW ((uint16_t*)0x050)
+#define LEGACY2_CW_OFFSET_FREQUENCY ((uint32_t*)0x052)
+#define LEGACY2_AM_DRIVE_LEVEL_HIGH ((uint8_t*)0x056)
+#define LEGACY2_AM_DRIVE_LEVEL_LOW ((uint8_t*)0x057)
+#define LEGACY2_2M_MODULATION ((uint8_t*)0x058)
+
+#define LEGACY2_POWER_TABLE_LENGTH 16
+#define LEGACY2_80M_POWER_TABLE ((uint8_t*)0x059)
+#define LEGACY2_2M_AM_POWER_TABLE ((uint8_t*)0x069)
+#define LEGACY2_2M_AM_DRIVE_LOW_TABLE ((uint8_t*)0x079)
+#define LEGACY2_2M_AM_DRIVE_HIGH_TABLE ((uint8_t*)0x089)
+#define LEGACY2_2M_CW_POWER_TABLE ((uint8_t*)0x099)
+#define LEGACY2_2M_CW_DRIVE_TABLE ((uint8_t*)0x0A9)
+
+/**
+ * Moves settings saved in either legacy layout into the journal, so that an upgrade keeps
+ * them. Call only when journal_init() returns JOURNAL_SCHEMA_LEGACY. Layout 1 stored power
+ * and drive levels in units the transmitter no longer uses, so those revert to their
+ * defaults. The flags are cleared so that the settings move only once, except the layout 2
+ * transmitter flag, which also guards the power tables.
+ */
+void legacy_migrate(void);
+
+#endif  /* LEGACY_H_ */
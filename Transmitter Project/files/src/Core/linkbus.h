@@ -96,13 +96,14 @@ typedef enum
 
 	/*	DUAL-BAND TX MESSAGE FAMILY (FUNCTIONAL MESSAGING) */
 	MESSAGE_SET_FREQ = 'F' * 100 + 'R' * 10 + 'E',  /* $FRE,Fhz; / $FRE,FHz? / !FRE,; // Set/request current frequency */
-	MESSAGE_CLOCK = 'T' * 100 + 'I' * 10 + 'M',		/* Sets/reads the real-time clock */
+	MESSAGE_CLOCK = 'T' * 100 + 'I' * 10 + 'M',		/* $TIM,yyyy-mm-ddThh:mm:ss[,ms]; / !TIM,O,ms; // Sets/reads the real-time clock; reply gives the clock's offset before it was set */
 	MESSAGE_STARTFINISH = 'S' * 10 + 'F',			/* Sets the start and finish times */
 	MESSAGE_BAT = 'B' * 100 + 'A' * 10 + 'T',       /* Battery charge data */
 	MESSAGE_TEMP = 'T' * 100 + 'E' * 10 + 'M',      /* Temperature  data */
 	MESSAGE_PERM = 'P' * 100 + 'R' * 10 + 'M',		/* Saves most settings to EEPROM "perm" */
 	MESSAGE_TX_POWER = 'P' * 100 + 'O' * 10 + 'W',	/* Sets transmit power level */
 	MESSAGE_TX_MOD = 'M' * 100 + 'O' * 10 + 'D',    /* Sets 2m modulation format to AM or CW */
+	MESSAGE_TX_CALIBRATION = 'C' * 100 + 'A' * 10 + 'L', /* $CAL; / $CAL,mW,drive; / $CAL,H|L,mW,bias; // Read calibration points for the active band and modulation, or set a point's drive level or 2m AM peak (or CW) / trough gate bias */
 #ifdef DONOTUSE
 	MESSAGE_DRIVE_LEVEL = 'D' * 100 + 'R' * 10 + 'I', /*  Adjust 2m drive level */
 #endif // DONOTUSE
@@ -116,6 +117,9 @@ typedef enum
 	/* UTILITY MESSAGES */
 	MESSAGE_RESET = 'R' * 100 + 'S' * 10 + 'T',		/* Processor reset */
 	MESSAGE_WIFI = 'W' * 10 + 'I',					/* Enable/disable WiFi */
+	MESSAGE_SCHEDULER = 'S' * 100 + 'C' * 10 + 'H', /* $SCH; / $SCH,0; // Read (and optionally clear) max interrupts-off us, event queue high water, dropped events */
+	MESSAGE_ENERGY = 'N' * 100 + 'R' * 10 + 'G',	/* $NRG; / $NRG,0; // Read (and optionally clear) power-state times and battery discharge rate */
+	MESSAGE_I2C = 'I' * 100 + '2' * 10 + 'C',		/* $I2C; / $I2C,0; // Read each I2C device's address, probed bus speed (kHz; 0 = did not respond), and (optionally clear) NACK, timeout and bus recovery counts */
 	MESSAGE_BIAS = 'B',
 	INVALID_MESSAGE = UINT16_MAX					/* This value must never overlap a valid message ID */
 } LBMessageID;
@@ -128,6 +132,10 @@ typedef enum
 #define MESSAGE_VER_LABEL "VER"
 #define MESSAGE_SET_FREQ_LABEL "FRE"
 #define MESSAGE_TX_POWER_LABEL "POW"
+#define MESSAGE_TX_CALIBRATION_LABEL "CAL"
+#define MESSAGE_SCHEDULER_LABEL "SCH"
+#define MESSAGE_ENERGY_LABEL "NRG"
+#define MESSAGE_I2C_LABEL "I2C"
 #define MESSAGE_ACK "!ACK;"
 
 typedef enum
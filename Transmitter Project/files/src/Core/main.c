@@ -37,6 +37,11 @@
 #include "huzzah.h"
 #include "util.h"
 #include "morse.h"
+#include "scheduler.h"
+#include "energy.h"
+#include "journal.h"
+#include "legacy.h"
+#include "fm.h"
 
 #include <avr/io.h>
 #include <stdint.h>         /* has to be added to use uint8_t */
@@ -75,6 +80,9 @@ static volatile BOOL g_powering_off = FALSE;
 static volatile uint8_t g_wifi_enable_delay = 0;
 
 static volatile uint16_t g_util_tick_countdown = 0;
+static volatile uint16_t g_ticks_since_rtc_second = 0;  /* TIMER2 ticks since the last RTC 1-second interrupt */
+static time_t g_clock_set_epoch;                        /* time to be written to the RTC by setClockAtSecond() */
+static int32_t g_clock_offset_ms;                       /* system clock minus the reference time, before it was set */
 static volatile BOOL g_battery_measurements_active = FALSE;
 static volatile uint16_t g_maximum_battery = 0;
 volatile BatteryType g_battery_type = BATTERY_UNKNOWN;
@@ -92,21 +100,7 @@ volatile uint8_t g_mod_down = MAX_2M_CW_DRIVE_LEVEL;
 
 /* Linkbus variables */
 #define MAX_PATTERN_TEXT_LENGTH 20
-
-static BOOL EEMEM ee_interface_eeprom_initialization_flag = EEPROM_UNINITIALIZED;
-
-static char EEMEM ee_stationID_text[MAX_PATTERN_TEXT_LENGTH + 1];
-static char EEMEM ee_pattern_text[MAX_PATTERN_TEXT_LENGTH + 1];
-static uint8_t EEMEM ee_pattern_codespeed;
-static uint8_t EEMEM ee_id_codespeed;
-static uint16_t EEMEM ee_on_air_time;
-static uint16_t EEMEM ee_off_air_time;
-static uint16_t EEMEM ee_intra_cycle_delay_time;
-static uint16_t EEMEM ee_ID_time;
-static time_t EEMEM ee_start_time;
-static time_t EEMEM ee_finish_time;
-static uint16_t EEMEM ee_battery_empty_mV;
-static uint8_t EEMEM ee_clock_OSCCAL;
+#define MAX_CLOCK_OFFSET_SECONDS 2000000L   /* larger clock offsets are reported as this, so that milliseconds fit in an int32_t */
 
 static char g_messages_text[2][MAX_PATTERN_TEXT_LENGTH + 1] = { "\0", "\0" };
 static volatile uint8_t g_id_codespeed = EEPROM_ID_CODE_SPEED_DEFAULT;
@@ -129,10 +123,13 @@ static volatile int32_t g_on_the_air = 0;
 static volatile int g_sendID_seconds_countdown = 0;
 static volatile uint16_t g_code_throttle = 50;
 static volatile uint8_t g_WiFi_shutdown_seconds = 120;
-static volatile BOOL g_report_seconds = FALSE;
 static volatile BOOL g_wifi_active = TRUE;
 static volatile BOOL g_shutting_down_wifi = FALSE;
 static volatile SleepType g_sleepType = NOT_SLEEPING;
+static volatile uint16_t g_keyed_ticks = 0;
+
+static BOOL g_init_hardware = FALSE;
+static uint8_t g_hw_tries = 10;    /* give up after too many failures */
 
 static BOOL g_calibrate_baud = FALSE;
 static int g_baud_count = 0;
@@ -153,17 +150,42 @@ static BOOL g_OSCCAL_inhibit = FALSE;
 #define TX_PA_DRIVE_VOLTAGE ADCH6
 #define BAT_VOLTAGE ADCH7
 #define NUMBER_OF_POLLED_ADC_CHANNELS 5
-static const uint8_t activeADC[NUMBER_OF_POLLED_ADC_CHANNELS] = { BAT_VOLTAGE, TX_PA_DRIVE_VOLTAGE, V12V_VOLTAGE, BAND_80M_ANT_DETECT, BAND_2M_ANT_DETECT };
 
-static const uint16_t g_adcChannelConversionPeriod_ticks[NUMBER_OF_POLLED_ADC_CHANNELS] = { TIMER2_0_5HZ, TIMER2_0_5HZ, TIMER2_0_5HZ, TIMER2_5_8HZ, TIMER2_5_8HZ };
-static volatile uint16_t g_tickCountdownADCFlag[NUMBER_OF_POLLED_ADC_CHANNELS] = { TIMER2_0_5HZ, TIMER2_0_5HZ, TIMER2_0_5HZ, TIMER2_5_8HZ, TIMER2_5_8HZ };
-static uint16_t g_filterADCValue[NUMBER_OF_POLLED_ADC_CHANNELS] = { 500, 500, 500, 500, 500 };
+#define ADC_OVERSAMPLE_NONE 0   /* log4 of the number of conversions summed per reading */
+#define ADC_OVERSAMPLE_4X 1
+#define ADC_OVERSAMPLE_16X 2
+#define ADC_RESULT_BITS 12      /* readings are scaled to 12 bits after decimation */
+#define ADC_FILTER_FRAC_BITS 4  /* fractional bits kept in the IIR filter state */
+#define ADC_SEQUENCE_PERIOD_TICKS TIMER2_20HZ
+
+typedef struct
+{
+	uint8_t mux;            /* ADC input channel */
+	uint8_t oversample;     /* ADC_OVERSAMPLE_x */
+	uint8_t filterShift;    /* IIR: y += (x - y) >> filterShift; 0 = unfiltered */
+	uint8_t passDivider;    /* sampled on every passDivider-th pass of the sequence; must be a power of two */
+} ADCSequenceEntry;
+
+/* Entries are in *_READING order */
+static const ADCSequenceEntry g_adcSequence[NUMBER_OF_POLLED_ADC_CHANNELS] = {
+	{ BAT_VOLTAGE, ADC_OVERSAMPLE_16X, 3, 8 },
+	{ TX_PA_DRIVE_VOLTAGE, ADC_OVERSAMPLE_4X, 2, 1 },
+	{ V12V_VOLTAGE, ADC_OVERSAMPLE_4X, 3, 8 },
+	{ BAND_80M_ANT_DETECT, ADC_OVERSAMPLE_4X, 0, 2 },
+	{ BAND_2M_ANT_DETECT, ADC_OVERSAMPLE_4X, 0, 2 } };
+
+static volatile BOOL g_adcSequenceInProcess = FALSE;
+static uint8_t g_adcSequenceIndex;                                  /* entry being converted */
+static uint8_t g_adcSequencePass = 0;
+static uint8_t g_adcConversionsLeft;                                /* includes the conversion discarded after a mux change */
+static uint16_t g_adcSampleSum;
+static uint16_t g_adcFilterState[NUMBER_OF_POLLED_ADC_CHANNELS];   /* ADC_RESULT_BITS + ADC_FILTER_FRAC_BITS */
+static uint8_t g_adcFilterPrimed = 0;                               /* one bit per entry */
 static volatile BOOL g_adcUpdated[NUMBER_OF_POLLED_ADC_CHANNELS] = { FALSE, FALSE, FALSE, FALSE, FALSE };
 static volatile uint16_t g_lastConversionResult[NUMBER_OF_POLLED_ADC_CHANNELS];
 
 /*static volatile uint32_t g_PA_voltage = 0; */
 
-extern volatile BOOL g_i2c_not_timed_out;
 static volatile BOOL g_sufficient_power_detected = FALSE;
 static volatile BOOL g_enableHardwareWDResets = FALSE;
 extern volatile BOOL g_tx_power_is_zero;
@@ -192,6 +214,11 @@ void set_ports(SleepType initType);
 BOOL antennaIsConnected(void);
 void initializeAllEventSettings(BOOL disableEvent);
 void suspendEvent(void);
+void handleRTCSecond(void);
+void adcStartSequenceEntry(uint8_t index);
+void checkAntennaConnection(void);
+void setClockAtSecond(void);
+uint16_t batteryMillivolts(void);
 
 
 /***********************************************************************
@@ -270,6 +297,7 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 		{
 			g_antenna_connect_state = ANT_ALL_DISCONNECTED;
 			g_antenna_connection_changed = TRUE;
+			sched_post_event(SCHED_EVENT_ANTENNA_CHANGED);
 		}
 	}
 }
@@ -277,6 +305,9 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 
 /***********************************************************************
  * Handle RTC interrupts
+ *
+ * Only antenna debouncing and sleep timing are handled here. Event
+ * timing is handled in the foreground by handleRTCSecond().
  **********************************************************************/
 #ifdef SELECTIVELY_DISABLE_OPTIMIZATION
 	__attribute__((optimize("O0"))) ISR( INT0_vect )
@@ -286,6 +317,7 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 {
 	static BOOL lastAntennaConnectionState = FALSE;
 	static uint8_t antennaReadCount = 3;
+	uint16_t isrStart = TCNT1;
 	BOOL ant = antennaIsConnected();
 
 	if(!ant)    /* immediately detect disconnection */
@@ -294,6 +326,7 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 		{
 			g_antenna_connect_state = ANT_ALL_DISCONNECTED;
 			g_antenna_connection_changed = TRUE;
+			sched_post_event(SCHED_EVENT_ANTENNA_CHANGED);
 		}
 	}
 	else if(g_antenna_connect_state == ANT_ALL_DISCONNECTED)
@@ -308,6 +341,7 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 				{
 					g_antenna_connect_state = ANT_CONNECTION_UNDETERMINED;
 					g_antenna_connection_changed = TRUE;
+					sched_post_event(SCHED_EVENT_ANTENNA_CHANGED);
 					antennaReadCount = 3;
 				}
 			}
@@ -321,6 +355,7 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 	lastAntennaConnectionState = ant;
 
 	system_tick();
+	g_ticks_since_rtc_second = 0;
 
 	if(g_sleeping)
 	{
@@ -337,205 +372,10 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
 	}
 	else
 	{
-		time_t temp_time;
-
-		if(g_update_timeout_seconds)
-		{
-			g_update_timeout_seconds--;
-		}
-
-		if(g_event_commenced)
-		{
-			if(g_event_finish_time && !g_check_for_next_event && !g_shutting_down_wifi)
-			{
-				time(&temp_time);
-
-				if(temp_time >= g_event_finish_time)
-				{
-					g_last_status_code = STATUS_CODE_EVENT_FINISHED;
-					g_on_the_air = 0;
-					keyTransmitter(OFF);
-					g_event_enabled = FALSE;
-					g_event_commenced = FALSE;
-					g_check_for_next_event = TRUE;
-					g_update_timeout_seconds = 90;
-					if(g_wifi_active)
-					{
-						g_WiFi_shutdown_seconds = 60;
-					}
-				}
-			}
-		}
-
-		if(g_event_enabled)
-		{
-			if(g_event_commenced)
-			{
-				BOOL repeat;
-
-				if(g_sendID_seconds_countdown)
-				{
-					g_sendID_seconds_countdown--;
-				}
-
-				if(g_on_the_air)
-				{
-					if(g_on_the_air > 0)    /* on the air */
-					{
-						g_on_the_air--;
-
-						if(!g_sendID_seconds_countdown && g_time_needed_for_ID)
-						{
-							if(g_on_the_air == g_time_needed_for_ID)    /* wait until the end of a transmission */
-							{
-								g_last_status_code = STATUS_CODE_SENDING_ID;
-								g_sendID_seconds_countdown = g_ID_period_seconds;
-								g_code_throttle = throttleValue(g_id_codespeed);
-								repeat = FALSE;
-								makeMorse(g_messages_text[STATION_ID], &repeat, NULL);  /* Send only once */
-							}
-						}
-
-
-						if(!g_on_the_air)
-						{
-							if(g_off_air_seconds)
-							{
-								keyTransmitter(OFF);
-								g_on_the_air -= g_off_air_seconds;
-								repeat = TRUE;
-								makeMorse(g_messages_text[PATTERN_TEXT], &repeat, NULL);    /* Reset pattern to start */
-								g_last_status_code = STATUS_CODE_EVENT_STARTED_WAITING_FOR_TIME_SLOT;
-
-
-								/* Enable sleep during off-the-air periods */
-								int32_t timeRemaining = 0;
-								time(&temp_time);
-								if(temp_time < g_event_finish_time)
-								{
-									timeRemaining = timeDif(g_event_finish_time, temp_time);
-								}
-
-								/* Don't sleep for the last cycle to ensure that the event doesn't end while
-								 * the transmitter is sleeping - which can cause problems with loading the next event */
-								if(timeRemaining > (g_off_air_seconds + g_on_air_seconds + 15))
-								{
-									if((g_off_air_seconds > 15) && !g_WiFi_shutdown_seconds)
-									{
-										g_seconds_to_sleep = (time_t)(g_off_air_seconds - 10);
-										g_sleepType = SLEEP_UNTIL_NEXT_XMSN;
-										g_go_to_sleep = TRUE;
-										g_sendID_seconds_countdown = MAX(0, g_sendID_seconds_countdown - (int)g_seconds_to_sleep);
-									}
-								}
-							}
-							else
-							{
-								g_on_the_air = g_on_air_seconds;
-								g_code_throttle = throttleValue(g_pattern_codespeed);
-							}
-						}
-					}
-					else if(g_on_the_air < 0)   /* off the air - g_on_the_air = 0 means all transmissions are disabled */
-					{
-						g_on_the_air++;
-
-						if(!g_on_the_air)       /* off-the-air time has expired */
-						{
-							g_last_status_code = STATUS_CODE_EVENT_STARTED_NOW_TRANSMITTING;
-							g_on_the_air = g_on_air_seconds;
-							g_code_throttle = throttleValue(g_pattern_codespeed);
-							BOOL repeat = TRUE;
-							makeMorse(g_messages_text[PATTERN_TEXT], &repeat, NULL);
-						}
-					}
-				}
-			}
-			else if(g_event_start_time > 0) /* off the air - waiting for the start time to arrive */
-			{
-				time(&temp_time);
-
-				if(temp_time >= g_event_start_time)
-				{
-					if(g_intra_cycle_delay_time)
-					{
-						g_last_status_code = STATUS_CODE_EVENT_STARTED_WAITING_FOR_TIME_SLOT;
-						g_on_the_air = -g_intra_cycle_delay_time;
-						g_sendID_seconds_countdown = g_intra_cycle_delay_time + g_on_air_seconds - g_time_needed_for_ID;
-					}
-					else
-					{
-						g_last_status_code = STATUS_CODE_EVENT_STARTED_NOW_TRANSMITTING;
-						g_on_the_air = g_on_air_seconds;
-						g_sendID_seconds_countdown = g_on_air_seconds - g_time_needed_for_ID;
-						g_code_throttle = throttleValue(g_pattern_codespeed);
-						BOOL repeat = TRUE;
-						makeMorse(g_messages_text[PATTERN_TEXT], &repeat, NULL);
-					}
-
-					g_event_commenced = TRUE;
-				}
-			}
-		}
-
-
-		/**************************************
-		 * Delay before re-enabling linkbus receive
-		 ***************************************/
-		if(g_wifi_enable_delay)
-		{
-			g_wifi_enable_delay--;
-
-			if(g_wifi_enable_delay == (LINKBUS_POWERUP_DELAY_SECONDS - 1))
-			{
-				wifi_power(ON);     /* power on WiFi */
-				wifi_reset(OFF);    /* bring WiFi out of reset */
-			}
-			else if(!g_wifi_enable_delay)
-			{
-				linkbus_init(BAUD);
-				g_calibrate_baud = TRUE;
-			}
-		}
-		else
-		{
-			if(!g_update_timeout_seconds || g_shutting_down_wifi || (!g_check_for_next_event && !g_waiting_for_next_event))
-			{
-				if(g_WiFi_shutdown_seconds)
-				{
-					g_WiFi_shutdown_seconds--;
-
-					if(!g_WiFi_shutdown_seconds)
-					{
-						wifi_reset(ON);     /* put WiFi into reset */
-						wifi_power(OFF);    /* power off WiFi */
-						g_shutting_down_wifi = FALSE;
-
-						/* If an event hasn't been enabled by the time that WiFi shuts
-						 *  down, then the transmitter will never run. Just sleep indefinitely
-						 */
-						if(!g_event_enabled)
-						{
-							g_sleepType = SLEEP_FOREVER;
-							g_go_to_sleep = TRUE;
-							g_seconds_to_sleep = MAX_TIME;
-						}
-						else if(g_sleepType == SLEEP_AFTER_WIFI_GOES_OFF)
-						{
-							eventEnabled(); /* Sets sleep time appropriately */
-						}
-
-						g_wifi_active = FALSE;
-					}
-				}
-			}
-
-			if(g_wifi_active)
-			{
-				g_report_seconds = TRUE;
-			}
-		}
+		sched_post_event(SCHED_EVENT_RTC_SECOND);
 	}
+
+	sched_irq_off_end(isrStart);
 }
 
 /***********************************************************************
@@ -545,17 +385,25 @@ void __attribute__((optimize("O1"))) wdt_init(WDReset resetType)
  ************************************************************************/
 ISR( TIMER2_COMPB_vect )
 {
-	static BOOL conversionInProcess = FALSE;
-	static int8_t indexConversionInProcess;
+	static uint16_t adcSequenceCountdown = ADC_SEQUENCE_PERIOD_TICKS;
 	static uint16_t codeInc = 0;
 	static uint8_t modulationToggle = 0;
+	uint16_t isrStart = TCNT1;
 	BOOL repeat, finished;
 
+	sched_tick();
+	i2c_tick();
+
 	if(g_util_tick_countdown)
 	{
 		g_util_tick_countdown--;
 	}
 
+	if(g_ticks_since_rtc_second < UINT16_MAX)
+	{
+		g_ticks_since_rtc_second++;
+	}
+
 	if(g_baud_count)
 	{
 		g_baud_count--;
@@ -567,6 +415,11 @@ ISR( TIMER2_COMPB_vect )
 	{
 		if(g_on_the_air > 0)
 		{
+			if(key)
+			{
+				g_keyed_ticks++;
+			}
+
 			if(codeInc)
 			{
 				codeInc--;
@@ -608,130 +461,136 @@ ISR( TIMER2_COMPB_vect )
 		}
 	}
 
-	Modulation m = txGetModulation();
-
-	if(m != MODE_CW)
+	/* FM is generated by the TIMER0 ISR */
+	if(txGetModulation() == MODE_AM)
 	{
 		modulationToggle = !modulationToggle;
 
 		if(modulationToggle)
 		{
-			if(m == MODE_AM)
-			{
-				txSet2mGateBias(g_mod_up);
-			}
-			else if(m == MODE_FM)
-			{
-				PORTC = I2C_PINS | (1 << PORTC3);
-			}
+			txSet2mGateBias(g_mod_up);
 		}
 		else
 		{
-			if(m == MODE_AM)
-			{
-				txSet2mGateBias(g_mod_down);
-			}
-			else if(m == MODE_FM)
-			{
-				PORTC = I2C_PINS;
-			}
+			txSet2mGateBias(g_mod_down);
 		}
 	}
 
 	/**
-	 * Handle Periodic ADC Readings
-	 * The following algorithm allows multipe ADC channel readings to be performed at different polling intervals. */
-	if(!conversionInProcess)
+	 * Start a pass through the ADC sequence table. The conversions themselves are chained by ADC_vect. */
+	if(adcSequenceCountdown)
+	{
+		adcSequenceCountdown--;
+	}
+	else if(!g_adcSequenceInProcess)
 	{
-		/* Note: countdowns will pause while a conversion is in process. Conversions are so fast that this should not be an issue though. */
+		adcSequenceCountdown = ADC_SEQUENCE_PERIOD_TICKS;
+		g_adcSequenceInProcess = TRUE;
+		adcStartSequenceEntry(0);
+	}
 
-		volatile uint8_t i; /* volatile to prevent optimization performing undefined behavior */
-		indexConversionInProcess = -1;
+	sched_irq_off_end(isrStart);
+}/* ISR */
 
-		for(i = 0; i < NUMBER_OF_POLLED_ADC_CHANNELS; i++)
-		{
-			if(g_tickCountdownADCFlag[i])
-			{
-				g_tickCountdownADCFlag[i]--;
-			}
 
-			if(g_tickCountdownADCFlag[i] == 0)
-			{
-				indexConversionInProcess = (int8_t)i;
-			}
-		}
+/***********************************************************************
+ * ADC Conversion Complete ISR
+ *
+ * Walks the ADC sequence table one conversion at a time. Each reading
+ * is the sum of 4^n conversions decimated to ADC_RESULT_BITS, passed
+ * through a first-order IIR filter, and stored in millivolts at the pin.
+ ************************************************************************/
+ISR( ADC_vect )
+{
+	uint16_t isrStart = TCNT1;
+	uint16_t sample = ADC;
+	uint8_t index = g_adcSequenceIndex;
+	const ADCSequenceEntry* entry = &g_adcSequence[index];
 
-		if(indexConversionInProcess >= 0)
-		{
-			g_tickCountdownADCFlag[indexConversionInProcess] = g_adcChannelConversionPeriod_ticks[indexConversionInProcess];    /* reset the tick countdown */
-			ADMUX = (ADMUX & 0xF0) | activeADC[indexConversionInProcess];                                                       /* index through all active channels */
-			ADCSRA |= (1 << ADSC);                                                                                              /*single conversion mode */
-			conversionInProcess = TRUE;
-		}
+	if(g_adcConversionsLeft <= (1 << (entry->oversample << 1)))   /* discard the first conversion after a mux change */
+	{
+		g_adcSampleSum += sample;
+	}
+
+	if(--g_adcConversionsLeft)
+	{
+		ADCSRA |= (1 << ADSC);
 	}
-	else if(!( ADCSRA & (1 << ADSC) ))                                                                                          /* wait for conversion to complete */
+	else
 	{
-		uint16_t hold = ADC;
-		static uint16_t holdConversionResult;
-		holdConversionResult = (uint16_t)(((uint32_t)hold * ADC_REF_VOLTAGE_mV) >> 10);                                         /* millivolts at ADC pin */
-		uint16_t lastResult = g_lastConversionResult[indexConversionInProcess];
+		uint16_t x = g_adcSampleSum << (ADC_RESULT_BITS - 10 + ADC_FILTER_FRAC_BITS - (entry->oversample << 1));   /* decimate */
+		uint16_t y = g_adcFilterState[index];
+		uint16_t mV;
+
+		if(!entry->filterShift || !(g_adcFilterPrimed & (1 << index)))
+		{
+			y = x;
+			g_adcFilterPrimed |= (1 << index);
+		}
+		else if(x > y)
+		{
+			y += (x - y) >> entry->filterShift;
+		}
+		else
+		{
+			y -= (y - x) >> entry->filterShift;
+		}
 
-		g_adcUpdated[indexConversionInProcess] = TRUE;
+		g_adcFilterState[index] = y;
+		mV = (uint16_t)(((uint32_t)y * ADC_REF_VOLTAGE_mV) >> (ADC_RESULT_BITS + ADC_FILTER_FRAC_BITS));    /* millivolts at ADC pin */
 
-		if(indexConversionInProcess == BATTERY_READING)
+		if(index == BATTERY_READING)
 		{
-			BOOL directionUP = holdConversionResult > lastResult;
-			uint16_t delta = directionUP ? holdConversionResult - lastResult : lastResult - holdConversionResult;
+			g_battery_measurements_active = TRUE;
 
-			if(delta > g_filterADCValue[indexConversionInProcess])
+			if(mV > VOLTS_5)
 			{
-				lastResult = holdConversionResult;
-				g_tickCountdownADCFlag[indexConversionInProcess] = 100; /* speed up next conversion */
+				g_battery_type = BATTERY_9V;
 			}
-			else
+			else if(mV > VOLTS_3_0)
 			{
-				if(directionUP)
-				{
-					lastResult++;
-				}
-				else if(delta)
-				{
-					lastResult--;
-				}
-
-				g_battery_measurements_active = TRUE;
-
-				if(lastResult > VOLTS_5)
-				{
-					g_battery_type = BATTERY_9V;
-				}
-				else if(lastResult > VOLTS_3_0)
-				{
-					g_battery_type = BATTERY_4r2V;
-				}
+				g_battery_type = BATTERY_4r2V;
 			}
 		}
-		else if(indexConversionInProcess == V12V_VOLTAGE_READING)
-		{
-			lastResult = holdConversionResult;
-		}
-/*		else if(indexConversionInProcess == PA_VOLTAGE_READING)
- *		{
- *			lastResult = holdConversionResult;
- *			g_PA_voltage = holdConversionResult;
- *		} */
-		else
+
+		g_lastConversionResult[index] = mV;
+		g_adcUpdated[index] = TRUE;
+
+		if(index == PA_VOLTAGE_READING)
 		{
-			lastResult = holdConversionResult;
+			sched_post_event(SCHED_EVENT_PA_VOLTAGE);
 		}
 
-		g_lastConversionResult[indexConversionInProcess] = lastResult;
-
-		conversionInProcess = FALSE;
+		adcStartSequenceEntry(index + 1);
 	}
+
+	sched_irq_off_end(isrStart);
 }/* ISR */
 
 
+/***********************************************************************
+ * Timer/Counter0 Compare Match A ISR
+ *
+ * Runs only while an FM carrier is keyed. Steps the 2m clock through
+ * the deviation table at FM_SAMPLE_RATE_HZ.
+ ************************************************************************/
+ISR( TIMER0_COMPA_vect )
+{
+	fm_sample();
+}
+
+
+/***********************************************************************
+ * TWI ISR
+ *
+ * Advances the I2C transaction in progress by one bus event.
+ ************************************************************************/
+ISR( TWI_vect )
+{
+	i2c_twi_interrupt();
+}
+
+
 /***********************************************************************
  * Watchdog Timeout ISR
  *
@@ -743,7 +602,7 @@ ISR(WDT_vect)
 {
 	static uint8_t limit = 10;
 
-	g_i2c_not_timed_out = FALSE;    /* unstick I2C */
+	i2c_reset();    /* unstick I2C */
 
 	/* Don't allow an unlimited number of WD interrupts to occur without enabling
 	 * hardware resets. But a limited number might be required during hardware
@@ -1106,10 +965,16 @@ void __attribute__((optimize("O1"))) set_ports(SleepType initType)
 		TCCR2B |= (1 << CS22) | (1 << CS21) | (1 << CS20);  /* 1024 Prescaler - why are we setting CS21?? */
 		TIMSK2 |= (1 << OCIE0B);                            /* enable compare interrupt */
 
+		/**
+		 * TIMER1 free-runs (no interrupts) to time interrupts-disabled windows */
+		TCCR1A = 0x00;                                      /* normal mode */
+		TCCR1B = SCHED_TIMER1_PRESCALE;
+
 		/**
 		 * Set up ADC */
 		ADMUX |= (1 << REFS0) | (1 << REFS1);               /* Use internal 1.1V reference */
-		ADCSRA |= (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0) | (1 << ADEN);
+		ADCSRA |= (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0) | (1 << ADEN) | (1 << ADIE);
+		g_adcSequenceInProcess = FALSE;                     /* any pass interrupted by sleep is abandoned */
 
 		/**
 		 * Set up pin interrupts */
@@ -1178,6 +1043,8 @@ void __attribute__((optimize("O1"))) set_ports(SleepType initType)
 		TCCR2A &= ~(1 << WGM01);                                /* set CTC with OCRA */
 		TCCR2B &= ~((1 << CS22) | (1 << CS21) | (1 << CS20));   /* Prescalar */
 
+		TCCR1B = 0x00;                                          /* stop TIMER1 */
+
 		/**
 		 * Set up ADC */
 		ADMUX &= ~((1 << REFS0) | (1 << REFS1));
@@ -1241,19 +1108,24 @@ int main( void )
 {
 	static EC code = ERROR_CODE_SW_LOGIC_ERROR;
 	uint8_t tries = 10;
-	BOOL init_hardware = FALSE;
 	uint8_t holdOSCCAL;
-	static uint8_t hw_tries = 10;   /* give up after too many failures */
 
 	/**
 	 * Initialize vars stored in EEPROM */
 
+	if(journal_init() == JOURNAL_SCHEMA_LEGACY)
+	{
+		legacy_migrate();
+	}
+
 	initializeEEPROMVars();
+	energy_init();
 	g_event_enabled = FALSE;    /* ensure the event is disabled until hardware is initialized */
 	holdOSCCAL = OSCCAL;
 	/**
 	 * Initialize port pins and timers */
 	set_ports(NOT_SLEEPING);
+	sched_init();
 
 	cpu_irq_enable();   /* same as sei(); */
 
@@ -1264,6 +1136,8 @@ int main( void )
 		wdt_reset();    /* HW watchdog */
 #endif /* TRANQUILIZE_WATCHDOG */
 
+	i2c_probe();    /* select the fastest bus speed each device supports */
+
 	g_antenna_connect_state = antennaIsConnected() ? ANT_CONNECTION_UNDETERMINED : ANT_ALL_DISCONNECTED;
 
 	while(code && tries)
@@ -1292,13 +1166,47 @@ int main( void )
 		wdt_init(WD_HW_RESETS); /* enable hardware interrupts */
 #endif /* TRANQUILIZE_WATCHDOG */
 
+	sched_add_task(checkAntennaConnection, 0);  /* determine initial antenna connection */
+
 	while(1)
 	{
+		SchedEvent event;
+
 		/**************************************
 		* The watchdog must be petted periodically to keep it from barking
 		**************************************/
 		cli(); wdt_reset(); /* HW watchdog */ sei();
 
+		/***************************************
+		* Handle events posted by ISRs
+		***************************************/
+		while((event = sched_next_event()) != SCHED_EVENT_NONE)
+		{
+			switch(event)
+			{
+				case SCHED_EVENT_RTC_SECOND:
+				{
+					handleRTCSecond();
+				}
+				break;
+
+				case SCHED_EVENT_ANTENNA_CHANGED:
+				{
+					sched_add_task(checkAntennaConnection, 0);
+				}
+				break;
+
+				case SCHED_EVENT_PA_VOLTAGE:
+				{
+					txRegulatePower((uint16_t)VPA_FROM_PIN_MV(g_lastConversionResult[PA_VOLTAGE_READING]));
+				}
+				break;
+
+				default:
+				break;
+			}
+		}
+
 		/***************************************
 		* Check for Power
 		***************************************/
@@ -1309,7 +1217,7 @@ int main( void )
 				if(g_lastConversionResult[BATTERY_READING] > POWER_ON_VOLT_THRESH_MV)   /* Battery measurement indicates sufficient voltage */
 				{
 					g_sufficient_power_detected = TRUE;
-					init_hardware = TRUE;
+					g_init_hardware = TRUE;
 				}
 				else if(!g_wifi_enable_delay)   /* no battery detected by the time WiFi  is turned on, assume an external battery is being used */
 				{
@@ -1317,23 +1225,23 @@ int main( void )
 					{
 						g_battery_type = BATTERY_EXTERNAL;
 						g_sufficient_power_detected = TRUE;
-						init_hardware = TRUE;
+						g_init_hardware = TRUE;
 					}
 				}
 			}
 		}
 
-		if(init_hardware)
+		if(g_init_hardware)
 		{
 			code = ERROR_CODE_NO_ERROR;
 
-			if(hw_tries)
+			if(g_hw_tries)
 			{
-				hw_tries--;
+				g_hw_tries--;
 				code = hw_init();   /* initialize transmitter and related I2C devices */
-				init_hardware = (code != ERROR_CODE_NO_ERROR);
+				g_init_hardware = (code != ERROR_CODE_NO_ERROR);
 
-				if(!init_hardware)  /* hardware was successfully initialized */
+				if(!g_init_hardware)  /* hardware was successfully initialized */
 				{
 					SC status = STATUS_CODE_IDLE;
 					EC ec = ERROR_CODE_SW_LOGIC_ERROR;
@@ -1373,26 +1281,32 @@ int main( void )
 		 ******************************/
 		if(g_go_to_sleep)
 		{
-			init_hardware = FALSE;                  /* ensure failing attempts are canceled */
+			time_t sleepStart;
+
+			g_init_hardware = FALSE;                  /* ensure failing attempts are canceled */
 			g_sufficient_power_detected = FALSE;    /* init hardware on return from sleep */
 			g_seconds_left_to_sleep = g_seconds_to_sleep;
 			linkbus_disable();
+			energy_save();
+			sleepStart = time(NULL);
 
 			while(g_go_to_sleep)
 			{
 				set_ports(g_sleepType); /* Sleep occurs here */
 			}
 
+			energy_add_sleep_seconds((uint32_t)MAX(0L, timeDif(time(NULL), sleepStart)));
+
 			set_ports(NOT_SLEEPING);
 			linkbus_enable();
 			wdt_init(WD_HW_RESETS);         /* enable hardware interrupts */
 			wdt_reset();                    /* HW watchdog */
-			g_i2c_not_timed_out = FALSE;    /* unstick I2C */
+			i2c_reset();                    /* unstick I2C */
 
 			if((g_sleepType == SLEEP_UNTIL_NEXT_XMSN) || (g_sleepType == SLEEP_UNTIL_START_TIME))
 			{
-				hw_tries = 10;              /* give up after too many failures */
-				init_hardware = TRUE;
+				g_hw_tries = 10;              /* give up after too many failures */
+				g_init_hardware = TRUE;
 			}
 			else
 			{
@@ -1429,7 +1343,7 @@ int main( void )
 					if(g_best_OSCCAL)
 					{
 						OSCCAL = g_best_OSCCAL;
-						eeprom_update_byte(&ee_clock_OSCCAL, g_best_OSCCAL);
+						journal_write_byte(JOURNAL_TAG_CLOCK_OSCCAL, g_best_OSCCAL);
 					}
 					else
 					{
@@ -1438,7 +1352,7 @@ int main( void )
 
 					calVal = 0;
 					g_baud_count = 6000 / OCR2A;
-					init_hardware = TRUE;
+					g_init_hardware = TRUE;
 				}
 				else
 				{
@@ -1458,13 +1372,6 @@ int main( void )
 			}
 		}
 
-		if(g_report_seconds)
-		{
-			g_report_seconds = FALSE;
-			sprintf(g_tempStr, "%lu", time(NULL));
-			lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_CLOCK_LABEL, g_tempStr);
-		}
-
 		if(g_last_error_code)
 		{
 			sprintf(g_tempStr, "%u", g_last_error_code);
@@ -1479,121 +1386,50 @@ int main( void )
 			g_last_status_code = STATUS_CODE_IDLE;
 		}
 
-		if(g_antenna_connection_changed)
+		/***************************************
+		* Run foreground tasks whose deadlines have expired
+		***************************************/
+		sched_run_due_tasks();
+
+#ifdef SUPPORT_STATE_MACHINE
+		/* Perform tasks specified by the transmitter */
+		if(g_txTask)
 		{
-			static AntConnType lastAntennaConnectState = ANT_CONNECTION_UNDETERMINED;
-			static uint8_t confirmations = 5;
+			EC ec;
+			ec = (*g_txTask)(NULL);
+			if(ec)
+			{
+				g_last_error_code = ec;
+			}
+		}
+#endif // SUPPORT_STATE_MACHINE
 
-			if(g_antenna_connect_state == ANT_CONNECTION_UNDETERMINED)
+		if(g_check_for_next_event && !g_waiting_for_next_event && !g_shutting_down_wifi)
+		{
+			if(!g_WiFi_shutdown_seconds)    /* Power up WiFi to receive next event */
 			{
-				if(!g_util_tick_countdown)
-				{
-					AntConnType connection = ANT_CONNECTION_UNDETERMINED;
+				wifi_power(ON);             /* power on WiFi */
+				wifi_reset(OFF);            /* bring WiFi out of reset */
+			}
+			else                            /* WiFi is already powered up */
+			{
+				lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_ESP_LABEL, "1");
+			}
 
-					if(g_lastConversionResult[BAND_80M_ANTENNA] < ANTENNA_DETECT_THRESH)
-					{
-						connection = ANT_80M_CONNECTED;
-					}
-
-					if(g_lastConversionResult[BAND_2M_ANTENNA] < ANTENNA_DETECT_THRESH)
-					{
-						if(connection == ANT_80M_CONNECTED)
-						{
-							connection = ANT_2M_AND_80M_CONNECTED;
-						}
-						else
-						{
-							connection = ANT_2M_CONNECTED;
-						}
-					}
-
-					if(lastAntennaConnectState == connection)
-					{
-						if(confirmations)
-						{
-							confirmations--;
-							g_util_tick_countdown = ANTENNA_DETECT_DEBOUNCE;
-						}
-						else
-						{
-							g_antenna_connect_state = connection;
-							g_antenna_connection_changed = FALSE;
-
-							if(connection == ANT_80M_CONNECTED)
-							{
-								g_last_status_code = STATUS_CODE_80M_ANT_ATTACHED;
-								/* Re-enable transmitter power and state if it is currently operating */
-								if(g_event_commenced)
-								{
-									hw_tries = 10;              /* give up after too many failures */
-									init_hardware = TRUE;
-								}
-							}
-							else if(connection == ANT_2M_CONNECTED)
-							{
-								/*txSetBand(BAND_2M, OFF); */
-								g_last_status_code = STATUS_CODE_2M_ANT_ATTACHED;
-
-								/* TODO: re-enable transmitter power and state if it is currently operating */
-							}
-						}
-					}
-					else
-					{
-						confirmations = 5;
-					}
-
-					lastAntennaConnectState = connection;
-				}
-			}
-			else if(g_antenna_connect_state == ANT_ALL_DISCONNECTED)
-			{
-				powerToTransmitter(OFF);
-				g_antenna_connection_changed = FALSE;
-				lastAntennaConnectState = ANT_ALL_DISCONNECTED;
-				g_last_status_code = STATUS_CODE_NO_ANT_ATTACHED;
-			}
-			else    /* logic error - this should not occur */
-			{
-				powerToTransmitter(OFF);
-				g_antenna_connection_changed = FALSE;
-			}
-		}
-
-#ifdef SUPPORT_STATE_MACHINE
-		/* Perform tasks specified by the transmitter */
-		if(g_txTask)
-		{
-			EC ec;
-			ec = (*g_txTask)(NULL);
-			if(ec)
-			{
-				g_last_error_code = ec;
-			}
-		}
-#endif // SUPPORT_STATE_MACHINE
-
-		if(g_check_for_next_event && !g_waiting_for_next_event && !g_shutting_down_wifi)
-		{
-			if(!g_WiFi_shutdown_seconds)    /* Power up WiFi to receive next event */
-			{
-				wifi_power(ON);             /* power on WiFi */
-				wifi_reset(OFF);            /* bring WiFi out of reset */
-			}
-			else                            /* WiFi is already powered up */
-			{
-				lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_ESP_LABEL, "1");
-			}
-
-			g_WiFi_shutdown_seconds = 60;
-			g_waiting_for_next_event = TRUE;
-			g_check_for_next_event = FALSE;
-		}
+			g_WiFi_shutdown_seconds = 60;
+			g_waiting_for_next_event = TRUE;
+			g_check_for_next_event = FALSE;
+		}
 
 		/***********************************************************************
 		 *  Handle arriving Linkbus messages
 		 ************************************************************************/
 		handleLinkBusMsgs();
+
+		/***********************************************************************
+		 *  Sleep until the next interrupt
+		 ************************************************************************/
+		sched_idle();
 	}   /* while(1) */
 }/* main */
 
@@ -1658,7 +1494,7 @@ void __attribute__((optimize("O0"))) handleLinkBusMsgs()
 					}
 					else if(val == 255)
 					{
-						eeprom_update_byte(&ee_clock_OSCCAL, 0xFF); /* erase any existing value */
+						journal_write_byte(JOURNAL_TAG_CLOCK_OSCCAL, 0xFF); /* erase any existing value */
 					}
 					else
 					{
@@ -1776,10 +1612,59 @@ void __attribute__((optimize("O0"))) handleLinkBusMsgs()
 			}
 			break;
 
+			case MESSAGE_TX_CALIBRATION:
+			{
+				PowerCalSetting setting = POWER_CAL_DRIVE;
+				uint8_t f = FIELD1;
+
+				if(lb_buff->fields[FIELD1][0] == 'H')
+				{
+					setting = POWER_CAL_MOD_HIGH;
+					f = FIELD2;
+				}
+				else if(lb_buff->fields[FIELD1][0] == 'L')
+				{
+					setting = POWER_CAL_MOD_LOW;
+					f = FIELD2;
+				}
+
+				if(lb_buff->fields[f][0] && lb_buff->fields[f + 1][0])
+				{
+					EC ec = ERROR_CODE_ILLEGAL_COMMAND_RCVD;
+					int value = atoi(lb_buff->fields[f + 1]);
+
+					if((value >= 0) && (value < 256))
+					{
+						ec = txSetPowerCalibration((uint16_t)atoi(lb_buff->fields[f]), setting, (uint8_t)value);
+					}
+
+					if(ec)
+					{
+						g_last_error_code = ec;
+					}
+				}
+				else
+				{
+					uint8_t index = 0;
+					uint16_t mW;
+					PowerCalPoint pt;
+
+					while(!txGetPowerCalibration(index++, &mW, &pt))
+					{
+						sprintf(g_tempStr, "%u,%u,%u,%u", mW, pt.drive, pt.modHigh, pt.modLow);
+						lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_TX_CALIBRATION_LABEL, g_tempStr);
+					}
+				}
+			}
+			break;
+
 			case MESSAGE_PERM:
 			{
 				storeTransmitterValues();
 				saveAllEEPROM();
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+					si5351_save_plans();    /* only on request: the cache is too large to rewrite with every save */
+#endif
 			}
 			break;
 
@@ -1906,9 +1791,44 @@ void __attribute__((optimize("O0"))) handleLinkBusMsgs()
 				{
 					if(lb_buff->fields[FIELD1][0])
 					{
+						time_t epoch, now;
+						uint16_t ms = 0, ticks;
+
 						strncpy(g_tempStr, lb_buff->fields[FIELD1], 20);
-						ds3231_set_date_time(g_tempStr, RTC_CLOCK);
-						set_system_time(ds3231_get_epoch(NULL));    /* update system clock */
+						epoch = convertTimeStringToEpoch(g_tempStr);
+
+						if(!epoch)  /* unparsable: take whatever the RTC was set to */
+						{
+							ds3231_set_date_time(g_tempStr, RTC_CLOCK);
+							set_system_time(ds3231_get_epoch(NULL));    /* update system clock */
+						}
+						else
+						{
+							if(lb_buff->fields[FIELD2][0])
+							{
+								ms = MIN(atoi(lb_buff->fields[FIELD2]), 999);
+							}
+
+							cli();
+							now = time(NULL);
+							ticks = g_ticks_since_rtc_second;
+							sei();
+
+							g_clock_offset_ms = CLAMP(-MAX_CLOCK_OFFSET_SECONDS, timeDif(now, epoch), MAX_CLOCK_OFFSET_SECONDS) * 1000L + (int32_t)((ticks * 1000UL) / TIMER2_TICKS_PER_SECOND) - ms;
+
+							/* Writing the seconds register restarts the RTC's second, so wait for the
+							 * reference second to roll over and then write the following second */
+							if(ms)
+							{
+								g_clock_set_epoch = epoch + 1;
+								sched_add_task(setClockAtSecond, (uint16_t)(((1000UL - ms) * TIMER2_TICKS_PER_SECOND) / 1000UL));
+							}
+							else
+							{
+								g_clock_set_epoch = epoch;
+								setClockAtSecond();
+							}
+						}
 					}
 					else
 					{
@@ -2162,6 +2082,71 @@ void __attribute__((optimize("O0"))) handleLinkBusMsgs()
 			}
 			break;
 
+			case MESSAGE_ENERGY:
+			{
+				EnergyStats stats;
+				char statStr[LINKBUS_MAX_MSG_LENGTH - 6];
+				uint16_t mV = batteryMillivolts();
+				uint16_t runtime = ENERGY_RUNTIME_UNKNOWN;
+
+				if(lb_buff->fields[FIELD1][0] == '0')
+				{
+					energy_reset();
+				}
+
+				energy_get_stats(&stats);
+
+				sprintf(statStr, "T,%lu,%lu,%lu,%lu,%lu", stats.sleep_seconds / 60, stats.awake_seconds / 60, stats.wifi_seconds / 60, stats.on_air_seconds / 60, stats.keyed_ticks / (TIMER2_TICKS_PER_SECOND * 60UL));
+				lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_ENERGY_LABEL, statStr);
+
+				if(g_battery_type != BATTERY_EXTERNAL)
+				{
+					runtime = energy_runtime_minutes(mV, g_battery_empty_mV);
+				}
+
+				sprintf(statStr, "B,%u,%d,%u", mV, stats.battery_slope, runtime);
+				lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_ENERGY_LABEL, statStr);
+			}
+			break;
+
+			case MESSAGE_SCHEDULER:
+			{
+				uint8_t highWater, dropped;
+				uint16_t maxIrqOff;
+
+				cli();
+				maxIrqOff = g_sched_max_irq_off_us;
+				sei();
+				sched_get_stats(&highWater, &dropped);
+
+				sprintf(g_tempStr, "%u,%u,%u", maxIrqOff, highWater, dropped);
+				lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_SCHEDULER_LABEL, g_tempStr);
+
+				if(lb_buff->fields[FIELD1][0] == '0')
+				{
+					sched_reset_stats();
+				}
+			}
+			break;
+
+			case MESSAGE_I2C:
+			{
+				uint8_t index = 0;
+				I2CDevice dev;
+
+				while(!i2c_get_device(index++, &dev))
+				{
+					sprintf(g_tempStr, "%02X,%u,%u,%u,%u", dev.slaveAddr, (dev.speed == I2C_SPEED_FAST) ? 400 : (dev.speed == I2C_SPEED_STANDARD) ? 100 : 0, dev.nacks, dev.timeouts, dev.recoveries);
+					lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_I2C_LABEL, g_tempStr);
+				}
+
+				if(lb_buff->fields[FIELD1][0] == '0')
+				{
+					i2c_reset_stats();
+				}
+			}
+			break;
+
 
 			case MESSAGE_BIAS:
 			{
@@ -2224,6 +2209,341 @@ void __attribute__((optimize("O0"))) handleLinkBusMsgs()
 	}
 }
 
+/***********************************************************************
+ * Foreground handler for the 1-second RTC event posted by INT0
+ *
+ * State shared with the TIMER2 ISR (keying, Morse, on-air timing) is
+ * updated inside a single measured critical section.
+ ************************************************************************/
+void handleRTCSecond(void)
+{
+	time_t temp_time;
+	BOOL keyOff = FALSE;
+	BOOL onAir;
+	uint16_t keyedTicks;
+	uint16_t irqOff;
+
+	if(g_update_timeout_seconds)
+	{
+		g_update_timeout_seconds--;
+	}
+
+	time(&temp_time);
+
+	irqOff = sched_cli();
+
+	onAir = g_event_commenced && (g_on_the_air > 0);
+	keyedTicks = g_keyed_ticks;
+	g_keyed_ticks = 0;
+
+	if(g_event_commenced)
+	{
+		if(g_event_finish_time && !g_check_for_next_event && !g_shutting_down_wifi)
+		{
+			if(temp_time >= g_event_finish_time)
+			{
+				g_last_status_code = STATUS_CODE_EVENT_FINISHED;
+				g_on_the_air = 0;
+				keyOff = TRUE;
+				g_event_enabled = FALSE;
+				g_event_commenced = FALSE;
+				g_check_for_next_event = TRUE;
+				g_update_timeout_seconds = 90;
+				if(g_wifi_active)
+				{
+					g_WiFi_shutdown_seconds = 60;
+				}
+			}
+		}
+	}
+
+	if(g_event_enabled)
+	{
+		if(g_event_commenced)
+		{
+			BOOL repeat;
+
+			if(g_sendID_seconds_countdown)
+			{
+				g_sendID_seconds_countdown--;
+			}
+
+			if(g_on_the_air)
+			{
+				if(g_on_the_air > 0)    /* on the air */
+				{
+					g_on_the_air--;
+
+					if(!g_sendID_seconds_countdown && g_time_needed_for_ID)
+					{
+						if(g_on_the_air == g_time_needed_for_ID)    /* wait until the end of a transmission */
+						{
+							g_last_status_code = STATUS_CODE_SENDING_ID;
+							g_sendID_seconds_countdown = g_ID_period_seconds;
+							g_code_throttle = throttleValue(g_id_codespeed);
+							repeat = FALSE;
+							makeMorse(g_messages_text[STATION_ID], &repeat, NULL);  /* Send only once */
+						}
+					}
+
+
+					if(!g_on_the_air)
+					{
+						if(g_off_air_seconds)
+						{
+							keyOff = TRUE;
+							g_on_the_air -= g_off_air_seconds;
+							repeat = TRUE;
+							makeMorse(g_messages_text[PATTERN_TEXT], &repeat, NULL);    /* Reset pattern to start */
+							g_last_status_code = STATUS_CODE_EVENT_STARTED_WAITING_FOR_TIME_SLOT;
+
+
+							/* Enable sleep during off-the-air periods */
+							int32_t timeRemaining = 0;
+							if(temp_time < g_event_finish_time)
+							{
+								timeRemaining = timeDif(g_event_finish_time, temp_time);
+							}
+
+							/* Don't sleep for the last cycle to ensure that the event doesn't end while
+							 * the transmitter is sleeping - which can cause problems with loading the next event */
+							if(timeRemaining > (g_off_air_seconds + g_on_air_seconds + 15))
+							{
+								if((g_off_air_seconds > 15) && !g_WiFi_shutdown_seconds)
+								{
+									g_seconds_to_sleep = (time_t)(g_off_air_seconds - 10);
+									g_sleepType = SLEEP_UNTIL_NEXT_XMSN;
+									g_go_to_sleep = TRUE;
+									g_sendID_seconds_countdown = MAX(0, g_sendID_seconds_countdown - (int)g_seconds_to_sleep);
+								}
+							}
+						}
+						else
+						{
+							g_on_the_air = g_on_air_seconds;
+							g_code_throttle = throttleValue(g_pattern_codespeed);
+						}
+					}
+				}
+				else if(g_on_the_air < 0)   /* off the air - g_on_the_air = 0 means all transmissions are disabled */
+				{
+					g_on_the_air++;
+
+					if(!g_on_the_air)       /* off-the-air time has expired */
+					{
+						g_last_status_code = STATUS_CODE_EVENT_STARTED_NOW_TRANSMITTING;
+						g_on_the_air = g_on_air_seconds;
+						g_code_throttle = throttleValue(g_pattern_codespeed);
+						BOOL repeat = TRUE;
+						makeMorse(g_messages_text[PATTERN_TEXT], &repeat, NULL);
+					}
+				}
+			}
+		}
+		else if(g_event_start_time > 0) /* off the air - waiting for the start time to arrive */
+		{
+			if(temp_time >= g_event_start_time)
+			{
+				if(g_intra_cycle_delay_time)
+				{
+					g_last_status_code = STATUS_CODE_EVENT_STARTED_WAITING_FOR_TIME_SLOT;
+					g_on_the_air = -g_intra_cycle_delay_time;
+					g_sendID_seconds_countdown = g_intra_cycle_delay_time + g_on_air_seconds - g_time_needed_for_ID;
+				}
+				else
+				{
+					g_last_status_code = STATUS_CODE_EVENT_STARTED_NOW_TRANSMITTING;
+					g_on_the_air = g_on_air_seconds;
+					g_sendID_seconds_countdown = g_on_air_seconds - g_time_needed_for_ID;
+					g_code_throttle = throttleValue(g_pattern_codespeed);
+					BOOL repeat = TRUE;
+					makeMorse(g_messages_text[PATTERN_TEXT], &repeat, NULL);
+				}
+
+				g_event_commenced = TRUE;
+			}
+		}
+	}
+
+	sched_sei(irqOff);
+
+	if(keyOff)
+	{
+		keyTransmitter(OFF);
+		txSavePowerCorrections();   /* end of a transmission */
+	}
+
+	energy_add_awake_second(g_wifi_active, onAir, keyedTicks, batteryMillivolts());
+
+	/**************************************
+	 * Delay before re-enabling linkbus receive
+	 ***************************************/
+	if(g_wifi_enable_delay)
+	{
+		g_wifi_enable_delay--;
+
+		if(g_wifi_enable_delay == (LINKBUS_POWERUP_DELAY_SECONDS - 1))
+		{
+			wifi_power(ON);     /* power on WiFi */
+			wifi_reset(OFF);    /* bring WiFi out of reset */
+		}
+		else if(!g_wifi_enable_delay)
+		{
+			linkbus_init(BAUD);
+			g_calibrate_baud = TRUE;
+		}
+	}
+	else
+	{
+		if(!g_update_timeout_seconds || g_shutting_down_wifi || (!g_check_for_next_event && !g_waiting_for_next_event))
+		{
+			if(g_WiFi_shutdown_seconds)
+			{
+				g_WiFi_shutdown_seconds--;
+
+				if(!g_WiFi_shutdown_seconds)
+				{
+					wifi_reset(ON);     /* put WiFi into reset */
+					wifi_power(OFF);    /* power off WiFi */
+					g_shutting_down_wifi = FALSE;
+
+					/* If an event hasn't been enabled by the time that WiFi shuts
+					 *  down, then the transmitter will never run. Just sleep indefinitely
+					 */
+					if(!g_event_enabled)
+					{
+						g_sleepType = SLEEP_FOREVER;
+						g_go_to_sleep = TRUE;
+						g_seconds_to_sleep = MAX_TIME;
+					}
+					else if(g_sleepType == SLEEP_AFTER_WIFI_GOES_OFF)
+					{
+						eventEnabled(); /* Sets sleep time appropriately */
+					}
+
+					g_wifi_active = FALSE;
+				}
+			}
+		}
+
+		if(g_wifi_active)
+		{
+			sprintf(g_tempStr, "%lu", temp_time);
+			lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_CLOCK_LABEL, g_tempStr);
+		}
+	}
+}
+
+/***********************************************************************
+ * Foreground task that sets the RTC and system clock to g_clock_set_epoch
+ *
+ * Scheduled to run at the instant a new reference second begins. Reports
+ * the offset measured before the clock was set.
+ ************************************************************************/
+void setClockAtSecond(void)
+{
+	ds3231_set_epoch(g_clock_set_epoch);
+
+	cli();
+	set_system_time(g_clock_set_epoch);
+	g_ticks_since_rtc_second = 0;
+	sei();
+
+	sprintf(g_tempStr, "O,%ld", g_clock_offset_ms);
+	lb_send_msg(LINKBUS_MSG_REPLY, MESSAGE_CLOCK_LABEL, g_tempStr);
+}
+
+
+/***********************************************************************
+ * Foreground task that debounces antenna connections
+ *
+ * Scheduled whenever an ISR reports a change in antenna connection. It
+ * re-arms itself until the connection state has been confirmed.
+ ************************************************************************/
+void checkAntennaConnection(void)
+{
+	static AntConnType lastAntennaConnectState = ANT_CONNECTION_UNDETERMINED;
+	static uint8_t confirmations = 5;
+
+	if(!g_antenna_connection_changed)
+	{
+		return;
+	}
+
+	if(g_antenna_connect_state == ANT_CONNECTION_UNDETERMINED)
+	{
+		AntConnType connection = ANT_CONNECTION_UNDETERMINED;
+
+		if(g_lastConversionResult[BAND_80M_ANTENNA] < ANTENNA_DETECT_THRESH)
+		{
+			connection = ANT_80M_CONNECTED;
+		}
+
+		if(g_lastConversionResult[BAND_2M_ANTENNA] < ANTENNA_DETECT_THRESH)
+		{
+			if(connection == ANT_80M_CONNECTED)
+			{
+				connection = ANT_2M_AND_80M_CONNECTED;
+			}
+			else
+			{
+				connection = ANT_2M_CONNECTED;
+			}
+		}
+
+		if(lastAntennaConnectState == connection)
+		{
+			if(confirmations)
+			{
+				confirmations--;
+				sched_add_task(checkAntennaConnection, ANTENNA_DETECT_DEBOUNCE);
+			}
+			else
+			{
+				g_antenna_connect_state = connection;
+				g_antenna_connection_changed = FALSE;
+
+				if(connection == ANT_80M_CONNECTED)
+				{
+					g_last_status_code = STATUS_CODE_80M_ANT_ATTACHED;
+					/* Re-enable transmitter power and state if it is currently operating */
+					if(g_event_commenced)
+					{
+						g_hw_tries = 10;            /* give up after too many failures */
+						g_init_hardware = TRUE;
+					}
+				}
+				else if(connection == ANT_2M_CONNECTED)
+				{
+					/*txSetBand(BAND_2M, OFF); */
+					g_last_status_code = STATUS_CODE_2M_ANT_ATTACHED;
+
+					/* TODO: re-enable transmitter power and state if it is currently operating */
+				}
+			}
+		}
+		else
+		{
+			confirmations = 5;
+			sched_add_task(checkAntennaConnection, 1);
+		}
+
+		lastAntennaConnectState = connection;
+	}
+	else if(g_antenna_connect_state == ANT_ALL_DISCONNECTED)
+	{
+		powerToTransmitter(OFF);
+		g_antenna_connection_changed = FALSE;
+		lastAntennaConnectState = ANT_ALL_DISCONNECTED;
+		g_last_status_code = STATUS_CODE_NO_ANT_ATTACHED;
+	}
+	else    /* logic error - this should not occur */
+	{
+		powerToTransmitter(OFF);
+		g_antenna_connection_changed = FALSE;
+	}
+}
+
 BOOL __attribute__((optimize("O0"))) eventEnabled()
 {
 	time_t now;
@@ -2440,102 +2760,68 @@ EC activateEventUsingCurrentSettings(SC* statusCode)
 
 void initializeEEPROMVars()
 {
-	uint8_t i;
-
-	if(eeprom_read_byte(&ee_interface_eeprom_initialization_flag) == EEPROM_INITIALIZED_FLAG)
-	{
-		g_event_start_time = eeprom_read_dword((uint32_t*)(&ee_start_time));
-		g_event_finish_time = eeprom_read_dword((uint32_t*)(&ee_finish_time));
-
-		g_pattern_codespeed = eeprom_read_byte(&ee_pattern_codespeed);
-		g_id_codespeed = eeprom_read_byte(&ee_id_codespeed);
-		g_on_air_seconds = eeprom_read_word(&ee_on_air_time);
-		g_off_air_seconds = eeprom_read_word(&ee_off_air_time);
-		g_intra_cycle_delay_time = eeprom_read_word(&ee_intra_cycle_delay_time);
-		g_ID_period_seconds = eeprom_read_word(&ee_ID_time);
+	uint8_t temp;
+	uint8_t len;
 
-		g_battery_empty_mV = eeprom_read_word(&ee_battery_empty_mV);
+	g_event_start_time = journal_read_dword(JOURNAL_TAG_EVENT_START_TIME, EEPROM_START_TIME_DEFAULT);
+	g_event_finish_time = journal_read_dword(JOURNAL_TAG_EVENT_FINISH_TIME, EEPROM_FINISH_TIME_DEFAULT);
 
-		uint8_t temp = eeprom_read_byte(&ee_clock_OSCCAL);
-		if((temp > 10) && (temp < 240))
-		{
-			OSCCAL = temp;
-			g_OSCCAL_inhibit = TRUE;    /* flag to prevent recalibration */
-		}
+	g_id_codespeed = journal_read_byte(JOURNAL_TAG_ID_CODESPEED, EEPROM_ID_CODE_SPEED_DEFAULT);
+	g_pattern_codespeed = journal_read_byte(JOURNAL_TAG_PATTERN_CODESPEED, EEPROM_PATTERN_CODE_SPEED_DEFAULT);
+	g_on_air_seconds = journal_read_word(JOURNAL_TAG_ON_AIR_TIME, EEPROM_ON_AIR_TIME_DEFAULT);
+	g_off_air_seconds = journal_read_word(JOURNAL_TAG_OFF_AIR_TIME, EEPROM_OFF_AIR_TIME_DEFAULT);
+	g_intra_cycle_delay_time = journal_read_word(JOURNAL_TAG_INTRA_CYCLE_DELAY_TIME, EEPROM_INTRA_CYCLE_DELAY_TIME_DEFAULT);
+	g_ID_period_seconds = journal_read_word(JOURNAL_TAG_ID_TIME, EEPROM_ID_TIME_INTERVAL_DEFAULT);
 
-		for(i = 0; i < 20; i++)
-		{
-			g_messages_text[STATION_ID][i] = (char)eeprom_read_byte((uint8_t*)(&ee_stationID_text[i]));
-			if(!g_messages_text[STATION_ID][i])
-			{
-				break;
-			}
-		}
+	g_battery_empty_mV = journal_read_word(JOURNAL_TAG_BATTERY_EMPTY_MV, EEPROM_BATTERY_EMPTY_MV);
 
-		for(i = 0; i < 20; i++)
-		{
-			g_messages_text[PATTERN_TEXT][i] = (char)eeprom_read_byte((uint8_t*)(&ee_pattern_text[i]));
-			if(!g_messages_text[PATTERN_TEXT][i])
-			{
-				break;
-			}
-		}
-	}
-	else
+	temp = journal_read_byte(JOURNAL_TAG_CLOCK_OSCCAL, 0xFF);
+	if((temp > 10) && (temp < 240))
 	{
-		g_event_start_time = EEPROM_START_TIME_DEFAULT;
-		g_event_finish_time = EEPROM_FINISH_TIME_DEFAULT;
-
-		g_id_codespeed = EEPROM_ID_CODE_SPEED_DEFAULT;
-		g_pattern_codespeed = EEPROM_PATTERN_CODE_SPEED_DEFAULT;
-		g_on_air_seconds = EEPROM_ON_AIR_TIME_DEFAULT;
-		g_off_air_seconds = EEPROM_OFF_AIR_TIME_DEFAULT;
-		g_intra_cycle_delay_time = EEPROM_INTRA_CYCLE_DELAY_TIME_DEFAULT;
-		g_ID_period_seconds = EEPROM_ID_TIME_INTERVAL_DEFAULT;
-
-		g_battery_empty_mV = EEPROM_BATTERY_EMPTY_MV;
-		eeprom_update_byte(&ee_clock_OSCCAL, 0xFF); /* erase any existing value */
+		OSCCAL = temp;
+		g_OSCCAL_inhibit = TRUE;    /* flag to prevent recalibration */
+	}
 
+	/* Text is stored with its terminating null */
+	len = journal_length(JOURNAL_TAG_STATION_ID_TEXT);
+	if((len > MAX_PATTERN_TEXT_LENGTH + 1) || journal_read(JOURNAL_TAG_STATION_ID_TEXT, g_messages_text[STATION_ID], len))
+	{
 		strncpy(g_messages_text[STATION_ID], EEPROM_STATION_ID_DEFAULT, MAX_PATTERN_TEXT_LENGTH);
-		strncpy(g_messages_text[PATTERN_TEXT], EEPROM_PATTERN_TEXT_DEFAULT, MAX_PATTERN_TEXT_LENGTH);
+	}
 
-		saveAllEEPROM();
-		eeprom_write_byte(&ee_interface_eeprom_initialization_flag, EEPROM_INITIALIZED_FLAG);
-		wdt_reset();    /* HW watchdog */
+	len = journal_length(JOURNAL_TAG_PATTERN_TEXT);
+	if((len > MAX_PATTERN_TEXT_LENGTH + 1) || journal_read(JOURNAL_TAG_PATTERN_TEXT, g_messages_text[PATTERN_TEXT], len))
+	{
+		strncpy(g_messages_text[PATTERN_TEXT], EEPROM_PATTERN_TEXT_DEFAULT, MAX_PATTERN_TEXT_LENGTH);
 	}
+
+	g_messages_text[STATION_ID][MAX_PATTERN_TEXT_LENGTH] = '\0';
+	g_messages_text[PATTERN_TEXT][MAX_PATTERN_TEXT_LENGTH] = '\0';
 }
 
+/**
+ * Only settings that have changed since they were last saved are written.
+ */
 void saveAllEEPROM()
 {
-	uint8_t i;
-
 	wdt_reset();    /* HW watchdog */
 
-	eeprom_update_dword((uint32_t*)&ee_start_time, g_event_start_time);
-	eeprom_update_dword((uint32_t*)&ee_finish_time, g_event_finish_time);
-
-	eeprom_update_byte(&ee_id_codespeed, g_id_codespeed);
-	eeprom_update_byte(&ee_pattern_codespeed, g_pattern_codespeed);
-	eeprom_update_word(&ee_on_air_time, g_on_air_seconds);
-	eeprom_update_word(&ee_off_air_time, g_off_air_seconds);
-	eeprom_update_word(&ee_intra_cycle_delay_time, g_intra_cycle_delay_time);
-	eeprom_update_word(&ee_ID_time, g_ID_period_seconds);
+	journal_write_dword(JOURNAL_TAG_EVENT_START_TIME, g_event_start_time);
+	journal_write_dword(JOURNAL_TAG_EVENT_FINISH_TIME, g_event_finish_time);
 
-	eeprom_update_word(&ee_battery_empty_mV, g_battery_empty_mV);
+	journal_write_byte(JOURNAL_TAG_ID_CODESPEED, g_id_codespeed);
+	journal_write_byte(JOURNAL_TAG_PATTERN_CODESPEED, g_pattern_codespeed);
+	journal_write_word(JOURNAL_TAG_ON_AIR_TIME, g_on_air_seconds);
+	journal_write_word(JOURNAL_TAG_OFF_AIR_TIME, g_off_air_seconds);
+	journal_write_word(JOURNAL_TAG_INTRA_CYCLE_DELAY_TIME, g_intra_cycle_delay_time);
+	journal_write_word(JOURNAL_TAG_ID_TIME, g_ID_period_seconds);
 
-	for(i = 0; i < strlen(g_messages_text[STATION_ID]); i++)
-	{
-		eeprom_update_byte((uint8_t*)&ee_stationID_text[i], (uint8_t)g_messages_text[STATION_ID][i]);
-	}
+	journal_write_word(JOURNAL_TAG_BATTERY_EMPTY_MV, g_battery_empty_mV);
 
-	eeprom_update_byte((uint8_t*)&ee_stationID_text[i], 0);
+	journal_write(JOURNAL_TAG_STATION_ID_TEXT, g_messages_text[STATION_ID], strlen(g_messages_text[STATION_ID]) + 1);
+	journal_write(JOURNAL_TAG_PATTERN_TEXT, g_messages_text[PATTERN_TEXT], strlen(g_messages_text[PATTERN_TEXT]) + 1);
 
-	for(i = 0; i < strlen(g_messages_text[PATTERN_TEXT]); i++)
-	{
-		eeprom_update_byte((uint8_t*)&ee_pattern_text[i], (uint8_t)g_messages_text[PATTERN_TEXT][i]);
-	}
-
-	eeprom_update_byte((uint8_t*)&ee_pattern_text[i], 0);
+	energy_save();
 }
 
 uint16_t throttleValue(uint8_t speed)
@@ -2547,6 +2833,51 @@ uint16_t throttleValue(uint8_t speed)
 	return( temp);
 }
 
+/**
+ * Returns the battery voltage in mV, or 0 if no measurement is yet available
+ */
+uint16_t batteryMillivolts(void)
+{
+	if(!g_battery_measurements_active)
+	{
+		return( 0);
+	}
+
+	if(g_lastConversionResult[BATTERY_READING] > VOLTS_3_0)
+	{
+		return( (uint16_t)VBAT(g_lastConversionResult[BATTERY_READING]));
+	}
+
+	return( (uint16_t)VEXT(g_lastConversionResult[V12V_VOLTAGE_READING]));
+}
+
+/**
+ * Selects the first entry at or after index that is due on this pass of the ADC sequence,
+ * and starts its first conversion. Ends the pass if no entry remains. Called from ISRs only.
+ */
+void adcStartSequenceEntry(uint8_t index)
+{
+	while(index < NUMBER_OF_POLLED_ADC_CHANNELS)
+	{
+		const ADCSequenceEntry* entry = &g_adcSequence[index];
+
+		if(!(g_adcSequencePass & (entry->passDivider - 1)))
+		{
+			g_adcSequenceIndex = index;
+			g_adcConversionsLeft = (1 << (entry->oversample << 1)) + 1;
+			g_adcSampleSum = 0;
+			ADMUX = (ADMUX & 0xF0) | entry->mux;
+			ADCSRA |= (1 << ADSC);
+			return;
+		}
+
+		index++;
+	}
+
+	g_adcSequencePass++;
+	g_adcSequenceInProcess = FALSE;
+}
+
 BOOL antennaIsConnected(void)
 {
 	return( !(PIND & (1 << PORTD3)));
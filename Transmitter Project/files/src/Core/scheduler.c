@@ -0,0 +1,247 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * scheduler.c
+ *
+ */
+
+#include "scheduler.h"
+#include <stddef.h>
+#include <util/atomic.h>
+
+typedef struct
+{
+	SchedTask task;
+	uint16_t deadline;
+} SchedTaskEntry;
+
+volatile uint16_t g_sched_max_irq_off_us = 0;
+
+static volatile uint8_t g_event_queue[SCHED_EVENT_QUEUE_SIZE];
+static volatile uint8_t g_event_head = 0;   /* next slot to be written */
+static volatile uint8_t g_event_tail = 0;   /* next slot to be read */
+static volatile uint8_t g_event_high_water = 0;
+static volatile uint8_t g_events_dropped = 0;
+
+static SchedTaskEntry g_tasks[SCHED_MAX_TASKS];
+static volatile uint16_t g_sched_ticks = 0;
+
+void sched_init(void)
+{
+	uint8_t i;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		g_event_head = 0;
+		g_event_tail = 0;
+	}
+
+	for(i = 0; i < SCHED_MAX_TASKS; i++)
+	{
+		g_tasks[i].task = NULL;
+	}
+
+	sched_reset_stats();
+}
+
+BOOL sched_post_event(SchedEvent event)
+{
+	BOOL failure = FALSE;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint8_t count = (uint8_t)(g_event_head - g_event_tail);
+
+		if(count >= SCHED_EVENT_QUEUE_SIZE)
+		{
+			if(g_events_dropped < UINT8_MAX)
+			{
+				g_events_dropped++;
+			}
+
+			failure = TRUE;
+		}
+		else
+		{
+			g_event_queue[g_event_head & (SCHED_EVENT_QUEUE_SIZE - 1)] = (uint8_t)event;
+			g_event_head++;
+			count++;
+
+			if(count > g_event_high_water)
+			{
+				g_event_high_water = count;
+			}
+		}
+	}
+
+	return( failure);
+}
+
+SchedEvent sched_next_event(void)
+{
+	SchedEvent event = SCHED_EVENT_NONE;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(g_event_head != g_event_tail)
+		{
+			event = (SchedEvent)g_event_queue[g_event_tail & (SCHED_EVENT_QUEUE_SIZE - 1)];
+			g_event_tail++;
+		}
+	}
+
+	return( event);
+}
+
+BOOL sched_add_task(SchedTask task, uint16_t delay_ticks)
+{
+	uint8_t i;
+	int8_t slot = -1;
+	uint16_t now;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = g_sched_ticks;
+	}
+
+	for(i = 0; i < SCHED_MAX_TASKS; i++)
+	{
+		if(g_tasks[i].task == task)
+		{
+			slot = (int8_t)i;
+			break;
+		}
+		else if((slot < 0) && !g_tasks[i].task)
+		{
+			slot = (int8_t)i;
+		}
+	}
+
+	if(slot < 0)
+	{
+		return( TRUE);
+	}
+
+	g_tasks[slot].deadline = now + delay_ticks;
+	g_tasks[slot].task = task;
+
+	return( FALSE);
+}
+
+void sched_cancel_task(SchedTask task)
+{
+	uint8_t i;
+
+	for(i = 0; i < SCHED_MAX_TASKS; i++)
+	{
+		if(g_tasks[i].task == task)
+		{
+			g_tasks[i].task = NULL;
+		}
+	}
+}
+
+void sched_run_due_tasks(void)
+{
+	BOOL done = FALSE;
+
+	while(!done)
+	{
+		uint8_t i;
+		int8_t due = -1;
+		int16_t mostLate = -1;
+		uint16_t now;
+
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			now = g_sched_ticks;
+		}
+
+		for(i = 0; i < SCHED_MAX_TASKS; i++)
+		{
+			if(g_tasks[i].task)
+			{
+				int16_t late = (int16_t)(now - g_tasks[i].deadline);   /* wrap-safe */
+
+				if(late > mostLate)
+				{
+					mostLate = late;
+					due = (int8_t)i;
+				}
+			}
+		}
+
+		if(due < 0)
+		{
+			done = TRUE;
+		}
+		else
+		{
+			SchedTask task = g_tasks[due].task;
+			g_tasks[due].task = NULL;   /* the task may re-arm itself */
+			(*task)();
+		}
+	}
+}
+
+void sched_tick(void)
+{
+	g_sched_ticks++;
+}
+
+void sched_idle(void)
+{
+	cli();
+
+	if(g_event_head == g_event_tail)
+	{
+		SMCR = (1 << SE);   /* idle mode: timers, UART and TWI keep running */
+		sei();
+		asm ("sleep");      /* the instruction following sei() always executes before a pending interrupt */
+		SMCR = 0x00;
+	}
+
+	sei();
+}
+
+void sched_get_stats(uint8_t* queueHighWater, uint8_t* dropped)
+{
+	if(queueHighWater)
+	{
+		*queueHighWater = g_event_high_water;
+	}
+
+	if(dropped)
+	{
+		*dropped = g_events_dropped;
+	}
+}
+
+void sched_reset_stats(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		g_sched_max_irq_off_us = 0;
+		g_event_high_water = 0;
+		g_events_dropped = 0;
+	}
+}
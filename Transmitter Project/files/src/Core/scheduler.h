@@ -0,0 +1,138 @@
+/**********************************************************************************************
+ * Copyright  2017 Digital Confections LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in the
+ * Software without restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the
+ * following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **********************************************************************************************
+ *
+ * scheduler.h
+ *
+ * A tiny cooperative scheduler for the foreground. ISRs post events into a bounded
+ * queue; foreground tasks are run when their tick deadlines expire. Between events
+ * the CPU is put into idle sleep.
+ *
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "defs.h"
+
+#define SCHED_EVENT_QUEUE_SIZE 16   /* must be a power of two */
+#define SCHED_MAX_TASKS 4
+
+/* TIMER1 free-runs at F_CPU/8 so one count = 1 us at 8 MHz */
+#define SCHED_TIMER1_PRESCALE (1 << CS11)
+
+typedef enum
+{
+	SCHED_EVENT_NONE = 0,
+	SCHED_EVENT_RTC_SECOND,         /* 1-second RTC interrupt arrived while awake */
+	SCHED_EVENT_ANTENNA_CHANGED,    /* antenna connection state changed */
+	SCHED_EVENT_PA_VOLTAGE          /* new PA drain voltage reading */
+} SchedEvent;
+
+typedef void (*SchedTask)(void);
+
+extern volatile uint16_t g_sched_max_irq_off_us;
+
+/**
+ * Clears the event queue and task list.
+ */
+void sched_init(void);
+
+/**
+ * Places an event in the queue. Safe to call from ISRs and from the foreground.
+ * Returns TRUE if the queue was full and the event was dropped.
+ */
+BOOL sched_post_event(SchedEvent event);
+
+/**
+ * Removes and returns the oldest queued event, or SCHED_EVENT_NONE.
+ */
+SchedEvent sched_next_event(void);
+
+/**
+ * Arranges for task to run once, delay_ticks TIMER2 ticks from now. A task that is
+ * already pending is re-armed with the new deadline. Foreground only.
+ * Returns TRUE if the task list is full.
+ */
+BOOL sched_add_task(SchedTask task, uint16_t delay_ticks);
+
+/**
+ * Removes task from the task list, if present.
+ */
+void sched_cancel_task(SchedTask task);
+
+/**
+ * Runs all tasks whose deadlines have expired, earliest deadline first.
+ */
+void sched_run_due_tasks(void);
+
+/**
+ * Advances the scheduler clock. Call once per TIMER2 interrupt.
+ */
+void sched_tick(void);
+
+/**
+ * Enters idle sleep unless an event is already waiting. Any interrupt wakes the CPU.
+ */
+void sched_idle(void);
+
+/**
+ * Returns the event queue high-water mark and number of dropped events since the last reset.
+ */
+void sched_get_stats(uint8_t* queueHighWater, uint8_t* dropped);
+
+/**
+ * Clears all statistics, including the longest interrupts-disabled window.
+ */
+void sched_reset_stats(void);
+
+/**
+ * Disables interrupts and returns a timestamp for sched_sei().
+ */
+static inline uint16_t sched_cli(void)
+{
+	cli();
+	return( TCNT1);
+}
+
+/**
+ * Records the length of the interrupts-disabled window begun at start. Use at the end of ISRs.
+ */
+static inline void sched_irq_off_end(uint16_t start)
+{
+	uint16_t dif = TCNT1 - start;
+
+	if(dif > g_sched_max_irq_off_us)
+	{
+		g_sched_max_irq_off_us = dif;
+	}
+}
+
+/**
+ * Ends a critical section begun with sched_cli() and re-enables interrupts.
+ */
+static inline void sched_sei(uint16_t start)
+{
+	sched_irq_off_end(start);
+	sei();
+}
+
+#endif  /* SCHEDULER_H_ */
@@ -26,8 +26,12 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <avr/pgmspace.h>
 #include "transmitter.h"
 #include "i2c.h"    /* DAC on 80m VGA of Rev X1 Receiver board */
+#include "fm.h"
+#include "journal.h"
+#include "legacy.h"
 
 #ifdef INCLUDE_TRANSMITTER_SUPPORT
 
@@ -58,25 +62,27 @@
 /* EEPROM Defines */
 #define EEPROM_BAND_DEFAULT BAND_80M
 
-	static BOOL EEMEM ee_eeprom_initialization_flag = EEPROM_INITIALIZED_FLAG;
-	static int32_t EEMEM ee_si5351_ref_correction = EEPROM_SI5351_CALIBRATION_DEFAULT;
-
-	static uint8_t EEMEM ee_active_band = EEPROM_BAND_DEFAULT;
-	static uint32_t EEMEM ee_active_2m_frequency = DEFAULT_TX_2M_FREQUENCY;
-	static uint16_t EEMEM ee_2m_power_level_mW = DEFAULT_TX_2M_POWER_MW;
-	static uint32_t EEMEM ee_active_80m_frequency = DEFAULT_TX_80M_FREQUENCY;
-	static uint16_t EEMEM ee_80m_power_level_mW = DEFAULT_TX_80M_POWER_MW;
-	static uint32_t EEMEM ee_cw_offset_frequency = DEFAULT_RTTY_OFFSET_FREQUENCY;
-	static uint8_t EEMEM ee_am_drive_level_high = DEFAULT_AM_DRIVE_LEVEL_HIGH;
-	static uint8_t EEMEM ee_am_drive_level_low = DEFAULT_AM_DRIVE_LEVEL_LOW;
-/*	static uint8_t EEMEM ee_cw_drive_level = DEFAULT_CW_DRIVE_LEVEL; */
-	static uint8_t EEMEM ee_active_2m_modulation = DEFAULT_TX_2M_MODULATION;
-	static uint8_t EEMEM ee_80m_power_table[16] = DEFAULT_80M_POWER_TABLE;
-	static uint8_t EEMEM ee_2m_am_power_table[16] = DEFAULT_2M_AM_POWER_TABLE;
-	static uint8_t EEMEM ee_2m_am_drive_low_table[16] = DEFAULT_2M_AM_DRIVE_LOW_TABLE;
-	static uint8_t EEMEM ee_2m_am_drive_high_table[16] = DEFAULT_2M_AM_DRIVE_HIGH_TABLE;
-	static uint8_t EEMEM ee_2m_cw_power_table[16] = DEFAULT_2M_CW_POWER_TABLE;
-	static uint8_t EEMEM ee_2m_cw_drive_table[16] = DEFAULT_2M_CW_DRIVE_TABLE;
+/* Settings are kept in the journal. The power tables are still where the firmware that
+ * predates it kept them (see legacy.h). */
+
+	typedef enum
+	{
+		POWER_CURVE_80M,
+		POWER_CURVE_2M_AM,
+		POWER_CURVE_2M_CW,
+		POWER_CURVE_NONE
+	} PowerCurve;
+
+	static const uint16_t g_power_cal_mW[POWER_CALIBRATION_POINTS] PROGMEM = POWER_CALIBRATION_MW;
+	static PowerCalPoint g_power_cal[POWER_CALIBRATION_POINTS];
+	static uint8_t g_power_cal_count = 0;
+	static PowerCurve g_power_cal_curve = POWER_CURVE_NONE;
+	static uint16_t g_power_cal_max_mW = 0;
+
+	static uint8_t g_pa_nominal_drive = 0;                      /* DAC setting from the calibration points */
+	static uint8_t g_pa_drive = 0;                              /* DAC setting in use */
+	static int8_t g_pa_correction[RADIO_NUMBER_OF_BANDS] = { 0, 0 };   /* DAC steps, indexed by RadioBand */
+	static BOOL g_pa_saturated[RADIO_NUMBER_OF_BANDS] = { FALSE, FALSE };  /* a DAC increase gave no drain voltage rise */
 
 /*
  *       Local Function Prototypes
@@ -90,6 +96,29 @@
 	 */
 	void txSet2mModulationGlobals(uint8_t *high, uint8_t *low);
 
+	/**
+	 */
+	static PowerCurve activePowerCurve(void);
+
+	/**
+	 * Returns the maximum power for curve with the battery type in use.
+	 */
+	static uint16_t maxPowerMW(PowerCurve curve);
+
+	/**
+	 * Returns the EEPROM table holding setting for curve, or NULL if curve does not use it.
+	 */
+	static uint8_t* powerCalTable(PowerCurve curve, PowerCalSetting setting);
+
+	/**
+	 */
+	static uint8_t interpolate(uint8_t y0, uint8_t y1, uint16_t x, uint16_t span);
+
+	/**
+	 * Returns the nominal DAC setting with the active band's learned correction applied.
+	 */
+	static uint8_t correctedDrive(uint8_t nominal);
+
 	/**
 	 */
 /*	EC tx2mBiasStateMachine(BiasStateMachineCommand* smCommand); */
@@ -123,8 +152,14 @@
 		{
 			if(bandSet == BAND_2M)
 			{
+				fm_stop();  /* the samples must not race the retune, and leave the shadow matching the device */
 				si5351_set_freq(*freq, TX_CLOCK_VHF, leaveClockOff);
-				si5351_set_freq(*freq + 10000, TX_CLOCK_VHF_FM, leaveClockOff);
+				fm_prepare(*freq, TX_CLOCK_VHF, FM_DEFAULT_DEVIATION_HZ);
+
+				if(g_transmitter_keyed && (g_2m_modulationFormat == MODE_FM))
+				{
+					fm_start();
+				}
 			}
 			else
 			{
@@ -237,7 +272,11 @@
 				else
 				{
 					si5351_clock_enable(TX_CLOCK_VHF, SI5351_CLK_ENABLED);
-					si5351_clock_enable(TX_CLOCK_VHF_FM, SI5351_CLK_ENABLED);
+
+					if(g_2m_modulationFormat == MODE_FM)
+					{
+						fm_start();
+					}
 				}
 
 				g_transmitter_keyed = TRUE;
@@ -251,8 +290,8 @@
 			}
 			else
 			{
+				fm_stop();
 				si5351_clock_enable(TX_CLOCK_VHF, SI5351_CLK_DISABLED);
-				si5351_clock_enable(TX_CLOCK_VHF_FM, SI5351_CLK_DISABLED);
 			}
 
 			g_transmitter_keyed = FALSE;
@@ -314,6 +353,18 @@
 				modulation = *modulationType;
 				g_2m_modulationFormat = modulation;
 
+				if(g_transmitter_keyed)
+				{
+					if(modulation == MODE_FM)
+					{
+						fm_start();
+					}
+					else
+					{
+						fm_stop();
+					}
+				}
+
 				if(power_mW == NULL)
 				{
 					power = g_2m_power_level_mW;
@@ -337,6 +388,10 @@
 				code = txMilliwattsToSettings(&power, &drainVoltageDAC, &modLevelHigh, &modLevelLow);
 				err = (code == ERROR_CODE_SW_LOGIC_ERROR);
 
+				g_pa_nominal_drive = drainVoltageDAC;
+				drainVoltageDAC = correctedDrive(drainVoltageDAC);
+				g_pa_drive = drainVoltageDAC;
+
 				g_tx_power_is_zero = (power == 0);
 
 				if(!err)
@@ -441,6 +496,132 @@
 	}
 
 
+	static uint8_t correctedDrive(uint8_t nominal)
+	{
+		int16_t drive;
+
+		if(!nominal || (g_activeBand >= BAND_INVALID))
+		{
+			return( nominal);   /* the PA stays off */
+		}
+
+		drive = (int16_t)nominal + g_pa_correction[g_activeBand];
+
+		return( (uint8_t)CLAMP(1, drive, (g_activeBand == BAND_80M) ? MAX_80M_PWR_SETTING : MAX_2M_PWR_SETTING));
+	}
+
+	/**
+	 * The correction learned on each band carries over to later power settings and, once saved,
+	 * to later events, so that the loop starts near where it last settled.
+	 *
+	 * Anti-windup: once the drive is clamped, or a DAC increase does not raise the drain voltage
+	 * (the buck converter has run out of headroom on a low battery), further increases would only
+	 * wind up the correction. The step is taken back and the band is marked saturated, which
+	 * stops increases until the voltage is back within the deadband or the transmission ends.
+	 */
+	void txRegulatePower(uint16_t pa_mV)
+	{
+		static uint8_t readings = 0;
+		static uint16_t raised_from_mV = 0; /* drain voltage before the last DAC increase; zero once checked */
+		uint16_t target_mV;
+		uint8_t drive;
+		int8_t* correction;
+		int8_t step;
+		BOOL noRise;
+
+		if(!g_transmitter_keyed || !g_pa_nominal_drive || (g_activeBand >= BAND_INVALID))
+		{
+			readings = 0;
+			raised_from_mV = 0;
+			return;
+		}
+
+		if(++readings < PA_REGULATION_READINGS)
+		{
+			return;
+		}
+
+		readings = 0;
+		correction = &g_pa_correction[g_activeBand];
+		target_mV = PA_MV_FOR_DRIVE(g_pa_nominal_drive);
+		noRise = raised_from_mV && (pa_mV < raised_from_mV + PA_MIN_RISE_PER_STEP_MV);
+		raised_from_mV = 0;
+
+		if(noRise)
+		{
+			g_pa_saturated[g_activeBand] = TRUE;
+			step = -1;  /* take back the increase that had no effect */
+		}
+		else if(pa_mV + PA_REGULATION_DEADBAND_MV < target_mV)
+		{
+			if(g_pa_saturated[g_activeBand] || (*correction >= PA_MAX_CORRECTION))
+			{
+				return;
+			}
+
+			step = 1;
+		}
+		else if(pa_mV > target_mV + PA_REGULATION_DEADBAND_MV)
+		{
+			if(*correction <= -PA_MAX_CORRECTION)
+			{
+				return;
+			}
+
+			step = -1;
+		}
+		else
+		{
+			g_pa_saturated[g_activeBand] = FALSE;
+			return;
+		}
+
+		*correction += step;
+		drive = correctedDrive(g_pa_nominal_drive);
+
+		if(drive == g_pa_drive)
+		{
+			*correction -= step;    /* the drive is clamped */
+
+			if(step > 0)
+			{
+				g_pa_saturated[g_activeBand] = TRUE;
+			}
+
+			return;
+		}
+
+		if(dac081c_set_dac(drive, PA_DAC))
+		{
+			*correction -= step;    /* the DAC did not respond: nothing changed */
+			return;
+		}
+
+		if(step > 0)
+		{
+			raised_from_mV = pa_mV;
+		}
+
+		g_pa_drive = drive;
+	}
+
+	void txSavePowerCorrections(void)
+	{
+		/* A correction reached while saturated reflects the battery, not the PA: keep the last good one */
+		if(!g_pa_saturated[BAND_2M])
+		{
+			journal_write_byte(JOURNAL_TAG_2M_PA_CORRECTION, (uint8_t)g_pa_correction[BAND_2M]);
+		}
+
+		if(!g_pa_saturated[BAND_80M])
+		{
+			journal_write_byte(JOURNAL_TAG_80M_PA_CORRECTION, (uint8_t)g_pa_correction[BAND_80M]);
+		}
+
+		g_pa_saturated[BAND_2M] = FALSE;   /* the next transmission may try again */
+		g_pa_saturated[BAND_80M] = FALSE;
+	}
+
 	Modulation txGetModulation(void)
 	{
 		if(g_activeBand == BAND_2M)
@@ -489,11 +670,7 @@
 			return( code);
 		}
 
-		if((code = si5351_drive_strength(TX_CLOCK_VHF_FM, SI5351_DRIVE_8MA)))
-		{
-			return( code);
-		}
-		if((code = si5351_clock_enable(TX_CLOCK_VHF_FM, SI5351_CLK_DISABLED)))
+		if((code = si5351_clock_enable(TX_CLOCK_VHF_FM, SI5351_CLK_DISABLED)))  /* unused: FM modulates TX_CLOCK_VHF */
 		{
 			return( code);
 		}
@@ -522,64 +699,50 @@
 
 	void initializeTransmitterEEPROMVars(void)
 	{
-		if(eeprom_read_byte(&ee_eeprom_initialization_flag) == EEPROM_INITIALIZED_FLAG)
+		g_activeBand = journal_read_byte(JOURNAL_TAG_ACTIVE_BAND, EEPROM_BAND_DEFAULT);
+		g_2m_frequency = journal_read_dword(JOURNAL_TAG_2M_FREQUENCY, DEFAULT_TX_2M_FREQUENCY);
+		g_2m_power_level_mW = journal_read_word(JOURNAL_TAG_2M_POWER_LEVEL_MW, DEFAULT_TX_2M_POWER_MW);
+		g_80m_frequency = journal_read_dword(JOURNAL_TAG_80M_FREQUENCY, DEFAULT_TX_80M_FREQUENCY);
+		g_80m_power_level_mW = journal_read_word(JOURNAL_TAG_80M_POWER_LEVEL_MW, DEFAULT_TX_80M_POWER_MW);
+		g_rtty_offset = journal_read_dword(JOURNAL_TAG_RTTY_OFFSET_FREQUENCY, DEFAULT_RTTY_OFFSET_FREQUENCY);
+		g_am_drive_level_high = journal_read_byte(JOURNAL_TAG_AM_DRIVE_LEVEL_HIGH, DEFAULT_AM_DRIVE_LEVEL_HIGH);
+		g_am_drive_level_low = journal_read_byte(JOURNAL_TAG_AM_DRIVE_LEVEL_LOW, DEFAULT_AM_DRIVE_LEVEL_LOW);
+/*		g_cw_drive_level = DEFAULT_CW_DRIVE_LEVEL; */
+		g_2m_modulationFormat = journal_read_byte(JOURNAL_TAG_2M_MODULATION, DEFAULT_TX_2M_MODULATION);
+		g_pa_correction[BAND_2M] = CLAMP(-PA_MAX_CORRECTION, (int8_t)journal_read_byte(JOURNAL_TAG_2M_PA_CORRECTION, 0), PA_MAX_CORRECTION);
+		g_pa_correction[BAND_80M] = CLAMP(-PA_MAX_CORRECTION, (int8_t)journal_read_byte(JOURNAL_TAG_80M_PA_CORRECTION, 0), PA_MAX_CORRECTION);
+
+		/* The power tables are written once, not with every save */
+		if(eeprom_read_byte(LEGACY2_TRANSMITTER_FLAG) != LEGACY2_INITIALIZED_FLAG)
 		{
-			g_activeBand = eeprom_read_byte(&ee_active_band);
-			g_2m_frequency = eeprom_read_dword(&ee_active_2m_frequency);
-			g_2m_power_level_mW = eeprom_read_word(&ee_2m_power_level_mW);
-			g_80m_frequency = eeprom_read_dword(&ee_active_80m_frequency);
-			g_80m_power_level_mW = eeprom_read_word(&ee_80m_power_level_mW);
-			g_rtty_offset = eeprom_read_dword(&ee_cw_offset_frequency);
-			g_am_drive_level_high = eeprom_read_byte(&ee_am_drive_level_high);
-			g_am_drive_level_low = eeprom_read_byte(&ee_am_drive_level_low);
-			g_2m_modulationFormat = eeprom_read_byte(&ee_active_2m_modulation);
+			eeprom_update_block(DEFAULT_80M_POWER_TABLE, LEGACY2_80M_POWER_TABLE, LEGACY2_POWER_TABLE_LENGTH);
+			eeprom_update_block(DEFAULT_2M_AM_POWER_TABLE, LEGACY2_2M_AM_POWER_TABLE, LEGACY2_POWER_TABLE_LENGTH);
+			eeprom_update_block(DEFAULT_2M_AM_DRIVE_HIGH_TABLE, LEGACY2_2M_AM_DRIVE_HIGH_TABLE, LEGACY2_POWER_TABLE_LENGTH);
+			eeprom_update_block(DEFAULT_2M_AM_DRIVE_LOW_TABLE, LEGACY2_2M_AM_DRIVE_LOW_TABLE, LEGACY2_POWER_TABLE_LENGTH);
+			eeprom_update_block(DEFAULT_2M_CW_POWER_TABLE, LEGACY2_2M_CW_POWER_TABLE, LEGACY2_POWER_TABLE_LENGTH);
+			eeprom_update_block(DEFAULT_2M_CW_DRIVE_TABLE, LEGACY2_2M_CW_DRIVE_TABLE, LEGACY2_POWER_TABLE_LENGTH);
+			eeprom_write_byte(LEGACY2_TRANSMITTER_FLAG, LEGACY2_INITIALIZED_FLAG);
 		}
-		else
-		{
-			eeprom_write_byte(&ee_eeprom_initialization_flag, EEPROM_INITIALIZED_FLAG);
 
-			g_activeBand = EEPROM_BAND_DEFAULT;
-			g_2m_frequency = DEFAULT_TX_2M_FREQUENCY;
-			g_2m_power_level_mW = DEFAULT_TX_2M_POWER_MW;
-			g_80m_frequency = DEFAULT_TX_80M_FREQUENCY;
-			g_80m_power_level_mW = DEFAULT_TX_80M_POWER_MW;
-			g_rtty_offset = DEFAULT_RTTY_OFFSET_FREQUENCY;
-			g_am_drive_level_high = DEFAULT_AM_DRIVE_LEVEL_HIGH;
-			g_am_drive_level_low = DEFAULT_AM_DRIVE_LEVEL_LOW;
-/*			g_cw_drive_level = DEFAULT_CW_DRIVE_LEVEL; */
-			g_2m_modulationFormat = DEFAULT_TX_2M_MODULATION;
-
-			saveAllTransmitterEEPROM();
-		}
+		txLoadPowerCalibration();
 	}
 
+	/**
+	 * Only settings that have changed since they were last saved are written.
+	 */
 	void saveAllTransmitterEEPROM(void)
 	{
-		uint8_t table[22];
-
-		eeprom_update_byte(&ee_active_band, g_activeBand);
-		eeprom_update_dword((uint32_t*)&ee_active_2m_frequency, g_2m_frequency);
-		eeprom_update_word(&ee_2m_power_level_mW, g_2m_power_level_mW);
-		eeprom_update_dword((uint32_t*)&ee_active_80m_frequency, g_80m_frequency);
-		eeprom_update_word(&ee_80m_power_level_mW, g_80m_power_level_mW);
-		eeprom_update_dword((uint32_t*)&ee_cw_offset_frequency, g_rtty_offset);
-		eeprom_update_dword((uint32_t*)&ee_si5351_ref_correction, si5351_get_correction());
-		eeprom_update_byte(&ee_am_drive_level_high, g_am_drive_level_high);
-		eeprom_update_byte(&ee_am_drive_level_high, g_am_drive_level_low);
-/*		eeprom_update_byte(&ee_cw_drive_level, g_cw_drive_level); */
-		eeprom_update_byte(&ee_active_2m_modulation, g_2m_modulationFormat);
-		memcpy(table, DEFAULT_80M_POWER_TABLE, sizeof(table));
-		eeprom_write_block(table, ee_80m_power_table, sizeof(table));
-		memcpy(table, DEFAULT_2M_AM_POWER_TABLE, sizeof(table));
-		eeprom_write_block(table, ee_2m_am_power_table, sizeof(table));
-		memcpy(table, DEFAULT_2M_AM_DRIVE_HIGH_TABLE, sizeof(table));
-		eeprom_write_block(table, ee_2m_am_drive_high_table, sizeof(table));
-		memcpy(table, DEFAULT_2M_AM_DRIVE_LOW_TABLE, sizeof(table));
-		eeprom_write_block(table, ee_2m_am_drive_low_table, sizeof(table));
-		memcpy(table, DEFAULT_2M_CW_POWER_TABLE, sizeof(table));
-		eeprom_write_block(table, ee_2m_cw_power_table, sizeof(table));
-		memcpy(table, DEFAULT_2M_CW_DRIVE_TABLE, sizeof(table));
-		eeprom_write_block(table, ee_2m_cw_drive_table, sizeof(table));
+		journal_write_byte(JOURNAL_TAG_ACTIVE_BAND, g_activeBand);
+		journal_write_dword(JOURNAL_TAG_2M_FREQUENCY, g_2m_frequency);
+		journal_write_word(JOURNAL_TAG_2M_POWER_LEVEL_MW, g_2m_power_level_mW);
+		journal_write_dword(JOURNAL_TAG_80M_FREQUENCY, g_80m_frequency);
+		journal_write_word(JOURNAL_TAG_80M_POWER_LEVEL_MW, g_80m_power_level_mW);
+		journal_write_dword(JOURNAL_TAG_RTTY_OFFSET_FREQUENCY, g_rtty_offset);
+		journal_write_dword(JOURNAL_TAG_SI5351_REF_CORRECTION, si5351_get_correction());
+		journal_write_byte(JOURNAL_TAG_AM_DRIVE_LEVEL_HIGH, g_am_drive_level_high);
+		journal_write_byte(JOURNAL_TAG_AM_DRIVE_LEVEL_LOW, g_am_drive_level_low);
+		journal_write_byte(JOURNAL_TAG_2M_MODULATION, g_2m_modulationFormat);
+		txSavePowerCorrections();
 	}
 
 
@@ -601,152 +764,221 @@ RadioBand bandForFrequency(Frequency_Hz freq)
 	return(result);
 }
 
-EC txMilliwattsToSettings(uint16_t* powerMW, uint8_t* driveLevel, uint8_t* modLevelHigh, uint8_t* modLevelLow)
+static PowerCurve activePowerCurve(void)
 {
-	EC ec = ERROR_CODE_NO_ERROR;
-	RadioBand band = txGetBand();
-	int16_t maxPwr;
-	uint8_t index;
+	if(txGetBand() == BAND_80M)
+	{
+		return( POWER_CURVE_80M);
+	}
 
-	if(powerMW == NULL)
+	if(g_2m_modulationFormat == MODE_AM)
 	{
-		return(ERROR_CODE_SW_LOGIC_ERROR);
+		return( POWER_CURVE_2M_AM);
+	}
+
+	return( POWER_CURVE_2M_CW);
+}
+
+static uint16_t maxPowerMW(PowerCurve curve)
+{
+	if(curve == POWER_CURVE_80M)
+	{
+		return( (g_battery_type == BATTERY_4r2V) ? MAX_TX_POWER_80M_4r2V_MW : MAX_TX_POWER_80M_MW);
 	}
 
-	if(band == BAND_80M)
+	return( (g_battery_type == BATTERY_4r2V) ? MAX_TX_POWER_2M_4r2V_MW : MAX_TX_POWER_2M_MW);
+}
+
+static uint8_t* powerCalTable(PowerCurve curve, PowerCalSetting setting)
+{
+	switch(curve)
 	{
-		if(g_battery_type == BATTERY_4r2V)
+		case POWER_CURVE_80M:
 		{
-			maxPwr = MAX_TX_POWER_80M_4r2V_MW;
+			return( (setting == POWER_CAL_DRIVE) ? LEGACY2_80M_POWER_TABLE : NULL);
 		}
-		else
+
+		case POWER_CURVE_2M_AM:
 		{
-			maxPwr = MAX_TX_POWER_80M_MW;
+			if(setting == POWER_CAL_MOD_HIGH)
+			{
+				return( LEGACY2_2M_AM_DRIVE_HIGH_TABLE);
+			}
+
+			if(setting == POWER_CAL_MOD_LOW)
+			{
+				return( LEGACY2_2M_AM_DRIVE_LOW_TABLE);
+			}
+
+			return( LEGACY2_2M_AM_POWER_TABLE);
 		}
-	}
-	else
-	{
-		if(g_battery_type == BATTERY_4r2V)
+
+		case POWER_CURVE_2M_CW:
 		{
-			maxPwr = MAX_TX_POWER_2M_4r2V_MW;
+			if(setting == POWER_CAL_MOD_HIGH)
+			{
+				return( LEGACY2_2M_CW_DRIVE_TABLE);
+			}
+
+			return( (setting == POWER_CAL_DRIVE) ? LEGACY2_2M_CW_POWER_TABLE : NULL);
 		}
-		else
+
+		default:
 		{
-			maxPwr = MAX_TX_POWER_2M_MW;
+			return( NULL);
 		}
 	}
+}
 
-	if((int16_t)*powerMW > maxPwr)
-	{
-		ec = ERROR_CODE_POWER_LEVEL_NOT_SUPPORTED;
-	}
+/**
+ * Returns the value a fraction x / span of the way from y0 to y1, rounded to nearest.
+ */
+static uint8_t interpolate(uint8_t y0, uint8_t y1, uint16_t x, uint16_t span)
+{
+	return( (uint8_t)(((uint32_t)y0 * (span - x) + (uint32_t)y1 * x + span / 2) / span));
+}
 
-	*powerMW = CLAMP(0, (int16_t)*powerMW, maxPwr);
+/**
+ * Points above the battery type's maximum power are not loaded, except the first, which is
+ * needed to interpolate up to that maximum.
+ */
+void txLoadPowerCalibration(void)
+{
+	PowerCurve curve = activePowerCurve();
+	uint8_t* drive = powerCalTable(curve, POWER_CAL_DRIVE);
+	uint8_t* high = powerCalTable(curve, POWER_CAL_MOD_HIGH);
+	uint8_t* low = powerCalTable(curve, POWER_CAL_MOD_LOW);
+	uint8_t maxSetting = (curve == POWER_CURVE_80M) ? MAX_80M_PWR_SETTING : MAX_2M_PWR_SETTING;
+	uint8_t i;
 
-	if(*powerMW < 5)
-	{
-		index = 0;
-		*powerMW = 0;
-	}
-	else if(*powerMW < 50)
-	{
-		index = 1;
-		*powerMW = 10;
-	}
-	else if(*powerMW < 150)
-	{
-		index = 2;
-		*powerMW = 100;
-	}
-	else if(*powerMW < 250)
-	{
-		index = 3;
-		*powerMW = 200;
-	}
-	else if(*powerMW < 350)
-	{
-		index = 4;
-		*powerMW = 300;
-	}
-	else if(*powerMW < 450)
-	{
-		index = 5;
-		*powerMW = 400;
-	}
-	else if(*powerMW < 550)
-	{
-		index = 6;
-		*powerMW = 500;
-	}
-	else if(*powerMW < 650)
-	{
-		index = 7;
-		*powerMW = 600;
-	}
-	else if(*powerMW < 900)
-	{
-		index = 8;
-		*powerMW = 800;
-	}
-	else if(*powerMW < 1250)
+	g_power_cal_max_mW = maxPowerMW(curve);
+	g_power_cal_count = 0;
+
+	for(i = 0; i < POWER_CALIBRATION_POINTS; i++)
 	{
-		index = 9;
-		*powerMW = 1000;
+		PowerCalPoint* pt = &g_power_cal[i];
+
+		pt->drive = MIN(eeprom_read_byte(&drive[i]), maxSetting);
+		pt->modHigh = high ? eeprom_read_byte(&high[i]) : 0;
+		pt->modLow = low ? eeprom_read_byte(&low[i]) : pt->modHigh;
+		g_power_cal_count++;
+
+		if(pgm_read_word(&g_power_cal_mW[i]) >= g_power_cal_max_mW)
+		{
+			break;
+		}
 	}
-	else if(*powerMW < 1750)
+
+	g_power_cal_curve = curve;
+}
+
+EC txSetPowerCalibration(uint16_t powerMW, PowerCalSetting setting, uint8_t value)
+{
+	uint8_t* table = powerCalTable(activePowerCurve(), setting);
+	uint8_t i;
+
+	if(table == NULL)
 	{
-		index = 10;
-		*powerMW = 1500;
+		return( ERROR_CODE_ILLEGAL_COMMAND_RCVD);
 	}
-	else if(*powerMW < 2250)
+
+	for(i = 0; i < POWER_CALIBRATION_POINTS; i++)
 	{
-		index = 11;
-		*powerMW = 2000;
+		if(pgm_read_word(&g_power_cal_mW[i]) == powerMW)
+		{
+			eeprom_update_byte(&table[i], value);
+			g_power_cal_curve = POWER_CURVE_NONE;   /* reload at the next power setting */
+			return( ERROR_CODE_NO_ERROR);
+		}
 	}
-	else if(*powerMW < 2750)
+
+	return( ERROR_CODE_POWER_LEVEL_NOT_SUPPORTED);
+}
+
+BOOL txGetPowerCalibration(uint8_t index, uint16_t* powerMW, PowerCalPoint* point)
+{
+	PowerCurve curve = activePowerCurve();
+
+	if((curve != g_power_cal_curve) || (maxPowerMW(curve) != g_power_cal_max_mW))
 	{
-		index = 12;
-		*powerMW = 2500;
+		txLoadPowerCalibration();
 	}
-	else if(*powerMW < 3500)
+
+	if((index >= g_power_cal_count) || !powerMW || !point)
 	{
-		index = 13;
-		*powerMW = 3000;
+		return( TRUE);
 	}
-	else if(*powerMW < 4500)
+
+	*powerMW = pgm_read_word(&g_power_cal_mW[index]);
+	*point = g_power_cal[index];
+
+	return( FALSE);
+}
+
+/**
+ * The requested power is delivered as requested, not rounded to a calibration point: settings
+ * are interpolated between the two points that bracket it, found by binary search.
+ */
+EC txMilliwattsToSettings(uint16_t* powerMW, uint8_t* driveLevel, uint8_t* modLevelHigh, uint8_t* modLevelLow)
+{
+	EC ec = ERROR_CODE_NO_ERROR;
+	PowerCurve curve = activePowerCurve();
+	PowerCalPoint *p0, *p1;
+	uint16_t mW0, x, span;
+	uint8_t lo, hi, mid;
+
+	if(powerMW == NULL)
 	{
-		index = 14;
-		*powerMW = 4000;
+		return(ERROR_CODE_SW_LOGIC_ERROR);
 	}
-	else
+
+	if((curve != g_power_cal_curve) || (maxPowerMW(curve) != g_power_cal_max_mW))
 	{
-		index = 15;
-		*powerMW = 5000;
+		txLoadPowerCalibration();
 	}
 
-	if(band == BAND_80M)
+	if(*powerMW > g_power_cal_max_mW)
 	{
-		*driveLevel = eeprom_read_byte(&ee_80m_power_table[index]);
-		*modLevelHigh = 0;
-		*modLevelLow = 0;
-		*driveLevel = MIN(*driveLevel, MAX_80M_PWR_SETTING);
+		ec = ERROR_CODE_POWER_LEVEL_NOT_SUPPORTED;
+		*powerMW = g_power_cal_max_mW;
 	}
-	else
+
+	/* Find the last point at or below the requested power */
+	lo = 0;
+	hi = g_power_cal_count - 1;
+
+	while(lo < hi)
 	{
-		if(g_2m_modulationFormat == MODE_AM)
+		mid = (lo + hi + 1) / 2;
+
+		if(pgm_read_word(&g_power_cal_mW[mid]) <= *powerMW)
 		{
-			*driveLevel = eeprom_read_byte(&ee_2m_am_power_table[index]);
-			*modLevelHigh = eeprom_read_byte(&ee_2m_am_drive_high_table[index]);
-			*modLevelLow = eeprom_read_byte(&ee_2m_am_drive_low_table[index]);
+			lo = mid;
 		}
 		else
 		{
-			*driveLevel = eeprom_read_byte(&ee_2m_cw_power_table[index]);
-			*modLevelHigh = eeprom_read_byte(&ee_2m_cw_drive_table[index]);
-			*modLevelLow = *modLevelHigh;
+			hi = mid - 1;
 		}
+	}
 
-		*driveLevel = MIN(*driveLevel, MAX_2M_PWR_SETTING);
+	p0 = &g_power_cal[lo];
+	mW0 = pgm_read_word(&g_power_cal_mW[lo]);
+
+	if((lo + 1 < g_power_cal_count) && (*powerMW > mW0))
+	{
+		p1 = &g_power_cal[lo + 1];
+		x = *powerMW - mW0;
+		span = pgm_read_word(&g_power_cal_mW[lo + 1]) - mW0;
+
+		*driveLevel = interpolate(p0->drive, p1->drive, x, span);
+		*modLevelHigh = interpolate(p0->modHigh, p1->modHigh, x, span);
+		*modLevelLow = interpolate(p0->modLow, p1->modLow, x, span);
+	}
+	else
+	{
+		*driveLevel = p0->drive;
+		*modLevelHigh = p0->modHigh;
+		*modLevelLow = p0->modLow;
 	}
 
 	return(ec);
@@ -46,7 +46,7 @@ typedef int16_t Attenuation;
 /*
  * Define clock pins
  */
-#define TX_CLOCK_VHF_FM SI5351_CLK2
+#define TX_CLOCK_VHF_FM SI5351_CLK2     /* not used; held disabled */
 #define TX_CLOCK_HF_0 SI5351_CLK1
 #define TX_CLOCK_VHF SI5351_CLK0
 
@@ -133,6 +133,17 @@ typedef enum
 #define BUCK_6V 100
 #define BUCK_5V 75
 #define BUCK_0V 0
+
+/* PA drain voltage regulation. The nominal drain voltage for a DAC setting follows the
+ * BUCK_xV settings above; while keyed, the DAC is trimmed to hold the measured drain voltage
+ * within PA_REGULATION_DEADBAND_MV of nominal. */
+#define PA_MV_AT_ZERO_DRIVE 2000
+#define PA_MV_PER_DRIVE_STEP 40
+#define PA_MV_FOR_DRIVE(x) (PA_MV_AT_ZERO_DRIVE + (x) * PA_MV_PER_DRIVE_STEP)
+#define PA_REGULATION_DEADBAND_MV 100
+#define PA_REGULATION_READINGS 4        /* readings per DAC step: limits the slew to about 5 steps per second */
+#define PA_MAX_CORRECTION 25            /* DAC steps either side of nominal: about 1 V */
+#define PA_MIN_RISE_PER_STEP_MV (PA_MV_PER_DRIVE_STEP / 2) /* a smaller rise after a DAC increase means the converter is out of headroom */
                                                /*  0,10,100,200,300,400,500,600,800,1000,1500,2000,2500,3000,4000,5000 */
 #define DEFAULT_80M_POWER_TABLE ((const uint8_t[]){0, 2, 20, 40, 54, 62, 70, 78, 91, 100, 130, 155, 180, 200, 245, 254})
 
@@ -145,6 +156,25 @@ typedef enum
 #define DEFAULT_2M_CW_POWER_TABLE ((const uint8_t[]){0, 4, 30, 43, 63, 80,100,115,135, 155, 200, 240, 240, 240, 240, 254})
 #define DEFAULT_2M_CW_DRIVE_TABLE ((const uint8_t[]){250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250})
 
+/* The power tables above are calibration points: each entry gives the settings that deliver
+ * the corresponding power below. Settings for other powers are interpolated between them. */
+#define POWER_CALIBRATION_POINTS 16
+#define POWER_CALIBRATION_MW { 0, 10, 100, 200, 300, 400, 500, 600, 800, 1000, 1500, 2000, 2500, 3000, 4000, 5000 }
+
+typedef enum
+{
+	POWER_CAL_DRIVE,        /* drain voltage DAC setting */
+	POWER_CAL_MOD_HIGH,     /* 2m gate bias: AM modulation peak, or CW */
+	POWER_CAL_MOD_LOW       /* 2m gate bias: AM modulation trough */
+} PowerCalSetting;
+
+typedef struct
+{
+	uint8_t drive;
+	uint8_t modHigh;
+	uint8_t modLow;
+} PowerCalPoint;
+
 #define TX_MINIMUM_2M_FREQUENCY 144000000
 #define TX_MAXIMUM_2M_FREQUENCY 148000000
 #define TX_MINIMUM_80M_FREQUENCY 3500000
@@ -246,6 +276,26 @@ EC powerToTransmitter(BOOL on);
  */
 EC txMilliwattsToSettings(uint16_t* powerMW, uint8_t* powerLevel, uint8_t* modLevelHigh, uint8_t* modLevelLow);
 
+/**
+ * Loads into RAM the calibration points for the active band and 2m modulation format, up to
+ * the maximum power for the battery type. txMilliwattsToSettings() reloads them whenever the
+ * band, modulation format or battery type has changed.
+ */
+void txLoadPowerCalibration(void);
+
+/**
+ * Saves one setting of the calibration point at powerMW, which must be one of
+ * POWER_CALIBRATION_MW, for the active band and 2m modulation format. Takes effect at the
+ * next power setting.
+ */
+EC txSetPowerCalibration(uint16_t powerMW, PowerCalSetting setting, uint8_t value);
+
+/**
+ * Copies calibration point index for the active band and 2m modulation format, and its power.
+ * Returns TRUE if there is no such point.
+ */
+BOOL txGetPowerCalibration(uint8_t index, uint16_t* powerMW, PowerCalPoint* point);
+
 /**
 Returns TRUE if an antenna for the active band is connected to the transmitter
  */
@@ -259,5 +309,17 @@ void initializeTransmitterEEPROMVars(void);
  */
 BOOL txSet2mGateBias(uint8_t bias);
 
+/**
+ * Trims the PA drain voltage DAC one step toward the nominal drain voltage for the power
+ * setting, given a fresh drain voltage reading. Does nothing unless the transmitter is keyed.
+ */
+void txRegulatePower(uint16_t pa_mV);
+
+/**
+ * Saves the drain voltage corrections learned for each band, if they have changed. A band whose
+ * loop saturated during the transmission keeps its previously saved correction.
+ */
+void txSavePowerCorrections(void);
+
 
 #endif  /* TRANSMITTER_H_ */
\ No newline at end of file
@@ -32,138 +32,125 @@
 
 /**
  * Returns a-b
- * It appears difftime might not be handling subtraction of unsigned arguments correctly with current compiler
+ * Time values are unsigned, so the difference is taken modulo 2^32 and then interpreted as signed.
  */
 int32_t timeDif(time_t a, time_t b)
 {
-	int32_t dif; // = difftime(now, g_event_start_time); // returns arg1 - arg2
-	if(a > b)
-		dif = a - b;
-	else
-		dif = -(b - a);
-
-	return dif;
+	return( (int32_t)(a - b));
 }
 
 
 /***********************************************************************************************
- *  Print Formatting Utility Functions
+ *  Calendar Conversion Functions
+ *
+ *  The year is taken to begin on March 1st so that the leap day falls at its end. Each month
+ *  then starts a fixed number of days into the year, given by (153 * m + 2) / 5, and years and
+ *  400-year eras have fixed lengths, so no tables or loops are required.
  ************************************************************************************************/
 
-#ifdef DATE_STRING_SUPPORT_ENABLED
+#define DAYS_PER_ERA 146097UL          /* days in 400 Gregorian years */
+#define DAYS_0000_03_01_TO_EPOCH 719468UL  /* days from 0000-03-01 to 1970-01-01 */
 
-/**
- * Returns parsed time structure from a string of format "yyyy-mm-ddThh:mm:ssZ"
- */
-BOOL mystrptime(char* s, struct tm* ltm) {
-  const int month_days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-  char temp[6];
-  char str[21];
-  int hold;
-  BOOL isleap;
-  char *ptr0;
-  char *ptr1;
-  BOOL noSeconds = FALSE;
-
-  strncpy(str, s, 21);  // "yyyy-mm-ddThh:mm:ssZ\0" <- maximum length null-terminated string
-
-  ptr1 = strchr(str, 'Z');
-  if(ptr1) *ptr1 = '\0'; // erase the 'Z' character at the end if one exists
-
-  noSeconds = (strlen(str) < 17);
-
-  ptr1 = strchr(str, '-');
-  *ptr1 = '\0';
-  strncpy(temp, str, 5);
-  ++ptr1;
-  hold = atoi(temp);
-  isleap = is_leap_year(hold);
-  hold -= 1900;
-  if((hold < 0) || (hold > 200)) return TRUE;
-  ltm->tm_year = hold;
-
-  ptr0 = ptr1;
-
-  ptr1 = strchr(ptr0, '-');
-  *ptr1 = '\0';
-  strncpy(temp, ptr0, 3);
-  ++ptr1;
-  hold = atoi(temp) - 1;
-  if((hold > 11) || (hold < 0)) return TRUE;
-  ltm->tm_mon = hold;
-
-  ptr0 = ptr1;
-
-  ptr1 = strchr(ptr0, 'T');
-  *ptr1 = '\0';
-  strncpy(temp, ptr0, 3);
-  ++ptr1;
-  hold = atoi(temp);
-  if((hold > 31) || (hold < 1)) return TRUE;
-  ltm->tm_mday = hold;
-
-  ptr0 = ptr1;
-
-  ltm->tm_yday = 0;
-  for(int i=0; i<ltm->tm_mon; i++)
-  {
-    ltm->tm_yday += month_days[i];
-    if((i==1) && isleap) ltm->tm_yday++;
-  }
-
-  ltm->tm_yday += (ltm->tm_mday - 1);
-
-  ptr1 = strchr(ptr0, ':');
-  *ptr1 = '\0';
-  strncpy(temp, ptr0, 3);
-  ++ptr1;
-  hold = atoi(temp);
-  if((hold > 23) || (hold < 0)) return TRUE;
-  ltm->tm_hour = hold;
-
-  ptr0 = ptr1;
-
-  if(noSeconds)
-  {
-	  strncpy(temp, ptr0, 3);
-	  hold = atoi(temp);
-	  if(hold > 59) return TRUE;
-	  ltm->tm_min = hold;
-  }
-  else
-  {
-	  ptr1 = strchr(ptr0, ':');
-	  *ptr1 = '\0';
-	  strncpy(temp, ptr0, 3);
-	  ++ptr1;
-	  hold = atoi(temp);
-	  if(hold > 59) return TRUE;
-	  ltm->tm_min = hold;
-
-	  hold = atoi(ptr1);
-	  if(hold > 59) return TRUE;
-	  ltm->tm_sec = hold;
-  }
-
-  return FALSE;
+uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day)
+{
+	uint16_t era, yoe, doy;
+	uint32_t doe;
+
+	if(month <= 2)
+	{
+		year--;
+	}
+
+	era = year / 400;
+	yoe = year - era * 400;                                                     /* [0, 399] */
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;        /* [0, 365] */
+	doe = (uint32_t)yoe * 365 + yoe / 4 - yoe / 100 + doy;                      /* [0, 146096] */
+
+	return( era * DAYS_PER_ERA + doe - DAYS_0000_03_01_TO_EPOCH);
 }
 
+void civil_from_days(uint32_t days, uint16_t* year, uint8_t* month, uint8_t* day)
+{
+	uint16_t era, yoe, doy, mp;
+	uint32_t doe;
+
+	days += DAYS_0000_03_01_TO_EPOCH;
+	era = days / DAYS_PER_ERA;
+	doe = days - era * DAYS_PER_ERA;                                            /* [0, 146096] */
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;                /* [0, 399] */
+	doy = doe - (365 * (uint32_t)yoe + yoe / 4 - yoe / 100);                    /* [0, 365] */
+	mp = (5 * doy + 2) / 153;                                                   /* [0, 11] from March */
+
+	if(day)
+	{
+		*day = doy - (153 * mp + 2) / 5 + 1;
+	}
+
+	if(month)
+	{
+		*month = mp < 10 ? mp + 3 : mp - 9;
+	}
+
+	if(year)
+	{
+		*year = era * 400 + yoe + (mp >= 10);
+	}
+}
+
+uint8_t weekday_from_days(uint32_t days)
+{
+	return( (days + 4) % 7);    /* 1970-01-01 was a Thursday */
+}
+
+time_t epoch_from_civil(uint16_t year, uint8_t month, uint8_t day, uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+	return( days_from_civil(year, month, day) * SECONDS_PER_DAY + hours * 3600L + minutes * 60 + seconds);
+}
 
 /**
- * Converts a string of format "yyyy-mm-ddThh:mm:ss" to seconds since 1900
+ * Returns the value of the decimal digits s[0] .. s[n - 1], or -1 if any is not a digit.
  */
-uint32_t convertTimeStringToEpoch(char * s)
+static int16_t parseDigits(const char* s, uint8_t n)
 {
-  unsigned long result = 0;
-  struct tm ltm = {0};
+	int16_t val = 0;
+
+	while(n--)
+	{
+		if((*s < '0') || (*s > '9'))
+		{
+			return( -1);
+		}
 
-  if (!mystrptime(s, &ltm)) {
-    result = ltm.tm_sec + ltm.tm_min*60 + ltm.tm_hour*3600L + ltm.tm_yday*86400L +
-    (ltm.tm_year-70)*31536000L + ((ltm.tm_year-69)/4)*86400L -
-    ((ltm.tm_year-1)/100)*86400L + ((ltm.tm_year+299)/400)*86400L;
-  }
+		val = val * 10 + (*s++ - '0');
+	}
 
-  return result;
+	return( val);
 }
 
-#endif //  DATE_STRING_SUPPORT_ENABLED
+time_t convertTimeStringToEpoch(char * s)
+{
+	int16_t year, month, day, hours, minutes, seconds = 0;
+
+	if(strlen(s) < 16)  /* "yyyy-mm-ddThh:mm" */
+	{
+		return( 0);
+	}
+
+	year = parseDigits(s, 4);
+	month = parseDigits(&s[5], 2);
+	day = parseDigits(&s[8], 2);
+	hours = parseDigits(&s[11], 2);
+	minutes = parseDigits(&s[14], 2);
+
+	if(s[16] == ':')
+	{
+		seconds = parseDigits(&s[17], 2);
+	}
+
+	if((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > 31) || (hours < 0) || (hours > 23) || (minutes < 0) || (minutes > 59) || (seconds < 0) || (seconds > 59))
+	{
+		return( 0);
+	}
+
+	return( epoch_from_civil(year, month, day, hours, minutes, seconds));
+}
@@ -33,18 +33,41 @@
 #include "defs.h"
 #include <time.h>
 
+#define SECONDS_PER_DAY 86400UL
+
 int32_t timeDif(time_t a, time_t b);
 
 /***********************************************************************************************
- *  Print Formatting Utility Functions
+ *  Calendar Conversion Functions
+ *
+ *  Dates are in the proleptic Gregorian calendar, valid from 1970-01-01 through 2105.
+ *  Epoch values are seconds since 1970-01-01T00:00:00Z.
  ************************************************************************************************/
 
-#ifdef DATE_STRING_SUPPORT_ENABLED
 /**
- * Converts a string of format "yyyy-mm-ddThh:mm:ss" to seconds since 1900
+ * Returns the number of days from 1970-01-01 to year-month-day (month = 1 to 12).
+ */
+uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+
+/**
+ * Converts days since 1970-01-01 to year, month (1 to 12) and day of the month.
+ */
+void civil_from_days(uint32_t days, uint16_t* year, uint8_t* month, uint8_t* day);
+
+/**
+ * Returns the day of the week of days since 1970-01-01: 0 = Sunday ... 6 = Saturday
+ */
+uint8_t weekday_from_days(uint32_t days);
+
+/**
+ * Returns the epoch of the date and time specified.
+ */
+time_t epoch_from_civil(uint16_t year, uint8_t month, uint8_t day, uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+/**
+ * Converts a string of format "yyyy-mm-ddThh:mm:ss" or "yyyy-mm-ddThh:mm" to the epoch.
+ * Returns 0 if the string is malformed.
  */
-uint32_t convertTimeStringToEpoch(char * s);
-BOOL mystrptime(char* s, struct tm* ltm);
-#endif // DATE_STRING_SUPPORT_ENABLED
+time_t convertTimeStringToEpoch(char * s);
 
 #endif  /* UTIL_H_ */
\ No newline at end of file
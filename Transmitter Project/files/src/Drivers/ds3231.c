@@ -31,8 +31,6 @@
    #include "i2c.h"
    #include "util.h"
 
-   #define DS3231_I2C_SLAVE_ADDR 0xD0   /* corresponds to slave address = 0b1101000x */
-
    #define RTC_SECONDS                     0x00
    #define RTC_MINUTES                     0x01
    #define RTC_HOURS                       0x02
@@ -53,21 +51,21 @@
    #define RTC_TEMP_MSB                    0x11
    #define RTC_TEMP_LSB                    0x12
 
-#ifdef FOOBAR
-const uint8_t wd(int year, int month, int day)
+/**
+ * Converts a packed BCD byte to binary
+ */
+static uint8_t bcd2bin(uint8_t bcd)
+{
+	return( 10 * (bcd >> 4) + (bcd & 0x0f));
+}
+
+/**
+ * Converts binary 0 to 99 to packed BCD
+ */
+static uint8_t bin2bcd(uint8_t bin)
 {
-	static const uint8_t weekdayname[] = {2 /*Mon*/, 3 /*Tue*/, 4 /*Wed*/, 5 /*Thu*/, 6 /*Fri*/, 7 /*Sat*/, 1 /*Sun*/};
-	size_t JND =
-	day
-	+ ((153 * (month + 12 * ((14 - month) / 12) - 3) + 2) / 5)
-	+ (365 * (year + 4800 - ((14 - month) / 12)))
-	+ ((year + 4800 - ((14 - month) / 12)) / 4)
-	- ((year + 4800 - ((14 - month) / 12)) / 100)
-	+ ((year + 4800 - ((14 - month) / 12)) / 400)
-	- 32045;
-	return weekdayname[JND % 7];
+	return( ((bin / 10) << 4) | (bin % 10));
 }
-#endif
 
 time_t ds3231_get_epoch(EC *result)
 {
@@ -79,68 +77,18 @@ time_t ds3231_get_epoch(EC *result)
 
 	if(!res)
 	{
-		struct tm ltm = {0};
-		int16_t year = 100; // start at 100 years past 1900
-		uint8_t month;
-		uint8_t date;
-		uint8_t hours;
-		uint8_t minutes;
-		uint8_t seconds;
-		BOOL am_pm;
-		BOOL twelvehour;
-
-		year += data[6] & 0x0f;
-		year += 10*((data[6] & 0xf0) >> 4);
-		ltm.tm_year = year; // year since 1900
-
-		year += 1900; // adjust year to calendar year
+		uint8_t hours = bcd2bin(data[2] & 0x1f);
 
-		month = data[5] & 0x0f;
-		month += 10*((data[5] & 0xf0) >> 4);
-		ltm.tm_mon = month - 1; // mon 0 to 11
-
-		date = data[4] & 0x0f;
-		date += 10*((data[4] & 0xf0) >> 4);
-
-		ltm.tm_mday = date; // month day 1 to 31
-
-		ltm.tm_yday = 0;
-		for(uint8_t mon=1; mon<month; mon++) // months from 1 to 11 (excludes partial month)
+		if(data[2] & 0x40)  /* 12-hour: bit 5 = PM */
 		{
-		  ltm.tm_yday += month_length(year, mon);;
+			if(data[2] & 0x20) hours += 12;
 		}
-
-		ltm.tm_yday += (ltm.tm_mday - 1);
-
-		seconds = 10 * ((data[0] & 0xf0) >> 4);
-		seconds += (data[0] & 0x0f);
-
-		minutes = 10 * ((data[1] & 0xf0) >> 4);
-		minutes += (data[1] & 0x0f);
-
-		am_pm = ((data[2] >> 5) & 0x01);
-
-		hours = 10 * ((data[2] >> 4) & 0x01);
-		hours += (data[2] & 0x0f);
-
-		twelvehour = ((data[2] >> 6) & 0x01);
-
-		if(twelvehour)
-		{
-			if(am_pm) hours += 12;
-		}
-		else // am_pm holds 20 hours flag
+		else                /* 24-hour: bit 5 = 20 hours */
 		{
-			if(am_pm) hours += 20;
+			if(data[2] & 0x20) hours += 20;
 		}
 
-		ltm.tm_hour = hours;
-		ltm.tm_min = minutes;
-		ltm.tm_sec = seconds;
-
-		epoch = ltm.tm_sec + ltm.tm_min*60 + ltm.tm_hour*3600L + ltm.tm_yday*86400L +
-		(ltm.tm_year-70)*31536000L + ((ltm.tm_year-69)/4)*86400L -
-		((ltm.tm_year-1)/100)*86400L + ((ltm.tm_year+299)/400)*86400L;
+		epoch = epoch_from_civil(2000 + bcd2bin(data[6]), bcd2bin(data[5] & 0x1f), bcd2bin(data[4]), hours, bcd2bin(data[1]), bcd2bin(data[0]));
 	}
 
 	if(result) *result = res ? ERROR_CODE_RTC_NONRESPONSIVE : ERROR_CODE_NO_ERROR;
@@ -259,7 +207,6 @@ void ds3231_set_date_time(char * dateString, ClockSetting setting) /* "2018-03-2
 	data[1] |= ((dateString[14] - '0') << 4); /* 10s of minutes */
 	data[2] = dateString[12] - '0'; /* hours */
 	data[2] |= ((dateString[11] - '0') << 4); /* 10s of hours - sets 24-hour format (not AM/PM) */
-	//data[3] = Skip day of week
 	data[4] = dateString[9] - '0'; /* day of month digit 1 */
 	date = data[4];
 	temp = dateString[8] - '0';
@@ -276,9 +223,35 @@ void ds3231_set_date_time(char * dateString, ClockSetting setting) /* "2018-03-2
 	year += 10*temp;
 	data[6] |= (temp << 4); /* year digit 10 */
 
+	if(setting == RTC_CLOCK)
+	{
+		data[3] = weekday_from_days(days_from_civil(year, month, date)) + 1; /* day of week: 1 = Sunday */
+	}
+
 	i2c_device_write(DS3231_I2C_SLAVE_ADDR, RTC_SECONDS+(setting*7), data, 7);
 }
 
+void ds3231_set_epoch(time_t epoch)
+{
+	uint8_t data[7];
+	uint32_t days = epoch / SECONDS_PER_DAY;
+	uint32_t secs = epoch - days * SECONDS_PER_DAY;
+	uint16_t year;
+	uint8_t month, date;
+
+	civil_from_days(days, &year, &month, &date);
+
+	data[0] = bin2bcd(secs % 60);
+	data[1] = bin2bcd((secs / 60) % 60);
+	data[2] = bin2bcd(secs / 3600);    /* 24-hour format */
+	data[3] = weekday_from_days(days) + 1;
+	data[4] = bin2bcd(date);
+	data[5] = bin2bcd(month);           /* century = 0 */
+	data[6] = bin2bcd(year - 2000);
+
+	i2c_device_write(DS3231_I2C_SLAVE_ADDR, RTC_SECONDS, data, 7);
+}
+
 	void ds3231_1s_sqw(BOOL enable)
 	{
 		if(enable)
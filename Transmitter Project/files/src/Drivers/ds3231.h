@@ -38,6 +38,8 @@
 #ifndef DS3231_H_
 #define DS3231_H_
 
+#define DS3231_I2C_SLAVE_ADDR 0xD0   /* corresponds to slave address = 0b1101000x */
+
 typedef enum {
 	RTC_CLOCK,
 	RTC_ALARM1,
@@ -70,14 +72,10 @@ time_t ds3231_get_epoch(EC *result);
 	void ds3231_set_date_time(char * dateString, ClockSetting setting);
 
 /**
- * Returns day of week given any date
- * year = 20xx
- * month = mm
- * day = dd
- * Returns 1=Sun, ... 7=Sat
+ *  Sets the DS3231 clock to epoch. Writing the seconds register restarts the DS3231's
+ *  sub-second countdown, so the next seconds rollover occurs one second after this returns.
  */
-//const uint8_t wd(int year, int month, int day);
-
+	void ds3231_set_epoch(time_t epoch);
 
 /**
  *
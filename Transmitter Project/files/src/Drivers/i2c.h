@@ -28,10 +28,15 @@
 #ifndef I2C_H_
 #define I2C_H_
 
-#ifndef TRANQUILIZE_WATCHDOG
-	#define I2C_TIMEOUT_SUPPORT /* limit number of tries for i2c success */
-#endif // TRANQUILIZE_WATCHDOG
-/* #define SUPPORT_I2C_CLEARBUS_FUNCTION */
+/* SCL = F_CPU / (16 + 2 * TWBR) with TWI prescale /1 */
+#define I2C_TWBR_STANDARD 0x25  /* ~90 kHz at 8 MHz */
+#define I2C_TWBR_FAST 0x02      /* 400 kHz at 8 MHz */
+
+#define I2C_QUEUE_SIZE 4        /* must be a power of two */
+#define I2C_TIMEOUT_TICKS 26    /* ~20 ms in TIMER2 ticks: abandon a transaction that has not finished */
+#define I2C_POLL_LIMIT 10000    /* polling passes without bus activity before giving up, with interrupts disabled */
+#define I2C_RECOVERY_SCL_WAIT_TICKS 130 /* ~100 ms in TIMER2 ticks: longest clock stretch tolerated during bus recovery */
+#define I2C_RECOVERY_CLOCKS 20          /* > 2x9 clocks to free a slave holding SDA low */
 
 #ifndef BOOL
 	typedef uint8_t BOOL;
@@ -45,23 +50,110 @@
 #define TRUE !FALSE
 #endif
 
+typedef enum
+{
+	I2C_SPEED_ABSENT = 0,   /* did not acknowledge when probed; addressed at standard speed */
+	I2C_SPEED_STANDARD,
+	I2C_SPEED_FAST
+} I2CSpeed;
+
+typedef struct
+{
+	uint8_t slaveAddr;
+	I2CSpeed maxSpeed;      /* fastest speed supported by the part and its wiring */
+	I2CSpeed speed;         /* speed in use, as determined by i2c_probe() */
+	uint16_t nacks;
+	uint16_t timeouts;
+	uint16_t recoveries;    /* bus recoveries following a timeout or bus error while addressing this device */
+} I2CDevice;
+
+typedef enum
+{
+	I2C_STATUS_OK = 0,
+	I2C_STATUS_PENDING,     /* queued */
+	I2C_STATUS_BUSY,        /* on the bus */
+	I2C_STATUS_NACK,        /* slave did not acknowledge its address or data */
+	I2C_STATUS_TIMEOUT,
+	I2C_STATUS_BUS_ERROR    /* illegal START/STOP or arbitration lost */
+} I2CStatus;
+
+struct I2CTransaction;
+typedef void (*I2CCallback)(struct I2CTransaction *t);
+
+/**
+ * A write of writeBytes followed by a read of readBytes, either of which may be zero. The
+ * register address is sent before the data unless noRegister is set. The descriptor and its
+ * buffers must remain valid until status is no longer pending or busy.
+ */
+typedef struct I2CTransaction
+{
+	uint8_t slaveAddr;
+	uint8_t regAddr;
+	BOOL noRegister;
+	uint8_t *writeData;
+	uint8_t writeBytes;
+	uint8_t *readData;
+	uint8_t readBytes;
+	I2CCallback callback;       /* called from the TWI interrupt when the transaction ends; may be NULL */
+	volatile I2CStatus status;
+} I2CTransaction;
+
 /**
  */
 	void i2c_init(void);
 
 /**
+ * Queues a transaction to be carried out by the TWI interrupt. Returns TRUE if the queue is full.
  */
-	BOOL i2c_device_read(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2read);
+	BOOL i2c_submit(I2CTransaction *t);
 
 /**
+ * Returns TRUE while any transaction is queued or in progress.
  */
-	BOOL i2c_device_write(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2write);
+	BOOL i2c_busy(void);
+
+/**
+ * Abandons all queued transactions with I2C_STATUS_TIMEOUT and releases the bus.
+ */
+	void i2c_reset(void);
+
+/**
+ * Times out a stalled transaction, and advances bus recovery following a timeout or bus
+ * error. Queued transactions resume once recovery completes. Call once per TIMER2 interrupt.
+ */
+	void i2c_tick(void);
+
+/**
+ * Advances the transaction in progress. Call from the TWI interrupt.
+ */
+	void i2c_twi_interrupt(void);
+
+/**
+ * Addresses each device in the device table, first at the fastest speed it supports and then at
+ * standard speed, and thereafter uses the fastest speed at which it acknowledged. Call once at boot.
+ */
+	void i2c_probe(void);
 
-#ifdef SUPPORT_I2C_CLEARBUS_FUNCTION
 /**
+ * Copies entry index of the device table, including its error counts. Returns TRUE if index is
+ * beyond the end of the table.
  */
-	BOOL i2c_clearBus(void);
-#endif  /* SUPPORT_I2C_CLEARBUS_FUNCTION */
+	BOOL i2c_get_device(uint8_t index, I2CDevice *device);
+
+/**
+ * Clears the error counts of all devices.
+ */
+	void i2c_reset_stats(void);
+
+/**
+ * Blocking wrappers: submit a transaction and wait for it. Return TRUE on failure.
+ * May be called with interrupts disabled, in which case the bus is polled.
+ */
+	BOOL i2c_device_read(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2read);
+
+/**
+ */
+	BOOL i2c_device_write(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2write);
 
 #ifdef INCLUDE_DAC081C085_SUPPORT
 
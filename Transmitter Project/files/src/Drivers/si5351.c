@@ -35,10 +35,36 @@
 #include <math.h>
 #include <util/twi.h>
 
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+	#include <avr/eeprom.h>
+#endif
+
 #include "i2c.h"
 #include "si5351.h"
 
-#define SI5351_I2C_SLAVE_ADDR                            0xC0    /* I2C slave address */
+/* Registers mirrored in RAM so that unchanged values need not be rewritten, and so that
+ * read-modify-write operations need no I2C reads */
+#define SI5351_SHADOW_FIRST                              SI5351_OUTPUT_ENABLE_CTRL
+#define SI5351_SHADOW_LAST                               (SI5351_CLK2_PARAMETERS + SI5351_PARAMETERS_LENGTH - 1)
+#define SI5351_SHADOW_SIZE                               (SI5351_SHADOW_LAST - SI5351_SHADOW_FIRST + 1)
+#define SI5351_BURST_MERGE_GAP                           3       /* resending this many unchanged bytes is cheaper than starting another transfer */
+#define SI5351_FINE_TUNE_SHIFT                           5       /* fine tuning uses a fixed PLL denominator of (reference >> 5), which fits in 20 bits */
+
+/* Register images for one output frequency, as calculated by si5351_set_freq(). Entries are
+ * keyed by everything the calculation depends on, so a cached entry can be written without
+ * further arithmetic. */
+	typedef struct
+	{
+		Frequency_Hz freq;                              /* output frequency after R divider selection and rounding; zero if the entry is unused */
+		Frequency_Hz vcoB;                              /* PLLB frequency the multisynth was fitted to; zero for PLLA, and if PLLB was free */
+		Frequency_Hz freq_VCO;                          /* PLL frequency; zero if the PLL is to be left unchanged */
+		uint16_t ms_divider;                            /* see g_pllA_ms_divider */
+		uint8_t clk;
+		uint8_t r_div;
+		BOOL int_mode;
+		uint8_t ms_params[SI5351_PARAMETERS_LENGTH];    /* P1, P2, P3, R divider and divide-by-4 */
+		uint8_t pll_params[SI5351_PARAMETERS_LENGTH];   /* P1, P2, P3 of the feedback multisynth */
+	} Si5351Plan;
 
 /*******************************
  * Global Variables
@@ -50,6 +76,25 @@
 	static uint8_t enabledClocksMask = 0x00;
 	static Frequency_Hz clock_out[3] = { 0, 0, 0 };
 
+	static uint16_t g_pllA_ms_divider = 0;  /* CLK0 integer multisynth divider; zero if CLK0 cannot be fine tuned */
+
+	static uint8_t g_shadow[SI5351_SHADOW_SIZE];
+	static uint8_t g_shadow_valid[(SI5351_SHADOW_SIZE + 7) / 8];    /* one bit per shadowed register */
+
+	static Si5351Plan g_plan_cache[SI5351_PLAN_CACHE_SIZE];
+	static uint8_t g_plan_next = 0;                 /* cache entry to be replaced next */
+
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+		typedef struct
+		{
+			Frequency_Hz xtal_freq;                     /* reference and correction the plans were calculated for */
+			int32_t correction;
+			Si5351Plan plans[SI5351_PLAN_CACHE_SIZE];
+		} Si5351SavedPlans;
+
+		#define SI5351_SAVED_PLANS ((Si5351SavedPlans*)SI5351_PLANS_EEPROM_ADDRESS)
+#endif
+
 #ifdef SUPPORT_STATUS_READS
 		Si5351Status dev_status;
 		Si5351IntStatus dev_int_status;
@@ -167,6 +212,14 @@
  ********************************/
 
 	void pll_reset(Si5351_pll);
+	Frequency_Hz reference_frequency(void);
+	void set_pll_registers(Union_si5351_regs, Si5351_pll);
+	void set_pll_parameters(Si5351_pll, uint8_t *);
+	void pack_parameters(Union_si5351_regs, uint8_t *);
+	uint8_t normalize_frequency(Frequency_Hz *);
+	void plan_cache_reset(void);
+	Si5351Plan* plan_lookup(Frequency_Hz, Si5351_clock, uint8_t);
+	Si5351Plan* plan_compute(Frequency_Hz, Si5351_clock, uint8_t);
 
 #ifdef DEBUGGING_ONLY
 		uint32_t pll_calc(Frequency_Hz, Union_si5351_regs *, int32_t);
@@ -196,14 +249,17 @@
 
 	Frequency_Hz multisynth_estimate(Frequency_Hz freq_Fout, Union_si5351_regs *reg, BOOL *int_mode, BOOL *divBy4);
 	void set_multisynth_registers_source(Si5351_clock, Si5351_pll);
-	void set_multisynth_registers(Si5351_clock, Union_si5351_regs, uint8_t, uint8_t, BOOL);
+	void set_multisynth_parameters(Si5351_clock, uint8_t *);
 	uint32_t calc_gcd(uint32_t, uint32_t);
 	void reduce_by_gcd(uint32_t *, uint32_t *);
 	BOOL si5351_write_bulk(uint8_t, uint8_t, uint8_t *);
+	BOOL si5351_write_shadowed(uint8_t, uint8_t, uint8_t *);
 	BOOL si5351_write(uint8_t, uint8_t);
 	BOOL si5351_read(uint8_t, uint8_t *);
+	BOOL si5351_read_shadowed(uint8_t, uint8_t *);
+	BOOL shadow_is_current(uint8_t, uint8_t);
+	void shadow_store(uint8_t, uint8_t, uint8_t *, BOOL);
 	void set_integer_mode(Si5351_clock, BOOL);
-	void ms_div(Si5351_clock, uint8_t, BOOL);
 
 #ifdef SUPPORT_STATUS_READS
 		BOOL si5351_read_sys_status(Si5351Status *);
@@ -241,6 +297,9 @@
 		freqVCOB = 0;
 		xtal_freq = SI5351_XTAL_FREQ;
 		enabledClocksMask = 0x00;
+		memset(g_shadow_valid, 0, sizeof(g_shadow_valid)); /* device contents unknown until written */
+		g_pllA_ms_divider = 0;
+		plan_cache_reset();
 
 		/* Disable Outputs */
 		/* Set CLKx_DIS high; Reg. 3 = 0xFF */
@@ -265,7 +324,7 @@
 		/* Change the ref osc freq if different from default */
 		if(ref_osc_freq != xtal_freq)
 		{
-			if(si5351_read(SI5351_PLL_INPUT_SOURCE, &reg_val))
+			if(si5351_read_shadowed(SI5351_PLL_INPUT_SOURCE, &reg_val))
 			{
 				return TRUE;
 			}
@@ -293,6 +352,7 @@
 #endif  /* #ifndef DIVIDE_XTAL_FREQ_IF_NEEDED */
 
 			err |= si5351_write(SI5351_PLL_INPUT_SOURCE, reg_val);
+			plan_cache_reset();     /* plans depend on the reference frequency */
 		}
 
 		return err;
@@ -407,17 +467,10 @@
  */
 	BOOL si5351_set_freq(Frequency_Hz freq_Fout, Si5351_clock clk, BOOL clocksOff)
 	{
-		Union_si5351_regs ms_reg;
-		Frequency_Hz freq_VCO = 0;
+		Si5351Plan *plan;
 		Si5351_pll target_pll;
 		uint8_t clock_ctrl_addr;
-		uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
-		BOOL int_mode = FALSE;
-		BOOL div_by_4 = FALSE;
-
-#ifdef DEBUGGING_ONLY
-			uint32_t div = 0;
-#endif
+		uint8_t r_div;
 
 #ifdef DO_BOUNDS_CHECKING
 			if(freq_Fout < SI5351_CLKOUT_MIN_FREQ)
@@ -431,20 +484,7 @@
 			}
 #endif
 
-#ifdef SUPPORT_FOUT_BELOW_1024KHZ
-			/* Select the proper R div value used for Fout frequencies below 1.024 MHz */
-			r_div = select_r_div(&freq_Fout);
-#endif
-
-#ifdef PREVENT_UNACHIEVABLE_FREQUENCIES
-			/* Prevent unachievable frequencies from being entered. The Si5351 will accept these, but some may result */
-			/* in no clock output. */
-			if(freq_Fout > 999999)
-			{
-				freq_Fout /= 100;
-				freq_Fout *= 100;
-			}
-#endif
+		r_div = normalize_frequency(&freq_Fout);
 
 		/* Determine which PLL to use: CLK0 gets PLLA, CLK1 and CLK2 get PLLB */
 		/* The first of CLK1 or CLK2 to be configured, determines the VCO frequency used for PLLB. */
@@ -538,47 +578,34 @@
 		/* step also needs to power up the output drivers */
 		/* (Registers 15-92 and 149-170 and 183) */
 
-#ifdef DEBUGGING_ONLY
-			Frequency_Hz freq_VCO_calc;
-			Frequency_Hz fout_calc;
-			int32_t f_err;
-#endif
+		/* Switching to a recently used frequency needs no calculation */
+		plan = plan_lookup(freq_Fout, clk, r_div);
 
-		if((target_pll == SI5351_PLLA) || !freqVCOB)
+		if(!plan)
 		{
-#ifdef DEBUGGING_ONLY
-				freq_VCO = multisynth_calc(freq_Fout, &ms_reg, &int_mode, &div_by_4, &div);
-#else
-				freq_VCO = multisynth_calc(freq_Fout, &ms_reg, &int_mode, &div_by_4);
-#endif
+			plan = plan_compute(freq_Fout, clk, r_div);
+
+			if(!plan)
+			{
+				return(TRUE);   /* the clock is left disabled */
+			}
 		}
-		else
+
+		if(target_pll == SI5351_PLLA)
 		{
-#ifdef DEBUGGING_ONLY
-				fout_calc = freq_Fout;  /* save the intended output frequency */
-#endif
-			freq_Fout = multisynth_estimate(freq_Fout, &ms_reg, &int_mode, &div_by_4);
+			g_pllA_ms_divider = plan->ms_divider;
 		}
 
 		/* Set multisynth registers (MS must be set before PLL) */
 		set_multisynth_registers_source(clk, target_pll);
-		set_multisynth_registers(clk, ms_reg, int_mode, r_div, div_by_4);
+		set_multisynth_parameters(clk, plan->ms_params);
+		set_integer_mode(clk, plan->int_mode);
 
 		/* Set PLL if necessary */
-#ifdef DEBUGGING_ONLY
-			if(freq_VCO)
-			{
-				freq_VCO_calc = set_pll(freq_VCO, target_pll);
-				fout_calc = freq_VCO_calc / div;
-			}
-
-			f_err = freq_Fout - fout_calc;
-#else
-			if(freq_VCO)
-			{
-				set_pll(freq_VCO, target_pll);
-			}
-#endif
+		if(plan->freq_VCO)
+		{
+			set_pll_parameters(target_pll, plan->pll_params);
+		}
 
 		/* Block 5: */
 		/* Apply PLLA or PLLB soft reset */
@@ -610,7 +637,7 @@
 		}
 		else
 		{
-			if(int_mode)
+			if(plan->int_mode)
 			{
 				si5351_write(clock_ctrl_addr, 0x6C);    /* power up only clock being set, leaving that clock configured as follows: */
 				/*   o Drive strength = 2 mA */
@@ -631,9 +658,9 @@
 				/*   o Clock powered up */
 			}
 
-			if(freq_VCO)
+			if(plan->freq_VCO)
 			{
-				freqVCOB = freq_VCO;
+				freqVCOB = plan->freq_VCO;
 			}
 		}
 
@@ -641,6 +668,162 @@
 	}
 
 
+/*
+ * BOOL si5351_plan_cached(Frequency_Hz freq_Fout, Si5351_clock clk)
+ *
+ * Returns TRUE if si5351_set_freq() would set freq_Fout on clk from cached register
+ * images, with no calculation.
+ *
+ */
+	BOOL si5351_plan_cached(Frequency_Hz freq_Fout, Si5351_clock clk)
+	{
+		uint8_t r_div = normalize_frequency(&freq_Fout);
+
+		return(plan_lookup(freq_Fout, clk, r_div) != NULL);
+	}
+
+
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+/*
+ * si5351_save_plans(void)
+ *
+ * Stores the frequency plan cache in EEPROM, along with the reference frequency and
+ * correction it was calculated for. The cache is restored by si5351_init() and
+ * si5351_set_correction() if those still match.
+ *
+ */
+		void si5351_save_plans(void)
+		{
+			eeprom_update_dword((uint32_t*)&SI5351_SAVED_PLANS->xtal_freq, xtal_freq);
+			eeprom_update_dword((uint32_t*)&SI5351_SAVED_PLANS->correction, (uint32_t)g_si5351_ref_correction);
+			eeprom_update_block(g_plan_cache, SI5351_SAVED_PLANS->plans, sizeof(g_plan_cache));
+		}
+#endif
+
+
+/*
+ * BOOL si5351_fine_tune(Frequency_Hz freq_Fout, Si5351_clock clk)
+ *
+ * Retunes a clock by changing only the fractional feedback of its PLL, leaving the integer
+ * multisynth divider chosen by si5351_set_freq() in place. Only the few changed PLL parameter
+ * bytes are written, and no 64-bit arithmetic or GCD reduction is needed. Resolution is
+ * (reference >> SI5351_FINE_TUNE_SHIFT) / divider, a few Hz at most.
+ *
+ * Only CLK0 is supported, because PLLB may be shared by CLK1 and CLK2.
+ *
+ * Returns TRUE if the frequency cannot be reached this way; the caller should then use
+ * si5351_set_freq().
+ *
+ */
+	BOOL si5351_fine_tune(Frequency_Hz freq_Fout, Si5351_clock clk)
+	{
+		uint8_t params[SI5351_PARAMETERS_LENGTH];
+
+		if(si5351_fine_tune_params(freq_Fout, clk, params))
+		{
+			return(TRUE);
+		}
+
+		set_pll_parameters(SI5351_PLLA, params);
+		clock_out[clk] = freq_Fout;
+
+		return(FALSE);
+	}
+
+
+/*
+ * BOOL si5351_fine_tune_params(Frequency_Hz freq_Fout, Si5351_clock clk, uint8_t *params)
+ *
+ * Calculates the PLL parameters that si5351_fine_tune() would write, without writing them.
+ * The packed parameters can later be written with si5351_load_pll_params(), e.g., to
+ * modulate the clock from a precalculated table.
+ *
+ * Returns TRUE if the frequency cannot be reached this way.
+ *
+ */
+	BOOL si5351_fine_tune_params(Frequency_Hz freq_Fout, Si5351_clock clk, uint8_t *params)
+	{
+		Union_si5351_regs pll_reg;
+		Frequency_Hz ref_freq;
+		Frequency_Hz freq_VCO;
+		uint32_t a, b, c;
+
+		if((clk != SI5351_CLK0) || !g_pllA_ms_divider)
+		{
+			return(TRUE);
+		}
+
+		if(freq_Fout > (SI5351_PLL_VCO_MAX / g_pllA_ms_divider))
+		{
+			return(TRUE);
+		}
+
+		freq_VCO = freq_Fout * g_pllA_ms_divider;
+
+		if(freq_VCO < SI5351_PLL_VCO_MIN)
+		{
+			return(TRUE);
+		}
+
+		ref_freq = reference_frequency();
+		c = ref_freq >> SI5351_FINE_TUNE_SHIFT;
+		a = freq_VCO / ref_freq;
+		b = ((freq_VCO % ref_freq) + (1 << (SI5351_FINE_TUNE_SHIFT - 1))) >> SI5351_FINE_TUNE_SHIFT;
+
+		if(b >= c)  /* rounded up to the next integer */
+		{
+			a++;
+			b -= c;
+		}
+
+		uint32_t bx128 = b << 7;
+		uint32_t bx128overc = bx128 / c;
+		pll_reg.ms.p1 = (uint32_t)((a << 7) + bx128overc) - 512;   /* 128 * a + floor((128 * b) / c) - 512 */
+		pll_reg.ms.p2 = (uint32_t)bx128 - (c * bx128overc);        /* 128 * b - c * floor((128 * b) / c) */
+		pll_reg.ms.p3 = c;
+
+		pack_parameters(pll_reg, params);
+
+		return(FALSE);
+	}
+
+
+/*
+ * BOOL si5351_load_pll_params(Si5351_clock clk, uint8_t *params)
+ *
+ * Writes PLL parameters calculated by si5351_fine_tune_params() for clk. Only those
+ * bytes that differ from the present settings are sent.
+ *
+ * Returns TRUE on failure
+ *
+ */
+	BOOL si5351_load_pll_params(Si5351_clock clk, uint8_t *params)
+	{
+		if((clk != SI5351_CLK0) || !g_pllA_ms_divider)
+		{
+			return(TRUE);
+		}
+
+		return(si5351_write_shadowed(SI5351_PLLA_PARAMETERS, SI5351_PARAMETERS_LENGTH, params));
+	}
+
+
+/*
+ * void si5351_forget_pll_params(Si5351_clock clk)
+ *
+ * Marks the PLL parameters used by clk as unknown, so that the next write of them is sent in
+ * full. The shadow is otherwise only updated by this driver's own writes.
+ *
+ */
+	void si5351_forget_pll_params(Si5351_clock clk)
+	{
+		if(clk == SI5351_CLK0)
+		{
+			shadow_store(SI5351_PLLA_PARAMETERS, SI5351_PARAMETERS_LENGTH, NULL, FALSE);
+		}
+	}
+
+
 /*
  * Frequency_Hz si5351_get_freq(Si5351_clock output)
  *
@@ -669,7 +852,7 @@
 	{
 		uint8_t reg_val;
 
-		if(si5351_read(SI5351_OUTPUT_ENABLE_CTRL, &reg_val)) return ERROR_CODE_RTC_NONRESPONSIVE;
+		if(si5351_read_shadowed(SI5351_OUTPUT_ENABLE_CTRL, &reg_val)) return ERROR_CODE_RTC_NONRESPONSIVE;
 
 		if(enable)
 		{
@@ -700,7 +883,7 @@
 		uint8_t reg_val;
 		const uint8_t mask = 0x03;
 
-		if(si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk, &reg_val))
+		if(si5351_read_shadowed(SI5351_CLK0_CTRL + (uint8_t)clk, &reg_val))
 		{
 			return ERROR_CODE_CLKGEN_NONRESPONSIVE;
 		}
@@ -846,7 +1029,6 @@
 #endif
 	{
 		Union_si5351_regs pll_reg;
-		uint8_t params[10];
 
 		/* Output Multisynth Settings (Synthesis Stage 2) */
 #ifdef DEBUGGING_ONLY
@@ -861,43 +1043,215 @@
 
 #endif
 
-		/* Derive the register values to write */
+		set_pll_registers(pll_reg, target_pll);
 
-		/* Prepare an array for parameters to be written to */
-		uint8_t i = 0;
-
-		/* Registers 26-27 */
-		params[i++] = pll_reg.reg.p3_1;
-		params[i++] = pll_reg.reg.p3_0;
+#ifdef DEBUGGING_ONLY
+			return(result);
+#endif
+	}
 
-		/* Register 28 */
-		params[i++] = pll_reg.reg.p1_2 & 0x03;
 
-		/* Registers 29-30 */
-		params[i++] = pll_reg.reg.p1_1;
-		params[i++] = pll_reg.reg.p1_0;
+/*
+ * set_pll_registers(Union_si5351_regs pll_reg, Si5351_pll target_pll)
+ *
+ * Writes feedback multisynth parameters to the specified PLL
+ *
+ */
+	void set_pll_registers(Union_si5351_regs pll_reg, Si5351_pll target_pll)
+	{
+		uint8_t params[SI5351_PARAMETERS_LENGTH];
 
-		/* Register 31 */
-		params[i] = pll_reg.reg.p3_2 << 4;
-		params[i++] += pll_reg.reg.p2_2 & 0x0F;
+		pack_parameters(pll_reg, params);
+		set_pll_parameters(target_pll, params);
+	}
 
-		/* Registers 32-33 */
-		params[i++] = pll_reg.reg.p2_1;
-		params[i++] = pll_reg.reg.p2_0;
 
-		/* Write the parameters */
+/*
+ * set_pll_parameters(Si5351_pll target_pll, uint8_t *params)
+ *
+ * Writes packed feedback multisynth parameters to the specified PLL
+ *
+ */
+	void set_pll_parameters(Si5351_pll target_pll, uint8_t *params)
+	{
 		if(target_pll == SI5351_PLLA)
 		{
-			si5351_write_bulk(SI5351_PLLA_PARAMETERS, i, params);
+			si5351_write_shadowed(SI5351_PLLA_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
 		}
 		else    /* if(target_pll == SI5351_PLLB) */
 		{
-			si5351_write_bulk(SI5351_PLLB_PARAMETERS, i, params);
+			si5351_write_shadowed(SI5351_PLLB_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
 		}
+	}
+
+
+/*
+ * pack_parameters(Union_si5351_regs reg, uint8_t *params)
+ *
+ * Arranges P1, P2 and P3 in the register order shared by the feedback (PLL) and output
+ * multisynths: registers 26-33 for PLLA; 42-49 for CLK0. Bits of the third byte other
+ * than P1[17:16] are left clear.
+ *
+ */
+	void pack_parameters(Union_si5351_regs reg, uint8_t *params)
+	{
+		params[0] = reg.reg.p3_1;
+		params[1] = reg.reg.p3_0;
+		params[2] = reg.reg.p1_2 & 0x03;
+		params[3] = reg.reg.p1_1;
+		params[4] = reg.reg.p1_0;
+		params[5] = (reg.reg.p3_2 << 4) | (reg.reg.p2_2 & 0x0F);
+		params[6] = reg.reg.p2_1;
+		params[7] = reg.reg.p2_0;
+	}
+
+
+/*
+ * uint8_t normalize_frequency(Frequency_Hz *freq_Fout)
+ *
+ * Applies the R divider selection and rounding used by si5351_set_freq() to freq_Fout,
+ * and returns the R divider setting.
+ *
+ */
+	uint8_t normalize_frequency(Frequency_Hz *freq_Fout)
+	{
+		uint8_t r_div = SI5351_OUTPUT_CLK_DIV_1;
+
+#ifdef SUPPORT_FOUT_BELOW_1024KHZ
+			/* Select the proper R div value used for Fout frequencies below 1.024 MHz */
+			r_div = select_r_div(freq_Fout);
+#endif
+
+#ifdef PREVENT_UNACHIEVABLE_FREQUENCIES
+			/* Prevent unachievable frequencies from being entered. The Si5351 will accept these, but some may result */
+			/* in no clock output. */
+			if(*freq_Fout > 999999)
+			{
+				*freq_Fout /= 100;
+				*freq_Fout *= 100;
+			}
+#endif
+
+		return(r_div);
+	}
+
+
+/*
+ * plan_cache_reset(void)
+ *
+ * Empties the frequency plan cache, then restores it from EEPROM if it was saved
+ * for the present reference frequency and correction.
+ *
+ */
+	void plan_cache_reset(void)
+	{
+		memset(g_plan_cache, 0, sizeof(g_plan_cache));
+		g_plan_next = 0;
+
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+			if((eeprom_read_dword((uint32_t*)&SI5351_SAVED_PLANS->xtal_freq) == xtal_freq) && ((int32_t)eeprom_read_dword((uint32_t*)&SI5351_SAVED_PLANS->correction) == g_si5351_ref_correction))
+			{
+				eeprom_read_block(g_plan_cache, SI5351_SAVED_PLANS->plans, sizeof(g_plan_cache));
+			}
+#endif
+	}
+
+
+/*
+ * Si5351Plan* plan_lookup(Frequency_Hz freq_Fout, Si5351_clock clk, uint8_t r_div)
+ *
+ * Returns the cached plan for freq_Fout (already normalized) on clk, or NULL. A plan for
+ * PLLB only matches if PLLB is at the frequency the plan was fitted to.
+ *
+ */
+	Si5351Plan* plan_lookup(Frequency_Hz freq_Fout, Si5351_clock clk, uint8_t r_div)
+	{
+		Frequency_Hz vcoB = (clk == SI5351_CLK0) ? 0 : freqVCOB;
+		uint8_t i;
+
+		for(i = 0; i < SI5351_PLAN_CACHE_SIZE; i++)
+		{
+			Si5351Plan *plan = &g_plan_cache[i];
+
+			if((plan->freq == freq_Fout) && (plan->clk == clk) && (plan->r_div == r_div) && (plan->vcoB == vcoB))
+			{
+				return(plan);
+			}
+		}
+
+		return(NULL);
+	}
+
+
+/*
+ * Si5351Plan* plan_compute(Frequency_Hz freq_Fout, Si5351_clock clk, uint8_t r_div)
+ *
+ * Calculates the register images for freq_Fout (already normalized) on clk, and stores
+ * them in place of the oldest cache entry. CLK0 gets PLLA; CLK1 and CLK2 share PLLB,
+ * which is only changed if no other clock has set it yet.
+ *
+ * Returns NULL if freq_Fout cannot be produced from PLLB as it is set.
+ *
+ */
+	Si5351Plan* plan_compute(Frequency_Hz freq_Fout, Si5351_clock clk, uint8_t r_div)
+	{
+		Si5351Plan *plan = &g_plan_cache[g_plan_next];
+		Union_si5351_regs reg;
+		Frequency_Hz freq_VCO = 0;
+		BOOL int_mode = FALSE;
+		BOOL div_by_4 = FALSE;
 
 #ifdef DEBUGGING_ONLY
-			return(result);
+			uint32_t div = 0;
+#endif
+
+		if((clk == SI5351_CLK0) || !freqVCOB)
+		{
+#ifdef DEBUGGING_ONLY
+				freq_VCO = multisynth_calc(freq_Fout, &reg, &int_mode, &div_by_4, &div);
+#else
+				freq_VCO = multisynth_calc(freq_Fout, &reg, &int_mode, &div_by_4);
+#endif
+		}
+		else if(!multisynth_estimate(freq_Fout, &reg, &int_mode, &div_by_4))
+		{
+			return(NULL);
+		}
+
+		g_plan_next = (g_plan_next + 1) % SI5351_PLAN_CACHE_SIZE;
+
+		plan->freq = freq_Fout;
+		plan->clk = clk;
+		plan->r_div = r_div;
+		plan->vcoB = (clk == SI5351_CLK0) ? 0 : freqVCOB;
+
+		pack_parameters(reg, plan->ms_params);
+		plan->ms_params[2] |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
+
+		if(div_by_4)
+		{
+			plan->ms_params[2] |= SI5351_OUTPUT_CLK_DIVBY4;
+		}
+
+		plan->int_mode = int_mode;
+		plan->freq_VCO = freq_VCO;
+		plan->ms_divider = (freq_VCO && (r_div == SI5351_OUTPUT_CLK_DIV_1)) ? (uint16_t)(freq_VCO / freq_Fout) : 0;
+
+		if(freq_VCO)
+		{
+#ifdef DEBUGGING_ONLY
+				pll_calc(freq_VCO, &reg, g_si5351_ref_correction);
+#else
+	#ifdef APPLY_XTAL_CALIBRATION_VALUE
+			pll_calc(freq_VCO, &reg, g_si5351_ref_correction);
+	#else
+			pll_calc(freq_VCO, &reg);
+	#endif
 #endif
+			pack_parameters(reg, plan->pll_params);
+		}
+
+		return(plan);
 	}
 
 
@@ -948,7 +1302,11 @@
  */
 	void si5351_set_correction(int32_t corr)
 	{
-		g_si5351_ref_correction = corr;
+		if(corr != g_si5351_ref_correction)
+		{
+			g_si5351_ref_correction = corr;
+			plan_cache_reset();
+		}
 	}
 
 
@@ -963,6 +1321,27 @@
 	}
 
 
+/*
+ * Frequency_Hz reference_frequency(void)
+ *
+ * Returns the reference frequency, including any crystal correction, as used by pll_calc()
+ *
+ */
+	Frequency_Hz reference_frequency(void)
+	{
+		Frequency_Hz ref_freq = xtal_freq;
+
+#ifdef APPLY_XTAL_CALIBRATION_VALUE
+			if(g_si5351_ref_correction)
+			{
+				ref_freq += (int32_t)((((((int64_t)g_si5351_ref_correction) << 31) / 1000000000LL) * ref_freq) >> 31);
+			}
+#endif
+
+		return(ref_freq);
+	}
+
+
 /*
  * BOOL pll_calc(Frequency_Hz vco_freq, Union_si5351_regs *reg, int32_t correction)
  *
@@ -1025,6 +1404,13 @@
 
 		reduce_by_gcd(&b, &c);
 
+		/* P3 is limited to 20 bits; a corrected reference frequency seldom reduces that far */
+		if(c > SI5351_PLL_C_MAX)
+		{
+			b = (uint32_t)(((uint64_t)b * SI5351_PLL_C_MAX) / c);
+			c = SI5351_PLL_C_MAX;
+		}
+
 		uint32_t bx128 = b << 7;
 		uint32_t bx128overc = bx128 / c;
 		reg->ms.p1 = (uint32_t)((a << 7) + bx128overc) - 512;   /* 128 * a + floor((128 * b) / c) - 512 */
@@ -1193,6 +1579,9 @@
 /*
  * Frequency_Hz multisynth_estimate(Frequency_Hz freq_Fout, Union_si5351_regs *reg, BOOL *int_mode, BOOL *divBy4)
  *
+ * Fits the multisynth divider to the present PLLB frequency. Returns the approximate output
+ * frequency, or zero if freq_Fout cannot be produced from PLLB as it is set.
+ *
  * Note: do not call this function with global value freqVCOB == zero
  */
 	Frequency_Hz multisynth_estimate(Frequency_Hz freq_Fout, Union_si5351_regs *reg, BOOL *int_mode, BOOL *divBy4)
@@ -1227,6 +1616,19 @@
 		c = freq_Fout;
 		reduce_by_gcd(&b, &c);  /* prevents overflow conditions and makes results agree with ClockBuilder */
 
+		/* Below 8 the multisynth can only divide by 4 or 6: the other clock's PLLB frequency rules this output out */
+		if((a < 4) || ((a < 8) && (b || (a & 1))))
+		{
+			return(0);
+		}
+
+		/* P3 is limited to 20 bits; approximate b/c if the GCD did not reduce it enough */
+		if(c > SI5351_MULTISYNTH_C_MAX)
+		{
+			b = (uint32_t)(((uint64_t)b * SI5351_MULTISYNTH_C_MAX) / c);
+			c = SI5351_MULTISYNTH_C_MAX;
+		}
+
 		/* Calculate the approximated output frequency given by fOUT = fvco / (a + b/c) */
 		freq_Fout = freqVCOB;
 		freq_Fout /= (a * c + b);
@@ -1260,9 +1662,68 @@
 		return(i2c_device_write(SI5351_I2C_SLAVE_ADDR, addr, data, bytes));
 	}
 
+/*
+ * BOOL si5351_write_shadowed(uint8_t addr, uint8_t bytes, uint8_t *data)
+ *
+ * Writes only those of the registers addr...addr+bytes-1 whose shadowed values differ from data[].
+ * Changed bytes separated by no more than SI5351_BURST_MERGE_GAP unchanged bytes are sent in one burst.
+ *
+ * Returns TRUE on failure
+ */
+	BOOL si5351_write_shadowed(uint8_t addr, uint8_t bytes, uint8_t *data)
+	{
+		BOOL err = FALSE;
+		uint8_t i = 0;
+
+		while(i < bytes)
+		{
+			uint8_t start, end, gap = 0;
+
+			while((i < bytes) && shadow_is_current(addr + i, data[i]))
+			{
+				i++;
+			}
+
+			if(i >= bytes)
+			{
+				break;
+			}
+
+			start = i;
+			end = i;
+
+			for(i = start + 1; i < bytes; i++)
+			{
+				if(!shadow_is_current(addr + i, data[i]))
+				{
+					end = i;
+					gap = 0;
+				}
+				else if(++gap > SI5351_BURST_MERGE_GAP)
+				{
+					break;
+				}
+			}
+
+			i = end + 1;
+
+			if(si5351_write_bulk(addr + start, i - start, &data[start]))
+			{
+				shadow_store(addr + start, i - start, &data[start], FALSE);
+				err = TRUE;
+			}
+			else
+			{
+				shadow_store(addr + start, i - start, &data[start], TRUE);
+			}
+		}
+
+		return(err);
+	}
+
 	BOOL si5351_write(uint8_t addr, uint8_t data)
 	{
-		return(i2c_device_write(SI5351_I2C_SLAVE_ADDR, addr, &data, 1));
+		return(si5351_write_shadowed(addr, 1, &data));
 	}
 
 	BOOL si5351_read(uint8_t addr, uint8_t *data)
@@ -1270,6 +1731,79 @@
 		return(i2c_device_read(SI5351_I2C_SLAVE_ADDR, addr, data, 1));
 	}
 
+/*
+ * BOOL si5351_read_shadowed(uint8_t addr, uint8_t *data)
+ *
+ * Returns the shadowed value of a register, reading it from the device only if it is not yet known.
+ *
+ * Returns TRUE on failure
+ */
+	BOOL si5351_read_shadowed(uint8_t addr, uint8_t *data)
+	{
+		uint8_t i = addr - SI5351_SHADOW_FIRST;
+
+		if((addr >= SI5351_SHADOW_FIRST) && (addr <= SI5351_SHADOW_LAST) && (g_shadow_valid[i >> 3] & (1 << (i & 0x07))))
+		{
+			*data = g_shadow[i];
+			return(FALSE);
+		}
+
+		if(si5351_read(addr, data))
+		{
+			return(TRUE);
+		}
+
+		shadow_store(addr, 1, data, TRUE);
+
+		return(FALSE);
+	}
+
+/*
+ * BOOL shadow_is_current(uint8_t addr, uint8_t data)
+ *
+ * Returns TRUE if the device register is known to hold data
+ */
+	BOOL shadow_is_current(uint8_t addr, uint8_t data)
+	{
+		uint8_t i = addr - SI5351_SHADOW_FIRST;
+
+		if((addr < SI5351_SHADOW_FIRST) || (addr > SI5351_SHADOW_LAST))
+		{
+			return(FALSE);
+		}
+
+		return((g_shadow_valid[i >> 3] & (1 << (i & 0x07))) && (g_shadow[i] == data));
+	}
+
+/*
+ * void shadow_store(uint8_t addr, uint8_t bytes, uint8_t *data, BOOL valid)
+ *
+ * Records values written to the device. If valid is FALSE, the registers are marked unknown instead.
+ */
+	void shadow_store(uint8_t addr, uint8_t bytes, uint8_t *data, BOOL valid)
+	{
+		while(bytes--)
+		{
+			if((addr >= SI5351_SHADOW_FIRST) && (addr <= SI5351_SHADOW_LAST))
+			{
+				uint8_t i = addr - SI5351_SHADOW_FIRST;
+
+				if(valid)
+				{
+					g_shadow[i] = *data;
+					g_shadow_valid[i >> 3] |= (1 << (i & 0x07));
+				}
+				else
+				{
+					g_shadow_valid[i >> 3] &= ~(1 << (i & 0x07));
+				}
+			}
+
+			addr++;
+			data++;
+		}
+	}
+
 
 #ifdef SUPPORT_STATUS_READS
 		BOOL si5351_read_sys_status(Si5351Status *status)
@@ -1326,7 +1860,7 @@
 		uint8_t reg_val;
 		uint8_t addr = SI5351_CLK0_CTRL + (uint8_t)clk;
 
-		if(si5351_read(addr, &reg_val))
+		if(si5351_read_shadowed(addr, &reg_val))
 		{
 			return;
 		}
@@ -1345,65 +1879,33 @@
 
 
 /*
- * set_multisynth_registers(Si5351_clock clk, Union_si5351_regs ms_reg, BOOL int_mode, uint8_t r_div, BOOL div_by_4)
+ * set_multisynth_parameters(Si5351_clock clk, uint8_t *params)
  *
- * Set the specified multisynth parameters.
+ * Writes packed multisynth parameters, including the R divider and divide-by-4 bits,
+ * for the specified clock.
  *
  * clk - Clock output (use the si5351_clock enum)
- * int_mode - 1 to enable, 0 to disable
- * r_div - Desired r_div ratio
- * div_by_4 - 1 Divide By 4 mode: 0 to disable
  *
  */
-	void set_multisynth_registers(Si5351_clock clk, Union_si5351_regs ms_reg, BOOL int_mode, uint8_t r_div, BOOL div_by_4)
+	void set_multisynth_parameters(Si5351_clock clk, uint8_t *params)
 	{
-		uint8_t params[10];
-		uint8_t i = 0;
-		uint8_t reg_val;
-
-		/* Registers 42-43 for CLK0; 50-51 for CLK1 */
-		params[i++] = ms_reg.reg.p3_1;
-		params[i++] = ms_reg.reg.p3_0;
-
-		/* Register 44 for CLK0; 52 for CLK1 */
-		if(si5351_read((SI5351_CLK0_PARAMETERS + 2) + (clk * 8), &reg_val))
-		{
-			return;
-		}
-
-		reg_val &= 0xFC;    /*~(0x03); */
-		params[i++] = reg_val | (ms_reg.reg.p1_2 & 0x03);
-
-		/* Registers 45-46 for CLK0 */
-		params[i++] = ms_reg.reg.p1_1;
-		params[i++] = ms_reg.reg.p1_0;
-
-		/* Register 47 for CLK0 */
-		params[i] = (ms_reg.reg.p3_2 << 4);
-		params[i++] += (ms_reg.reg.p2_2 & 0x0F);
-
-		/* Registers 48-49 for CLK0 */
-		params[i++] = ms_reg.reg.p2_1;
-		params[i++] = ms_reg.reg.p2_0;
-
-		/* Write the parameters */
 		switch(clk)
 		{
 			case SI5351_CLK0:
 			{
-				si5351_write_bulk(SI5351_CLK0_PARAMETERS, i, params);
+				si5351_write_shadowed(SI5351_CLK0_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
 			}
 			break;
 
 			case SI5351_CLK1:
 			{
-				si5351_write_bulk(SI5351_CLK1_PARAMETERS, i, params);
+				si5351_write_shadowed(SI5351_CLK1_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
 			}
 			break;
 
 			case SI5351_CLK2:
 			{
-				si5351_write_bulk(SI5351_CLK2_PARAMETERS, i, params);
+				si5351_write_shadowed(SI5351_CLK2_PARAMETERS, SI5351_PARAMETERS_LENGTH, params);
 			}
 			break;
 
@@ -1412,9 +1914,6 @@
 			}
 			break;
 		}
-
-		set_integer_mode(clk, int_mode);
-		ms_div(clk, r_div, div_by_4);
 	}
 
 
@@ -1430,7 +1929,7 @@
 	{
 		uint8_t reg_val;
 
-		if(si5351_read(SI5351_CLK0_CTRL + (uint8_t)clk, &reg_val))
+		if(si5351_read_shadowed(SI5351_CLK0_CTRL + (uint8_t)clk, &reg_val))
 		{
 			return;
 		}
@@ -1448,54 +1947,4 @@
 	}
 
 
-	void ms_div(Si5351_clock clk, uint8_t r_div, BOOL div_by_4)
-	{
-		uint8_t reg_val, reg_addr;
-
-		switch(clk)
-		{
-			case SI5351_CLK0:
-			{
-				reg_addr = SI5351_CLK0_PARAMETERS + 2;
-			}
-			break;
-
-			case SI5351_CLK1:
-			{
-				reg_addr = SI5351_CLK1_PARAMETERS + 2;
-			}
-			break;
-
-			case SI5351_CLK2:
-			{
-				reg_addr = SI5351_CLK2_PARAMETERS + 2;
-			}
-			break;
-
-			default:
-				return;
-		}
-
-		if(si5351_read(reg_addr, &reg_val))
-		{
-			return;
-		}
-
-		/* Clear the appropriate bits */
-		reg_val &= ~(0x7c);
-
-		if(div_by_4)
-		{
-			reg_val |= (SI5351_OUTPUT_CLK_DIVBY4);
-		}
-		else
-		{
-			reg_val &= ~(SI5351_OUTPUT_CLK_DIVBY4);
-		}
-
-		reg_val |= (r_div << SI5351_OUTPUT_CLK_DIV_SHIFT);
-
-		si5351_write(reg_addr, reg_val);
-	}
-
 #endif  /* #ifdef INCLUDE_SI5351_SUPPORT */
@@ -131,6 +131,7 @@
 #define DIVIDE_XTAL_FREQ_IF_NEEDED
 #define APPLY_XTAL_CALIBRATION_VALUE
 #define SUPPORT_STATUS_READS
+#define SI5351_PERSIST_FREQUENCY_PLANS
 */
 #define PREVENT_UNACHIEVABLE_FREQUENCIES
 /*
@@ -144,6 +145,8 @@
 /*
  ****************************************************************************************************************/
 
+#define SI5351_I2C_SLAVE_ADDR                           0xC0    /* I2C slave address */
+
 #define SI5351_XTAL_FREQ                                25000000UL
 #define SI5351_PLL_FIXED                                900000000UL
 
@@ -215,6 +218,8 @@
 #define SI5351_CLK_DISABLE_STATE_FLOAT                  2
 #define SI5351_CLK_DISABLE_STATE_NEVER                  3
 
+#define SI5351_PLAN_CACHE_SIZE                          4   /* frequencies whose register images are kept for fast switching: the 2m and 80m carriers, with room to spare */
+#define SI5351_PLANS_EEPROM_ADDRESS                     0x0C0   /* fixed, above the legacy settings (legacy.h) and below the journal */
 #define SI5351_PARAMETERS_LENGTH                        8
 #define SI5351_PLLA_PARAMETERS                          26
 #define SI5351_PLLB_PARAMETERS                          34
@@ -443,6 +448,40 @@ BOOL si5351_init(Si5351_Xtal_load_pF, Frequency_Hz);
  */
 BOOL si5351_set_freq(Frequency_Hz, Si5351_clock, BOOL clocksOff);
 
+/**
+ * Retunes CLK0 without changing its multisynth divider. Returns TRUE if si5351_set_freq() is needed instead.
+ */
+BOOL si5351_fine_tune(Frequency_Hz, Si5351_clock);
+
+/**
+ * Calculates, but does not write, the PLL parameters for si5351_fine_tune(). Returns TRUE if the frequency is unreachable.
+ */
+BOOL si5351_fine_tune_params(Frequency_Hz, Si5351_clock, uint8_t *);
+
+/**
+ * Writes PLL parameters from si5351_fine_tune_params(). Only changed bytes are sent.
+ */
+BOOL si5351_load_pll_params(Si5351_clock, uint8_t *);
+
+/**
+ * Marks the PLL parameters of the clock as unknown, so that the next write sends them in full. Call after writing them
+ * other than through this driver, e.g., with i2c_submit().
+ */
+void si5351_forget_pll_params(Si5351_clock);
+
+/**
+ * Returns TRUE if si5351_set_freq() can set the frequency from cached register images, without calculation.
+ */
+BOOL si5351_plan_cached(Frequency_Hz, Si5351_clock);
+
+#ifdef SI5351_PERSIST_FREQUENCY_PLANS
+/**
+ * Saves cached register images to EEPROM. They are restored when the same reference and correction are next in use.
+ * At some 140 bytes the cache is too large to save routinely: call this only when the user asks for settings to be stored.
+ */
+	void si5351_save_plans(void);
+#endif
+
 /**
  */
 Frequency_Hz si5351_get_frequency(Si5351_clock clock);
@@ -0,0 +1,90 @@
+/*
+ * calendar_test.c
+ *
+ * Checks the transmitter's calendar conversions against the host C library for every day
+ * from 2000-01-01 through 2099-12-31:
+ *
+ * - days_from_civil() and civil_from_days() are inverses and agree with gmtime()
+ * - weekday_from_days() agrees with gmtime()
+ * - convertTimeStringToEpoch() parses "yyyy-mm-ddThh:mm:ss" and "yyyy-mm-ddThh:mm" to the
+ *   same epoch as the host, with the time of day varied from one day to the next
+ *
+ * Malformed strings must be rejected with 0.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "util.h"
+
+#define FIRST_EPOCH 946684800LL    /* 2000-01-01T00:00:00Z */
+#define END_EPOCH 4102444800LL     /* 2100-01-01T00:00:00Z */
+
+static int g_failures = 0;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(g_failures++ < 20) { printf("FAIL: " __VA_ARGS__); printf("\n"); } } } while(0)
+
+static void checkEveryDay(void)
+{
+	long long t;
+	long n = 0;
+
+	for(t = FIRST_EPOCH; t < END_EPOCH; t += SECONDS_PER_DAY, n++)
+	{
+		time_t tt = (time_t)t;
+		struct tm g;
+		uint32_t days;
+		uint16_t year;
+		uint8_t month, day;
+		int hh = n % 24, mm = (n * 7) % 60, ss = (n * 13) % 60;
+		char s[48];
+
+		gmtime_r(&tt, &g);
+		days = days_from_civil(g.tm_year + 1900, g.tm_mon + 1, g.tm_mday);
+		CHECK(days == t / SECONDS_PER_DAY, "days_from_civil(%d-%02d-%02d) = %u, expected %lld", g.tm_year + 1900, g.tm_mon + 1, g.tm_mday, days, t / SECONDS_PER_DAY);
+
+		civil_from_days((uint32_t)(t / SECONDS_PER_DAY), &year, &month, &day);
+		CHECK((year == g.tm_year + 1900) && (month == g.tm_mon + 1) && (day == g.tm_mday), "civil_from_days(%lld) = %u-%02u-%02u, expected %d-%02d-%02d", t / SECONDS_PER_DAY, year, month, day, g.tm_year + 1900, g.tm_mon + 1, g.tm_mday);
+
+		CHECK(weekday_from_days((uint32_t)(t / SECONDS_PER_DAY)) == g.tm_wday, "weekday_from_days(%lld) = %u, expected %d", t / SECONDS_PER_DAY, weekday_from_days((uint32_t)(t / SECONDS_PER_DAY)), g.tm_wday);
+
+		sprintf(s, "%04d-%02d-%02dT%02d:%02d:%02d", g.tm_year + 1900, g.tm_mon + 1, g.tm_mday, hh, mm, ss);
+		CHECK((uint32_t)convertTimeStringToEpoch(s) == (uint32_t)(t + hh * 3600 + mm * 60 + ss), "convertTimeStringToEpoch(\"%s\") = %u", s, (uint32_t)convertTimeStringToEpoch(s));
+
+		s[16] = '\0';   /* without seconds */
+		CHECK((uint32_t)convertTimeStringToEpoch(s) == (uint32_t)(t + hh * 3600 + mm * 60), "convertTimeStringToEpoch(\"%s\") = %u", s, (uint32_t)convertTimeStringToEpoch(s));
+	}
+
+	printf("calendar: checked %ld days\n", n);
+}
+
+static void checkMalformed(void)
+{
+	static const char* const bad[] = {
+		"", "2018-03-23", "2018-03-23T18", "2018-3-23T18:00:00", "1969-12-31T23:59:59",
+		"2018-00-23T18:00", "2018-13-23T18:00", "2018-03-00T18:00", "2018-03-32T18:00",
+		"2018-03-23T24:00", "2018-03-23T18:60", "2018-03-23T18:00:60", "2018-03-23T1a:00",
+		"20x8-03-23T18:00", "2018-03-23T18:00:5x" };
+	char s[32];
+	unsigned i;
+
+	for(i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+	{
+		strcpy(s, bad[i]);
+		CHECK(convertTimeStringToEpoch(s) == 0, "convertTimeStringToEpoch(\"%s\") accepted a malformed string", bad[i]);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	checkEveryDay();
+	checkMalformed();
+
+	CHECK(timeDif(5, 10) == -5, "timeDif(5, 10) = %ld", (long)timeDif(5, 10));
+	CHECK(timeDif(0, 0xFFFFFFFFUL) == 1, "timeDif() does not wrap");
+
+	printf("%s: %d failure(s)\n", argv[0], g_failures);
+	return( g_failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,533 @@
+/*
+ * legacy_test.c
+ *
+ * Boots the journal over EEPROM images saved by firmware that predates it, and checks that
+ * legacy_migrate() moves every setting into the journal:
+ *
+ * - the settings read back from the journal are those in the image
+ * - the data still kept outside the journal (the transmitter's power tables, the receiver's
+ *   frequency memories) is left where it was
+ * - the flags that guard a migration are cleared, so a second boot finds the journal and
+ *   migrates nothing
+ * - a blank EEPROM migrates nothing
+ *
+ * The images are built from structures that mirror the EEMEM variables of each legacy build
+ * as its linker placed them, rather than from the addresses in legacy.h, so that a wrong
+ * address there fails the test. The host, like the ATmega328P, is little-endian.
+ *
+ * The transmitter build takes the path of Debug/RDP.eep, the EEPROM image of the firmware
+ * that gave layout 1. Build with -DRECEIVER_FIRMWARE against the receiver's sources.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include "journal.h"
+#include "legacy.h"
+#ifdef RECEIVER_FIRMWARE
+#include "receiver.h"
+#else
+#include "transmitter.h"
+#endif
+
+#define EEPROM_SIZE (E2END + 1)
+#define JOURNAL_START (EEPROM_SIZE - 2 * JOURNAL_SECTOR_SIZE)
+#define NO_RECORD 0xDEADBEEFUL
+
+static uint8_t g_eeprom[EEPROM_SIZE];
+static int g_failures = 0;
+
+#define CHECK(cond, ...) do { if(!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); g_failures++; } } while(0)
+
+/**
+ * EEPROM access, over g_eeprom. Addresses are the pointer values themselves.
+ */
+static uint8_t* cell(const void* p, size_t n)
+{
+	uintptr_t a = (uintptr_t)p;
+
+	if(a + n > EEPROM_SIZE)
+	{
+		printf("FAIL: EEPROM access of %u bytes at 0x%03X\n", (unsigned)n, (unsigned)a);
+		exit(EXIT_FAILURE);
+	}
+
+	return( &g_eeprom[a]);
+}
+
+uint8_t eeprom_read_byte(const uint8_t* p)
+{
+	return( *cell(p, 1));
+}
+
+uint16_t eeprom_read_word(const uint16_t* p)
+{
+	uint8_t* c = cell(p, 2);
+	return( c[0] | (c[1] << 8));
+}
+
+uint32_t eeprom_read_dword(const uint32_t* p)
+{
+	uint8_t* c = cell(p, 4);
+	return( c[0] | (c[1] << 8) | ((uint32_t)c[2] << 16) | ((uint32_t)c[3] << 24));
+}
+
+void eeprom_read_block(void* dst, const void* src, size_t n)
+{
+	memcpy(dst, cell(src, n), n);
+}
+
+void eeprom_write_byte(uint8_t* p, uint8_t value)
+{
+	*cell(p, 1) = value;
+}
+
+void eeprom_write_dword(uint32_t* p, uint32_t value)
+{
+	uint8_t* c = cell(p, 4);
+	uint8_t i;
+
+	for(i = 0; i < 4; i++)
+	{
+		c[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+void eeprom_update_byte(uint8_t* p, uint8_t value)
+{
+	eeprom_write_byte(p, value);
+}
+
+void eeprom_update_word(uint16_t* p, uint16_t value)
+{
+	uint8_t* c = cell(p, 2);
+	c[0] = (uint8_t)value;
+	c[1] = (uint8_t)(value >> 8);
+}
+
+void eeprom_update_dword(uint32_t* p, uint32_t value)
+{
+	eeprom_write_dword(p, value);
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t n)
+{
+	memcpy(cell(dst, n), src, n);
+}
+
+/**
+ * Runs the startup sequence of main(): returns the schema version journal_init() found.
+ */
+static uint8_t boot(void)
+{
+	uint8_t version = journal_init();
+
+	if(version == JOURNAL_SCHEMA_LEGACY)
+	{
+		legacy_migrate();
+	}
+
+	return( version);
+}
+
+static uint32_t readTag(JournalTag tag)
+{
+	uint32_t value = 0;
+
+	if(!journal_length(tag))
+	{
+		return( NO_RECORD);
+	}
+
+	CHECK(journal_length(tag) <= sizeof(value), "tag %d is not a scalar", tag);
+	journal_read(tag, &value, journal_length(tag));   /* little-endian, as on the ATmega328P */
+	return( value);
+}
+
+static void checkTag(const char* image, JournalTag tag, uint32_t expected)
+{
+	uint32_t value = readTag(tag);
+	CHECK(value == expected, "%s: tag %d holds 0x%lX, expected 0x%lX", image, tag, (unsigned long)value, (unsigned long)expected);
+}
+
+static void checkNoTags(const char* image)
+{
+	uint8_t tag;
+
+	for(tag = 0; tag < JOURNAL_NUMBER_OF_TAGS; tag++)
+	{
+		CHECK(!journal_length(tag), "%s: tag %d was migrated", image, tag);
+	}
+}
+
+/**
+ * Boots twice: the first boot must migrate, the second must find the journal unchanged.
+ */
+static void migrate(const char* image)
+{
+	uint8_t before[JOURNAL_START];
+
+	CHECK(boot() == JOURNAL_SCHEMA_LEGACY, "%s: journal found before migration", image);
+	memcpy(before, g_eeprom, JOURNAL_START);
+	CHECK(boot() == JOURNAL_SCHEMA_VERSION, "%s: no journal after migration", image);
+	CHECK(!memcmp(before, g_eeprom, JOURNAL_START), "%s: second boot wrote below the journal", image);
+}
+
+static void checkBlank(void)
+{
+	memset(g_eeprom, 0xFF, sizeof(g_eeprom));
+	migrate("blank");
+	checkNoTags("blank");
+	printf("blank: nothing migrated\n");
+}
+
+#ifndef RECEIVER_FIRMWARE
+
+/* Layout 1: the EEMEM variables of main.o, then transmitter.o, as nm lists them in Debug/RDP.elf */
+typedef struct __attribute__((packed))
+{
+	uint8_t interface_flag;
+	char stationID_text[20];
+	char pattern_text[20];
+	uint8_t pattern_codespeed;
+	uint8_t id_codespeed;
+	uint16_t on_air_time;
+	uint16_t off_air_time;
+	uint16_t intra_cycle_delay_time;
+	uint16_t ID_time;
+	uint32_t start_time;
+	uint32_t finish_time;
+
+	uint8_t transmitter_flag;
+	int32_t si5351_ref_correction;
+	uint8_t active_band;
+	uint32_t active_2m_frequency;
+	uint8_t power_level_2m;
+	uint32_t active_80m_frequency;
+	uint8_t power_level_80m;
+	uint32_t cw_offset_frequency;
+	uint8_t am_drive_level;
+	uint8_t cw_drive_level;
+	uint8_t active_2m_modulation;
+} Layout1;
+
+#define LAYOUT1_EEPROM_END 0x52     /* __eeprom_end in Debug/RDP.elf */
+
+/* Layout 2: the EEMEM variables of main.c, then transmitter.c, in declaration order */
+typedef struct __attribute__((packed))
+{
+	uint8_t interface_flag;
+	char stationID_text[21];
+	char pattern_text[21];
+	uint8_t pattern_codespeed;
+	uint8_t id_codespeed;
+	uint16_t on_air_time;
+	uint16_t off_air_time;
+	uint16_t intra_cycle_delay_time;
+	uint16_t ID_time;
+	uint32_t start_time;
+	uint32_t finish_time;
+	uint16_t battery_empty_mV;
+	uint8_t clock_OSCCAL;
+
+	uint8_t transmitter_flag;
+	int32_t si5351_ref_correction;
+	uint8_t active_band;
+	uint32_t active_2m_frequency;
+	uint16_t power_level_2m_mW;
+	uint32_t active_80m_frequency;
+	uint16_t power_level_80m_mW;
+	uint32_t cw_offset_frequency;
+	uint8_t am_drive_level_high;
+	uint8_t am_drive_level_low;
+	uint8_t active_2m_modulation;
+	uint8_t power_tables[6][16];    /* 80m, 2m AM power, 2m AM drive low, 2m AM drive high, 2m CW power, 2m CW drive */
+} Layout2;
+
+/**
+ * Reads an Intel HEX file into g_eeprom. Returns nonzero on failure.
+ */
+static int loadHex(const char* path)
+{
+	char line[128];
+	FILE* f = fopen(path, "r");
+
+	if(!f)
+	{
+		return( 1);
+	}
+
+	while(fgets(line, sizeof(line), f))
+	{
+		unsigned count, address, type, byte, i;
+
+		if((sscanf(line, ":%2x%4x%2x", &count, &address, &type) != 3) || (type == 1))
+		{
+			break;
+		}
+
+		for(i = 0; (type == 0) && (i < count) && (address + i < EEPROM_SIZE); i++)
+		{
+			sscanf(&line[9 + 2 * i], "%2x", &byte);
+			g_eeprom[address + i] = (uint8_t)byte;
+		}
+	}
+
+	fclose(f);
+	return( 0);
+}
+
+static void checkText(const char* image, JournalTag tag, const char* expected)
+{
+	char text[JOURNAL_MAX_DATA_LENGTH] = "";
+
+	journal_read(tag, text, journal_length(tag));
+	CHECK(!strcmp(text, expected), "%s: tag %d holds \"%s\", expected \"%s\"", image, tag, text, expected);
+}
+
+/**
+ * The shipped image, as a unit leaves it once its interface settings are saved.
+ */
+static void checkLayout1(const char* eep)
+{
+	const char* image = "layout 1";
+	Layout1* ee = (Layout1*)g_eeprom;
+
+	CHECK(sizeof(Layout1) == LAYOUT1_EEPROM_END, "%s: %u bytes, expected %u", image, (unsigned)sizeof(Layout1), LAYOUT1_EEPROM_END);
+
+	memset(g_eeprom, 0xFF, sizeof(g_eeprom));
+	CHECK(!loadHex(eep), "cannot read %s", eep);
+	CHECK(ee->transmitter_flag == LEGACY1_INITIALIZED_FLAG, "%s: %s does not hold layout 1", image, eep);
+
+	ee->interface_flag = LEGACY1_INITIALIZED_FLAG;
+	memcpy(ee->stationID_text, "DE W1AW/FOX-NUMBER-1", 20);    /* fills the array: the last character is lost */
+	strcpy(ee->pattern_text, "MOE");
+	ee->pattern_codespeed = 8;
+	ee->id_codespeed = 20;
+	ee->on_air_time = 60;
+	ee->off_air_time = 240;
+	ee->intra_cycle_delay_time = 120;
+	ee->ID_time = 600;
+	ee->start_time = 1500000000UL;
+	ee->finish_time = 1500007200UL;
+	ee->si5351_ref_correction = -1234;
+
+	migrate(image);
+
+	checkTag(image, JOURNAL_TAG_SI5351_REF_CORRECTION, (uint32_t)-1234L);
+	checkTag(image, JOURNAL_TAG_ACTIVE_BAND, BAND_80M);
+	checkTag(image, JOURNAL_TAG_2M_FREQUENCY, 145566000UL);
+	checkTag(image, JOURNAL_TAG_80M_FREQUENCY, 3550000UL);
+	checkTag(image, JOURNAL_TAG_RTTY_OFFSET_FREQUENCY, 170);
+	checkTag(image, JOURNAL_TAG_2M_MODULATION, MODE_AM);
+	checkTag(image, JOURNAL_TAG_2M_POWER_LEVEL_MW, NO_RECORD);
+	checkTag(image, JOURNAL_TAG_80M_POWER_LEVEL_MW, NO_RECORD);
+	checkTag(image, JOURNAL_TAG_AM_DRIVE_LEVEL_HIGH, NO_RECORD);
+	checkTag(image, JOURNAL_TAG_AM_DRIVE_LEVEL_LOW, NO_RECORD);
+
+	checkText(image, JOURNAL_TAG_STATION_ID_TEXT, "DE W1AW/FOX-NUMBER-");
+	checkText(image, JOURNAL_TAG_PATTERN_TEXT, "MOE");
+	checkTag(image, JOURNAL_TAG_PATTERN_CODESPEED, 8);
+	checkTag(image, JOURNAL_TAG_ID_CODESPEED, 20);
+	checkTag(image, JOURNAL_TAG_ON_AIR_TIME, 60);
+	checkTag(image, JOURNAL_TAG_OFF_AIR_TIME, 240);
+	checkTag(image, JOURNAL_TAG_INTRA_CYCLE_DELAY_TIME, 120);
+	checkTag(image, JOURNAL_TAG_ID_TIME, 600);
+	checkTag(image, JOURNAL_TAG_EVENT_START_TIME, 1500000000UL);
+	checkTag(image, JOURNAL_TAG_EVENT_FINISH_TIME, 1500007200UL);
+	checkTag(image, JOURNAL_TAG_BATTERY_EMPTY_MV, NO_RECORD);
+	checkTag(image, JOURNAL_TAG_CLOCK_OSCCAL, NO_RECORD);
+
+	CHECK(ee->interface_flag != LEGACY1_INITIALIZED_FLAG, "%s: interface flag not cleared", image);
+	CHECK(ee->transmitter_flag != LEGACY1_INITIALIZED_FLAG, "%s: transmitter flag not cleared", image);
+	printf("%s: migrated from %s\n", image, eep);
+}
+
+/**
+ * The last firmware before the journal. The modulation formats were renumbered between the
+ * layouts, so MODE_CW here checks that layout 1's numbering is not applied.
+ */
+static void checkLayout2(void)
+{
+	const char* image = "layout 2";
+	Layout2* ee = (Layout2*)g_eeprom;
+	uint8_t* const tables[6] = { LEGACY2_80M_POWER_TABLE, LEGACY2_2M_AM_POWER_TABLE, LEGACY2_2M_AM_DRIVE_LOW_TABLE, LEGACY2_2M_AM_DRIVE_HIGH_TABLE, LEGACY2_2M_CW_POWER_TABLE, LEGACY2_2M_CW_DRIVE_TABLE };
+	uint8_t saved[6][16];
+	uint8_t i;
+
+	memset(g_eeprom, 0xFF, sizeof(g_eeprom));
+	ee->interface_flag = LEGACY2_INITIALIZED_FLAG;
+	strcpy(ee->stationID_text, "DE W1AW/FOX-NUMBER-1");
+	strcpy(ee->pattern_text, "MOS");
+	ee->pattern_codespeed = 10;
+	ee->id_codespeed = 18;
+	ee->on_air_time = 30;
+	ee->off_air_time = 90;
+	ee->intra_cycle_delay_time = 45;
+	ee->ID_time = 300;
+	ee->start_time = 1600000000UL;
+	ee->finish_time = 1600003600UL;
+	ee->battery_empty_mV = 3350;
+	ee->clock_OSCCAL = 0x9C;
+
+	ee->transmitter_flag = LEGACY2_INITIALIZED_FLAG;
+	ee->si5351_ref_correction = 5678;
+	ee->active_band = BAND_2M;
+	ee->active_2m_frequency = 144500000UL;
+	ee->power_level_2m_mW = 250;
+	ee->active_80m_frequency = 3520000UL;
+	ee->power_level_80m_mW = 1500;
+	ee->cw_offset_frequency = 600;
+	ee->am_drive_level_high = 0xE0;
+	ee->am_drive_level_low = 0x20;
+	ee->active_2m_modulation = MODE_CW;
+
+	for(i = 0; i < 6; i++)
+	{
+		memset(ee->power_tables[i], 0x10 * (i + 1), 16);
+		CHECK((uintptr_t)tables[i] == offsetof(Layout2, power_tables[i]), "%s: power table %u pinned at 0x%03X, was at 0x%03X", image, i, (unsigned)(uintptr_t)tables[i], (unsigned)offsetof(Layout2, power_tables[i]));
+	}
+
+	memcpy(saved, ee->power_tables, sizeof(saved));
+
+	migrate(image);
+
+	checkTag(image, JOURNAL_TAG_SI5351_REF_CORRECTION, 5678);
+	checkTag(image, JOURNAL_TAG_ACTIVE_BAND, BAND_2M);
+	checkTag(image, JOURNAL_TAG_2M_FREQUENCY, 144500000UL);
+	checkTag(image, JOURNAL_TAG_2M_POWER_LEVEL_MW, 250);
+	checkTag(image, JOURNAL_TAG_80M_FREQUENCY, 3520000UL);
+	checkTag(image, JOURNAL_TAG_80M_POWER_LEVEL_MW, 1500);
+	checkTag(image, JOURNAL_TAG_RTTY_OFFSET_FREQUENCY, 600);
+	checkTag(image, JOURNAL_TAG_AM_DRIVE_LEVEL_HIGH, 0xE0);
+	checkTag(image, JOURNAL_TAG_AM_DRIVE_LEVEL_LOW, 0x20);
+	checkTag(image, JOURNAL_TAG_2M_MODULATION, MODE_CW);
+
+	checkText(image, JOURNAL_TAG_STATION_ID_TEXT, "DE W1AW/FOX-NUMBER-1");
+	checkText(image, JOURNAL_TAG_PATTERN_TEXT, "MOS");
+	checkTag(image, JOURNAL_TAG_PATTERN_CODESPEED, 10);
+	checkTag(image, JOURNAL_TAG_ID_CODESPEED, 18);
+	checkTag(image, JOURNAL_TAG_ON_AIR_TIME, 30);
+	checkTag(image, JOURNAL_TAG_OFF_AIR_TIME, 90);
+	checkTag(image, JOURNAL_TAG_INTRA_CYCLE_DELAY_TIME, 45);
+	checkTag(image, JOURNAL_TAG_ID_TIME, 300);
+	checkTag(image, JOURNAL_TAG_EVENT_START_TIME, 1600000000UL);
+	checkTag(image, JOURNAL_TAG_EVENT_FINISH_TIME, 1600003600UL);
+	checkTag(image, JOURNAL_TAG_BATTERY_EMPTY_MV, 3350);
+	checkTag(image, JOURNAL_TAG_CLOCK_OSCCAL, 0x9C);
+
+	CHECK(!memcmp(saved, ee->power_tables, sizeof(saved)), "%s: power tables changed", image);
+	CHECK(ee->interface_flag != LEGACY2_INITIALIZED_FLAG, "%s: interface flag not cleared", image);
+	CHECK(ee->transmitter_flag == LEGACY2_INITIALIZED_FLAG, "%s: power table flag cleared", image);
+	printf("%s: migrated\n", image);
+}
+
+#else   /* RECEIVER_FIRMWARE */
+
+/* The EEMEM variables of main.c, then receiver.c, in declaration order */
+typedef struct __attribute__((packed))
+{
+	uint8_t interface_flag;
+	uint8_t tone_volume_setting;
+	uint8_t main_volume_setting;
+	uint8_t audio_RSSI_setting;
+	uint8_t tone_RSSI_direction_setting;
+	uint8_t rssi_filter_setting;
+
+	uint8_t receiver_flag;
+	int32_t si5351_ref_correction;
+	uint8_t active_band;
+	uint32_t active_2m_frequency;
+	uint32_t active_80m_frequency;
+	uint32_t cw_offset_frequency;
+	uint8_t preamp_80m;
+	uint8_t preamp_2m;
+	uint8_t attenuation_setting;
+	uint32_t memories_2m[5];
+	uint32_t memories_80m[5];
+} ReceiverLayout;
+
+static void checkLayout(void)
+{
+	const char* image = "receiver layout";
+	ReceiverLayout* ee = (ReceiverLayout*)g_eeprom;
+	uint8_t i;
+
+	CHECK((uintptr_t)LEGACY_2M_MEMORIES == offsetof(ReceiverLayout, memories_2m), "%s: 2m memories pinned at 0x%03X, were at 0x%03X", image, (unsigned)(uintptr_t)LEGACY_2M_MEMORIES, (unsigned)offsetof(ReceiverLayout, memories_2m));
+	CHECK((uintptr_t)LEGACY_80M_MEMORIES == offsetof(ReceiverLayout, memories_80m), "%s: 80m memories pinned at 0x%03X, were at 0x%03X", image, (unsigned)(uintptr_t)LEGACY_80M_MEMORIES, (unsigned)offsetof(ReceiverLayout, memories_80m));
+
+	memset(g_eeprom, 0xFF, sizeof(g_eeprom));
+	ee->interface_flag = EEPROM_INITIALIZED_FLAG;
+	ee->tone_volume_setting = 7;
+	ee->main_volume_setting = 9;
+	ee->audio_RSSI_setting = 1;
+	ee->tone_RSSI_direction_setting = 0;
+	ee->rssi_filter_setting = 2;
+
+	ee->receiver_flag = EEPROM_INITIALIZED_FLAG;
+	ee->si5351_ref_correction = -4321;
+	ee->active_band = BAND_80M;
+	ee->active_2m_frequency = 146520000UL;
+	ee->active_80m_frequency = 3560000UL;
+	ee->cw_offset_frequency = 700;
+	ee->preamp_80m = 1;
+	ee->preamp_2m = 0;
+	ee->attenuation_setting = 40;
+
+	for(i = 0; i < 5; i++)
+	{
+		ee->memories_2m[i] = 144000000UL + i;
+		ee->memories_80m[i] = 3500000UL + i;
+	}
+
+	migrate(image);
+
+	checkTag(image, JOURNAL_TAG_TONE_VOLUME, 7);
+	checkTag(image, JOURNAL_TAG_MAIN_VOLUME, 9);
+	checkTag(image, JOURNAL_TAG_AUDIO_RSSI, 1);
+	checkTag(image, JOURNAL_TAG_TONE_RSSI_DIRECTION, 0);
+	checkTag(image, JOURNAL_TAG_RSSI_FILTER, 2);
+	checkTag(image, JOURNAL_TAG_SI5351_REF_CORRECTION, (uint32_t)-4321L);
+	checkTag(image, JOURNAL_TAG_ACTIVE_BAND, BAND_80M);
+	checkTag(image, JOURNAL_TAG_2M_FREQUENCY, 146520000UL);
+	checkTag(image, JOURNAL_TAG_80M_FREQUENCY, 3560000UL);
+	checkTag(image, JOURNAL_TAG_CW_OFFSET_FREQUENCY, 700);
+	checkTag(image, JOURNAL_TAG_PREAMP_80M, 1);
+	checkTag(image, JOURNAL_TAG_PREAMP_2M, 0);
+	checkTag(image, JOURNAL_TAG_ATTENUATION, 40);
+
+	for(i = 0; i < 5; i++)
+	{
+		CHECK(ee->memories_2m[i] == 144000000UL + i, "%s: 2m memory %u changed", image, i + 1);
+		CHECK(ee->memories_80m[i] == 3500000UL + i, "%s: 80m memory %u changed", image, i + 1);
+	}
+
+	CHECK(ee->interface_flag != EEPROM_INITIALIZED_FLAG, "%s: interface flag not cleared", image);
+	CHECK(ee->receiver_flag == EEPROM_INITIALIZED_FLAG, "%s: memory flag cleared", image);
+	printf("%s: migrated\n", image);
+}
+
+#endif  /* RECEIVER_FIRMWARE */
+
+int main(int argc, char* argv[])
+{
+	checkBlank();
+
+#ifndef RECEIVER_FIRMWARE
+	if(argc < 2)
+	{
+		printf("usage: %s RDP.eep\n", argv[0]);
+		return( EXIT_FAILURE);
+	}
+
+	checkLayout1(argv[1]);
+	checkLayout2();
+#else
+	checkLayout();
+#endif
+
+	printf("%s: %d failure(s)\n", argv[0], g_failures);
+	return( g_failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
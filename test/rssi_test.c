@@ -0,0 +1,233 @@
+/*
+ * rssi_test.c
+ *
+ * Replays RSSI traces through the receiver's rssi_filter() and checks each filter profile:
+ *
+ * - the output never leaves the range of the readings that produced it (no overflow or wrap)
+ * - filter 0 passes readings through unchanged
+ * - the smoothing filters rise faster than they fall
+ * - the smoothing filters reduce reading-to-reading jitter
+ * - the peak is held within RSSI_PEAK_TOLERANCE_MV of the peak of the raw readings' running
+ *   median, which ignores impulse noise
+ *
+ * Each filter's lag is reported from the full-scale step, as the time its output takes to reach
+ * half the step (the half-rise point). The traces are noisy enough that lag measured from them
+ * would mostly measure the noise.
+ *
+ * Trace files hold one reading per line, in millivolts at the RSSI pin, at the ADC sequence
+ * rate of about 100 readings per second. Lines starting with '#' are comments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rssi.h"
+
+#define MAX_TRACE_LENGTH 4096
+#define STEP_LENGTH 512
+#define READINGS_PER_SECOND 100
+#define RSSI_PEAK_TOLERANCE_MV 75   /* 3 dB at the log detector's ~25 mV/dB slope */
+#define PEAK_REFERENCE_LENGTH 9     /* raw readings in the running median that gives the reference peak */
+
+static uint16_t g_trace[MAX_TRACE_LENGTH];
+static uint16_t g_filtered[MAX_TRACE_LENGTH];
+static int g_failures = 0;
+
+#define CHECK(cond, ...) do { if(!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); g_failures++; } } while(0)
+
+/**
+ * Runs readings through filter, starting it afresh from the first reading.
+ */
+static void replay(const uint16_t* readings, int length, uint8_t filter, uint16_t* out)
+{
+	int i;
+
+	rssi_filter(readings[0], (filter + 1) % NUMBER_OF_RSSI_FILTERS);  /* a change of filter restarts it */
+
+	for(i = 0; i < length; i++)
+	{
+		out[i] = rssi_filter(readings[i], filter);
+	}
+}
+
+static int loadTrace(const char* path, uint16_t* readings)
+{
+	char line[64];
+	int length = 0;
+	FILE* f = fopen(path, "r");
+
+	if(!f)
+	{
+		printf("FAIL: cannot open %s\n", path);
+		g_failures++;
+		return( 0);
+	}
+
+	while(fgets(line, sizeof(line), f) && (length < MAX_TRACE_LENGTH))
+	{
+		if((line[0] == '#') || (line[0] == '\n'))
+		{
+			continue;
+		}
+
+		readings[length++] = (uint16_t)atoi(line);
+	}
+
+	fclose(f);
+	return( length);
+}
+
+static int compareReadings(const void* a, const void* b)
+{
+	return( (int)*(const uint16_t*)a - (int)*(const uint16_t*)b);
+}
+
+/**
+ * Mean absolute difference between successive values.
+ */
+static double jitter(const uint16_t* v, int length)
+{
+	double sum = 0;
+	int i;
+
+	for(i = 1; i < length; i++)
+	{
+		sum += abs((int)v[i] - (int)v[i - 1]);
+	}
+
+	return( sum / (length - 1));
+}
+
+static void checkBounds(const char* name, const uint16_t* readings, const uint16_t* out, int length, uint8_t filter)
+{
+	uint16_t lo = readings[0], hi = readings[0];
+	int i;
+
+	for(i = 0; i < length; i++)
+	{
+		lo = (readings[i] < lo) ? readings[i] : lo;
+		hi = (readings[i] > hi) ? readings[i] : hi;
+
+		if((out[i] < lo) || (out[i] > hi))
+		{
+			CHECK(0, "%s filter %u: reading %d gave %u mV, outside %u..%u mV", name, filter, i, out[i], lo, hi);
+			return;
+		}
+	}
+}
+
+static void replayTrace(const char* path)
+{
+	const char* name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	int length = loadTrace(path, g_trace);
+	int i, peakAt = 0;
+	uint16_t window[PEAK_REFERENCE_LENGTH], refPeak = 0;
+	double rawJitter;
+	uint8_t filter;
+
+	if(length < PEAK_REFERENCE_LENGTH)
+	{
+		CHECK(length, "%s: no readings", name);
+		return;
+	}
+
+	for(i = 0; i + PEAK_REFERENCE_LENGTH <= length; i++)
+	{
+		memcpy(window, &g_trace[i], sizeof(window));
+		qsort(window, PEAK_REFERENCE_LENGTH, sizeof(uint16_t), compareReadings);
+
+		if(window[PEAK_REFERENCE_LENGTH / 2] > refPeak)
+		{
+			refPeak = window[PEAK_REFERENCE_LENGTH / 2];
+			peakAt = i + PEAK_REFERENCE_LENGTH / 2;
+		}
+	}
+
+	rawJitter = jitter(g_trace, length);
+	printf("%s: %d readings, median peak %u mV at %d ms, jitter %.1f mV\n", name, length, refPeak, peakAt * 1000 / READINGS_PER_SECOND, rawJitter);
+	printf("  filter  peak mV  jitter mV\n");
+
+	for(filter = 0; filter < NUMBER_OF_RSSI_FILTERS; filter++)
+	{
+		uint16_t peak = 0;
+
+		replay(g_trace, length, filter, g_filtered);
+		checkBounds(name, g_trace, g_filtered, length, filter);
+
+		for(i = 0; i < length; i++)
+		{
+			peak = MAX(peak, g_filtered[i]);
+		}
+
+		printf("  %6u  %7u  %9.1f\n", filter, peak, jitter(g_filtered, length));
+
+		if(!filter)
+		{
+			CHECK(!memcmp(g_trace, g_filtered, length * sizeof(uint16_t)), "%s: filter 0 altered the readings", name);
+			continue;
+		}
+
+		CHECK(jitter(g_filtered, length) < rawJitter, "%s filter %u: jitter not reduced", name, filter);
+		CHECK(peak + RSSI_PEAK_TOLERANCE_MV >= refPeak, "%s filter %u: peak %u mV is more than %u mV below %u mV", name, filter, peak, RSSI_PEAK_TOLERANCE_MV, refPeak);
+	}
+}
+
+/**
+ * Full-scale steps: the output must stay in range, settle, and rise faster than it falls.
+ */
+static void checkSteps(void)
+{
+	static uint16_t up[STEP_LENGTH], down[STEP_LENGTH], out[STEP_LENGTH];
+	uint8_t filter;
+	int i, halfRise, rise, fall;
+
+	for(i = 0; i < STEP_LENGTH; i++)
+	{
+		up[i] = (i < 16) ? 0 : RSSI_MAX_INPUT_MV;
+		down[i] = (i < 16) ? RSSI_MAX_INPUT_MV : 0;
+	}
+
+	for(filter = 1; filter < NUMBER_OF_RSSI_FILTERS; filter++)
+	{
+		replay(up, STEP_LENGTH, filter, out);
+		checkBounds("step up", up, out, STEP_LENGTH, filter);
+		CHECK(out[STEP_LENGTH - 1] + 2 >= RSSI_MAX_INPUT_MV, "step up filter %u: settled at %u mV", filter, out[STEP_LENGTH - 1]);
+
+		for(halfRise = 16; (halfRise < STEP_LENGTH) && (out[halfRise] < RSSI_MAX_INPUT_MV / 2); halfRise++)
+		{
+			;
+		}
+
+		for(rise = 16; (rise < STEP_LENGTH) && (out[rise] < RSSI_MAX_INPUT_MV * 9 / 10); rise++)
+		{
+			;
+		}
+
+		replay(down, STEP_LENGTH, filter, out);
+		checkBounds("step down", down, out, STEP_LENGTH, filter);
+		CHECK(out[STEP_LENGTH - 1] <= 2, "step down filter %u: settled at %u mV", filter, out[STEP_LENGTH - 1]);
+
+		for(fall = 16; (fall < STEP_LENGTH) && (out[fall] > RSSI_MAX_INPUT_MV / 10); fall++)
+		{
+			;
+		}
+
+		printf("step: filter %u lags %d ms (half rise), reaches 90%% in %d ms rising, %d ms falling\n", filter, (halfRise - 16) * 1000 / READINGS_PER_SECOND, (rise - 16) * 1000 / READINGS_PER_SECOND, (fall - 16) * 1000 / READINGS_PER_SECOND);
+		CHECK(rise < fall, "filter %u: rises no faster than it falls", filter);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int i;
+
+	checkSteps();
+
+	for(i = 1; i < argc; i++)
+	{
+		replayTrace(argv[i]);
+	}
+
+	printf("%s: %d failure(s)\n", argv[0], g_failures);
+	return( g_failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
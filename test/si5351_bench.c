@@ -0,0 +1,355 @@
+/*
+ * si5351_bench.c
+ *
+ * Host bench for the Si5351 frequency-plan math. The driver is compiled unchanged, talking to
+ * a register map in RAM in place of the I2C bus. Each scenario below sets one output across
+ * a range of frequencies, optionally after another output has pinned PLLB, and decodes the
+ * output frequency from the register image the driver wrote. The bench reports:
+ *
+ * - the distribution of achieved-minus-requested frequency error
+ * - PLLB sharing conflicts: register images the hardware cannot produce (a multisynth divider
+ *   below 8 other than an integer 4 or 6, or a denominator wider than 20 bits), and requests
+ *   the driver refused
+ * - time per call of multisynth_calc(), multisynth_estimate(), pll_calc() and reduce_by_gcd()
+ *   on the host, as a proxy for comparing versions of the math; it says nothing absolute about
+ *   the ATmega328P
+ *
+ * Build with -DRECEIVER_DRIVER against the receiver's copy of the driver, and with
+ * -DAPPLY_XTAL_CALIBRATION_VALUE to include the crystal correction; the first argument then
+ * gives the correction in parts per billion.
+ *
+ * Exits with failure if any scenario produced a register image the hardware cannot produce.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "defs.h"
+#include "i2c.h"
+#include "si5351.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define HAVE_CYCLE_COUNTER
+#endif
+
+/* The driver's private functions timed below */
+uint32_t multisynth_calc(Frequency_Hz, Union_si5351_regs *, BOOL *, BOOL *);
+Frequency_Hz multisynth_estimate(Frequency_Hz, Union_si5351_regs *, BOOL *, BOOL *);
+void reduce_by_gcd(uint32_t *, uint32_t *);
+Frequency_Hz reference_frequency(void);
+
+#if defined(RECEIVER_DRIVER) || defined(APPLY_XTAL_CALIBRATION_VALUE)
+	BOOL pll_calc(Frequency_Hz, Union_si5351_regs *, int32_t);
+	#define PLL_CALC(f, r) pll_calc(f, r, si5351_get_correction())
+#else
+	BOOL pll_calc(Frequency_Hz, Union_si5351_regs *);
+	#define PLL_CALC(f, r) pll_calc(f, r)
+#endif
+
+#ifdef RECEIVER_DRIVER
+	#define SET_FREQ(f, clk) si5351_set_freq(f, clk)
+#else
+	#define SET_FREQ(f, clk) si5351_set_freq(f, clk, FALSE)
+#endif
+
+typedef struct
+{
+	const char* name;
+	Frequency_Hz from;
+	Frequency_Hz to;
+	Frequency_Hz step;
+	Si5351_clock clk;
+	Frequency_Hz pinPLLB;   /* frequency first set on CLK1 so that PLLB is taken; zero to leave PLLB free */
+} Scenario;
+
+static const Scenario g_scenarios[] = {
+	{ "80 m, CLK1, PLLB free", 3500000, 4000000, 100, SI5351_CLK1, 0 },
+	{ "2 m, CLK0, PLLA", 144000000, 148000000, 500, SI5351_CLK0, 0 },
+	{ "2 m +10 kHz, CLK2, PLLB free", 144010000, 148010000, 500, SI5351_CLK2, 0 },
+	{ "2 m +10 kHz, CLK2, PLLB at 80 m", 144010000, 148010000, 500, SI5351_CLK2, 3550000 },
+	{ "80 m VFO +IF, CLK0, PLLA", 14200000, 14700000, 100, SI5351_CLK0, 0 },
+	{ "2 m VFO -IF, CLK0, PLLA", 133300000, 137300000, 500, SI5351_CLK0, 0 },
+	{ "10.7 MHz BFO, CLK2, PLLB free", 10690000, 10710000, 10, SI5351_CLK2, 0 },
+	{ "10.7 MHz BFO, CLK2, PLLB at 80 m", 10690000, 10710000, 10, SI5351_CLK2, 3550000 },
+};
+
+#define NUMBER_OF_SCENARIOS (sizeof(g_scenarios) / sizeof(g_scenarios[0]))
+
+/* Error histogram bucket limits, in Hz */
+static const double g_buckets[] = { 0.001, 0.1, 1.0, 10.0, 100.0, 1000.0, INFINITY };
+static const char* const g_bucketNames[] = { "exact", "<0.1", "<1", "<10", "<100", "<1k", ">=1k" };
+#define NUMBER_OF_BUCKETS (sizeof(g_buckets) / sizeof(g_buckets[0]))
+
+static uint8_t g_regs[256];
+
+/*
+ * The I2C bus: the Si5351 register map.
+ */
+void i2c_init(void)
+{
+}
+
+BOOL i2c_device_write(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2write)
+{
+	memcpy(&g_regs[addr], data, bytes2write);
+	return( FALSE);
+}
+
+BOOL i2c_device_read(uint8_t slaveAddr, uint8_t addr, uint8_t data[], uint8_t bytes2read)
+{
+	memcpy(data, &g_regs[addr], bytes2read);
+	return( FALSE);
+}
+
+/**
+ * Unpacks P1, P2 and P3 from the eight parameter registers starting at base.
+ */
+static void unpack(uint8_t base, uint32_t* p1, uint32_t* p2, uint32_t* p3)
+{
+	const uint8_t* r = &g_regs[base];
+
+	*p3 = ((uint32_t)(r[5] >> 4) << 16) | ((uint32_t)r[0] << 8) | r[1];
+	*p1 = ((uint32_t)(r[2] & 0x03) << 16) | ((uint32_t)r[3] << 8) | r[4];
+	*p2 = ((uint32_t)(r[5] & 0x0F) << 16) | ((uint32_t)r[6] << 8) | r[7];
+}
+
+/**
+ * Decodes the frequency of clk from the register map. Returns a negative value if the register
+ * image is one the hardware cannot produce.
+ */
+static double decode(Si5351_clock clk)
+{
+	uint8_t msBase = SI5351_CLK0_PARAMETERS + SI5351_PARAMETERS_LENGTH * clk;
+	uint8_t pllBase = (g_regs[SI5351_CLK0_CTRL + clk] & 0x20) ? SI5351_PLLB_PARAMETERS : SI5351_PLLA_PARAMETERS;
+	uint32_t p1, p2, p3;
+	double vco, divider;
+	uint8_t rDiv = (g_regs[msBase + 2] >> 4) & 0x07;
+
+	unpack(pllBase, &p1, &p2, &p3);
+
+	if(!p3)
+	{
+		return( -1);
+	}
+
+	vco = (double)reference_frequency() * (p1 + 512 + (double)p2 / p3) / 128;
+
+	if((vco < SI5351_PLL_VCO_MIN - 1) || (vco > SI5351_PLL_VCO_MAX + 1))
+	{
+		return( -1);
+	}
+
+	unpack(msBase, &p1, &p2, &p3);
+
+	if(((g_regs[msBase + 2] >> 2) & 0x03) == 0x03)
+	{
+		divider = 4;
+	}
+	else if(!p3)
+	{
+		return( -1);
+	}
+	else
+	{
+		divider = (p1 + 512 + (double)p2 / p3) / 128;
+
+		/* Below 8 the multisynth divides only by an integer 4 or 6 */
+		if((divider < 8) && (p2 || (p1 + 512) % 256))
+		{
+			return( -1);
+		}
+	}
+
+	return( vco / divider / (1 << rDiv));
+}
+
+static double now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return( t.tv_sec * 1e9 + t.tv_nsec);
+}
+
+static void pinPLLB(Frequency_Hz freq)
+{
+	si5351_init(SI5351_CRYSTAL_LOAD_10PF, 0);
+
+	if(freq)
+	{
+		SET_FREQ(freq, SI5351_CLK1);
+	}
+}
+
+/**
+ * Returns the number of register images the hardware cannot produce.
+ */
+static long runScenario(const Scenario* s)
+{
+	long histogram[NUMBER_OF_BUCKETS] = { 0 };
+	long count = 0, refused = 0, invalid = 0;
+	double worst = 0, sum = 0;
+	Frequency_Hz f, worstAt = 0;
+	unsigned i;
+
+	for(f = s->from; f <= s->to; f += s->step)
+	{
+		double achieved, error;
+		Frequency_Hz requested = (f > 999999) ? f / 100 * 100 : f;  /* the driver rounds to 100 Hz */
+
+		pinPLLB(s->pinPLLB);
+		count++;
+
+		if(SET_FREQ(f, s->clk))
+		{
+			refused++;
+			continue;
+		}
+
+		achieved = decode(s->clk);
+
+		if(achieved < 0)
+		{
+			invalid++;
+			continue;
+		}
+
+		error = fabs(achieved - requested);
+		sum += error;
+
+		if(error > worst)
+		{
+			worst = error;
+			worstAt = f;
+		}
+
+		for(i = 0; error >= g_buckets[i]; i++)
+		{
+			;
+		}
+
+		histogram[i]++;
+	}
+
+	printf("%-34s %6ld  max %9.3f Hz", s->name, count, worst);
+
+	if(worst >= g_buckets[0])
+	{
+		printf(" at %lu", (unsigned long)worstAt);
+	}
+
+	printf(", mean %.4f Hz\n   ", (count > refused + invalid) ? sum / (count - refused - invalid) : 0.0);
+
+	for(i = 0; i < NUMBER_OF_BUCKETS; i++)
+	{
+		printf(" %s:%ld", g_bucketNames[i], histogram[i]);
+	}
+
+	printf("  conflicts: %ld refused, %ld invalid\n", refused, invalid);
+
+	return( invalid);
+}
+
+#define TIMED_CALLS 200000
+
+static double g_startNs;
+#ifdef HAVE_CYCLE_COUNTER
+	static uint64_t g_startCycles;
+#endif
+
+static void startTiming(void)
+{
+#ifdef HAVE_CYCLE_COUNTER
+	g_startCycles = __rdtsc();
+#endif
+	g_startNs = now_ns();
+}
+
+static void stopTiming(const char* name)
+{
+	double ns = now_ns() - g_startNs;
+
+	printf("  %-22s %7.1f ns/call", name, ns / TIMED_CALLS);
+#ifdef HAVE_CYCLE_COUNTER
+	printf("  %7.1f cycles/call", (double)(__rdtsc() - g_startCycles) / TIMED_CALLS);
+#endif
+	printf("\n");
+}
+
+/**
+ * Times each of the plan functions over the frequencies they see in use. The results are
+ * accumulated so that the calls cannot be optimized away.
+ */
+static void timeFunctions(void)
+{
+	Union_si5351_regs reg;
+	BOOL intMode, divBy4;
+	volatile uint32_t sink = 0;
+	uint32_t b, c;
+	long i;
+
+	printf("host time per call, %d calls:\n", TIMED_CALLS);
+
+	startTiming();
+	for(i = 0; i < TIMED_CALLS; i++)
+	{
+		sink += multisynth_calc(144000000UL + (i % 8000) * 500, &reg, &intMode, &divBy4);
+	}
+	stopTiming("multisynth_calc()");
+
+	startTiming();
+	for(i = 0; i < TIMED_CALLS; i++)
+	{
+		sink += PLL_CALC(864000000UL + (i % 8000) * 3000, &reg) + reg.ms.p1;
+	}
+	stopTiming("pll_calc()");
+
+	pinPLLB(3550000);
+	startTiming();
+	for(i = 0; i < TIMED_CALLS; i++)
+	{
+		sink += multisynth_estimate(10690000UL + (i % 2000) * 10, &reg, &intMode, &divBy4);
+	}
+	stopTiming("multisynth_estimate()");
+
+	startTiming();
+	for(i = 0; i < TIMED_CALLS; i++)
+	{
+		b = (i * 7919) % SI5351_XTAL_FREQ;
+		c = SI5351_XTAL_FREQ;
+		reduce_by_gcd(&b, &c);
+		sink += b + c;
+	}
+	stopTiming("reduce_by_gcd()");
+}
+
+int main(int argc, char* argv[])
+{
+	long invalid = 0;
+	unsigned i;
+
+	if(argc > 1)
+	{
+		si5351_set_correction(atol(argv[1]));
+	}
+
+#ifdef RECEIVER_DRIVER
+	printf("Receiver Si5351 driver");
+#else
+	printf("Transmitter Si5351 driver");
+#endif
+	printf(", crystal correction %ld ppb\n", (long)si5351_get_correction());
+
+	for(i = 0; i < NUMBER_OF_SCENARIOS; i++)
+	{
+		invalid += runScenario(&g_scenarios[i]);
+	}
+
+	timeFunctions();
+
+	return( invalid ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for <avr/eeprom.h>. A test that uses the access functions defines them,
+ * over an array standing in for EEPROM.
+ */
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t* p);
+uint16_t eeprom_read_word(const uint16_t* p);
+uint32_t eeprom_read_dword(const uint32_t* p);
+void eeprom_read_block(void* dst, const void* src, size_t n);
+void eeprom_write_byte(uint8_t* p, uint8_t value);
+void eeprom_write_dword(uint32_t* p, uint32_t value);
+void eeprom_update_byte(uint8_t* p, uint8_t value);
+void eeprom_update_word(uint16_t* p, uint16_t value);
+void eeprom_update_dword(uint32_t* p, uint32_t value);
+void eeprom_update_block(const void* src, void* dst, size_t n);
+
+#endif  /* HOST_AVR_EEPROM_H_ */
@@ -0,0 +1,12 @@
+/*
+ * Host stand-in for <avr/interrupt.h>
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#define ISR(vector) void vector(void)
+#define cli()
+#define sei()
+
+#endif  /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for <avr/io.h>: just enough of the ATmega328P for firmware modules
+ * that do not touch hardware registers.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#define E2END 0x3FF     /* last EEPROM address */
+
+#endif  /* HOST_AVR_IO_H_ */
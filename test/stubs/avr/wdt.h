@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for <avr/wdt.h>
+ */
+
+#ifndef HOST_AVR_WDT_H_
+#define HOST_AVR_WDT_H_
+
+#define wdt_reset()
+
+#endif  /* HOST_AVR_WDT_H_ */
@@ -0,0 +1,11 @@
+/*
+ * Host stand-in for <util/delay.h>
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#define _delay_ms(ms)
+#define _delay_us(us)
+
+#endif  /* HOST_UTIL_DELAY_H_ */